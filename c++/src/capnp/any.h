@@ -97,6 +97,10 @@ struct AnyPointer {
     inline MessageSize targetSize() const;
     // Get the total size of the target object and all its children.
 
+    inline MessageSize targetSize(uint threadCount) const;
+    // Like targetSize(), but traverses independent subtrees on up to `threadCount` threads
+    // (including the calling one).  Useful for very large messages.
+
     inline PointerType getPointerType() const;
 
     inline bool isNull() const { return getPointerType() == PointerType::NULL_; }
@@ -458,6 +462,9 @@ public:
       : _reader(_::PointerHelpers<FromReader<T>>::getInternalReader(kj::fwd<T>(value))) {}
 
   inline MessageSize totalSize() const { return _reader.totalSize().asPublic(); }
+  inline MessageSize totalSize(uint threadCount) const {
+    return _reader.totalSize(threadCount).asPublic();
+  }
 
   kj::ArrayPtr<const byte> getDataSection() const {
     return _reader.getDataSectionAsBlob();
@@ -466,8 +473,8 @@ public:
     return List<AnyPointer>::Reader(_reader.getPointerSectionAsList());
   }
 
-  kj::Array<word> canonicalize() {
-    return _reader.canonicalize();
+  kj::Array<word> canonicalize(uint threadCount = 1) {
+    return _reader.canonicalize(threadCount);
   }
 
   Equality equals(AnyStruct::Reader right) const;
@@ -767,6 +774,10 @@ inline MessageSize AnyPointer::Reader::targetSize() const {
   return reader.targetSize().asPublic();
 }
 
+inline MessageSize AnyPointer::Reader::targetSize(uint threadCount) const {
+  return reader.targetSize(threadCount).asPublic();
+}
+
 inline PointerType AnyPointer::Reader::getPointerType() const {
   return reader.getPointerType();
 }
@@ -157,6 +157,61 @@ void ReaderArena::reportReadLimitReached() {
 
 // =======================================================================================
 
+LimitedArena::LimitedArena(SegmentReader& segment)
+    : inner(segment.arena), innerLimiter(segment.readLimiter),
+      budget(segment.readLimiter->readLimit()), readLimiter(bounded(budget) * WORDS) {}
+
+LimitedArena::~LimitedArena() noexcept(false) {}
+
+SegmentReader* LimitedArena::getSegment(SegmentReader* segment) {
+  KJ_IREQUIRE(segment->arena == inner);
+  return tryGetSegment(segment->id);
+}
+
+void LimitedArena::commit(kj::ArrayPtr<kj::Own<LimitedArena>> arenas) {
+  if (arenas.size() == 0) return;
+
+  // Each arena started with what the real limiter had left, so the total can exceed that (and
+  // even overflow) if several of them read a lot.
+  LimitedArena& first = *arenas[0];
+  uint64_t total = 0;
+  for (auto& arena: arenas) {
+    KJ_IREQUIRE(arena->inner == first.inner);
+    uint64_t charged = arena->budget - arena->readLimiter.readLimit();
+    if (charged > first.budget - total) {
+      first.inner->reportReadLimitReached();
+      return;
+    }
+    total += charged;
+  }
+
+  first.innerLimiter->canRead(bounded(total) * WORDS, first.inner);
+}
+
+SegmentReader* LimitedArena::tryGetSegment(SegmentId id) {
+  KJ_IF_SOME(segment, segments.find(id.value)) {
+    return segment;
+  }
+
+  SegmentReader* original = inner->tryGetSegment(id);
+  if (original == nullptr) {
+    return nullptr;
+  }
+
+  auto segment = kj::heap<SegmentReader>(
+      this, id, original->getStartPtr(), original->getSize(), &readLimiter);
+  SegmentReader* result = segment;
+  segments.insert(id.value, kj::mv(segment));
+  return result;
+}
+
+void LimitedArena::reportReadLimitReached() {
+  // Report it exactly as the mirrored arena would have.
+  inner->reportReadLimitReached();
+}
+
+// =======================================================================================
+
 BuilderArena::BuilderArena(MessageBuilder* message)
     : message(message), segment0(nullptr, SegmentId(0), nullptr, nullptr) {}
 
@@ -101,6 +101,8 @@ private:
 
   KJ_DISALLOW_COPY_AND_MOVE(ReadLimiter);
 
+  friend class LimitedArena;
+
   KJ_ALWAYS_INLINE(void setLimit(uint64_t newLimit)) {
 #if defined(__GNUC__) || defined(__clang__)
     __atomic_store_n(&limit, newLimit, __ATOMIC_RELAXED);
@@ -177,6 +179,7 @@ private:
   KJ_DISALLOW_COPY_AND_MOVE(SegmentReader);
 
   friend class SegmentBuilder;
+  friend class LimitedArena;
 
   [[noreturn]] static void abortCheckObjectFault();
   // Called in debug mode in cases that would segfault in opt mode. (Should be impossible!)
@@ -275,6 +278,39 @@ private:
   ReaderArena(MessageReader* message, const word* firstSegment, SegmentWordCount firstSegmentSize);
 };
 
+class LimitedArena final: public Arena {
+  // Presents the same segments as some other arena, but counts reads against a ReadLimiter of its
+  // own. ReadLimiter is not safe to charge from several threads at once -- concurrent charges can
+  // be lost -- so each thread of a parallel traversal reads through one of these instead, and the
+  // sum of what they read is charged to the real limiter afterwards, by commit().
+
+public:
+  explicit LimitedArena(SegmentReader& segment);
+  // Mirrors the arena `segment` belongs to. The budget is whatever `segment`'s read limiter has
+  // left.
+
+  ~LimitedArena() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(LimitedArena);
+
+  SegmentReader* getSegment(SegmentReader* segment);
+  // Returns this arena's counterpart of `segment`, which must belong to the mirrored arena.
+
+  static void commit(kj::ArrayPtr<kj::Own<LimitedArena>> arenas);
+  // Charges the real read limiter with everything read through `arenas`, which must all mirror
+  // the same arena, reporting the limit as reached if the total exceeds it.
+
+  // implements Arena ------------------------------------------------
+  SegmentReader* tryGetSegment(SegmentId id) override;
+  void reportReadLimitReached() override;
+
+private:
+  Arena* inner;
+  ReadLimiter* innerLimiter;
+  uint64_t budget;
+  ReadLimiter readLimiter;
+  kj::HashMap<uint, kj::Own<SegmentReader>> segments;
+};
+
 class BuilderArena final: public Arena {
   // A BuilderArena that does not allow the injection of capabilities.
 
@@ -34,6 +34,7 @@
 #include "capability.h"
 #include "test-util.h"
 #include <kj/debug.h>
+#include <kj/thread.h>
 #include <kj/compat/gtest.h>
 
 namespace capnp {
@@ -1473,6 +1474,88 @@ KJ_TEST("servers can be refcounted") {
   }
 }
 
+KJ_TEST("CrossThreadCapability delivers calls to the home thread") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  int callCount = 0;
+  int handleCount = 0;
+  test::TestMoreStuff::Client cap = kj::heap<TestMoreStuffImpl>(callCount, handleCount);
+  auto shared = shareAcrossThreads(cap);
+
+  // On the home thread, we just get the original capability back.
+  KJ_EXPECT(shared->isHomeThread());
+  KJ_EXPECT(shared->getHook().get() == ClientHook::from(kj::cp(cap)).get());
+
+  auto done = kj::newPromiseAndFulfiller<void>();
+  const kj::Executor& homeExecutor = kj::getCurrentThreadExecutor();
+
+  int workerCallCount = 0;
+  kj::Thread thread([&]() {
+    kj::EventLoop loop;
+    kj::WaitScope waitScope(loop);
+
+    KJ_EXPECT(!shared->isHomeThread());
+    auto client = shared->getClient<test::TestMoreStuff>();
+
+    // The home thread calls back into a capability hosted on this thread.
+    test::TestInterface::Client local = kj::heap<TestInterfaceImpl>(workerCallCount);
+    auto request = client.callFooRequest();
+    request.setCap(local);
+    auto promise = request.send();
+
+    // Pipelined calls work too, once the results arrive.
+    test::TestCallOrder::Client order = kj::heap<TestCallOrderImpl>();
+    auto echoRequest = client.echoRequest();
+    echoRequest.setCap(order);
+    auto echoPromise = echoRequest.send();
+    auto pipelinedPromise = echoPromise.getCap().getCallSequenceRequest().send();
+
+    KJ_EXPECT(promise.wait(waitScope).getS() == "bar");
+    KJ_EXPECT(pipelinedPromise.wait(waitScope).getN() == 0);
+
+    // A capability that went to the home thread and back unwraps to the original.
+    auto echoed = echoPromise.wait(waitScope).getCap();
+    KJ_EXPECT(ClientHook::from(kj::mv(echoed)).get() == ClientHook::from(kj::mv(order)).get());
+
+    homeExecutor.executeSync([&]() { done.fulfiller->fulfill(); });
+  });
+
+  done.promise.wait(waitScope);
+  KJ_EXPECT(callCount == 2);
+  KJ_EXPECT(workerCallCount == 1);
+}
+
+KJ_TEST("CrossThreadCapability released after its home thread exits is logged and dropped") {
+  kj::Own<const CrossThreadCapability> shared;
+  int callCount = 0;
+  int handleCount = 0;
+  bool destroyed = false;
+
+  {
+    kj::Thread thread([&]() {
+      kj::EventLoop loop;
+      kj::WaitScope waitScope(loop);
+      test::TestMoreStuff::Client cap = kj::heap<TestMoreStuffImpl>(callCount, handleCount)
+          .attach(kj::defer([&]() { destroyed = true; }));
+      shared = shareAcrossThreads(cap);
+    });
+  }
+
+  // This thread has no event loop, but can still ask.
+  KJ_EXPECT(!shared->isHomeThread());
+
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  {
+    KJ_EXPECT_LOG(ERROR, "outlived its home thread");
+    shared = nullptr;
+  }
+
+  // The capability was dropped rather than leaked.
+  KJ_EXPECT(destroyed);
+}
+
 }  // namespace
 }  // namespace _
 }  // namespace capnp
@@ -28,6 +28,7 @@
 #include <kj/debug.h>
 #include <kj/vector.h>
 #include <map>
+#include <atomic>
 #include "generated-header-support.h"
 
 namespace capnp {
@@ -1165,6 +1166,323 @@ void BuilderCapabilityTable::dropCap(uint index) {
   table[index] = kj::none;
 }
 
+// =======================================================================================
+// Cross-thread capabilities
+
+namespace {
+
+static const uint CROSS_THREAD_CAPABILITY_BRAND = 0;
+// Value is irrelevant; used for pointer.
+
+}  // namespace
+
+struct CrossThreadCapability::Payload {
+  // A params or results message on its way between threads, along with its capabilities.
+
+  kj::Own<MallocMessageBuilder> message;
+  kj::Array<kj::Maybe<kj::Own<const CrossThreadCapability>>> caps;
+};
+
+class CrossThreadCapability::ResponseImpl final: public ResponseHook, public kj::Refcounted {
+  // Results received on the calling thread.
+
+public:
+  ResponseImpl(Payload&& results)
+      : message(kj::mv(results.message)), capTable(receiveTable(results.caps)) {}
+
+  kj::Own<ResponseImpl> addRef() {
+    return kj::addRef(*this);
+  }
+
+  AnyPointer::Reader getRoot() {
+    return capTable.imbue(message->getRoot<AnyPointer>().asReader());
+  }
+
+private:
+  kj::Own<MallocMessageBuilder> message;
+  ReaderCapabilityTable capTable;
+};
+
+class CrossThreadCapability::PipelineImpl final: public PipelineHook, public kj::Refcounted {
+public:
+  PipelineImpl(kj::Own<ResponseImpl> response): response(kj::mv(response)) {}
+
+  kj::Own<PipelineHook> addRef() override {
+    return kj::addRef(*this);
+  }
+
+  kj::Own<ClientHook> getPipelinedCap(kj::ArrayPtr<const PipelineOp> ops) override {
+    return response->getRoot().getPipelinedCap(ops);
+  }
+
+private:
+  kj::Own<ResponseImpl> response;
+};
+
+class CrossThreadCapability::CallContextImpl final
+    : public CallContextHook, public kj::Refcounted {
+  // Runs on the home thread, delivering a call received from another thread to the capability.
+
+public:
+  CallContextImpl(Payload&& params)
+      : params(kj::mv(params.message)),
+        paramCaps(kj::heap<ReaderCapabilityTable>(receiveTable(params.caps))) {}
+
+  AnyPointer::Reader getParams() override {
+    KJ_REQUIRE(params.get() != nullptr, "Can't call getParams() after releaseParams().");
+    return paramCaps->imbue(params->getRoot<AnyPointer>().asReader());
+  }
+  void releaseParams() override {
+    params = nullptr;
+    paramCaps = nullptr;
+  }
+  AnyPointer::Builder getResults(kj::Maybe<MessageSize> sizeHint) override {
+    if (results.get() == nullptr) {
+      results = kj::heap<MallocMessageBuilder>(firstSegmentSize(sizeHint));
+      resultsRoot = resultCaps.imbue(results->getRoot<AnyPointer>());
+    }
+    return resultsRoot;
+  }
+  void setPipeline(kj::Own<PipelineHook>&& pipeline) override {
+    // The calling thread doesn't see the home thread's pipeline, so there's nothing to do.
+  }
+  kj::Promise<void> tailCall(kj::Own<RequestHook>&& request) override {
+    return directTailCall(kj::mv(request)).promise;
+  }
+  ClientHook::VoidPromiseAndPipeline directTailCall(kj::Own<RequestHook>&& request) override {
+    KJ_REQUIRE(results.get() == nullptr,
+               "Can't call tailCall() after initializing the results struct.");
+
+    // The results have to be copied back to the calling thread anyway, so a tail call is just
+    // a call whose results we copy into our own.
+    auto promise = request->send();
+    auto voidPromise = promise.then([this](Response<AnyPointer>&& response) {
+      getResults(response.targetSize()).set(response);
+    });
+    return { kj::mv(voidPromise), PipelineHook::from(kj::mv(promise)) };
+  }
+  kj::Promise<AnyPointer::Pipeline> onTailCall() override {
+    return kj::NEVER_DONE;
+  }
+  kj::Own<CallContextHook> addRef() override {
+    return kj::addRef(*this);
+  }
+
+  Payload finish() {
+    // Called once the call completes, to package up the results for the calling thread.
+
+    getResults(MessageSize { 0, 0 });
+    return { kj::mv(results), shareTable(resultCaps.getTable()) };
+  }
+
+private:
+  kj::Own<MallocMessageBuilder> params;
+  kj::Own<ReaderCapabilityTable> paramCaps;
+
+  kj::Own<MallocMessageBuilder> results;
+  BuilderCapabilityTable resultCaps;
+  AnyPointer::Builder resultsRoot = nullptr;  // only valid if `results` is non-null
+};
+
+class CrossThreadCapability::RequestImpl final: public RequestHook {
+public:
+  RequestImpl(kj::Own<const CrossThreadCapability> target,
+              uint64_t interfaceId, uint16_t methodId,
+              kj::Maybe<MessageSize> sizeHint, ClientHook::CallHints hints)
+      : target(kj::mv(target)), interfaceId(interfaceId), methodId(methodId), hints(hints),
+        message(kj::heap<MallocMessageBuilder>(firstSegmentSize(sizeHint))) {}
+
+  AnyPointer::Builder getRoot() {
+    return capTable.imbue(message->getRoot<AnyPointer>());
+  }
+
+  RemotePromise<AnyPointer> send() override {
+    KJ_REQUIRE(message.get() != nullptr, "Already called send() on this request.");
+
+    // The home thread's pipeline is never used, since pipelined calls wait for the results on
+    // this side. The results themselves are always needed.
+    auto homeHints = hints;
+    homeHints.noPromisePipelining = true;
+    homeHints.onlyPromisePipeline = false;
+
+    Payload params { kj::mv(message), shareTable(capTable.getTable()) };
+    auto promise = target->home->executeAsync(
+        [target = target->addRef(), interfaceId = interfaceId, methodId = methodId,
+         hints = homeHints, params = kj::mv(params)]() mutable {
+      // Now on the home thread.
+      auto context = kj::refcounted<CallContextImpl>(kj::mv(params));
+      auto promise = target->hook->call(interfaceId, methodId, kj::addRef(*context), hints).promise;
+      return promise.then([context = kj::mv(context)]() mutable {
+        return context->finish();
+      });
+    });
+
+    auto forked = promise.then([](Payload&& results) {
+      return kj::refcounted<ResponseImpl>(kj::mv(results));
+    }).fork();
+
+    // Note that the fork hub keeps the call running as long as either branch exists.
+    auto pipeline = forked.addBranch()
+        .then([](kj::Own<ResponseImpl>&& response) -> kj::Own<PipelineHook> {
+      return kj::refcounted<PipelineImpl>(kj::mv(response));
+    });
+    auto response = forked.addBranch().then([](kj::Own<ResponseImpl>&& response) {
+      auto reader = response->getRoot();
+      return Response<AnyPointer>(reader, kj::mv(response));
+    });
+
+    return RemotePromise<AnyPointer>(kj::mv(response),
+        AnyPointer::Pipeline(newLocalPromisePipeline(kj::mv(pipeline))));
+  }
+
+  kj::Promise<void> sendStreaming() override {
+    // Executor calls to the same thread are delivered in order, and there's no network latency
+    // to hide, so streaming calls need no special treatment.
+    return send().ignoreResult();
+  }
+
+  AnyPointer::Pipeline sendForPipeline() override {
+    return AnyPointer::Pipeline(PipelineHook::from(send()));
+  }
+
+  const void* getBrand() override {
+    return nullptr;
+  }
+
+private:
+  kj::Own<const CrossThreadCapability> target;
+  uint64_t interfaceId;
+  uint16_t methodId;
+  ClientHook::CallHints hints;
+
+  kj::Own<MallocMessageBuilder> message;
+  BuilderCapabilityTable capTable;
+};
+
+class CrossThreadCapability::ClientImpl final: public ClientHook, public kj::Refcounted {
+  // A client on some thread other than the capability's home thread.
+
+public:
+  ClientImpl(kj::Own<const CrossThreadCapability> target): target(kj::mv(target)) {}
+
+  Request<AnyPointer, AnyPointer> newCall(
+      uint64_t interfaceId, uint16_t methodId, kj::Maybe<MessageSize> sizeHint,
+      CallHints hints) override {
+    auto hook = kj::heap<RequestImpl>(target->addRef(), interfaceId, methodId, sizeHint, hints);
+    auto root = hook->getRoot();
+    return Request<AnyPointer, AnyPointer>(root, kj::mv(hook));
+  }
+
+  VoidPromiseAndPipeline call(uint64_t interfaceId, uint16_t methodId,
+                              kj::Own<CallContextHook>&& context, CallHints hints) override {
+    auto params = context->getParams();
+    auto request = newCall(interfaceId, methodId, params.targetSize(), hints);
+
+    request.set(params);
+    context->releaseParams();
+
+    return context->directTailCall(RequestHook::from(kj::mv(request)));
+  }
+
+  kj::Maybe<ClientHook&> getResolved() override {
+    return kj::none;
+  }
+
+  kj::Maybe<kj::Promise<kj::Own<ClientHook>>> whenMoreResolved() override {
+    return kj::none;
+  }
+
+  kj::Own<ClientHook> addRef() override {
+    return kj::addRef(*this);
+  }
+
+  const void* getBrand() override {
+    return &CROSS_THREAD_CAPABILITY_BRAND;
+  }
+
+  kj::Maybe<int> getFd() override {
+    // File descriptors aren't shared across threads this way.
+    return kj::none;
+  }
+
+  kj::Own<const CrossThreadCapability> target;
+};
+
+CrossThreadCapability::CrossThreadCapability(
+    kj::Own<ClientHook> hook, kj::Own<const kj::Executor> home)
+    : hook(kj::mv(hook)), home(kj::mv(home)) {}
+
+CrossThreadCapability::~CrossThreadCapability() noexcept(false) {
+  if (hook.get() == nullptr || isHomeThread()) return;
+
+  // The hook has to be dropped on its home thread, so box it up and send it there. (The box is a
+  // raw pointer because executeAsync() destroys the function itself back on this thread.)
+  //
+  // If the home thread's event loop is gone, the application broke the rule that the last
+  // reference must be dropped while the home thread is still running. There's no loop left to
+  // hand the hook to, so we report it (once per process, since it tends to happen for every
+  // capability at shutdown) and drop the hook right here.
+  if (home->isLive()) {
+    auto box = new kj::Own<ClientHook>(kj::mv(hook));
+    home->executeAsync([box]() { delete box; })
+        .detach([](kj::Exception&& e) {
+      // The event didn't run, so the home thread must have exited in the meantime.
+      KJ_LOG(ERROR, "CrossThreadCapability outlived its home thread's event loop", e);
+    });
+  } else {
+    static std::atomic<bool> reported(false);
+    if (!reported.exchange(true, std::memory_order_relaxed)) {
+      KJ_LOG(ERROR, "CrossThreadCapability outlived its home thread's event loop; dropping it on "
+                    "the current thread");
+    }
+    KJ_IF_SOME(e, kj::runCatchingExceptions([&]() { hook = nullptr; })) {
+      KJ_LOG(ERROR, "exception while dropping orphaned CrossThreadCapability", e);
+    }
+  }
+}
+
+kj::Own<ClientHook> CrossThreadCapability::getHook() const {
+  if (isHomeThread()) {
+    return hook->addRef();
+  } else {
+    return kj::refcounted<ClientImpl>(addRef());
+  }
+}
+
+bool CrossThreadCapability::isHomeThread() const {
+  return home->isCurrentThread();
+}
+
+kj::Own<const CrossThreadCapability> CrossThreadCapability::share(kj::Own<ClientHook> hook) {
+  if (hook->getBrand() == &CROSS_THREAD_CAPABILITY_BRAND) {
+    // Already a cross-thread client; share the original rather than wrapping it again.
+    return kj::downcast<ClientImpl>(*hook).target->addRef();
+  } else {
+    return kj::atomicRefcounted<CrossThreadCapability>(
+        kj::mv(hook), kj::getCurrentThreadExecutor().addRef());
+  }
+}
+
+kj::Array<kj::Maybe<kj::Own<const CrossThreadCapability>>> CrossThreadCapability::shareTable(
+    kj::ArrayPtr<kj::Maybe<kj::Own<ClientHook>>> table) {
+  return KJ_MAP(entry, table) -> kj::Maybe<kj::Own<const CrossThreadCapability>> {
+    return entry.map([](kj::Own<ClientHook>& cap) { return share(cap->addRef()); });
+  };
+}
+
+kj::Array<kj::Maybe<kj::Own<ClientHook>>> CrossThreadCapability::receiveTable(
+    kj::ArrayPtr<const kj::Maybe<kj::Own<const CrossThreadCapability>>> table) {
+  return KJ_MAP(entry, table) -> kj::Maybe<kj::Own<ClientHook>> {
+    return entry.map([](const kj::Own<const CrossThreadCapability>& cap) {
+      return cap->getHook();
+    });
+  };
+}
+
+kj::Own<const CrossThreadCapability> shareAcrossThreads(Capability::Client cap) {
+  return CrossThreadCapability::share(ClientHook::from(kj::mv(cap)));
+}
+
 // =======================================================================================
 // CapabilityServerSet
 
@@ -724,6 +724,69 @@ public:
   // accepts an lvalue input).
 };
 
+// =======================================================================================
+
+class CrossThreadCapability final: public kj::AtomicRefcounted {
+  // A thread-safe reference to a capability that lives on some particular thread's event loop
+  // (its "home" thread). Other threads can obtain Clients from it, whose calls are delivered to
+  // the home thread via its kj::Executor and executed there. Create one with
+  // `shareAcrossThreads()`.
+  //
+  // Call parameters and results are copied between threads in memory; they are not serialized.
+  // Capabilities within them are shared the same way, so a capability passed from thread A to
+  // thread B can be called from B, and if passed back to A it unwraps to the original. Promise
+  // pipelining is supported on the calling side, but pipelined calls wait for the results to
+  // arrive, since the home thread doesn't forward its pipeline.
+  //
+  // The last reference must be released on a thread that has an event loop, and before the home
+  // thread's event loop exits. If that is not the home thread, the underlying capability is handed
+  // back to the home thread to be dropped. Releasing it after the home thread's loop has exited is
+  // an error: it is logged (once per process) and the capability is dropped on the releasing
+  // thread instead, which is only safe if its destructor doesn't touch the dead loop.
+
+public:
+  CrossThreadCapability(kj::Own<ClientHook> hook, kj::Own<const kj::Executor> home);
+  ~CrossThreadCapability() noexcept(false);
+  // Use shareAcrossThreads() instead.
+
+  kj::Own<const CrossThreadCapability> addRef() const { return kj::atomicAddRef(*this); }
+
+  template <typename T = Capability>
+  typename T::Client getClient() const { return typename T::Client(getHook()); }
+  // Returns a client for the capability, usable on the current thread. On the home thread, this
+  // is just the original capability.
+
+  kj::Own<ClientHook> getHook() const;
+
+  bool isHomeThread() const;
+  // Is the calling thread the capability's home thread?
+
+private:
+  mutable kj::Own<ClientHook> hook;
+  // Only touched on the home thread.
+
+  kj::Own<const kj::Executor> home;
+
+  struct Payload;
+  class ClientImpl;
+  class RequestImpl;
+  class CallContextImpl;
+  class ResponseImpl;
+  class PipelineImpl;
+
+  static kj::Own<const CrossThreadCapability> share(kj::Own<ClientHook> hook);
+  static kj::Array<kj::Maybe<kj::Own<const CrossThreadCapability>>> shareTable(
+      kj::ArrayPtr<kj::Maybe<kj::Own<ClientHook>>> table);
+  static kj::Array<kj::Maybe<kj::Own<ClientHook>>> receiveTable(
+      kj::ArrayPtr<const kj::Maybe<kj::Own<const CrossThreadCapability>>> table);
+
+  friend kj::Own<const CrossThreadCapability> shareAcrossThreads(Capability::Client cap);
+};
+
+kj::Own<const CrossThreadCapability> shareAcrossThreads(Capability::Client cap);
+// Makes `cap` callable from other threads, with the calling thread as its home. Pass the result
+// (or addRef()s of it) to other threads and call getClient() there.
+
 // =======================================================================================
 // Hook interfaces which must be implemented by the RPC system.  Applications never call these
 // directly; the RPC system implements them and the types defined earlier in this file wrap them.
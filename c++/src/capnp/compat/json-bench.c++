@@ -0,0 +1,73 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks for JSON encoding and decoding. Run with `--benchmark-time <seconds>` to get useful
+// timings; by default each benchmark runs once, as a smoke test.
+
+#include "json.h"
+#include <capnp/test-util.h>
+#include <capnp/compat/json.capnp.h>
+#include <kj/debug.h>
+#include <kj/test.h>
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+KJ_TEST("benchmark: JSON encode and decode TestAllTypes") {
+  // Compares the direct text <-> struct paths against going through an intermediate JsonValue,
+  // which is what a Handler-heavy codec (or older versions of this library) would do.
+
+  MallocMessageBuilder message;
+  auto root = message.getRoot<TestAllTypes>();
+  initTestMessage(root);
+
+  JsonCodec json;
+  auto text = json.encode(root);
+
+  doBenchmark("encode, direct", text.size(), [&]() {
+    json.encode(root);
+  });
+
+  doBenchmark("encode, via JsonValue", text.size(), [&]() {
+    MallocMessageBuilder jsonMessage;
+    auto jsonValue = jsonMessage.initRoot<JsonValue>();
+    json.encode(root.asReader(), jsonValue);
+    json.encodeRaw(jsonValue);
+  });
+
+  doBenchmark("decode, direct", text.size(), [&]() {
+    MallocMessageBuilder decoded;
+    json.decode(text, decoded.initRoot<TestAllTypes>());
+  });
+
+  doBenchmark("decode, via JsonValue", text.size(), [&]() {
+    MallocMessageBuilder decoded;
+    MallocMessageBuilder jsonMessage;
+    auto jsonValue = jsonMessage.initRoot<JsonValue>();
+    json.decodeRaw(text, jsonValue);
+    json.decode(jsonValue, decoded.initRoot<TestAllTypes>());
+  });
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
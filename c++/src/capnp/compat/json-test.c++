@@ -24,6 +24,7 @@
 #include <capnp/compat/json.capnp.h>
 #include <capnp/compat/json-test.capnp.h>
 #include <kj/debug.h>
+#include <kj/io.h>
 #include <kj/string.h>
 #include <kj/test.h>
 
@@ -1029,6 +1030,154 @@ KJ_TEST("base64 union encoded correctly") {
   KJ_EXPECT(json.encode(root) == "{\"foo\": \"AAAAAAA=\"}", json.encode(root));
 }
 
+KJ_TEST("direct encoding matches encoding via JsonValue") {
+  JsonCodec json;
+  json.handleByAnnotation<TestJsonAnnotations>();
+
+  PrefixAdder customHandler;
+  json.addFieldHandler(Schema::from<TestJsonAnnotations>().getFieldByName("customFieldHandler"),
+                       customHandler);
+
+  auto expectSameEncoding = [&](DynamicStruct::Reader value) {
+    MallocMessageBuilder jsonMessage;
+    auto jsonValue = jsonMessage.initRoot<JsonValue>();
+    json.encode(value, value.getSchema(), jsonValue);
+    auto expected = json.encodeRaw(jsonValue);
+
+    auto encoded = json.encode(value);
+    KJ_EXPECT(encoded == expected, encoded, expected);
+
+    kj::VectorOutputStream stream;
+    json.encode(value, stream);
+    auto streamed = kj::heapString(stream.getArray().asChars());
+    KJ_EXPECT(streamed == expected, streamed, expected);
+  };
+
+  {
+    MallocMessageBuilder message;
+    auto root = message.getRoot<TestAllTypes>();
+    initTestMessage(root);
+    expectSameEncoding(root.asReader());
+
+    json.setHasMode(HasMode::NON_DEFAULT);
+    expectSameEncoding(root.asReader());
+    json.setHasMode(HasMode::NON_NULL);
+
+    // Big enough that the stream gets written to several times.
+    auto list = root.initInt32List(10000);
+    for (auto i: kj::indices(list)) list.set(i, i * 7919);
+    root.setTextField("escapes: \" \\ \b \f \n \r \t \x01 \x1f and UTF-8: \xe2\x98\x83");
+    expectSameEncoding(root.asReader());
+  }
+
+  {
+    MallocMessageBuilder message;
+    auto root = message.getRoot<test::TestUnion>();
+    root.getUnion0().setU0f1s32(1234567);
+    root.getUnion1().initU1f0sp(0);
+    expectSameEncoding(root.asReader());
+  }
+
+  {
+    MallocMessageBuilder message;
+    auto root = message.getRoot<TestJsonAnnotations>();
+    root.setSomeField("foo");
+
+    auto aGroup = root.getAGroup();
+    aGroup.setFlatFoo(123);
+    aGroup.setFlatBar("abc");
+    aGroup.getFlatBaz().setHello(true);
+    aGroup.getDoubleFlat().setFlatQux("cba");
+
+    auto prefixedGroup = root.getPrefixedGroup();
+    prefixedGroup.setFoo("def");
+    prefixedGroup.setBar(321);
+    prefixedGroup.getMorePrefix().setQux("fed");
+
+    auto unionBar = root.getAUnion().initBar();
+    unionBar.setBarMember(789);
+    unionBar.setMultiMember("ghi");
+
+    root.initDependency().setFoo("corge");
+    root.setEnums({ TestJsonAnnotatedEnum::QUX, TestJsonAnnotatedEnum::BAR });
+
+    auto arr = root.initInnerJson().initArray(2);
+    arr[0].setNumber(123);
+    arr[1].setString("hello");
+
+    root.setCustomFieldHandler("waldo");
+    root.setTestBase64("fred"_kj.asBytes());
+    root.setTestHex("plugh"_kj.asBytes());
+    root.getBUnion().setBar(678);
+    root.initExternalUnion().initBar().setValue("cba");
+    root.initUnionWithVoid().setVoidValue();
+
+    expectSameEncoding(root.asReader());
+  }
+}
+
+KJ_TEST("direct decoding matches decoding via JsonValue") {
+  JsonCodec json;
+
+  auto expectSameDecoding = [&](StructSchema schema, kj::StringPtr text) {
+    MallocMessageBuilder viaJsonMessage;
+    auto viaJson = viaJsonMessage.getRoot<DynamicStruct>(schema);
+    {
+      MallocMessageBuilder jsonMessage;
+      auto jsonValue = jsonMessage.initRoot<JsonValue>();
+      json.decodeRaw(text, jsonValue);
+      json.decode(jsonValue, viaJson);
+    }
+
+    MallocMessageBuilder directMessage;
+    auto direct = directMessage.getRoot<DynamicStruct>(schema);
+    json.decode(text, direct);
+
+    KJ_EXPECT(kj::str(direct) == kj::str(viaJson), direct, viaJson);
+  };
+
+  {
+    MallocMessageBuilder message;
+    auto root = message.getRoot<TestAllTypes>();
+    initTestMessage(root);
+    expectSameDecoding(Schema::from<TestAllTypes>(), json.encode(root));
+  }
+
+  expectSameDecoding(Schema::from<TestAllTypes>(), R"(
+    { "unknown": [1, {"a": [true, null, "A\"]"]}, -2.5e3],
+      "textField" : "tab\there é",
+      "int64Field": "-12", "uInt32Field": 7, "float32Field": null,
+      "structField": {"int8Field": -3, "unknown": {}, "structList": [{}, {"boolField": true}]},
+      "int32List": [], "textList": ["a", "b\nc"], "dataList": [[1, 2], []],
+      "enumList": ["foo", "garply"], "voidField": {"ignored": [1]} }  )");
+
+  {
+    json.handleByAnnotation<TestJsonAnnotations>();
+    PrefixAdder customHandler;
+    json.addFieldHandler(Schema::from<TestJsonAnnotations>().getFieldByName("customFieldHandler"),
+                         customHandler);
+    expectSameDecoding(Schema::from<TestJsonAnnotations>(), GOLDEN_ANNOTATED);
+    expectSameDecoding(Schema::from<TestJsonAnnotations>(), GOLDEN_ANNOTATED_REVERSE);
+  }
+
+  {
+    MallocMessageBuilder message;
+    auto root = message.getRoot<TestAllTypes>();
+    KJ_EXPECT_THROW_MESSAGE("Input remains", json.decode(R"({"boolField":true} {})", root));
+    KJ_EXPECT_THROW_MESSAGE("Unexpected input",
+        json.decode(R"({"structList":[{},]})", root));
+    KJ_EXPECT_THROW_MESSAGE("Invalid escape",
+        json.decode(R"({"unknown":"\q"})", root));
+
+    json.setMaxNestingDepth(2);
+    json.decode(R"({"structField":{"int8Field":1}})", root);
+    KJ_EXPECT_THROW_MESSAGE("nest",
+        json.decode(R"({"structField":{"structField":{}}})", root));
+    KJ_EXPECT_THROW_MESSAGE("nest",
+        json.decode(R"({"unknown":[[1]]})", root));
+  }
+}
+
 KJ_TEST("JSON encode bench") {
   // Example test based on basic json encoding benchmark.
   capnp::JsonCodec json;
@@ -191,31 +191,6 @@ void JsonCodec::setHasMode(HasMode mode) { impl->hasMode = mode; }
 
 void JsonCodec::setRejectUnknownFields(bool enabled) { impl->rejectUnknownFields = enabled; }
 
-kj::String JsonCodec::encode(DynamicValue::Reader value, Type type) const {
-  MallocMessageBuilder message(128);
-  // Use a smaller initial segment size, this significantly improves performance when encoding
-  // short strings.
-
-  auto json = message.getRoot<JsonValue>();
-  encode(value, type, json);
-  return encodeRaw(json);
-}
-
-void JsonCodec::decode(kj::ArrayPtr<const char> input, DynamicStruct::Builder output) const {
-  MallocMessageBuilder message;
-  auto json = message.getRoot<JsonValue>();
-  decodeRaw(input, json);
-  decode(json, output);
-}
-
-Orphan<DynamicValue> JsonCodec::decode(
-    kj::ArrayPtr<const char> input, Type type, Orphanage orphanage) const {
-  MallocMessageBuilder message;
-  auto json = message.getRoot<JsonValue>();
-  decodeRaw(input, json);
-  return decode(json, type, orphanage);
-}
-
 kj::String JsonCodec::encodeRaw(JsonValue::Reader value) const {
   bool multiline = false;
   return impl->encodeRaw(value, 0, multiline, false).flatten();
@@ -657,7 +632,7 @@ public:
   }
 
   void parseNumber(JsonValue::Builder& output) {
-    output.setNumber(consumeNumber().parseAs<double>());
+    output.setNumber(consumeNumber());
   }
 
   void parseString(JsonValue::Builder& output) {
@@ -745,7 +720,113 @@ public:
     input.consume('}');
   }
 
-  bool inputExhausted() { return input.exhausted(); }
+  bool inputExhausted() {
+    input.consumeWhitespace();
+    return input.exhausted();
+  }
+
+  // The methods below let JsonCodec::DirectDecoder walk the input token by token, decoding into
+  // Cap'n Proto builders as it goes rather than building a JsonValue. Each skips leading
+  // whitespace.
+
+  char peekToken() {
+    input.consumeWhitespace();
+    return input.nextChar();
+  }
+
+  void consumeToken(char expected) {
+    input.consumeWhitespace();
+    input.consume(expected);
+  }
+
+  void consumeLiteral(kj::StringPtr literal) {
+    input.consumeWhitespace();
+    input.consume(literal);
+  }
+
+  double parseNumberToken() {
+    input.consumeWhitespace();
+    return consumeNumber();
+  }
+
+  kj::StringPtr parseStringToken(kj::Vector<char>& buffer) {
+    // Decodes a string into `buffer`, which is reused across calls to avoid allocating. The
+    // returned pointer is only valid until the next call with the same buffer.
+
+    input.consumeWhitespace();
+    buffer.clear();
+    appendQuotedString(buffer);
+    buffer.add('\0');
+    return kj::StringPtr(buffer.begin(), buffer.size() - 1);
+  }
+
+  void enterNesting() {
+    KJ_REQUIRE(++nestingDepth <= maxNestingDepth, "JSON message nested too deeply.");
+  }
+  void leaveNesting() { --nestingDepth; }
+
+  void skipValue() {
+    // Consume one value of any type, checking its syntax but not storing it.
+
+    switch (peekToken()) {
+      case 'n': input.consume(kj::StringPtr("null"));  break;
+      case 'f': input.consume(kj::StringPtr("false")); break;
+      case 't': input.consume(kj::StringPtr("true"));  break;
+      case '"': skipQuotedString(); break;
+      case '[': {
+        input.consume('[');
+        enterNesting();
+        KJ_DEFER(leaveNesting());
+        bool expectComma = false;
+        while (peekToken() != ']') {
+          if (expectComma) consumeToken(',');
+          skipValue();
+          expectComma = true;
+        }
+        input.consume(']');
+        break;
+      }
+      case '{': {
+        input.consume('{');
+        enterNesting();
+        KJ_DEFER(leaveNesting());
+        bool expectComma = false;
+        while (peekToken() != '}') {
+          if (expectComma) consumeToken(',');
+          input.consumeWhitespace();
+          skipQuotedString();
+          consumeToken(':');
+          skipValue();
+          expectComma = true;
+        }
+        input.consume('}');
+        break;
+      }
+      case '-': case '0': case '1': case '2': case '3':
+      case '4': case '5': case '6': case '7': case '8':
+      case '9': consumeNumber(); break;
+      default: KJ_FAIL_REQUIRE("Unexpected input in JSON message.");
+    }
+  }
+
+  size_t countArrayElements() {
+    // Counts the elements of the array at the current position without consuming it, so that
+    // the caller can allocate a list of the right size up front.
+
+    Input saved = input;
+    KJ_DEFER(input = saved);
+
+    consumeToken('[');
+    enterNesting();
+    KJ_DEFER(leaveNesting());
+    size_t count = 0;
+    while (peekToken() != ']') {
+      if (count > 0) consumeToken(',');
+      skipValue();
+      ++count;
+    }
+    return count;
+  }
 
 private:
   kj::String consumeQuotedString() {
@@ -763,6 +844,54 @@ private:
 
     kj::Vector<char> decoded;
     decoded.addAll(initalString);
+    appendEscapedRemainder(decoded);
+    decoded.add('\0');
+
+    // TODO(perf): This copy can be eliminated, but I can't find the kj::wayToDoIt();
+    return kj::String(decoded.releaseAsArray());
+  }
+
+  void appendQuotedString(kj::Vector<char>& decoded) {
+    input.consume('"');
+    decoded.addAll(input.consumeWhile([](const char chr) {
+        return chr != '"' && chr != '\\';
+    }));
+    if (input.nextChar() == '"') {
+      input.advance();
+    } else {
+      appendEscapedRemainder(decoded);
+    }
+  }
+
+  void skipQuotedString() {
+    input.consume('"');
+    for (;;) {
+      input.consumeWhile([](const char chr) {
+          return chr != '"' && chr != '\\';
+      });
+      if (input.nextChar() == '"') break;
+
+      input.advance();
+      switch (input.nextChar()) {
+        case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+          input.advance();
+          break;
+        case 'u':
+          input.advance();
+          for (char c: input.consume(size_t(4))) {
+            KJ_REQUIRE(('0' <= c && c <= '9') || ('a' <= c && c <= 'f') || ('A' <= c && c <= 'F'),
+                       "Invalid hex digit in unicode escape.", c);
+          }
+          break;
+        default: KJ_FAIL_REQUIRE("Invalid escape in JSON string."); break;
+      }
+    }
+    input.consume('"');
+  }
+
+  void appendEscapedRemainder(kj::Vector<char>& decoded) {
+    // Finishes decoding a quoted string whose first escape sequence is next in the input,
+    // consuming the closing quote.
 
     do {
       auto stringValue = input.consumeWhile([](const char chr) {
@@ -793,13 +922,9 @@ private:
     } while(input.nextChar() != '"');
 
     input.consume('"');
-    decoded.add('\0');
-
-    // TODO(perf): This copy can be eliminated, but I can't find the kj::wayToDoIt();
-    return kj::String(decoded.releaseAsArray());
   }
 
-  kj::String consumeNumber() {
+  double consumeNumber() {
     auto numArrayPtr = input.consumeCustom([](Input& input) {
       input.tryConsume('-');
       if (!input.tryConsume('0')) {
@@ -819,8 +944,12 @@ private:
 
     KJ_REQUIRE(numArrayPtr.size() > 0, "Expected number in JSON input.");
 
-    return kj::heapString(numArrayPtr.begin(), numArrayPtr.size());
-    // TODO(perf): parse double here directly to avoid memory allocation
+    // parseAs() needs a NUL-terminated string; numbers are short, so copy to the stack rather
+    // than the heap.
+    KJ_STACK_ARRAY(char, text, numArrayPtr.size() + 1, 32, 256);
+    memcpy(text.begin(), numArrayPtr.begin(), numArrayPtr.size());
+    text[numArrayPtr.size()] = '\0';
+    return kj::StringPtr(text.begin(), numArrayPtr.size()).parseAs<double>();
   }
 
   // TODO(someday): This "interface" is ugly, and won't work if/when surrogates are handled.
@@ -869,6 +998,568 @@ void JsonCodec::decodeRaw(kj::ArrayPtr<const char> input, JsonValue::Builder out
   KJ_REQUIRE(parser.inputExhausted(), "Input remains after parsing JSON.");
 }
 
+// -----------------------------------------------------------------------------
+// Direct text <-> Cap'n Proto translation, skipping JsonValue
+
+class JsonCodec::DirectEncoder {
+  // Writes JSON text for Cap'n Proto values straight into a buffer. The text is identical to
+  // what encoding into a JsonValue and then calling encodeRaw() (without pretty-printing) would
+  // produce. If a stream is given, the buffer is written out to it each time it fills up.
+
+public:
+  explicit DirectEncoder(const JsonCodec& codec, kj::Maybe<kj::OutputStream&> stream = kj::none)
+      : codec(codec), stream(stream) {}
+
+  void encode(DynamicValue::Reader input, Type type) {
+    KJ_IF_SOME(handler, codec.impl->typeHandlers.find(type)) {
+      handler->encodeDirectBase(codec, input, *this);
+      return;
+    }
+
+    switch (type.which()) {
+      case schema::Type::VOID:
+        write("null"_kj);
+        break;
+      case schema::Type::BOOL:
+        write(input.as<bool>() ? "true"_kj : "false"_kj);
+        break;
+      case schema::Type::INT8:
+      case schema::Type::INT16:
+      case schema::Type::INT32:
+      case schema::Type::UINT8:
+      case schema::Type::UINT16:
+      case schema::Type::UINT32:
+        writeNumber(input.as<double>());
+        break;
+      case schema::Type::FLOAT32:
+      case schema::Type::FLOAT64:
+        {
+          double value = input.as<double>();
+          // Inf, -inf and NaN are not allowed in the JSON spec. Storing into string.
+          if (kj::inf() == value) {
+            writeString("Infinity");
+          } else if (-kj::inf() == value) {
+            writeString("-Infinity");
+          } else if (kj::isNaN(value)) {
+            writeString("NaN");
+          } else {
+            writeNumber(value);
+          }
+        }
+        break;
+      case schema::Type::INT64:
+        write('"');
+        writeNumber(input.as<int64_t>());
+        write('"');
+        break;
+      case schema::Type::UINT64:
+        write('"');
+        writeNumber(input.as<uint64_t>());
+        write('"');
+        break;
+      case schema::Type::TEXT:
+        writeString(input.as<Text>());
+        break;
+      case schema::Type::DATA: {
+        auto bytes = input.as<Data>();
+        write('[');
+        for (auto i: kj::indices(bytes)) {
+          if (i > 0) write(',');
+          writeNumber(uint(bytes[i]));
+        }
+        write(']');
+        break;
+      }
+      case schema::Type::LIST: {
+        auto list = input.as<DynamicList>();
+        auto elementType = type.asList().getElementType();
+        write('[');
+        for (auto i: kj::indices(list)) {
+          if (i > 0) write(',');
+          encode(list[i], elementType);
+        }
+        write(']');
+        break;
+      }
+      case schema::Type::ENUM: {
+        auto e = input.as<DynamicEnum>();
+        KJ_IF_SOME(symbol, e.getEnumerant()) {
+          writeString(symbol.getProto().getName());
+        } else {
+          writeNumber(e.getRaw());
+        }
+        break;
+      }
+      case schema::Type::STRUCT: {
+        auto structValue = input.as<capnp::DynamicStruct>();
+        auto hasMode = codec.impl->hasMode;
+
+        // We try to write the union field, if any, in proper order with the rest.
+        auto which = structValue.which();
+        bool unionFieldIsNull = false;
+
+        KJ_IF_SOME(field, which) {
+          // Even if the union field is null, if it is not the default field of the union then we
+          // have to print it anyway.
+          unionFieldIsNull = !structValue.has(field, hasMode);
+          if (field.getProto().getDiscriminantValue() == 0 && unionFieldIsNull) {
+            which = kj::none;
+          }
+        }
+
+        bool first = true;
+        write('{');
+        for (auto field: structValue.getSchema().getNonUnionFields()) {
+          KJ_IF_SOME(unionField, which) {
+            if (unionField.getIndex() < field.getIndex()) {
+              encodeUnionField(structValue, unionField, unionFieldIsNull, first);
+              which = kj::none;
+            }
+          }
+          if (structValue.has(field, hasMode)) {
+            writeFieldName(field.getProto().getName(), first);
+            encodeField(field, structValue.get(field));
+          }
+        }
+        KJ_IF_SOME(unionField, which) {
+          // Union field not printed yet; must be last.
+          encodeUnionField(structValue, unionField, unionFieldIsNull, first);
+        }
+        write('}');
+        break;
+      }
+      case schema::Type::INTERFACE:
+        KJ_FAIL_REQUIRE("don't know how to JSON-encode capabilities; "
+                        "please register a JsonCodec::Handler for this");
+      case schema::Type::ANY_POINTER:
+        KJ_FAIL_REQUIRE("don't know how to JSON-encode AnyPointer; "
+                        "please register a JsonCodec::Handler for this");
+    }
+  }
+
+  void encodeField(StructSchema::Field field, DynamicValue::Reader input) {
+    KJ_IF_SOME(handler, codec.impl->fieldHandlers.find(field)) {
+      handler->encodeDirectBase(codec, input, *this);
+      return;
+    }
+
+    encode(input, field.getType());
+  }
+
+  void encodeRaw(JsonValue::Reader value) {
+    switch (value.which()) {
+      case JsonValue::NULL_:
+        write("null"_kj);
+        return;
+      case JsonValue::BOOLEAN:
+        write(value.getBoolean() ? "true"_kj : "false"_kj);
+        return;
+      case JsonValue::NUMBER:
+        writeNumber(value.getNumber());
+        return;
+      case JsonValue::STRING:
+        writeString(value.getString());
+        return;
+
+      case JsonValue::ARRAY: {
+        auto array = value.getArray();
+        write('[');
+        for (auto i: kj::indices(array)) {
+          if (i > 0) write(',');
+          encodeRaw(array[i]);
+        }
+        write(']');
+        return;
+      }
+
+      case JsonValue::OBJECT: {
+        bool first = true;
+        write('{');
+        for (auto field: value.getObject()) {
+          writeFieldName(field.getName(), first);
+          encodeRaw(field.getValue());
+        }
+        write('}');
+        return;
+      }
+
+      case JsonValue::CALL: {
+        auto call = value.getCall();
+        auto params = call.getParams();
+        write(call.getFunction());
+        write('(');
+        for (auto i: kj::indices(params)) {
+          if (i > 0) write(',');
+          encodeRaw(params[i]);
+        }
+        write(')');
+        return;
+      }
+
+      case JsonValue::RAW:
+        write(value.getRaw());
+        return;
+    }
+
+    KJ_FAIL_ASSERT("unknown JsonValue type", static_cast<uint>(value.which()));
+  }
+
+  void writeFieldName(kj::StringPtr name, bool& first) {
+    // Writes the name of an object member, preceded by a comma unless `first` is set.
+
+    if (!first) write(',');
+    first = false;
+    writeString(name);
+    write(':');
+  }
+
+  void writeString(kj::StringPtr chars) {
+    // Same escaping as Impl::encodeString(), but copying each run of plain characters in one go.
+
+    static const char HEXDIGITS[] = "0123456789abcdef";
+    write('"');
+    const char* runStart = chars.begin();
+    for (const char* pos = chars.begin(); pos != chars.end(); ++pos) {
+      char c = *pos;
+      if (static_cast<uint8_t>(c) >= 0x20 && c != '\"' && c != '\\') continue;
+
+      write(kj::arrayPtr(runStart, pos));
+      runStart = pos + 1;
+      switch (c) {
+        case '\"': write("\\\""_kj); break;
+        case '\\': write("\\\\"_kj); break;
+        case '\b': write("\\b"_kj); break;
+        case '\f': write("\\f"_kj); break;
+        case '\n': write("\\n"_kj); break;
+        case '\r': write("\\r"_kj); break;
+        case '\t': write("\\t"_kj); break;
+        default: {
+          write("\\u00"_kj);
+          uint8_t c2 = c;
+          write(HEXDIGITS[c2 / 16]);
+          write(HEXDIGITS[c2 % 16]);
+          break;
+        }
+      }
+    }
+    write(kj::arrayPtr(runStart, chars.end()));
+    write('"');
+  }
+
+  template <typename T>
+  void writeNumber(T value) {
+    auto text = kj::toCharSequence(value);
+    write(kj::arrayPtr(text.begin(), text.size()));
+  }
+
+  void write(char c) { buffer.add(c); }
+  void write(kj::StringPtr text) { write(text.asArray()); }
+  void write(kj::ArrayPtr<const char> text) {
+    buffer.addAll(text);
+    KJ_IF_SOME(s, stream) {
+      if (buffer.size() >= FLUSH_THRESHOLD) {
+        s.write(buffer.begin(), buffer.size());
+        buffer.clear();
+      }
+    }
+  }
+
+  kj::String finishString() {
+    KJ_ASSERT(stream == kj::none);
+    buffer.add('\0');
+    return kj::String(buffer.releaseAsArray());
+  }
+
+  void flush() {
+    auto& s = KJ_ASSERT_NONNULL(stream);
+    if (buffer.size() > 0) {
+      s.write(buffer.begin(), buffer.size());
+      buffer.clear();
+    }
+  }
+
+private:
+  static constexpr size_t FLUSH_THRESHOLD = 8192;
+
+  const JsonCodec& codec;
+  kj::Maybe<kj::OutputStream&> stream;
+  kj::Vector<char> buffer;
+
+  void encodeUnionField(DynamicStruct::Reader structValue, StructSchema::Field field,
+                        bool isNull, bool& first) {
+    writeFieldName(field.getProto().getName(), first);
+    if (isNull) {
+      write("null"_kj);
+    } else {
+      encodeField(field, structValue.get(field));
+    }
+  }
+};
+
+class JsonCodec::DirectDecoder {
+  // Parses JSON text straight into Cap'n Proto builders. A value covered by a Handler is parsed
+  // into a scratch JsonValue and passed to the handler, since that is the interface handlers
+  // implement; everything else is decoded as it is parsed.
+
+public:
+  DirectDecoder(const JsonCodec& codec, Parser& parser): codec(codec), parser(parser) {}
+
+  void decodeStruct(DynamicStruct::Builder output) {
+    auto type = output.getSchema();
+
+    KJ_IF_SOME(handler, codec.impl->typeHandlers.find(type)) {
+      MallocMessageBuilder message;
+      return handler->decodeStructBase(codec, parseJsonValue(message), output);
+    }
+
+    decodeObject(output);
+  }
+
+  Orphan<DynamicValue> decode(Type type, Orphanage orphanage) {
+    KJ_IF_SOME(handler, codec.impl->typeHandlers.find(type)) {
+      MallocMessageBuilder message;
+      return handler->decodeBase(codec, parseJsonValue(message), type, orphanage);
+    }
+
+    switch(type.which()) {
+      case schema::Type::VOID:
+        parser.skipValue();
+        return capnp::VOID;
+      case schema::Type::BOOL:
+        switch (parser.peekToken()) {
+          case 't':
+            parser.consumeLiteral("true");
+            return true;
+          case 'f':
+            parser.consumeLiteral("false");
+            return false;
+          default:
+            KJ_FAIL_REQUIRE("Expected boolean value");
+        }
+      case schema::Type::INT8:
+      case schema::Type::INT16:
+      case schema::Type::INT32:
+      case schema::Type::INT64: {
+        // Relies on range check in DynamicValue::Reader::as<IntType>
+        char c = parser.peekToken();
+        if (c == '"') {
+          return parser.parseStringToken(text).parseAs<int64_t>();
+        }
+        KJ_REQUIRE(isNumberStart(c), "Expected integer value");
+        return parser.parseNumberToken();
+      }
+      case schema::Type::UINT8:
+      case schema::Type::UINT16:
+      case schema::Type::UINT32:
+      case schema::Type::UINT64: {
+        // Relies on range check in DynamicValue::Reader::as<IntType>
+        char c = parser.peekToken();
+        if (c == '"') {
+          return parser.parseStringToken(text).parseAs<uint64_t>();
+        }
+        KJ_REQUIRE(isNumberStart(c), "Expected integer value");
+        return parser.parseNumberToken();
+      }
+      case schema::Type::FLOAT32:
+      case schema::Type::FLOAT64: {
+        char c = parser.peekToken();
+        if (c == 'n') {
+          parser.consumeLiteral("null");
+          return kj::nan();
+        } else if (c == '"') {
+          return parser.parseStringToken(text).parseAs<double>();
+        }
+        KJ_REQUIRE(isNumberStart(c), "Expected float value");
+        return parser.parseNumberToken();
+      }
+      case schema::Type::TEXT:
+        KJ_REQUIRE(parser.peekToken() == '"', "Expected text value") {
+          parser.skipValue();
+          return orphanage.newOrphan<Text>(0);
+        }
+        return orphanage.newOrphanCopy(Text::Reader(parser.parseStringToken(text)));
+      case schema::Type::DATA: {
+        KJ_REQUIRE(parser.peekToken() == '[', "Expected data value") {
+          parser.skipValue();
+          return orphanage.newOrphan<Data>(0);
+        }
+        auto orphan = orphanage.newOrphan<Data>(parser.countArrayElements());
+        auto data = orphan.get();
+        parser.consumeToken('[');
+        parser.enterNesting();
+        KJ_DEFER(parser.leaveNesting());
+        for (auto i: kj::indices(data)) {
+          if (i > 0) parser.consumeToken(',');
+          auto x = parser.parseNumberToken();
+          KJ_REQUIRE(byte(x) == x, "Number in byte array is not an integer in [0, 255]");
+          data[i] = x;
+        }
+        parser.consumeToken(']');
+        return kj::mv(orphan);
+      }
+      case schema::Type::LIST:
+        KJ_REQUIRE(parser.peekToken() == '[', "Expected list value") {
+          parser.skipValue();
+          return orphanage.newOrphan(type.asList(), 0);
+        }
+        return decodeArray(type.asList(), orphanage);
+      case schema::Type::ENUM:
+        KJ_REQUIRE(parser.peekToken() == '"', "Expected enum value") {
+          parser.skipValue();
+          return DynamicEnum(type.asEnum(), 0);
+        }
+        return DynamicEnum(type.asEnum().getEnumerantByName(parser.parseStringToken(text)));
+      case schema::Type::STRUCT: {
+        auto orphan = orphanage.newOrphan(type.asStruct());
+        decodeObject(orphan.get());
+        return kj::mv(orphan);
+      }
+      case schema::Type::INTERFACE:
+        KJ_FAIL_REQUIRE("don't know how to JSON-decode capabilities; "
+                        "please register a JsonCodec::Handler for this");
+      case schema::Type::ANY_POINTER:
+        KJ_FAIL_REQUIRE("don't know how to JSON-decode AnyPointer; "
+                        "please register a JsonCodec::Handler for this");
+    }
+
+    KJ_CLANG_KNOWS_THIS_IS_UNREACHABLE_BUT_GCC_DOESNT;
+  }
+
+private:
+  const JsonCodec& codec;
+  Parser& parser;
+
+  kj::Vector<char> text;
+  // Scratch space for strings which are consumed as soon as they are parsed (field names,
+  // numbers encoded as strings, and so on).
+
+  static bool isNumberStart(char c) {
+    return c == '-' || ('0' <= c && c <= '9');
+  }
+
+  JsonValue::Reader parseJsonValue(MallocMessageBuilder& message) {
+    auto json = message.getRoot<JsonValue>();
+    parser.parseValue(json);
+    return json.asReader();
+  }
+
+  Orphan<DynamicList> decodeArray(ListSchema type, Orphanage orphanage) {
+    auto orphan = orphanage.newOrphan(type, parser.countArrayElements());
+    auto output = orphan.get();
+    auto elementType = type.getElementType();
+    bool structsInPlace = elementType.isStruct() &&
+        codec.impl->typeHandlers.find(elementType) == kj::none;
+
+    parser.consumeToken('[');
+    parser.enterNesting();
+    KJ_DEFER(parser.leaveNesting());
+    for (auto i: kj::indices(output)) {
+      if (i > 0) parser.consumeToken(',');
+      if (structsInPlace) {
+        decodeObject(output[i].as<DynamicStruct>());
+      } else {
+        output.adopt(i, decode(elementType, orphanage));
+      }
+    }
+    parser.consumeToken(']');
+    return orphan;
+  }
+
+  void decodeObject(DynamicStruct::Builder output) {
+    KJ_REQUIRE(parser.peekToken() == '{', "Expected object value") {
+      parser.skipValue();
+      return;
+    }
+
+    auto type = output.getSchema();
+    bool expectComma = false;
+
+    parser.consumeToken('{');
+    parser.enterNesting();
+    KJ_DEFER(parser.leaveNesting());
+
+    while (parser.peekToken() != '}') {
+      if (expectComma) parser.consumeToken(',');
+
+      auto name = parser.parseStringToken(text);
+      parser.consumeToken(':');
+
+      KJ_IF_SOME(fieldSchema, type.findFieldByName(name)) {
+        decodeField(fieldSchema, output);
+      } else {
+        KJ_REQUIRE(!codec.impl->rejectUnknownFields, "Unknown field", name);
+        parser.skipValue();
+      }
+
+      expectComma = true;
+    }
+
+    parser.consumeToken('}');
+  }
+
+  void decodeField(StructSchema::Field fieldSchema, DynamicStruct::Builder output) {
+    auto fieldType = fieldSchema.getType();
+    auto orphanage = Orphanage::getForMessageContaining(output);
+
+    KJ_IF_SOME(handler, codec.impl->fieldHandlers.find(fieldSchema)) {
+      MallocMessageBuilder message;
+      output.adopt(fieldSchema,
+          handler->decodeBase(codec, parseJsonValue(message), fieldType, orphanage));
+    } else if (fieldType.isStruct() && codec.impl->typeHandlers.find(fieldType) == kj::none) {
+      // Decode in place rather than building an orphan and copying it in.
+      decodeObject(output.init(fieldSchema).as<DynamicStruct>());
+    } else {
+      output.adopt(fieldSchema, decode(fieldType, orphanage));
+    }
+  }
+};
+
+kj::String JsonCodec::encode(DynamicValue::Reader value, Type type) const {
+  if (impl->prettyPrint) {
+    // Pretty-printing decides where to break lines based on the encoded size of each subtree, so
+    // it needs the whole JsonValue up front.
+    MallocMessageBuilder message(128);
+    // Use a smaller initial segment size, this significantly improves performance when encoding
+    // short strings.
+
+    auto json = message.getRoot<JsonValue>();
+    encode(value, type, json);
+    return encodeRaw(json);
+  }
+
+  DirectEncoder encoder(*this);
+  encoder.encode(value, type);
+  return encoder.finishString();
+}
+
+void JsonCodec::encode(DynamicValue::Reader value, Type type, kj::OutputStream& output) const {
+  if (impl->prettyPrint) {
+    auto text = encode(value, type);
+    output.write(text.begin(), text.size());
+    return;
+  }
+
+  DirectEncoder encoder(*this, output);
+  encoder.encode(value, type);
+  encoder.flush();
+}
+
+void JsonCodec::decode(kj::ArrayPtr<const char> input, DynamicStruct::Builder output) const {
+  Parser parser(impl->maxNestingDepth, input);
+  DirectDecoder(*this, parser).decodeStruct(output);
+
+  KJ_REQUIRE(parser.inputExhausted(), "Input remains after parsing JSON.");
+}
+
+Orphan<DynamicValue> JsonCodec::decode(
+    kj::ArrayPtr<const char> input, Type type, Orphanage orphanage) const {
+  Parser parser(impl->maxNestingDepth, input);
+  auto result = DirectDecoder(*this, parser).decode(type, orphanage);
+
+  KJ_REQUIRE(parser.inputExhausted(), "Input remains after parsing JSON.");
+  return result;
+}
+
 // -----------------------------------------------------------------------------
 
 Orphan<DynamicValue> JsonCodec::HandlerBase::decodeBase(
@@ -879,6 +1570,13 @@ void JsonCodec::HandlerBase::decodeStructBase(
     const JsonCodec& codec, JsonValue::Reader input, DynamicStruct::Builder output) const {
   KJ_FAIL_ASSERT("JSON decoder handler type / value type mismatch");
 }
+void JsonCodec::HandlerBase::encodeDirectBase(
+    const JsonCodec& codec, DynamicValue::Reader input, DirectEncoder& output) const {
+  MallocMessageBuilder message(128);
+  auto json = message.getRoot<JsonValue>();
+  encodeBase(codec, input, json);
+  output.encodeRaw(json);
+}
 
 void JsonCodec::addTypeHandlerImpl(Type type, HandlerBase& handler) {
   impl->typeHandlers.upsert(type, &handler, [](HandlerBase*& existing, HandlerBase* replacement) {
@@ -908,6 +1606,11 @@ public:
     output.setString(kj::encodeBase64(input));
   }
 
+  void encodeDirectBase(const JsonCodec& codec, DynamicValue::Reader input,
+                        DirectEncoder& output) const override {
+    output.writeString(kj::encodeBase64(input.as<capnp::Data>()));
+  }
+
   Orphan<capnp::Data> decode(const JsonCodec& codec, JsonValue::Reader input,
                              Orphanage orphanage) const {
     return orphanage.newOrphanCopy(capnp::Data::Reader(kj::decodeBase64(input.getString())));
@@ -920,6 +1623,11 @@ public:
     output.setString(kj::encodeHex(input));
   }
 
+  void encodeDirectBase(const JsonCodec& codec, DynamicValue::Reader input,
+                        DirectEncoder& output) const override {
+    output.writeString(kj::encodeHex(input.as<capnp::Data>()));
+  }
+
   Orphan<capnp::Data> decode(const JsonCodec& codec, JsonValue::Reader input,
                              Orphanage orphanage) const {
     return orphanage.newOrphanCopy(capnp::Data::Reader(kj::decodeHex(input.getString())));
@@ -1134,6 +1842,27 @@ public:
     }
   }
 
+  void encodeDirectBase(const JsonCodec& codec, DynamicValue::Reader input,
+                        DirectEncoder& output) const override {
+    kj::Vector<FlattenedField> flattenedFields;
+    gatherForEncode(codec, input, nullptr, nullptr, flattenedFields);
+
+    bool first = true;
+    output.write('{');
+    for (auto& in: flattenedFields) {
+      output.writeFieldName(in.name, first);
+      KJ_SWITCH_ONEOF(in.type) {
+        KJ_CASE_ONEOF(type, Type) {
+          output.encode(in.value, type);
+        }
+        KJ_CASE_ONEOF(field, StructSchema::Field) {
+          output.encodeField(field, in.value);
+        }
+      }
+    }
+    output.write('}');
+  }
+
   void decode(const JsonCodec& codec, JsonValue::Reader input,
               DynamicStruct::Builder output) const override {
     KJ_REQUIRE(input.isObject());
@@ -1380,6 +2109,17 @@ public:
     }
   }
 
+  void encodeDirectBase(const JsonCodec& codec, DynamicValue::Reader input,
+                        DirectEncoder& output) const override {
+    auto e = input.as<DynamicEnum>();
+    KJ_IF_SOME(enumerant, e.getEnumerant()) {
+      KJ_ASSERT(enumerant.getIndex() < valueToName.size());
+      output.writeString(valueToName[enumerant.getIndex()]);
+    } else {
+      output.writeNumber(e.getRaw());
+    }
+  }
+
   DynamicEnum decode(const JsonCodec& codec, JsonValue::Reader input) const override {
     if (input.isNumber()) {
       return DynamicEnum(schema, static_cast<uint16_t>(input.getNumber()));
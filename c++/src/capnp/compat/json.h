@@ -24,6 +24,7 @@
 #include <capnp/schema.h>
 #include <capnp/dynamic.h>
 #include <capnp/compat/json.capnp.h>
+#include <kj/io.h>
 
 CAPNP_BEGIN_HEADER
 
@@ -100,12 +101,29 @@ public:
   // not distinguish between e.g. int32 and int64, which in JSON are handled differently. Most
   // of the time, though, you can use the single-argument templated version of `encode()` instead.
 
+  template <typename T>
+  void encode(T&& value, kj::OutputStream& output) const;
+  void encode(DynamicValue::Reader value, Type type, kj::OutputStream& output) const;
+  // Like encode() above, but writes the text to `output` as it is produced rather than returning
+  // it as one string.
+  //
+  // Unless pretty-printing is enabled, both this and the string-returning encode() write text
+  // straight from the Cap'n Proto value without building an intermediate JsonValue. Only values
+  // covered by a custom Handler go through JsonValue, since that is what handlers produce.
+  // (Pretty-printing chooses line breaks based on the size of whole subtrees, so it always
+  // builds the JsonValue first.)
+
   void decode(kj::ArrayPtr<const char> input, DynamicStruct::Builder output) const;
   // Decode JSON text directly into a struct builder. This only works for structs since lists
   // need to be allocated with the correct size in advance.
   //
   // (Remember that any Cap'n Proto struct reader type can be implicitly cast to
   // DynamicStruct::Reader.)
+  //
+  // Like encoding, the text-based decode() methods parse straight into the output without
+  // building an intermediate JsonValue, except for values covered by a Handler. As a result, if
+  // the input turns out to be malformed, `output` may already have been partially filled in when
+  // the exception is thrown.
 
   template <typename T>
   Orphan<T> decode(kj::ArrayPtr<const char> input, Orphanage orphanage) const;
@@ -239,6 +257,8 @@ private:
   class Base64Handler;
   class HexHandler;
   class JsonValueHandler;
+  class DirectEncoder;
+  class DirectDecoder;
   struct Impl;
 
   kj::Own<Impl> impl;
@@ -272,6 +292,13 @@ kj::String JsonCodec::encode(T&& value) const {
   return encode(DynamicValue::Reader(ReaderFor<Base>(kj::fwd<T>(value))), type);
 }
 
+template <typename T>
+void JsonCodec::encode(T&& value, kj::OutputStream& output) const {
+  Type type = Type::from(value);
+  typedef FromAny<kj::Decay<T>> Base;
+  encode(DynamicValue::Reader(ReaderFor<Base>(kj::fwd<T>(value))), type, output);
+}
+
 template <typename T>
 inline Orphan<T> JsonCodec::decode(kj::ArrayPtr<const char> input, Orphanage orphanage) const {
   return decode(input, Type::from<T>(), orphanage).template releaseAs<T>();
@@ -353,6 +380,10 @@ public:
                                           Type type, Orphanage orphanage) const;
   virtual void decodeStructBase(const JsonCodec& codec, JsonValue::Reader input,
                                 DynamicStruct::Builder output) const;
+  virtual void encodeDirectBase(const JsonCodec& codec, DynamicValue::Reader input,
+                                DirectEncoder& output) const;
+  // Writes the value as JSON text without a JsonValue. The default implementation calls
+  // encodeBase() on a scratch JsonValue and writes that out.
 };
 
 template <typename T>
@@ -44,6 +44,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <capnp/serialize.h>
+#include <capnp/serialize-archive.h>
 #include <capnp/serialize-packed.h>
 #include <capnp/serialize-text.h>
 #include <capnp/compat/json.h>
@@ -186,6 +187,12 @@ public:
                       "capnp::writePackedMessage*() from <capnp/serialize-packed.h>.  Do not use "
                       "this for messages written with capnp::writeMessage*() from "
                       "<capnp/serialize.h>.)")
+           .addOptionWithArg({"archive"}, KJ_BIND_METHOD(*this, setArchive), "<file>",
+                      "Read messages from the archive <file> (as written by capnp::ArchiveWriter "
+                      "from <capnp/serialize-archive.h>) instead of standard input.  The file is "
+                      "memory-mapped, and its offset index, if any, is used to seek to messages.")
+           .addOptionWithArg({"message"}, KJ_BIND_METHOD(*this, setArchiveMessage), "<n>",
+                      "With --archive, decode only message number <n> (counting from zero).")
            .addOption({"short"}, KJ_BIND_METHOD(*this, printShort),
                       "Print in short (non-pretty) format.  Each message will be printed on one "
                       "line, without using whitespace to improve readability.")
@@ -754,11 +761,20 @@ public:
       if (result.getError() != kj::none) return result;
     }
 
-    kj::FdInputStream rawInput(STDIN_FILENO);
-    kj::BufferedInputStreamWrapper input(rawInput);
+    if (archiveMessage != kj::none && archivePath == kj::none) {
+      return "--message requires --archive";
+    }
 
     kj::FdOutputStream output(STDOUT_FILENO);
 
+    KJ_IF_SOME(path, archivePath) {
+      convertArchive(path, output);
+      context.exit();
+    }
+
+    kj::FdInputStream rawInput(STDIN_FILENO);
+    kj::BufferedInputStreamWrapper input(rawInput);
+
     if (!quiet) {
       auto result = checkPlausibility(convertFrom, input.getReadBuffer());
       if (result.getError() != kj::none) {
@@ -775,6 +791,29 @@ public:
   }
 
 private:
+  void convertArchive(kj::StringPtr pathStr, kj::OutputStream& output) {
+    // Since this is a debug tool, lift the usual security limits, as in readOneAndConvert().
+    ReaderOptions options;
+    options.nestingLimit = kj::maxValue;
+    options.traversalLimitInWords = kj::maxValue;
+
+    auto file = disk->getRoot().openFile(disk->getCurrentPath().evalNative(pathStr));
+    ArchiveReader archive(*file, options);
+
+    KJ_IF_SOME(n, archiveMessage) {
+      if (n >= archive.size()) {
+        context.exitError(kj::str(pathStr, ": archive has only ", archive.size(), " messages"));
+      }
+      ParseErrorCatcher parseErrorCatcher(context);
+      writeConversion(archive.getMessage(n)->getRoot<AnyStruct>(), output);
+    } else {
+      for (size_t i = 0, count = archive.size(); i < count; i++) {
+        ParseErrorCatcher parseErrorCatcher(context);
+        writeConversion(archive.getMessage(i)->getRoot<AnyStruct>(), output);
+      }
+    }
+  }
+
   kj::Vector<byte> readAll(kj::BufferedInputStreamWrapper& input) {
     kj::Vector<byte> allBytes;
     for (;;) {
@@ -1144,14 +1183,30 @@ public:
   }
   kj::MainBuilder::Validity codeFlat() {
     if (binary) return "cannot be used with --binary";
+    if (archivePath != kj::none) return "cannot be used with --archive";
     flat = true;
     return true;
   }
   kj::MainBuilder::Validity codePacked() {
     if (binary) return "cannot be used with --binary";
+    if (archivePath != kj::none) return "cannot be used with --archive";
     packed = true;
     return true;
   }
+  kj::MainBuilder::Validity setArchive(kj::StringPtr path) {
+    if (flat) return "cannot be used with --flat";
+    if (packed) return "cannot be used with --packed";
+    archivePath = path;
+    return true;
+  }
+  kj::MainBuilder::Validity setArchiveMessage(kj::StringPtr number) {
+    char* end;
+    archiveMessage = strtoull(number.cStr(), &end, 0);
+    if (number.size() == 0 || *end != '\0') {
+      return "not an integer";
+    }
+    return true;
+  }
   kj::MainBuilder::Validity printShort() {
     pretty = false;
     return true;
@@ -1872,6 +1927,8 @@ private:
   bool pretty = true;
   bool quiet = false;
   uint segmentSize = 0;
+  kj::Maybe<kj::StringPtr> archivePath;
+  kj::Maybe<size_t> archiveMessage;
   StructSchema rootType;
   // For the "decode" and "encode" commands.
 
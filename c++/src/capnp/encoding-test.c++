@@ -2096,6 +2096,73 @@ KJ_TEST("Copying ListList downgraded from ListStruct does not get corrupted") {
   // out-of-bounds 0xbb bytes from `data` above, which should be impossible.
 }
 
+KJ_TEST("List<Struct>::Reader::validate()") {
+  MallocMessageBuilder builder(1 << 16);
+  auto list = builder.initRoot<TestAllTypes>().initStructList(100);
+  for (auto i: kj::indices(list)) {
+    list[i].setUInt32Field(i);
+    list[i].setTextField(kj::str("element ", i));
+  }
+  auto segments = builder.getSegmentsForOutput();
+  KJ_ASSERT(segments.size() == 1);
+
+  // Allow reading the list about once.
+  ReaderOptions options;
+  options.traversalLimitInWords = segments[0].size() + 10;
+
+  {
+    SegmentArrayMessageReader reader(segments, options);
+    auto validated = reader.getRoot<TestAllTypes>().getStructList().validate();
+    KJ_ASSERT(validated.size() == 100);
+
+    // Scanning the validated list again and again doesn't count against the read limit.
+    for (auto pass KJ_UNUSED: kj::zeroTo(3)) {
+      for (auto i: kj::indices(validated)) {
+        KJ_EXPECT(validated[i].getUInt32Field() == i);
+        KJ_EXPECT(validated[i].getTextField() == kj::str("element ", i));
+      }
+    }
+  }
+
+  {
+    // Whereas reading the unvalidated list repeatedly hits the limit.
+    SegmentArrayMessageReader reader(segments, options);
+    auto unvalidated = reader.getRoot<TestAllTypes>().getStructList();
+    auto scan = [&]() {
+      for (auto pass KJ_UNUSED: kj::zeroTo(3)) {
+        for (auto element: unvalidated) {
+          element.getTextField();
+        }
+      }
+    };
+    KJ_EXPECT_THROW_RECOVERABLE_MESSAGE("traversal limit", scan());
+  }
+
+  {
+    // Problems anywhere in the list are detected up front.
+    auto truncated = segments[0].slice(0, segments[0].size() - 20);
+    SegmentArrayMessageReader reader(kj::arrayPtr(&truncated, 1));
+    auto unvalidated = reader.getRoot<TestAllTypes>().getStructList();
+    KJ_EXPECT(unvalidated[0].getTextField() == "element 0");
+    KJ_EXPECT_THROW_RECOVERABLE_MESSAGE("out-of-bounds", unvalidated.validate());
+  }
+}
+
+KJ_TEST("List<Struct>::Reader::validate() with far pointers") {
+  // Elements whose content is in other segments are still readable, with checks.
+  MallocMessageBuilder builder(16, AllocationStrategy::FIXED_SIZE);
+  auto list = builder.initRoot<TestAllTypes>().initStructList(10);
+  for (auto i: kj::indices(list)) {
+    initTestMessage(list[i]);
+  }
+  KJ_ASSERT(builder.getSegmentsForOutput().size() > 1);
+
+  SegmentArrayMessageReader reader(builder.getSegmentsForOutput());
+  for (auto element: reader.getRoot<TestAllTypes>().getStructList().validate()) {
+    checkTestMessage(element);
+  }
+}
+
 }  // namespace
 }  // namespace _ (private)
 }  // namespace capnp
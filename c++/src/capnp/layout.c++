@@ -23,6 +23,8 @@
 #include "layout.h"
 #include <kj/debug.h>
 #include "arena.h"
+#include <kj/thread.h>
+#include <kj/vector.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -773,9 +775,34 @@ struct WireHelpers {
 
   // -----------------------------------------------------------------
 
-  static MessageSizeCounts totalSize(
-      SegmentReader* segment, const WirePointer* ref, int nestingLimit) {
-    // Compute the total size of the object pointed to, not counting far pointer overhead.
+  struct PointerRun {
+    // A run of `elementCount` consecutive elements within an object, each consisting of
+    // `dataWords` words of data followed by `pointerCount` pointers. `nestingLimit` applies to the
+    // objects those pointers point to.
+
+    SegmentReader* segment;
+    const word* start;
+    uint64_t elementCount;
+    uint dataWords;
+    uint pointerCount;
+    int nestingLimit;
+
+    PointerRun splitFront(uint64_t count) {
+      // Removes the first `count` elements from this run and returns them as a new run.
+      PointerRun result = *this;
+      result.elementCount = count;
+      start += count * (dataWords + pointerCount);
+      elementCount -= count;
+      return result;
+    }
+  };
+
+  template <typename VisitRun>
+  static MessageSizeCounts objectSize(
+      SegmentReader* segment, const WirePointer* ref, int nestingLimit, VisitRun&& visitRun) {
+    // Compute the size of the object pointed to, not counting far pointer overhead. Objects to
+    // which it points are not traversed; instead, `visitRun(run)` is called for each (non-empty)
+    // run of pointers in the object, and its result is added to the total.
 
     MessageSizeCounts result = { ZERO * WORDS, 0 };
 
@@ -804,10 +831,13 @@ struct WireHelpers {
         }
         result.addWords(ref->structRef.wordSize());
 
-        const WirePointer* pointerSection =
-            reinterpret_cast<const WirePointer*>(ptr + ref->structRef.dataSize.get());
-        for (auto i: kj::zeroTo(ref->structRef.ptrCount.get())) {
-          result += totalSize(segment, pointerSection + i, nestingLimit);
+        if (ref->structRef.ptrCount.get() > ZERO * POINTERS) {
+          result += visitRun(PointerRun {
+            segment, ptr, 1,
+            unbound(ref->structRef.dataSize.get() / WORDS),
+            unbound(ref->structRef.ptrCount.get() / POINTERS),
+            nestingLimit
+          });
         }
         break;
       }
@@ -843,9 +873,10 @@ struct WireHelpers {
 
             result.addWords(count * WORDS_PER_POINTER);
 
-            for (auto i: kj::zeroTo(count)) {
-              result += totalSize(segment, reinterpret_cast<const WirePointer*>(ptr) + i,
-                                  nestingLimit);
+            if (count > ZERO * POINTERS) {
+              result += visitRun(PointerRun {
+                segment, ptr, unbound(count / POINTERS), 0, 1, nestingLimit
+              });
             }
             break;
           }
@@ -880,17 +911,11 @@ struct WireHelpers {
             WordCount dataSize = elementTag->structRef.dataSize.get();
             WirePointerCount pointerCount = elementTag->structRef.ptrCount.get();
 
-            if (pointerCount > ZERO * POINTERS) {
-              const word* pos = ptr + POINTER_SIZE_IN_WORDS;
-              for (auto i KJ_UNUSED: kj::zeroTo(count)) {
-                pos += dataSize;
-
-                for (auto j KJ_UNUSED: kj::zeroTo(pointerCount)) {
-                  result += totalSize(segment, reinterpret_cast<const WirePointer*>(pos),
-                                      nestingLimit);
-                  pos += POINTER_SIZE_IN_WORDS;
-                }
-              }
+            if (pointerCount > ZERO * POINTERS && count > ZERO * ELEMENTS) {
+              result += visitRun(PointerRun {
+                segment, ptr + POINTER_SIZE_IN_WORDS, unbound(count / ELEMENTS),
+                unbound(dataSize / WORDS), unbound(pointerCount / POINTERS), nestingLimit
+              });
             }
             break;
           }
@@ -914,6 +939,144 @@ struct WireHelpers {
     return result;
   }
 
+  static MessageSizeCounts totalSize(
+      SegmentReader* segment, const WirePointer* ref, int nestingLimit) {
+    // Compute the total size of the object pointed to, not counting far pointer overhead.
+
+    return objectSize(segment, ref, nestingLimit, [](const PointerRun& run) {
+      return totalSize(run);
+    });
+  }
+
+  static MessageSizeCounts totalSize(const PointerRun& run) {
+    // Compute the total size of the objects pointed to by the run.
+
+    MessageSizeCounts result = { ZERO * WORDS, 0 };
+    const word* pos = run.start;
+    for (auto i KJ_UNUSED: kj::zeroTo(run.elementCount)) {
+      pos += run.dataWords;
+      for (auto j KJ_UNUSED: kj::zeroTo(run.pointerCount)) {
+        result += totalSize(run.segment, reinterpret_cast<const WirePointer*>(pos),
+                            run.nestingLimit);
+        pos += POINTER_SIZE_IN_WORDS;
+      }
+    }
+    return result;
+  }
+
+  static MessageSizeCounts validateRun(const PointerRun& run, bool& sameSegment) {
+    // Like totalSize(run), but also clears `sameSegment` if any object reachable from the run
+    // lies outside of `run.segment`, i.e. if a far pointer is reachable.
+
+    MessageSizeCounts result = { ZERO * WORDS, 0 };
+    const word* pos = run.start;
+    for (auto i KJ_UNUSED: kj::zeroTo(run.elementCount)) {
+      pos += run.dataWords;
+      for (auto j KJ_UNUSED: kj::zeroTo(run.pointerCount)) {
+        auto ref = reinterpret_cast<const WirePointer*>(pos);
+        pos += POINTER_SIZE_IN_WORDS;
+        if (ref->isNull()) {
+          // Most pointers in a typical struct are null; skip them cheaply.
+          continue;
+        } else if (ref->kind() == WirePointer::FAR) {
+          sameSegment = false;
+        }
+        result += objectSize(run.segment, ref, run.nestingLimit, [&](const PointerRun& inner) {
+          return validateRun(inner, sameSegment);
+        });
+      }
+    }
+    return result;
+  }
+
+  static MessageSizeCounts totalSizeParallel(
+      SegmentReader* segment, const WirePointer* ref, int nestingLimit, uint threadCount) {
+    // Like totalSize(), but spreads the traversal across `threadCount` threads, including this
+    // one.
+
+    if (threadCount <= 1) {
+      return totalSize(segment, ref, nestingLimit);
+    }
+
+    kj::Vector<PointerRun> queue;
+    MessageSizeCounts result = objectSize(segment, ref, nestingLimit,
+        [&](const PointerRun& run) {
+      queue.add(run);
+      return MessageSizeCounts { ZERO * WORDS, 0 };
+    });
+    result += totalSizeParallel(kj::mv(queue), threadCount);
+    return result;
+  }
+
+  static MessageSizeCounts totalSizeParallel(kj::Vector<PointerRun>&& queue, uint threadCount) {
+    // Compute the total size of the objects pointed to by the runs in `queue`, using
+    // `threadCount` threads. The top of the tree is first expanded breadth-first on this thread,
+    // splitting long runs in half, until there are enough independent runs to keep all threads
+    // busy. The threads then take runs from the queue until it is empty. Every object is visited
+    // exactly as in totalSize(), so the result and any errors are the same.
+    //
+    // Each thread counts its reads against a LimitedArena of its own, since concurrent charges to
+    // the message's ReadLimiter could be lost. The total is charged to the real limiter at the end.
+
+    MessageSizeCounts result = { ZERO * WORDS, 0 };
+    size_t head = 0;
+    auto enqueue = [&](const PointerRun& run) {
+      queue.add(run);
+      return MessageSizeCounts { ZERO * WORDS, 0 };
+    };
+
+    const size_t targetRunCount = threadCount * 8;
+    while (head < queue.size() && queue.size() - head < targetRunCount) {
+      PointerRun run = queue[head++];
+      if (run.elementCount > 1) {
+        enqueue(run.splitFront(run.elementCount / 2));
+        enqueue(run);
+      } else {
+        const word* pos = run.start + run.dataWords;
+        for (auto j KJ_UNUSED: kj::zeroTo(run.pointerCount)) {
+          result += objectSize(run.segment, reinterpret_cast<const WirePointer*>(pos),
+                               run.nestingLimit, enqueue);
+          pos += POINTER_SIZE_IN_WORDS;
+        }
+      }
+    }
+
+    auto runs = queue.asPtr().slice(head, queue.size());
+    if (runs.size() == 0) {
+      return result;
+    } else if (threadCount <= 1) {
+      for (auto& run: runs) {
+        result += totalSize(run);
+      }
+      return result;
+    }
+
+    auto partials = kj::heapArray<MessageSizeCounts>(threadCount);
+    for (auto& partial: partials) {
+      partial = { ZERO * WORDS, 0 };
+    }
+    kj::Vector<kj::Own<LimitedArena>> arenas(threadCount);
+    if (runs[0].segment != nullptr) {
+      // (A null segment means trusted data, which isn't bounds-checked or counted.)
+      for (auto i KJ_UNUSED: kj::zeroTo(threadCount)) {
+        arenas.add(kj::heap<LimitedArena>(*runs[0].segment));
+      }
+    }
+
+    kj::_::runInParallel(threadCount, runs.size(), [&](uint thread, size_t i) {
+      PointerRun run = runs[i];
+      if (arenas.size() > 0) run.segment = arenas[thread]->getSegment(run.segment);
+      partials[thread] += totalSize(run);
+    });
+
+    LimitedArena::commit(arenas);
+
+    for (auto& partial: partials) {
+      result += partial;
+    }
+    return result;
+  }
+
   // -----------------------------------------------------------------
   // Copy from an unchecked message.
 
@@ -2760,6 +2923,11 @@ MessageSizeCounts PointerReader::targetSize() const {
                             : WireHelpers::totalSize(segment, pointer, nestingLimit);
 }
 
+MessageSizeCounts PointerReader::targetSize(uint threadCount) const {
+  return pointer == nullptr ? MessageSizeCounts { ZERO * WORDS, 0 }
+      : WireHelpers::totalSizeParallel(segment, pointer, nestingLimit, threadCount);
+}
+
 PointerType PointerReader::getPointerType() const {
   if(pointer == nullptr || pointer->isNull()) {
     return PointerType::NULL_;
@@ -2989,8 +3157,29 @@ MessageSizeCounts StructReader::totalSize() const {
   return result;
 }
 
-kj::Array<word> StructReader::canonicalize() {
-  auto size = totalSize().wordCount + POINTER_SIZE_IN_WORDS;
+MessageSizeCounts StructReader::totalSize(uint threadCount) const {
+  MessageSizeCounts result = {
+    WireHelpers::roundBitsUpToWords(dataSize) + pointerCount * WORDS_PER_POINTER, 0 };
+
+  if (pointerCount > ZERO * POINTERS) {
+    kj::Vector<WireHelpers::PointerRun> runs;
+    runs.add(WireHelpers::PointerRun {
+      segment, reinterpret_cast<const word*>(pointers), 1, 0,
+      unbound(pointerCount / POINTERS), nestingLimit
+    });
+    result += WireHelpers::totalSizeParallel(kj::mv(runs), threadCount);
+  }
+
+  if (segment != nullptr) {
+    // As above, don't count against the read limit.
+    segment->unread(result.wordCount);
+  }
+
+  return result;
+}
+
+kj::Array<word> StructReader::canonicalize(uint threadCount) {
+  auto size = totalSize(threadCount).wordCount + POINTER_SIZE_IN_WORDS;
   kj::Array<word> backing = kj::heapArray<word>(unbound(size / WORDS));
   WireHelpers::zeroMemory(backing.asPtr());
   FlatMessageBuilder builder(backing);
@@ -3237,6 +3426,49 @@ MessageSizeCounts ListReader::totalSize() const {
   return result;
 }
 
+ListReader ListReader::validate() const {
+  if (segment == nullptr) {
+    // Already unchecked.
+    return *this;
+  }
+
+  WireHelpers::PointerRun run { segment, reinterpret_cast<const word*>(ptr), 0, 0, 0,
+                                nestingLimit };
+  switch (elementSize) {
+    case ElementSize::POINTER:
+      run.elementCount = unbound(elementCount / ELEMENTS);
+      run.pointerCount = 1;
+      break;
+    case ElementSize::INLINE_COMPOSITE:
+      if (structPointerCount > ZERO * POINTERS) {
+        run.elementCount = unbound(elementCount / ELEMENTS);
+        run.dataWords = unbound(structDataSize / BITS_PER_WORD);
+        run.pointerCount = unbound(structPointerCount / POINTERS);
+      }
+      break;
+    default:
+      // No pointers.
+      break;
+  }
+
+  bool sameSegment = true;
+  KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+    WireHelpers::validateRun(run, sameSegment);
+  })) {
+    kj::throwRecoverableException(kj::mv(exception));
+    return *this;
+  }
+
+  if (!sameSegment) {
+    // Unchecked readers can't follow far pointers.
+    return *this;
+  }
+
+  ListReader result = *this;
+  result.segment = nullptr;
+  return result;
+}
+
 CapTableReader* ListReader::getCapTable() {
   return capTable;
 }
@@ -431,6 +431,10 @@ public:
   // use the result as a hint for allocating the first segment, do the copy, and then throw an
   // exception if it overruns.
 
+  MessageSizeCounts targetSize(uint threadCount) const;
+  // Like targetSize(), but traverses independent subtrees on up to `threadCount` threads
+  // (including the calling one).  The result, and whether the traversal fails, are the same.
+
   inline bool isNull() const { return getPointerType() == PointerType::NULL_; }
   PointerType getPointerType() const;
 
@@ -593,7 +597,9 @@ public:
   inline kj::ArrayPtr<const byte> getDataSectionAsBlob() const;
   inline _::ListReader getPointerSectionAsList() const;
 
-  kj::Array<word> canonicalize();
+  kj::Array<word> canonicalize(uint threadCount = 1);
+  // Makes a canonical copy of the struct.  `threadCount` is used to size the copy, as in
+  // totalSize(threadCount); the copy itself is made on the calling thread.
 
   template <typename T>
   KJ_ALWAYS_INLINE(bool hasDataField(StructDataOffset offset) const);
@@ -619,6 +625,9 @@ public:
   // pointer overhead.  This is useful for deciding how much space is needed to copy the struct
   // into a flat array.
 
+  MessageSizeCounts totalSize(uint threadCount) const;
+  // Like totalSize(), but traverses on up to `threadCount` threads, as PointerReader::targetSize().
+
   CapTableReader* getCapTable();
   // Gets the capability context in which this object is operating.
 
@@ -786,6 +795,13 @@ public:
   MessageSizeCounts totalSize() const;
   // Like StructReader::totalSize(). Note that for struct lists, the size includes the list tag.
 
+  ListReader validate() const;
+  // Traverse everything reachable from this list, checking bounds and nesting and counting it
+  // against the read limit once. Returns a copy of this reader that reads the list and everything
+  // reachable from it as an unchecked message, i.e. without any further bounds checks or
+  // read-limit accounting. If a far pointer is reachable from the list, the returned reader is
+  // checked as usual, since unchecked readers can't follow far pointers.
+
   CapTableReader* getCapTable();
   // Gets the capability context in which this object is operating.
 
@@ -223,6 +223,15 @@ struct List<T, Kind::STRUCT> {
       return reader.totalSize().asPublic();
     }
 
+    inline Reader validate() const { return Reader(reader.validate()); }
+    // Validates the whole list, and everything it points to, in one pass, and returns a reader
+    // for the same list whose elements (and everything reachable from them) can be read without
+    // any per-access bounds checks or read-limit accounting. This makes scans over large lists
+    // faster, at the cost of reading the whole list up front. Throws if the list is invalid.
+    //
+    // Far pointers can't be followed without checks, so if the list's content is spread across
+    // segments, the returned reader is checked as usual (but the list has still been validated).
+
   private:
     _::ListReader reader;
     template <typename U, Kind K>
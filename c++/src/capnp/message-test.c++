@@ -192,6 +192,44 @@ KJ_TEST("disallow unaligned") {
 }
 #endif
 
+KJ_TEST("PooledMessageBuilder recycles zeroed segments") {
+  SegmentPool pool;
+
+  for (uint i = 0; i < 10; i++) {
+    PooledMessageBuilder builder(pool);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    checkTestMessage(builder.getRoot<TestAllTypes>());
+  }
+
+  // Everything after the first message should have been served from the pool.
+  auto allocations = pool.getAllocationCount();
+  KJ_EXPECT(allocations == 1, allocations);
+  KJ_EXPECT(pool.getCachedWords() >= SUGGESTED_FIRST_SEGMENT_WORDS);
+
+  // Recycled segments must come back zeroed.
+  auto segment = pool.allocate(SUGGESTED_FIRST_SEGMENT_WORDS);
+  for (auto& w: segment.asBytes()) {
+    KJ_ASSERT(w == 0);
+  }
+  pool.release(segment, 0);
+
+  // Multi-segment messages return all their segments.
+  for (uint i = 0; i < 3; i++) {
+    PooledMessageBuilder builder(pool, 64, AllocationStrategy::FIXED_SIZE);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    KJ_EXPECT(builder.getSegmentsForOutput().size() > 1);
+    checkTestMessage(builder.getRoot<TestAllTypes>());
+  }
+  KJ_EXPECT(pool.getAllocationCount() > allocations);
+  allocations = pool.getAllocationCount();
+  {
+    PooledMessageBuilder builder(pool, 64, AllocationStrategy::FIXED_SIZE);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    checkTestMessage(builder.getRoot<TestAllTypes>());
+  }
+  KJ_EXPECT(pool.getAllocationCount() == allocations);
+}
+
 KJ_TEST("MessageBuilder::sizeInWords()") {
   capnp::MallocMessageBuilder builder;
   auto root = builder.initRoot<TestAllTypes>();
@@ -213,6 +251,66 @@ KJ_TEST("MessageBuilder::sizeInWords()") {
   KJ_EXPECT(reader.sizeInWords() == expected);
 }
 
+KJ_TEST("MessageReader::validate() in parallel") {
+  MallocMessageBuilder builder(64, AllocationStrategy::FIXED_SIZE);
+  auto root = builder.initRoot<TestAllTypes>();
+  initTestMessage(root);
+  auto list = root.initStructList(200);
+  for (auto element: list) {
+    initTestMessage(element);
+  }
+  auto segments = builder.getSegmentsForOutput();
+  KJ_ASSERT(segments.size() > 1);
+
+  auto expected = root.asReader().totalSize();
+  for (uint threadCount: {1, 2, 4, 16}) {
+    SegmentArrayMessageReader reader(segments);
+    auto size = reader.validate(threadCount);
+    KJ_EXPECT(size.wordCount == expected.wordCount, threadCount);
+    KJ_EXPECT(size.capCount == expected.capCount, threadCount);
+
+    auto readerRoot = reader.getRoot<TestAllTypes>();
+    KJ_EXPECT(AnyStruct::Reader(readerRoot).totalSize(threadCount).wordCount ==
+              expected.wordCount);
+    KJ_EXPECT(canonicalize(readerRoot, threadCount).asBytes() ==
+              canonicalize(readerRoot).asBytes());
+
+    // Validation doesn't use up the traversal limit.
+    for (auto element: readerRoot.getStructList()) {
+      checkTestMessage(element);
+    }
+  }
+
+  // Errors are detected no matter how many threads are used.
+  for (uint threadCount: {1, 4}) {
+    ReaderOptions options;
+    options.traversalLimitInWords = expected.wordCount / 2;
+    SegmentArrayMessageReader reader(segments, options);
+    KJ_EXPECT_THROW_RECOVERABLE_MESSAGE("traversal limit", reader.validate(threadCount));
+  }
+  for (uint threadCount: {1, 2, 4, 16}) {
+    // Just under what the traversal reads. Each thread reads far less than this on its own, so
+    // only the total can trip the limit.
+    ReaderOptions options;
+    options.traversalLimitInWords = expected.wordCount - 1;
+    SegmentArrayMessageReader reader(segments, options);
+    KJ_EXPECT_THROW_RECOVERABLE_MESSAGE("traversal limit", reader.validate(threadCount));
+  }
+  for (uint threadCount: {1, 4}) {
+    ReaderOptions options;
+    options.nestingLimit = 2;
+    SegmentArrayMessageReader reader(segments, options);
+    KJ_EXPECT_THROW_RECOVERABLE_MESSAGE("nested", reader.validate(threadCount));
+  }
+  for (uint threadCount: {1, 4}) {
+    // Truncating the last segment leaves some pointers dangling.
+    auto truncated = kj::heapArray(segments);
+    truncated.back() = truncated.back().slice(0, truncated.back().size() / 2);
+    SegmentArrayMessageReader reader(truncated);
+    KJ_EXPECT_THROW_RECOVERABLE_MESSAGE("out-of-bounds", reader.validate(threadCount));
+  }
+}
+
 // TODO(test):  More tests.
 
 }  // namespace
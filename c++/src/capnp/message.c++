@@ -82,6 +82,19 @@ bool MessageReader::isCanonical() {
   return rootIsCanonical && allWordsConsumed;
 }
 
+MessageSize MessageReader::validate(uint threadCount) {
+  auto result = getRootInternal().targetSize(threadCount);
+
+  // Like StructReader::totalSize(), give back what the traversal took from the read limit: the
+  // caller presumably validated the message in order to read it.
+  _::SegmentReader* segment = arena()->tryGetSegment(_::SegmentId(0));
+  if (segment != nullptr) {
+    segment->unread(result.wordCount * WORDS);
+  }
+
+  return result;
+}
+
 size_t MessageReader::sizeInWords() {
   return arena()->sizeInWords();
 }
@@ -291,6 +304,106 @@ kj::ArrayPtr<word> MallocMessageBuilder::allocateSegment(uint minimumSize) {
 
 // -------------------------------------------------------------------
 
+SegmentPool::SegmentPool(size_t maxCachedWords): maxCachedWords(maxCachedWords) {}
+
+SegmentPool::~SegmentPool() noexcept(false) {
+  for (auto& list: freeLists) {
+    for (word* ptr: list) {
+      free(ptr);
+    }
+  }
+}
+
+kj::ArrayPtr<word> SegmentPool::allocate(uint minimumSize) {
+  uint sizeClass = 0;
+  while (sizeClass < CLASS_COUNT && (1u << (MIN_CLASS_BITS + sizeClass)) < minimumSize) {
+    ++sizeClass;
+  }
+
+  size_t size = sizeClass < CLASS_COUNT ? 1u << (MIN_CLASS_BITS + sizeClass) : minimumSize;
+
+  if (sizeClass < CLASS_COUNT) {
+    auto& list = freeLists[sizeClass];
+    if (!list.empty()) {
+      word* result = list.back();
+      list.removeLast();
+      cachedWords -= size;
+      return kj::arrayPtr(result, size);
+    }
+  }
+
+  void* result = calloc(size, sizeof(word));
+  if (result == nullptr) {
+    KJ_FAIL_SYSCALL("calloc(size, sizeof(word))", ENOMEM, size);
+  }
+  ++allocationCount;
+  return kj::arrayPtr(reinterpret_cast<word*>(result), size);
+}
+
+void SegmentPool::release(kj::ArrayPtr<word> segment, size_t usedWords) {
+  size_t size = segment.size();
+  uint sizeClass = 0;
+  while (sizeClass < CLASS_COUNT && (size_t(1) << (MIN_CLASS_BITS + sizeClass)) != size) {
+    ++sizeClass;
+  }
+
+  if (sizeClass == CLASS_COUNT || cachedWords + size > maxCachedWords) {
+    free(segment.begin());
+    return;
+  }
+
+  memset(segment.begin(), 0, kj::min(usedWords, size) * sizeof(word));
+  freeLists[sizeClass].add(segment.begin());
+  cachedWords += size;
+}
+
+PooledMessageBuilder::PooledMessageBuilder(
+    SegmentPool& pool, uint firstSegmentWords, AllocationStrategy allocationStrategy)
+    : pool(pool), nextSize(firstSegmentWords), allocationStrategy(allocationStrategy) {}
+
+PooledMessageBuilder::~PooledMessageBuilder() noexcept(false) {
+  if (firstSegment == nullptr) return;
+
+  // The arena reports the segments in the order we allocated them, each trimmed to the part that
+  // was actually used, which is all that needs re-zeroing.
+  kj::ArrayPtr<const kj::ArrayPtr<const word>> used = getSegmentsForOutput();
+  auto usedWords = [&](uint i, kj::ArrayPtr<word> segment) -> size_t {
+    return i < used.size() ? used[i].size() : segment.size();
+  };
+
+  pool.release(firstSegment, usedWords(0, firstSegment));
+  for (auto i: kj::indices(moreSegments)) {
+    pool.release(moreSegments[i], usedWords(i + 1, moreSegments[i]));
+  }
+}
+
+kj::ArrayPtr<word> PooledMessageBuilder::allocateSegment(uint minimumSize) {
+  KJ_REQUIRE(bounded(minimumSize) * WORDS <= MAX_SEGMENT_WORDS,
+      "PooledMessageBuilder asked to allocate segment above maximum serializable size.");
+  KJ_ASSERT(bounded(nextSize) * WORDS <= MAX_SEGMENT_WORDS,
+      "PooledMessageBuilder nextSize out of bounds.");
+
+  // The pool may round up to its size class. Its largest class is still far below the maximum
+  // segment size.
+  auto result = pool.allocate(kj::max(minimumSize, nextSize));
+  uint size = result.size();
+
+  if (firstSegment == nullptr) {
+    firstSegment = result;
+    if (allocationStrategy == AllocationStrategy::GROW_HEURISTICALLY) nextSize = size;
+  } else {
+    moreSegments.add(result);
+    if (allocationStrategy == AllocationStrategy::GROW_HEURISTICALLY) {
+      nextSize = (size <= unbound(MAX_SEGMENT_WORDS / WORDS) - nextSize)
+          ? nextSize + size : unbound(MAX_SEGMENT_WORDS / WORDS);
+    }
+  }
+
+  return result;
+}
+
+// -------------------------------------------------------------------
+
 FlatMessageBuilder::FlatMessageBuilder(kj::ArrayPtr<word> array): array(array), allocated(false) {}
 FlatMessageBuilder::~FlatMessageBuilder() noexcept(false) {}
 
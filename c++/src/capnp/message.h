@@ -121,6 +121,17 @@ public:
   bool isCanonical();
   // Returns whether the message encoded in the reader is in canonical form.
 
+  MessageSize validate(uint threadCount = 1);
+  // Traverses the whole message up front, checking that every pointer is well-formed and in
+  // bounds, and returns the message's total size.  Throws if the message is malformed, nested
+  // deeper than ReaderOptions::nestingLimit, or exceeds ReaderOptions::traversalLimitInWords.
+  // The traversal itself is not counted against the traversal limit, so the message can still
+  // be read in full afterwards.
+  //
+  // If `threadCount` is greater than 1, independent subtrees are traversed in parallel on that
+  // many threads (including the calling one).  This is worthwhile for messages of many
+  // megabytes, e.g. mmap()ed archives; the outcome is the same as with one thread.
+
   size_t sizeInWords();
   // Add up the size of all segments.
 
@@ -416,6 +427,79 @@ private:
   kj::Vector<void*> moreSegments;
 };
 
+class SegmentPool {
+  // A cache of zeroed message segments, for use with PooledMessageBuilder.
+  //
+  // Segments are rounded up to power-of-two size classes. When a segment is returned to the pool,
+  // only the prefix which the message actually used is re-zeroed, in the same way that
+  // MallocMessageBuilder handles a caller-provided first segment. Once the pool has warmed up,
+  // building a message of a typical size performs no heap allocation and zeroes only what it
+  // wrote.
+  //
+  // A SegmentPool is not thread-safe. Typically you would keep one per thread or per event loop,
+  // and share it among all the connections serviced there.
+
+public:
+  static constexpr size_t DEFAULT_MAX_CACHED_WORDS = 1u << 20;
+
+  explicit SegmentPool(size_t maxCachedWords = DEFAULT_MAX_CACHED_WORDS);
+  // `maxCachedWords` bounds the total size of idle segments the pool holds on to. Segments
+  // released beyond that are freed.
+
+  KJ_DISALLOW_COPY_AND_MOVE(SegmentPool);
+  ~SegmentPool() noexcept(false);
+
+  kj::ArrayPtr<word> allocate(uint minimumSize);
+  // Returns a zeroed segment of at least `minimumSize` words.
+
+  void release(kj::ArrayPtr<word> segment, size_t usedWords);
+  // Gives back a segment previously returned by allocate(). The caller promises that only the
+  // first `usedWords` words might be non-zero.
+
+  size_t getAllocationCount() const { return allocationCount; }
+  // Total number of segments this pool has had to obtain from the heap. In steady state this
+  // should stop increasing.
+
+  size_t getCachedWords() const { return cachedWords; }
+  // Total size of idle segments currently held.
+
+private:
+  static constexpr uint MIN_CLASS_BITS = 6;
+  static constexpr uint CLASS_COUNT = 15;
+  // Size classes run from 64 words (512 bytes) to 2^20 words (8 MiB). Larger segments bypass the
+  // pool.
+
+  size_t maxCachedWords;
+  size_t cachedWords = 0;
+  size_t allocationCount = 0;
+  kj::Vector<word*> freeLists[CLASS_COUNT];
+};
+
+class PooledMessageBuilder: public MessageBuilder {
+  // A MessageBuilder which takes its segments from a SegmentPool and gives them back when it is
+  // destroyed. Use this in place of MallocMessageBuilder when building many short-lived messages,
+  // such as outgoing RPC messages.
+
+public:
+  explicit PooledMessageBuilder(SegmentPool& pool,
+      uint firstSegmentWords = SUGGESTED_FIRST_SEGMENT_WORDS,
+      AllocationStrategy allocationStrategy = SUGGESTED_ALLOCATION_STRATEGY);
+  // `pool` must outlive the builder.
+
+  KJ_DISALLOW_COPY_AND_MOVE(PooledMessageBuilder);
+  virtual ~PooledMessageBuilder() noexcept(false);
+
+  virtual kj::ArrayPtr<word> allocateSegment(uint minimumSize) override;
+
+private:
+  SegmentPool& pool;
+  uint nextSize;
+  AllocationStrategy allocationStrategy;
+
+  kj::ArrayPtr<word> firstSegment;
+  kj::Vector<kj::ArrayPtr<word>> moreSegments;
+};
+
 class FlatMessageBuilder: public MessageBuilder {
   // THIS IS NOT THE CLASS YOU'RE LOOKING FOR.
   //
@@ -549,8 +633,8 @@ kj::Own<kj::Decay<Reader>> clone(Reader&& reader) {
 }
 
 template <typename T>
-kj::Array<word> canonicalize(T&& reader) {
-    return _::PointerHelpers<FromReader<T>>::getInternalReader(reader).canonicalize();
+kj::Array<word> canonicalize(T&& reader, uint threadCount = 1) {
+    return _::PointerHelpers<FromReader<T>>::getInternalReader(reader).canonicalize(threadCount);
 }
 
 }  // namespace capnp
@@ -0,0 +1,95 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks for RPC. Run with `--benchmark-time <seconds>` to get useful timings; by default each
+// benchmark runs once, as a smoke test.
+
+#include "rpc-twoparty.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+#include <kj/thread.h>
+#include "test-util.h"
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+kj::Promise<void> callFoo(test::TestInterface::Client& client) {
+  auto request = client.fooRequest();
+  request.setI(123);
+  request.setJ(true);
+  return request.send().then([](auto&& response) {
+    KJ_ASSERT(response.getX() == "foo");
+  });
+}
+
+KJ_TEST("benchmark: two-party RPC over a socketpair") {
+  auto io = kj::setupAsyncIo();
+  auto pipe = io.provider->newTwoWayPipe();
+
+  int callCount = 0;
+  TwoPartyClient server(*pipe.ends[1], kj::heap<TestInterfaceImpl>(callCount),
+                        rpc::twoparty::Side::SERVER);
+  TwoPartyClient client(*pipe.ends[0]);
+  auto cap = client.bootstrap().castAs<test::TestInterface>();
+
+  doBenchmark("round trip", 0, [&]() {
+    callFoo(cap).wait(io.waitScope);
+  });
+
+  doBenchmark("64 calls in flight", 0, [&]() {
+    auto calls = kj::heapArrayBuilder<kj::Promise<void>>(64);
+    for (auto i KJ_UNUSED: kj::zeroTo(calls.capacity())) {
+      calls.add(callFoo(cap));
+    }
+    kj::joinPromises(calls.finish()).wait(io.waitScope);
+  });
+}
+
+KJ_TEST("benchmark: CrossThreadCapability") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  int callCount = 0;
+  test::TestInterface::Client cap = kj::heap<TestInterfaceImpl>(callCount);
+  auto shared = shareAcrossThreads(cap);
+
+  auto done = kj::newPromiseAndFulfiller<void>();
+  const kj::Executor& homeExecutor = kj::getCurrentThreadExecutor();
+
+  kj::Thread thread([&]() {
+    kj::EventLoop loop;
+    kj::WaitScope waitScope(loop);
+    auto client = shared->getClient<test::TestInterface>();
+
+    doBenchmark("round trip", 0, [&]() {
+      callFoo(client).wait(waitScope);
+    });
+
+    homeExecutor.executeSync([&]() { done.fulfiller->fulfill(); });
+  });
+
+  done.promise.wait(waitScope);
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
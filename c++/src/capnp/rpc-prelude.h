@@ -34,6 +34,7 @@ namespace capnp {
 class OutgoingRpcMessage;
 class IncomingRpcMessage;
 class RpcFlowController;
+class RpcMetrics;
 
 template <typename SturdyRefHostId>
 class RpcSystem;
@@ -86,6 +87,7 @@ public:
   ~RpcSystemBase() noexcept(false);
 
   void setTraceEncoder(kj::Function<kj::String(const kj::Exception&)> func);
+  void setMetrics(RpcMetrics& metrics);
 
   kj::Promise<void> run();
 
@@ -34,6 +34,7 @@
 #include "test-util.h"
 #include <capnp/rpc.capnp.h>
 #include <kj/debug.h>
+#include <kj/map.h>
 #include <kj/thread.h>
 #include <kj/compat/gtest.h>
 #include <kj/miniposix.h>
@@ -231,6 +232,270 @@ TEST(TwoPartyNetwork, Basic) {
   KJ_EXPECT(network.getOutgoingMessageWaitTime() == 0 * kj::SECONDS);
 }
 
+KJ_TEST("TwoPartyVatNetwork outgoing messages can use a SegmentPool") {
+  auto ioContext = kj::setupAsyncIo();
+  int callCount = 0;
+  int handleCount = 0;
+
+  SegmentPool pool;
+  auto serverThread = runServer(*ioContext.provider, callCount, handleCount);
+  TwoPartyVatNetwork network(*serverThread.pipe, rpc::twoparty::Side::CLIENT);
+  network.setOutgoingSegmentPool(pool);
+  auto rpcClient = makeRpcClient(network);
+
+  auto client = getPersistentCap(rpcClient, rpc::twoparty::Side::SERVER,
+      test::TestSturdyRefObjectId::Tag::TEST_INTERFACE).castAs<test::TestInterface>();
+
+  auto call = [&]() {
+    auto request = client.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    EXPECT_EQ("foo", request.send().wait(ioContext.waitScope).getX());
+  };
+
+  // Warm up, then make sure further calls reuse the pooled segments.
+  for (uint i = 0; i < 4; i++) call();
+  kj::Promise<void>(kj::NEVER_DONE).poll(ioContext.waitScope);
+  auto allocations = pool.getAllocationCount();
+  KJ_EXPECT(allocations > 0);
+
+  for (uint i = 0; i < 100; i++) call();
+  kj::Promise<void>(kj::NEVER_DONE).poll(ioContext.waitScope);
+  KJ_EXPECT(pool.getAllocationCount() == allocations, pool.getAllocationCount(), allocations);
+  KJ_EXPECT(callCount == 104);
+}
+
+KJ_TEST("TwoPartyVatNetwork batches outgoing messages") {
+  auto ioContext = kj::setupAsyncIo();
+  int callCount = 0;
+  int handleCount = 0;
+
+  // The batch delay and the network's clock both run on a timer that only moves when we say so.
+  kj::TimerImpl timer(kj::origin<kj::TimePoint>());
+
+  auto serverThread = runServer(*ioContext.provider, callCount, handleCount);
+  TwoPartyVatNetwork network(*serverThread.pipe, rpc::twoparty::Side::CLIENT, ReaderOptions(),
+                             timer);
+  auto rpcClient = makeRpcClient(network);
+
+  auto client = getPersistentCap(rpcClient, rpc::twoparty::Side::SERVER,
+      test::TestSturdyRefObjectId::Tag::TEST_INTERFACE).castAs<test::TestInterface>();
+
+  auto sendCall = [&]() {
+    auto request = client.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    return request.send();
+  };
+  auto flush = [&]() {
+    kj::Promise<void>(kj::NEVER_DONE).poll(ioContext.waitScope);
+  };
+
+  // Warm up, so that the bootstrap is out of the way.
+  sendCall().wait(ioContext.waitScope);
+  flush();
+
+  {
+    // Calls made during one turn are written together.
+    auto before = network.getOutgoingBatchStats();
+    kj::Vector<RemotePromise<test::TestInterface::FooResults>> promises;
+    for (uint i = 0; i < 10; i++) promises.add(sendCall());
+    flush();
+    auto after = network.getOutgoingBatchStats();
+    KJ_EXPECT(after.messageCount - before.messageCount == 10);
+    KJ_EXPECT(after.writeCount - before.writeCount == 1);
+    for (auto& promise: promises) promise.wait(ioContext.waitScope);
+  }
+
+  {
+    // With a tiny byte limit, each message is written on its own.
+    network.setMaxOutgoingBatchBytes(1);
+    flush();
+    auto before = network.getOutgoingBatchStats();
+    kj::Vector<RemotePromise<test::TestInterface::FooResults>> promises;
+    for (uint i = 0; i < 10; i++) promises.add(sendCall());
+    flush();
+    auto after = network.getOutgoingBatchStats();
+    KJ_EXPECT(after.messageCount - before.messageCount == 10);
+    KJ_EXPECT(after.writeCount - before.writeCount == 10);
+    for (auto& promise: promises) promise.wait(ioContext.waitScope);
+    network.setMaxOutgoingBatchBytes(kj::maxValue);
+  }
+
+  {
+    // With a delay, calls made across several turns are written together.
+    network.setOutgoingBatchDelay(timer, 10 * kj::MILLISECONDS);
+    auto before = network.getOutgoingBatchStats();
+    kj::Vector<RemotePromise<test::TestInterface::FooResults>> promises;
+    for (uint i = 0; i < 5; i++) {
+      promises.add(sendCall());
+      flush();
+      timer.advanceTo(timer.now() + 1 * kj::MILLISECONDS);
+    }
+    KJ_EXPECT(network.getOutgoingBatchStats().writeCount == before.writeCount);
+    KJ_EXPECT(network.getOutgoingMessageWaitTime() == 5 * kj::MILLISECONDS);
+    timer.advanceTo(timer.now() + 5 * kj::MILLISECONDS);
+    flush();
+    auto after = network.getOutgoingBatchStats();
+    KJ_EXPECT(after.messageCount - before.messageCount == 5);
+    KJ_EXPECT(after.writeCount - before.writeCount == 1);
+    for (auto& promise: promises) promise.wait(ioContext.waitScope);
+
+    // Reaching the byte limit ends the delay early.
+    network.setOutgoingBatchDelay(timer, 1000 * kj::SECONDS);
+    network.setMaxOutgoingBatchBytes(1);
+    promises.clear();
+    before = network.getOutgoingBatchStats();
+    promises.add(sendCall());
+    promises.add(sendCall());
+    flush();
+    after = network.getOutgoingBatchStats();
+    KJ_EXPECT(after.messageCount - before.messageCount == 2);
+    for (auto& promise: promises) promise.wait(ioContext.waitScope);
+  }
+
+  KJ_EXPECT(callCount == 28);
+}
+
+class TestRpcMetrics final: public RpcMetrics {
+  // Keeps per-method call counts and power-of-two latency histograms, as an example of what an
+  // application might export to its monitoring system.
+
+public:
+  struct MethodStats {
+    uint sent = 0;
+    uint returned = 0;
+    uint failed = 0;
+    size_t resultWords = 0;
+    uint latencyHistogram[32] = {};
+    // Bucket i counts calls that took [2^i, 2^(i+1)) microseconds.
+  };
+
+  kj::HashMap<uint16_t, MethodStats> outgoing;
+  kj::HashMap<uint16_t, MethodStats> incoming;
+  uint messagesSent = 0;
+  uint messagesReceived = 0;
+  size_t wordsReceived = 0;
+  uint statsReports = 0;
+  size_t maxCallsInFlight = 0;
+
+  void callSent(uint64_t interfaceId, uint16_t methodId, size_t paramWords) override {
+    KJ_EXPECT(interfaceId == typeId<test::TestInterface>());
+    KJ_EXPECT(paramWords > 0);
+    ++get(outgoing, methodId).sent;
+  }
+  void callReturned(uint64_t interfaceId, uint16_t methodId, size_t resultWords,
+                    kj::Duration latency, bool failed) override {
+    record(get(outgoing, methodId), resultWords, latency, failed);
+  }
+  void callReceived(uint64_t interfaceId, uint16_t methodId, size_t paramWords) override {
+    ++get(incoming, methodId).sent;
+  }
+  void callAnswered(uint64_t interfaceId, uint16_t methodId, size_t resultWords,
+                    kj::Duration latency, bool failed) override {
+    record(get(incoming, methodId), resultWords, latency, failed);
+  }
+  void messageSent(size_t words) override {
+    ++messagesSent;
+  }
+  void messageReceived(size_t words) override {
+    ++messagesReceived;
+    wordsReceived += words;
+  }
+  void connectionStats(const ConnectionStats& stats) override {
+    ++statsReports;
+    maxCallsInFlight = kj::max(maxCallsInFlight, stats.callsInFlight);
+  }
+
+private:
+  static MethodStats& get(kj::HashMap<uint16_t, MethodStats>& map, uint16_t methodId) {
+    return map.findOrCreate(methodId, [&]() {
+      return kj::HashMap<uint16_t, MethodStats>::Entry { methodId, MethodStats() };
+    });
+  }
+
+  static void record(MethodStats& stats, size_t resultWords, kj::Duration latency, bool failed) {
+    ++stats.returned;
+    if (failed) ++stats.failed;
+    stats.resultWords += resultWords;
+
+    uint64_t us = latency / kj::MICROSECONDS;
+    uint bucket = 0;
+    while (us > 1 && bucket < 31) { us >>= 1; ++bucket; }
+    ++stats.latencyHistogram[bucket];
+  }
+};
+
+KJ_TEST("RpcSystem reports calls and traffic to RpcMetrics") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  auto pipe = kj::newTwoWayPipe();
+
+  int callCount = 0;
+  TwoPartyVatNetwork serverNetwork(*pipe.ends[1], rpc::twoparty::Side::SERVER);
+  auto server = makeRpcServer(serverNetwork,
+      test::TestInterface::Client(kj::heap<TestInterfaceImpl>(callCount)));
+  TestRpcMetrics serverMetrics;
+  server.setMetrics(serverMetrics);
+
+  TwoPartyVatNetwork clientNetwork(*pipe.ends[0], rpc::twoparty::Side::CLIENT);
+  auto rpcClient = makeRpcClient(clientNetwork);
+  TestRpcMetrics clientMetrics;
+  rpcClient.setMetrics(clientMetrics);
+
+  MallocMessageBuilder vatIdMessage(8);
+  auto vatId = vatIdMessage.initRoot<rpc::twoparty::VatId>();
+  vatId.setSide(rpc::twoparty::Side::SERVER);
+  auto client = rpcClient.bootstrap(vatId).castAs<test::TestInterface>();
+
+  auto promises = kj::heapArrayBuilder<kj::Promise<void>>(3);
+  for (uint i = 0; i < 3; i++) {
+    auto request = client.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    promises.add(request.send().ignoreResult());
+  }
+  kj::joinPromises(promises.finish()).wait(waitScope);
+  KJ_EXPECT(client.barRequest().send().then([](auto&&) { return false; },
+      [](kj::Exception&&) { return true; }).wait(waitScope));
+
+  // Let the `Finish` messages go through.
+  kj::Promise<void>(kj::NEVER_DONE).poll(waitScope);
+
+  KJ_EXPECT(callCount == 3);
+
+  auto& fooOut = KJ_ASSERT_NONNULL(clientMetrics.outgoing.find(0));
+  KJ_EXPECT(fooOut.sent == 3);
+  KJ_EXPECT(fooOut.returned == 3);
+  KJ_EXPECT(fooOut.failed == 0);
+  KJ_EXPECT(fooOut.resultWords > 0);
+  uint histogramTotal = 0;
+  for (auto count: fooOut.latencyHistogram) histogramTotal += count;
+  KJ_EXPECT(histogramTotal == 3);
+
+  auto& barOut = KJ_ASSERT_NONNULL(clientMetrics.outgoing.find(1));
+  KJ_EXPECT(barOut.sent == 1);
+  KJ_EXPECT(barOut.returned == 1);
+  KJ_EXPECT(barOut.failed == 1);
+
+  auto& fooIn = KJ_ASSERT_NONNULL(serverMetrics.incoming.find(0));
+  KJ_EXPECT(fooIn.sent == 3);
+  KJ_EXPECT(fooIn.returned == 3);
+  KJ_EXPECT(fooIn.failed == 0);
+  auto& barIn = KJ_ASSERT_NONNULL(serverMetrics.incoming.find(1));
+  KJ_EXPECT(barIn.returned == 1);
+  KJ_EXPECT(barIn.failed == 1);
+  KJ_EXPECT(serverMetrics.maxCallsInFlight >= 1);
+
+  // Bootstrap and four calls, plus `Finish`es for those results that need them.
+  KJ_EXPECT(clientMetrics.messagesSent >= 5, clientMetrics.messagesSent);
+  KJ_EXPECT(serverMetrics.messagesReceived == clientMetrics.messagesSent);
+  KJ_EXPECT(clientMetrics.messagesReceived == serverMetrics.messagesSent);
+  KJ_EXPECT(clientMetrics.wordsReceived > 0);
+  KJ_EXPECT(clientMetrics.statsReports == clientMetrics.messagesReceived);
+  KJ_EXPECT(clientMetrics.incoming.size() == 0);
+}
+
 TEST(TwoPartyNetwork, Pipelining) {
   auto ioContext = kj::setupAsyncIo();
   int callCount = 0;
@@ -442,6 +707,49 @@ TEST(TwoPartyNetwork, ConvenienceClasses) {
   EXPECT_EQ(1, callCount);
 }
 
+#if !_WIN32
+KJ_TEST("ShardedTwoPartyServer spreads connections across threads") {
+  auto ioContext = kj::setupAsyncIo();
+
+  int callCounts[2] = { 0, 0 };
+  uint threadIndex = 0;
+  auto server = kj::heap<ShardedTwoPartyServer>(2, [&]() -> Capability::Client {
+    // Called on each worker thread in turn.
+    return kj::heap<TestInterfaceImpl>(callCounts[threadIndex++]);
+  });
+
+  auto address = ioContext.provider->getNetwork()
+      .parseAddress("127.0.0.1").wait(ioContext.waitScope);
+  auto listener = address->listen();
+  auto listenPromise = server->listen(*listener);
+  address = ioContext.provider->getNetwork()
+      .parseAddress("127.0.0.1", listener->getPort()).wait(ioContext.waitScope);
+
+  kj::Vector<kj::Own<kj::AsyncIoStream>> connections;
+  kj::Vector<kj::Own<TwoPartyClient>> clients;
+  for (auto i KJ_UNUSED: kj::zeroTo(4)) {
+    auto& connection = connections.add(address->connect().wait(ioContext.waitScope));
+    auto& client = clients.add(kj::heap<TwoPartyClient>(*connection));
+    auto request = client->bootstrap().castAs<test::TestInterface>().fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    KJ_EXPECT(request.send().wait(ioContext.waitScope).getX() == "foo");
+  }
+
+  KJ_EXPECT(server->getConnectionCount(0) == 2);
+  KJ_EXPECT(server->getConnectionCount(1) == 2);
+
+  clients.clear();
+  connections.clear();
+  listenPromise = nullptr;
+  server = nullptr;
+
+  // Worker threads have been joined, so their counts are safe to read.
+  KJ_EXPECT(callCounts[0] == 2);
+  KJ_EXPECT(callCounts[1] == 2);
+}
+#endif
+
 TEST(TwoPartyNetwork, HugeMessage) {
   auto ioContext = kj::setupAsyncIo();
   int callCount = 0;
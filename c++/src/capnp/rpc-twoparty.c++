@@ -23,6 +23,12 @@
 #include "serialize-async.h"
 #include <kj/debug.h>
 #include <kj/io.h>
+#include <kj/mutex.h>
+#include <kj/thread.h>
+
+#if !_WIN32
+#include <fcntl.h>
+#endif
 
 namespace capnp {
 
@@ -129,11 +135,17 @@ class TwoPartyVatNetwork::OutgoingMessageImpl final
     : public OutgoingRpcMessage, public kj::Refcounted {
 public:
   OutgoingMessageImpl(TwoPartyVatNetwork& network, uint firstSegmentWordSize)
-      : network(network),
-        message(firstSegmentWordSize == 0 ? SUGGESTED_FIRST_SEGMENT_WORDS : firstSegmentWordSize) {}
+      : network(network) {
+    uint size = firstSegmentWordSize == 0 ? SUGGESTED_FIRST_SEGMENT_WORDS : firstSegmentWordSize;
+    KJ_IF_SOME(pool, network.segmentPool) {
+      message = &builder.init<PooledMessageBuilder>(pool, size);
+    } else {
+      message = &builder.init<MallocMessageBuilder>(size);
+    }
+  }
 
   AnyPointer::Builder getBody() override {
-    return message.getRoot<AnyPointer>();
+    return message->getRoot<AnyPointer>();
   }
 
   void setFds(kj::Array<int> fds) override {
@@ -144,7 +156,7 @@ public:
 
   void send() override {
     size_t size = 0;
-    for (auto& segment: message.getSegmentsForOutput()) {
+    for (auto& segment: message->getSegmentsForOutput()) {
       size += segment.size();
     }
     KJ_REQUIRE(size < network.receiveOptions.traversalLimitInWords, size,
@@ -154,7 +166,7 @@ public:
       return;
     }
 
-    auto sendTime = network.clock.now();
+    sendTime = network.clock.now();
     if (network.queuedMessages.size() == 0) {
       // Optimistically set sendTime when there's no messages in the queue. Without this, sending
       // a message after a long delay could cause getOutgoingMessageWaitTime() to return excessively
@@ -167,54 +179,129 @@ public:
     // Instead of sending each new message as soon as possible, we attempt to batch together small
     // messages by delaying when we send them using evalLast. This allows us to group together
     // related small messages, reducing the number of syscalls we make.
-    auto& previousWrite = KJ_ASSERT_NONNULL(network.previousWrite, "already shut down");
+    KJ_ASSERT(network.previousWrite != kj::none, "already shut down");
     bool alreadyPendingSend = !network.queuedMessages.empty();
-    network.currentQueueSize += message.sizeInWords() * sizeof(word);
+    network.currentQueueSize += message->sizeInWords() * sizeof(word);
     network.queuedMessages.add(kj::addRef(*this));
     if (alreadyPendingSend) {
       // The first send sets up an evalLast that will clear out pendingMessages when it's sent.
       // If pendingMessages is non-empty, then there must already be a callback waiting to send
       // them.
+      if (network.currentQueueSize >= network.maxBatchBytes) {
+        KJ_IF_SOME(fulfiller, network.batchFullFulfiller) {
+          // Don't wait out the rest of the batch delay.
+          fulfiller->fulfill();
+          network.batchFullFulfiller = kj::none;
+        }
+      }
       return;
     }
 
     // On the other hand, if pendingMessages was empty, then we should set up the delayed write.
-    network.previousWrite = previousWrite.then([&network = network, sendTime]() {
-      return kj::evalLast([&network, sendTime]() -> kj::Promise<void> {
-        network.currentOutgoingMessageSendTime = sendTime;
-        // Swap out the connection's pending messages and write all of them together.
-        auto ownMessages = kj::mv(network.queuedMessages);
-        network.currentQueueSize = 0;
-        auto messages =
-          kj::heapArray<MessageAndFds>(ownMessages.size());
-        for (int i = 0; i < messages.size(); ++i) {
-          messages[i].segments = ownMessages[i]->message.getSegmentsForOutput();
-          messages[i].fds = ownMessages[i]->fds;
-        }
-        return network.getStream().writeMessages(messages).attach(kj::mv(ownMessages), kj::mv(messages));
-      }).catch_([&network](kj::Exception&& e) {
-        // Since no one checks write failures, we need to propagate them into read failures,
-        // otherwise we might get stuck sending all messages into a black hole and wondering why
-        // the peer never replies.
-        network.readCancelReason = kj::cp(e);
-        if (!network.readCanceler.isEmpty()) {
-          network.readCanceler.cancel(kj::cp(e));
-        }
-        kj::throwRecoverableException(kj::mv(e));
-      });
-    }).eagerlyEvaluate(nullptr);
+    network.scheduleBatch(sendTime);
   }
 
   size_t sizeInWords() override {
-    return message.sizeInWords();
+    return message->sizeInWords();
   }
 
 private:
+  friend class TwoPartyVatNetwork;
+
   TwoPartyVatNetwork& network;
-  MallocMessageBuilder message;
+  kj::OneOf<MallocMessageBuilder, PooledMessageBuilder> builder;
+  MessageBuilder* message;
+  // Points into `builder`.
   kj::Array<int> fds;
+  kj::TimePoint sendTime = kj::origin<kj::TimePoint>();
+  // When send() queued this message.
 };
 
+void TwoPartyVatNetwork::setOutgoingBatchDelay(kj::Timer& timer, kj::Duration delay) {
+  batchTimer = timer;
+  batchDelay = delay;
+}
+
+void TwoPartyVatNetwork::scheduleBatch(kj::TimePoint sendTime) {
+  auto& previous = KJ_ASSERT_NONNULL(previousWrite, "already shut down");
+
+  kj::Promise<void> ready = kj::READY_NOW;
+  KJ_IF_SOME(timer, batchTimer) {
+    if (currentQueueSize < maxBatchBytes) {
+      // The delay starts now, concurrently with any write still in progress.
+      auto paf = kj::newPromiseAndFulfiller<void>();
+      batchFullFulfiller = kj::mv(paf.fulfiller);
+      ready = timer.afterDelay(batchDelay).exclusiveJoin(kj::mv(paf.promise));
+    }
+  }
+
+  previousWrite = previous.then([ready = kj::mv(ready)]() mutable {
+    return kj::mv(ready);
+  }).then([this, sendTime]() {
+    return kj::evalLast([this, sendTime]() {
+      return writeBatch(sendTime);
+    });
+  }).catch_([this](kj::Exception&& e) {
+    // Since no one checks write failures, we need to propagate them into read failures,
+    // otherwise we might get stuck sending all messages into a black hole and wondering why
+    // the peer never replies.
+    readCancelReason = kj::cp(e);
+    if (!readCanceler.isEmpty()) {
+      readCanceler.cancel(kj::cp(e));
+    }
+    kj::throwRecoverableException(kj::mv(e));
+  }).eagerlyEvaluate(nullptr);
+}
+
+kj::Promise<void> TwoPartyVatNetwork::writeBatch(kj::TimePoint sendTime) {
+  currentOutgoingMessageSendTime = sendTime;
+  batchFullFulfiller = kj::none;
+
+  // Take as many messages as fit in the batch size limit, but at least one.
+  size_t count = 0;
+  size_t bytes = 0;
+  for (auto& message: queuedMessages) {
+    size_t messageBytes = message->sizeInWords() * sizeof(word);
+    if (count > 0 && bytes + messageBytes > maxBatchBytes) break;
+    bytes += messageBytes;
+    ++count;
+  }
+
+  // Swap out the connection's pending messages and write all of them together.
+  kj::Vector<kj::Own<OutgoingMessageImpl>> ownMessages;
+  if (count == queuedMessages.size()) {
+    ownMessages = kj::mv(queuedMessages);
+  } else {
+    ownMessages.reserve(count);
+    kj::Vector<kj::Own<OutgoingMessageImpl>> rest(queuedMessages.size() - count);
+    for (auto i: kj::indices(queuedMessages)) {
+      (i < count ? ownMessages : rest).add(kj::mv(queuedMessages[i]));
+    }
+    queuedMessages = kj::mv(rest);
+  }
+  currentQueueSize -= bytes;
+
+  auto messages = kj::heapArray<MessageAndFds>(ownMessages.size());
+  for (auto i: kj::indices(messages)) {
+    messages[i].segments = ownMessages[i]->message->getSegmentsForOutput();
+    messages[i].fds = ownMessages[i]->fds;
+  }
+  ++batchStats.writeCount;
+  batchStats.messageCount += messages.size();
+
+  auto promise = getStream().writeMessages(messages)
+      .attach(kj::mv(ownMessages), kj::mv(messages));
+  if (queuedMessages.empty()) {
+    return promise;
+  } else {
+    // The rest didn't fit in this batch. They've waited long enough, so write them next.
+    return promise.then([this]() {
+      return queuedMessages.empty() ? kj::Promise<void>(kj::READY_NOW)
+                                    : writeBatch(queuedMessages[0]->sendTime);
+    });
+  }
+}
+
 kj::Duration TwoPartyVatNetwork::getOutgoingMessageWaitTime() {
   if (queuedMessages.size() > 0) {
     return clock.now() - currentOutgoingMessageSendTime;
@@ -434,6 +521,147 @@ void TwoPartyServer::taskFailed(kj::Exception&& exception) {
   KJ_LOG(ERROR, exception);
 }
 
+// =======================================================================================
+
+class ShardedTwoPartyServer::Worker {
+public:
+  explicit Worker(kj::Function<Capability::Client()>& bootstrapFactory)
+      : thread([this, &bootstrapFactory]() {
+          KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { run(bootstrapFactory); })) {
+            auto lock = state.lockExclusive();
+            if (lock->executor == kj::none) {
+              // Failed during startup; report it to the constructor.
+              lock->error = kj::mv(exception);
+            } else {
+              kj::throwFatalException(kj::mv(exception));
+            }
+          }
+        }) {
+    executor = state.when([](const StartState& s) {
+      return s.executor != kj::none || s.error != kj::none;
+    }, [](StartState& s) -> kj::Own<const kj::Executor> {
+      KJ_IF_SOME(e, s.error) {
+        kj::throwFatalException(kj::cp(e));
+      }
+      return KJ_ASSERT_NONNULL(s.executor)->addRef();
+    });
+  }
+
+  ~Worker() noexcept(false) {
+    // If the worker's loop already exited (because it failed), there's nothing to stop, and
+    // joining `thread` below reports the failure.
+    if (executor->isLive()) {
+      KJ_IF_SOME(e, kj::runCatchingExceptions([this]() {
+        executor->executeSync([this]() { stopFulfiller->fulfill(); });
+      })) {
+        // The loop exited between the check and the call.
+        KJ_LOG(ERROR, "ShardedTwoPartyServer worker exited before it was stopped", e);
+      }
+    }
+  }
+
+  uint connectionCount = 0;
+  // Only touched by the thread that owns the ShardedTwoPartyServer.
+
+  kj::Own<const kj::Executor> executor;
+
+  // The remaining members are only touched on the worker thread itself.
+  TwoPartyServer* server = nullptr;
+  kj::LowLevelAsyncIoProvider* provider = nullptr;
+  kj::Own<kj::PromiseFulfiller<void>> stopFulfiller;
+
+private:
+  struct StartState {
+    kj::Maybe<kj::Own<const kj::Executor>> executor;
+    kj::Maybe<kj::Exception> error;
+  };
+  kj::MutexGuarded<StartState> state;
+
+  kj::Thread thread;
+  // Declared last so that it is joined before anything else is destroyed.
+
+  void run(kj::Function<Capability::Client()>& bootstrapFactory) {
+    auto io = kj::setupAsyncIo();
+    TwoPartyServer twoPartyServer(bootstrapFactory());
+    auto paf = kj::newPromiseAndFulfiller<void>();
+
+    server = &twoPartyServer;
+    provider = io.lowLevelProvider.get();
+    stopFulfiller = kj::mv(paf.fulfiller);
+    state.lockExclusive()->executor = kj::getCurrentThreadExecutor().addRef();
+
+    paf.promise.wait(io.waitScope);
+    stopFulfiller = nullptr;
+  }
+};
+
+ShardedTwoPartyServer::ShardedTwoPartyServer(
+    uint threadCount, kj::Function<Capability::Client()> bootstrapFactory)
+    : tasks(*this) {
+  KJ_REQUIRE(threadCount > 0, "ShardedTwoPartyServer needs at least one thread.");
+
+  // Workers are started one at a time, so `bootstrapFactory` is never called concurrently.
+  auto builder = kj::heapArrayBuilder<kj::Own<Worker>>(threadCount);
+  for (auto i KJ_UNUSED: kj::zeroTo(threadCount)) {
+    builder.add(kj::heap<Worker>(bootstrapFactory));
+  }
+  workers = builder.finish();
+}
+
+ShardedTwoPartyServer::~ShardedTwoPartyServer() noexcept(false) {}
+
+void ShardedTwoPartyServer::accept(kj::Own<kj::AsyncIoStream>&& connection) {
+#if _WIN32
+  KJ_UNIMPLEMENTED("ShardedTwoPartyServer is not supported on Windows.");
+#else
+  // Event loops can't share an AsyncIoStream, so hand the worker a duplicate of the underlying
+  // file descriptor and drop our end.
+  int fd = KJ_REQUIRE_NONNULL(connection->getFd(),
+      "ShardedTwoPartyServer requires connections backed by file descriptors.");
+  int newFd;
+  KJ_SYSCALL(newFd = fcntl(fd, F_DUPFD_CLOEXEC, 0));
+  kj::AutoCloseFd ownFd(newFd);
+  connection = nullptr;
+
+  Worker* target = workers[0].get();
+  for (auto& worker: workers) {
+    if (worker->connectionCount < target->connectionCount) {
+      target = worker.get();
+    }
+  }
+  Worker& worker = *target;
+  ++worker.connectionCount;
+
+  auto promise = worker.executor->executeAsync([&worker, fd = kj::mv(ownFd)]() mutable {
+    // Now on the worker thread.
+    auto stream = worker.provider->wrapSocketFd(kj::mv(fd),
+        kj::LowLevelAsyncIoProvider::ALREADY_CLOEXEC);
+    auto promise = worker.server->accept(*stream);
+    return promise.attach(kj::mv(stream));
+  });
+  tasks.add(promise.attach(kj::defer([&worker]() { --worker.connectionCount; })));
+#endif
+}
+
+kj::Promise<void> ShardedTwoPartyServer::listen(kj::ConnectionReceiver& listener) {
+  return listener.accept()
+      .then([this,&listener](kj::Own<kj::AsyncIoStream>&& connection) mutable {
+    accept(kj::mv(connection));
+    return listen(listener);
+  });
+}
+
+uint ShardedTwoPartyServer::getConnectionCount(uint thread) const {
+  KJ_REQUIRE(thread < workers.size(), "no such worker thread");
+  return workers[thread]->connectionCount;
+}
+
+void ShardedTwoPartyServer::taskFailed(kj::Exception&& exception) {
+  KJ_LOG(ERROR, exception);
+}
+
+// =======================================================================================
+
 TwoPartyClient::TwoPartyClient(kj::AsyncIoStream& connection)
     : network(connection, rpc::twoparty::Side::CLIENT),
       rpcSystem(makeRpcClient(network)) {}
@@ -96,6 +96,34 @@ public:
   // Get how long the current outgoing message has been waiting to be sent on this connection.
   // Returns 0 if the queue is empty. This may be useful for backpressure.
 
+  void setOutgoingSegmentPool(SegmentPool& pool) { segmentPool = pool; }
+  // Build outgoing messages in segments recycled through `pool` instead of allocating fresh ones
+  // for each message. The pool must outlive this network and every message it sends. Since pools
+  // aren't thread-safe, only share one among networks driven by the same event loop.
+
+  void setMaxOutgoingBatchBytes(size_t bytes) { maxBatchBytes = bytes; }
+  // Outgoing messages are written in batches: all messages sent during one event loop turn, or
+  // while the previous write is still in progress, are written together with a single call to
+  // MessageStream::writeMessages(). This limits each batch to about `bytes` (a single larger
+  // message is still written on its own); any further messages go in the next batch. When an
+  // outgoing batch delay is set, reaching this size also ends the delay early. Default: no limit.
+
+  void setOutgoingBatchDelay(kj::Timer& timer, kj::Duration delay);
+  // Wait up to `delay` after a message is queued before writing it, so that messages sent during
+  // several event loop turns can be written together. This trades latency for fewer syscalls
+  // on chatty connections. By default there is no delay beyond the end of the current turn.
+
+  struct OutgoingBatchStats {
+    uint64_t messageCount = 0;
+    // Number of messages written.
+
+    uint64_t writeCount = 0;
+    // Number of batches written, i.e. calls to MessageStream::writeMessages(). Each is typically a
+    // single syscall, so `messageCount / writeCount` approximates messages per syscall.
+  };
+
+  OutgoingBatchStats getOutgoingBatchStats() { return batchStats; }
+
   // implements VatNetwork -----------------------------------------------------
 
   kj::Maybe<kj::Own<TwoPartyVatNetworkBase::Connection>> connect(
@@ -114,6 +142,7 @@ private:
   rpc::twoparty::Side side;
   MallocMessageBuilder peerVatId;
   ReaderOptions receiveOptions;
+  kj::Maybe<SegmentPool&> segmentPool;
   bool accepted = false;
 
   bool solSndbufUnimplemented = false;
@@ -138,6 +167,14 @@ private:
   const kj::MonotonicClock& clock;
   kj::TimePoint currentOutgoingMessageSendTime;
 
+  size_t maxBatchBytes = kj::maxValue;
+  kj::Maybe<kj::Timer&> batchTimer;
+  kj::Duration batchDelay = 0 * kj::SECONDS;
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> batchFullFulfiller;
+  // While waiting out the batch delay, fulfilled to end the wait once the batch is full.
+
+  OutgoingBatchStats batchStats;
+
   class FulfillerDisposer: public kj::Disposer {
     // Hack:  TwoPartyVatNetwork is both a VatNetwork and a VatNetwork::Connection.  When the RPC
     //   system detects (or initiates) a disconnection, it drops its reference to the Connection.
@@ -163,6 +200,13 @@ private:
 
   MessageStream& getStream();
 
+  void scheduleBatch(kj::TimePoint sendTime);
+  // Arrange for the queued messages to be written once the previous write completes and the
+  // batch is ready. Called when a message is added to an empty queue.
+
+  kj::Promise<void> writeBatch(kj::TimePoint sendTime);
+  // Write the next batch of queued messages, then any remaining ones.
+
   kj::Own<TwoPartyVatNetworkBase::Connection> asConnection();
   // Returns a pointer to this with the disposer set to disconnectFulfiller.
 
@@ -228,6 +272,52 @@ private:
   void taskFailed(kj::Exception&& exception) override;
 };
 
+class ShardedTwoPartyServer: private kj::TaskSet::ErrorHandler {
+  // Like TwoPartyServer, but spreads connections across a pool of worker threads, each with its
+  // own event loop and RpcSystem. Each connection is handed to whichever worker is currently
+  // servicing the fewest connections, and stays on that worker until it disconnects.
+  //
+  // Each worker gets its own bootstrap capability, created on the worker thread by
+  // `bootstrapFactory`. To let workers share state hosted on some other thread, have the factory
+  // return (or hand out) capabilities obtained from CrossThreadCapability::getClient(); calls on
+  // them are then delivered directly between threads without serialization.
+  //
+  // Connections must be backed by file descriptors (as all streams from kj::AsyncIoProvider's
+  // network are). This is currently not supported on Windows.
+  //
+  // Destroying the ShardedTwoPartyServer disconnects all clients and joins the worker threads. It
+  // blocks while workers shut down, so a worker must not be waiting on a cross-thread call into
+  // the destroying thread at that time.
+
+public:
+  ShardedTwoPartyServer(uint threadCount,
+                        kj::Function<Capability::Client()> bootstrapFactory);
+  ~ShardedTwoPartyServer() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(ShardedTwoPartyServer);
+
+  void accept(kj::Own<kj::AsyncIoStream>&& connection);
+  // Hands the connection off to a worker thread for servicing.
+
+  kj::Promise<void> listen(kj::ConnectionReceiver& listener);
+  // Listens for connections on the given listener, which belongs to the calling thread. The
+  // returned promise never resolves unless an exception is thrown while trying to accept. You may
+  // discard the returned promise to cancel listening.
+
+  kj::Promise<void> drain() { return tasks.onEmpty(); }
+  // Resolves when all clients have disconnected.
+
+  uint getConnectionCount(uint thread) const;
+  // Returns the number of connections currently serviced by the given worker thread.
+
+private:
+  class Worker;
+  kj::Array<kj::Own<Worker>> workers;
+  kj::TaskSet tasks;
+  // Declared after `workers` so that connections are torn down before workers are stopped.
+
+  void taskFailed(kj::Exception&& exception) override;
+};
+
 class TwoPartyClient {
   // Convenience class which implements a simple client.
 
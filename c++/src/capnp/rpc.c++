@@ -248,6 +248,11 @@ public:
     return *slot;
   }
 
+  size_t size() {
+    // Number of entries currently in the table.
+    return slots.size() - freeIds.size() + highSlots.size();
+  }
+
   template <typename Func>
   void forEach(Func&& func) {
     for (Id i = 0; i < slots.size(); i++) {
@@ -344,10 +349,11 @@ public:
                      kj::Own<VatNetworkBase::Connection>&& connectionParam,
                      kj::Own<kj::PromiseFulfiller<DisconnectInfo>>&& disconnectFulfiller,
                      size_t flowLimit,
-                     kj::Maybe<kj::Function<kj::String(const kj::Exception&)>&> traceEncoder)
+                     kj::Maybe<kj::Function<kj::String(const kj::Exception&)>&> traceEncoder,
+                     kj::Maybe<RpcMetrics&> metrics)
       : bootstrapFactory(bootstrapFactory),
         restorer(restorer), disconnectFulfiller(kj::mv(disconnectFulfiller)), flowLimit(flowLimit),
-        traceEncoder(traceEncoder), tasks(*this) {
+        traceEncoder(traceEncoder), metrics(metrics), tasks(*this) {
     connection.init<Connected>(kj::mv(connectionParam));
     tasks.add(messageLoop());
   }
@@ -396,10 +402,10 @@ public:
     // `tasks.add(exception)` to schedule a shutdown, since any error thrown by a task will be
     // passed to `disconnect()` later.
 
-    // After disconnect(), the RpcSystem could be destroyed, making `traceEncoder` a dangling
-    // reference, so null it out before we return from here. We don't need it anymore once
-    // disconnected anyway.
-    KJ_DEFER(traceEncoder = nullptr);
+    // After disconnect(), the RpcSystem could be destroyed, making `traceEncoder` and `metrics`
+    // dangling references, so null them out before we return from here. We don't need them
+    // anymore once disconnected anyway.
+    KJ_DEFER(traceEncoder = nullptr; metrics = kj::none);
 
     if (!connection.is<Connected>()) {
       // Already disconnected.
@@ -709,6 +715,10 @@ private:
 
   kj::Maybe<kj::Function<kj::String(const kj::Exception&)>&> traceEncoder;
 
+  kj::Maybe<RpcMetrics&> metrics;
+  size_t callsInFlight = 0;
+  // Number of RpcCallContexts counted in `callWordsInFlight`, for metrics.
+
   kj::TaskSet tasks;
 
   bool gotReturnForHighQuestionId = false;
@@ -1968,6 +1978,10 @@ private:
         result.questionRef->reject(kj::mv(exception));
       }
 
+      if (connectionState->metrics != kj::none) {
+        result.promise = meterCall(kj::mv(result.promise), message->sizeInWords());
+      }
+
       // Send and return.
       return kj::mv(result);
     }
@@ -1980,6 +1994,9 @@ private:
       if (isTailCall) {
         callBuilder.getSendResultsTo().setYourself();
       }
+      if (connectionState->metrics != kj::none) {
+        setup.promise = meterCall(kj::mv(setup.promise), message->sizeInWords());
+      }
       kj::Promise<void> flowPromise = nullptr;
       KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
         KJ_CONTEXT("sending RPC call",
@@ -2042,8 +2059,40 @@ private:
           callBuilder.getInterfaceId(), callBuilder.getMethodId());
       message->send();
 
+      KJ_IF_SOME(m, connectionState->metrics) {
+        m.callSent(callBuilder.getInterfaceId(), callBuilder.getMethodId(), message->sizeInWords());
+      }
+
       return kj::mv(questionRef);
     }
+
+    kj::Promise<kj::Own<RpcResponse>> meterCall(
+        kj::Promise<kj::Own<RpcResponse>> promise, size_t paramWords) {
+      // Reports the call to the connection's RpcMetrics, and arranges to report its completion.
+
+      uint64_t interfaceId = callBuilder.getInterfaceId();
+      uint16_t methodId = callBuilder.getMethodId();
+      KJ_ASSERT_NONNULL(connectionState->metrics).callSent(interfaceId, methodId, paramWords);
+
+      auto startTime = connectionState->metricsNow();
+      return promise.then(
+          [state = kj::addRef(*connectionState), interfaceId, methodId, startTime]
+          (kj::Own<RpcResponse>&& response) mutable {
+        KJ_IF_SOME(m, state->metrics) {
+          // `response` is null for tail calls.
+          size_t resultWords = response.get() == nullptr ? 0 : response->sizeInWords();
+          m.callReturned(interfaceId, methodId, resultWords,
+                         state->metricsNow() - startTime, false);
+        }
+        return kj::mv(response);
+      }, [state = kj::addRef(*connectionState), interfaceId, methodId, startTime]
+          (kj::Exception&& exception) mutable -> kj::Own<RpcResponse> {
+        KJ_IF_SOME(m, state->metrics) {
+          m.callReturned(interfaceId, methodId, 0, state->metricsNow() - startTime, true);
+        }
+        kj::throwFatalException(kj::mv(exception));
+      });
+    }
   };
 
   class RpcPipeline final: public PipelineHook, public kj::Refcounted {
@@ -2160,6 +2209,8 @@ private:
   public:
     virtual AnyPointer::Reader getResults() = 0;
     virtual kj::Own<RpcResponse> addRef() = 0;
+    virtual size_t sizeInWords() = 0;
+    // Size of the message holding the results, for metrics.
   };
 
   class RpcResponseImpl final: public RpcResponse, public kj::Refcounted {
@@ -2183,6 +2234,10 @@ private:
       return kj::addRef(*this);
     }
 
+    size_t sizeInWords() override {
+      return message->sizeInWords();
+    }
+
   private:
     kj::Own<RpcConnectionState> connectionState;
     kj::Own<IncomingRpcMessage> message;
@@ -2216,6 +2271,10 @@ private:
       return capTable.getTable().size() > 0;
     }
 
+    inline size_t sizeInWords() {
+      return message->sizeInWords();
+    }
+
     kj::Maybe<kj::Array<ExportId>> send() {
       // Send the response and return the export list.  Returns kj::none if there were no caps.
       // (Could return a non-null empty array if there were caps but none of them were exports.)
@@ -2302,6 +2361,10 @@ private:
       return kj::addRef(*this);
     }
 
+    size_t sizeInWords() override {
+      return message.sizeInWords();
+    }
+
   private:
     MallocMessageBuilder message;
   };
@@ -2389,6 +2452,7 @@ private:
           hints(hints),
           interfaceId(interfaceId),
           methodId(methodId),
+          startTime(connectionState.metricsNow()),
           requestSize(request->sizeInWords()),
           request(kj::mv(request)),
           paramsCapTable(kj::mv(capTableArray)),
@@ -2396,6 +2460,10 @@ private:
           returnMessage(nullptr),
           redirectResults(redirectResults) {
       connectionState.callWordsInFlight += requestSize;
+      ++connectionState.callsInFlight;
+      KJ_IF_SOME(m, connectionState.metrics) {
+        m.callReceived(interfaceId, methodId, requestSize);
+      }
     }
 
     ~RpcCallContext() noexcept(false) {
@@ -2427,6 +2495,7 @@ private:
             message->send();
           }
 
+          reportAnswered(0, true);
           cleanupAnswerTable(nullptr, shouldFreePipeline);
         });
       }
@@ -2486,6 +2555,8 @@ private:
           return;
         }
 
+        reportAnswered(responseImpl.sizeInWords(), false);
+
         if (responseImpl.hasCapabilities()) {
           auto& answer = KJ_ASSERT_NONNULL(connectionState->answers.find(answerId));
           // Swap out the `pipeline` in the answer table for one that will return capabilities
@@ -2527,6 +2598,8 @@ private:
           message->send();
         }
 
+        reportAnswered(0, true);
+
         // Do not allow releasing the pipeline because we want pipelined calls to propagate the
         // exception rather than fail with a "no such field" exception.
         cleanupAnswerTable(nullptr, false);
@@ -2551,6 +2624,7 @@ private:
 
         message->send();
 
+        reportAnswered(0, false);
         cleanupAnswerTable(nullptr, false);
       }
     }
@@ -2630,6 +2704,8 @@ private:
               message->send();
             }
 
+            reportAnswered(0, false);
+
             // There are no caps in our return message, but of course the tail results could have
             // caps, so we must continue to honor pipeline calls (and just bounce them back).
             cleanupAnswerTable(nullptr, false);
@@ -2676,7 +2752,10 @@ private:
 
     uint64_t interfaceId;
     uint16_t methodId;
-    // For debugging.
+    // For debugging and metrics.
+
+    kj::TimePoint startTime;
+    // When the call was received, if metrics are enabled.
 
     // Request ---------------------------------------------
 
@@ -2712,6 +2791,13 @@ private:
       }
     }
 
+    void reportAnswered(size_t resultWords, bool failed) {
+      KJ_IF_SOME(m, connectionState->metrics) {
+        m.callAnswered(interfaceId, methodId, resultWords,
+                       connectionState->metricsNow() - startTime, failed);
+      }
+    }
+
     void cleanupAnswerTable(kj::Array<ExportId> resultExports, bool shouldFreePipeline) {
       // We need to remove the `callContext` pointer -- which points back to us -- from the
       // answer table.  Or we might even be responsible for removing the entire answer table
@@ -2738,6 +2824,7 @@ private:
 
       // Also, this is the right time to stop counting the call against the flow limit.
       connectionState->callWordsInFlight -= requestSize;
+      --connectionState->callsInFlight;
       connectionState->maybeUnblockFlow();
     }
   };
@@ -2745,6 +2832,28 @@ private:
   // =====================================================================================
   // Message handling
 
+  kj::TimePoint metricsNow() {
+    // Reads the clock for metrics. Returns a dummy time if metrics are disabled, so that we don't
+    // pay for the clock read.
+    if (metrics == kj::none) {
+      return kj::origin<kj::TimePoint>();
+    } else {
+      return kj::systemPreciseMonotonicClock().now();
+    }
+  }
+
+  void reportConnectionStats() {
+    KJ_IF_SOME(m, metrics) {
+      RpcMetrics::ConnectionStats stats;
+      stats.questions = questions.size();
+      stats.exports = exports.size();
+      stats.embargoes = embargoes.size();
+      stats.callsInFlight = callsInFlight;
+      stats.callWordsInFlight = callWordsInFlight;
+      m.connectionStats(stats);
+    }
+  }
+
   void maybeUnblockFlow() {
     if (callWordsInFlight < flowLimit) {
       KJ_IF_SOME(w, flowWaiter) {
@@ -2760,9 +2869,15 @@ private:
     }
 
     if (callWordsInFlight > flowLimit) {
+      KJ_IF_SOME(m, metrics) {
+        m.flowLimitStalled();
+      }
       auto paf = kj::newPromiseAndFulfiller<void>();
       flowWaiter = kj::mv(paf.fulfiller);
-      return paf.promise.then([this]() {
+      return paf.promise.then([this,stallStart = metricsNow()]() {
+        KJ_IF_SOME(m, metrics) {
+          m.flowLimitResumed(metricsNow() - stallStart);
+        }
         return messageLoop();
       });
     }
@@ -2770,7 +2885,11 @@ private:
     return canceler.wrap(connection.get<Connected>()->receiveIncomingMessage()).then(
         [this](kj::Maybe<kj::Own<IncomingRpcMessage>>&& message) {
       KJ_IF_SOME(m, message) {
+        KJ_IF_SOME(mt, metrics) {
+          mt.messageReceived(m->sizeInWords());
+        }
         handleMessage(kj::mv(m));
+        reportConnectionStats();
         return true;
       } else {
         tasks.add(KJ_EXCEPTION(DISCONNECTED, "Peer disconnected."));
@@ -3531,6 +3650,51 @@ private:
   // Level 2
 };
 
+class MeteredOutgoingMessage final: public OutgoingRpcMessage {
+  // Wraps an outgoing message in order to report it to RpcMetrics when sent.
+
+public:
+  MeteredOutgoingMessage(kj::Own<OutgoingRpcMessage> inner, RpcMetrics& metrics)
+      : inner(kj::mv(inner)), metrics(metrics) {}
+
+  AnyPointer::Builder getBody() override { return inner->getBody(); }
+  void setFds(kj::Array<int> fds) override { inner->setFds(kj::mv(fds)); }
+  size_t sizeInWords() override { return inner->sizeInWords(); }
+
+  void send() override {
+    metrics.messageSent(inner->sizeInWords());
+    inner->send();
+  }
+
+private:
+  kj::Own<OutgoingRpcMessage> inner;
+  RpcMetrics& metrics;
+};
+
+class MeteredConnection final: public VatNetworkBase::Connection {
+  // Wraps a connection so that its outgoing messages are reported to RpcMetrics. (Incoming
+  // messages are reported by RpcConnectionState directly.) Only used when metrics are enabled.
+
+public:
+  MeteredConnection(kj::Own<VatNetworkBase::Connection> inner, RpcMetrics& metrics)
+      : inner(kj::mv(inner)), metrics(metrics) {}
+
+  kj::Own<OutgoingRpcMessage> newOutgoingMessage(uint firstSegmentWordSize) override {
+    return kj::heap<MeteredOutgoingMessage>(
+        inner->newOutgoingMessage(firstSegmentWordSize), metrics);
+  }
+  kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> receiveIncomingMessage() override {
+    return inner->receiveIncomingMessage();
+  }
+  kj::Promise<void> shutdown() override { return inner->shutdown(); }
+  AnyStruct::Reader baseGetPeerVatId() override { return inner->baseGetPeerVatId(); }
+  kj::Own<RpcFlowController> newStream() override { return inner->newStream(); }
+
+private:
+  kj::Own<VatNetworkBase::Connection> inner;
+  RpcMetrics& metrics;
+};
+
 }  // namespace
 
 class RpcSystemBase::Impl final: private BootstrapFactoryBase, private kj::TaskSet::ErrorHandler {
@@ -3599,6 +3763,10 @@ public:
     traceEncoder = kj::mv(func);
   }
 
+  void setMetrics(RpcMetrics& metrics) {
+    this->metrics = metrics;
+  }
+
   kj::Promise<void> run() { return kj::mv(acceptLoopPromise); }
 
 private:
@@ -3608,6 +3776,7 @@ private:
   kj::Maybe<SturdyRefRestorerBase&> restorer;
   size_t flowLimit = kj::maxValue;
   kj::Maybe<kj::Function<kj::String(const kj::Exception&)>> traceEncoder;
+  kj::Maybe<RpcMetrics&> metrics;
   kj::Promise<void> acceptLoopPromise = nullptr;
   kj::TaskSet tasks;
 
@@ -3627,9 +3796,12 @@ private:
         connections.erase(connectionPtr);
         tasks.add(kj::mv(info.shutdownPromise));
       }));
+      KJ_IF_SOME(m, metrics) {
+        connection = kj::heap<MeteredConnection>(kj::mv(connection), m);
+      }
       auto newState = kj::refcounted<RpcConnectionState>(
           bootstrapFactory, restorer, kj::mv(connection),
-          kj::mv(onDisconnect.fulfiller), flowLimit, traceEncoder);
+          kj::mv(onDisconnect.fulfiller), flowLimit, traceEncoder, metrics);
       RpcConnectionState& result = *newState;
       connections.insert(std::make_pair(connectionPtr, kj::mv(newState)));
       return result;
@@ -3692,6 +3864,10 @@ void RpcSystemBase::setTraceEncoder(kj::Function<kj::String(const kj::Exception&
   impl->setTraceEncoder(kj::mv(func));
 }
 
+void RpcSystemBase::setMetrics(RpcMetrics& metrics) {
+  impl->setMetrics(metrics);
+}
+
 kj::Promise<void> RpcSystemBase::run() {
   return impl->run();
 }
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <capnp/capability.h>
+#include <kj/time.h>
 #include "rpc-prelude.h"
 
 CAPNP_BEGIN_HEADER
@@ -151,6 +152,15 @@ public:
   // Stack traces can sometimes contain sensitive information, so you should think carefully about
   // what information you are willing to reveal to the remote party.
 
+  // void setMetrics(RpcMetrics& metrics);
+  //
+  // (Inherited from _::RpcSystemBase)
+  //
+  // Report calls, message traffic, table sizes, and flow limit stalls to `metrics`, which must
+  // outlive the RpcSystem. This must be called before any connections are established; existing
+  // connections are not affected. When no metrics object is installed, the RPC system does not
+  // read the clock or do any other bookkeeping on its behalf.
+
   kj::Promise<void> run() { return RpcSystemBase::run(); }
   // Listens for incoming RPC connections and handles them. Never returns normally, but could throw
   // an exception if the system becomes unable to accept new connections (e.g. because the
@@ -241,6 +251,84 @@ private:
   Capability::Client baseRestore(AnyPointer::Reader ref) override final;
 };
 
+class RpcMetrics {
+  // Receives events from an RpcSystem in order to collect statistics such as per-method call
+  // counts, latency histograms, and bandwidth. Install one with RpcSystem::setMetrics().
+  //
+  // Every method has an empty default implementation, so subclasses override only what they need.
+  // Methods are invoked synchronously from the event loop in the middle of RPC processing, so
+  // they should be cheap and must not throw. For example, a latency histogram of outgoing calls:
+  //
+  //    class LatencyHistogram final: public capnp::RpcMetrics {
+  //    public:
+  //      void callReturned(uint64_t interfaceId, uint16_t methodId, size_t resultWords,
+  //                        kj::Duration latency, bool failed) override {
+  //        // Bucket i counts calls that took [2^i, 2^(i+1)) microseconds.
+  //        uint64_t us = latency / kj::MICROSECONDS;
+  //        uint bucket = 0;
+  //        while (us > 1 && bucket < 31) { us >>= 1; ++bucket; }
+  //        ++buckets[bucket];
+  //      }
+  //
+  //      uint64_t buckets[32] = {};
+  //      // Periodically export these to your monitoring system.
+  //    };
+  //
+  // Calls which are still outstanding when their connection is lost are not reported as
+  // returned, since the RpcSystem may already have been destroyed by the time they fail.
+
+public:
+  virtual ~RpcMetrics() noexcept(false) = default;
+
+  virtual void callSent(uint64_t interfaceId, uint16_t methodId, size_t paramWords) {}
+  // A call was sent to the peer. `paramWords` is the size of the whole `Call` message.
+
+  virtual void callReturned(uint64_t interfaceId, uint16_t methodId, size_t resultWords,
+                            kj::Duration latency, bool failed) {}
+  // A call previously reported to callSent() completed. `resultWords` is the size of the
+  // `Return` message, or zero if the results didn't arrive in a message of their own (e.g. they
+  // were an exception, or the call was a tail call). `failed` is true if the call threw.
+  // Calls sent with only promise pipelining in mind (e.g. via `sendForPipeline()`) never return.
+
+  virtual void callReceived(uint64_t interfaceId, uint16_t methodId, size_t paramWords) {}
+  // The peer made a call to us.
+
+  virtual void callAnswered(uint64_t interfaceId, uint16_t methodId, size_t resultWords,
+                            kj::Duration latency, bool failed) {}
+  // We finished a call previously reported to callReceived(). `latency` runs from receipt of the
+  // `Call` to sending the `Return`. `failed` is true if the call threw or was canceled.
+
+  virtual void messageSent(size_t words) {}
+  virtual void messageReceived(size_t words) {}
+  // Called for every RPC protocol message, including calls and returns.
+
+  struct ConnectionStats {
+    size_t questions;
+    // Entries in the question table, i.e. outgoing calls awaiting a `Return` or `Finish`.
+
+    size_t exports;
+    // Capabilities exported to the peer.
+
+    size_t embargoes;
+    // Embargoes awaiting a `Disembargo` reply.
+
+    size_t callsInFlight;
+    size_t callWordsInFlight;
+    // Incoming calls that have not yet returned, and the total size of their `Call` messages.
+    // The latter is what RpcSystem::setFlowLimit() is compared against.
+  };
+
+  virtual void connectionStats(const ConnectionStats& stats) {}
+  // Gauges describing a connection, reported each time it finishes handling an incoming message.
+
+  virtual void flowLimitStalled() {}
+  // A connection stopped reading incoming messages because it reached the limit set with
+  // RpcSystem::setFlowLimit().
+
+  virtual void flowLimitResumed(kj::Duration stallTime) {}
+  // A connection that was reported to flowLimitStalled() resumed reading.
+};
+
 // =======================================================================================
 // VatNetwork
 
@@ -0,0 +1,175 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "serialize-archive.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+#include <atomic>
+#include "test-util.h"
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+kj::Own<const kj::File> writeTestArchive(uint count, bool writeIndex) {
+  // Writes `count` messages, where message `i` has `int32Field = i`. Every third message is a
+  // full test message spanning several segments, so that messages have varying sizes.
+
+  auto file = kj::newInMemoryFile(kj::nullClock());
+  auto appender = kj::newFileAppender(file->clone());
+  ArchiveWriter writer(*appender, writeIndex);
+
+  for (uint i = 0; i < count; i++) {
+    MallocMessageBuilder builder(i % 3 == 0 ? 16 : SUGGESTED_FIRST_SEGMENT_WORDS,
+                                 AllocationStrategy::FIXED_SIZE);
+    auto root = builder.initRoot<TestAllTypes>();
+    if (i % 3 == 0) {
+      initTestMessage(root);
+    }
+    root.setInt32Field(i);
+    writer.add(builder);
+  }
+  KJ_EXPECT(writer.size() == count);
+  writer.finish();
+
+  return kj::mv(file);
+}
+
+KJ_TEST("ArchiveReader with index") {
+  auto file = writeTestArchive(100, true);
+  ArchiveReader reader(*file);
+
+  KJ_EXPECT(reader.hasIndex());
+  KJ_ASSERT(reader.size() == 100);
+
+  // Random access, in no particular order.
+  for (uint i: {57u, 3u, 99u, 0u, 42u}) {
+    auto message = reader.getMessage(i);
+    auto root = message->getRoot<TestAllTypes>();
+    KJ_EXPECT(root.getInt32Field() == i);
+    if (i % 3 == 0) {
+      KJ_EXPECT(message->getSegment(1) != nullptr);
+      KJ_EXPECT(root.getTextField() == "foo");
+    }
+  }
+
+  // Messages are read in place from the mapping.
+  auto bytes = file->stat().size;
+  auto words = reader.getMessageWords(99);
+  auto mapping = file->mmap(0, bytes);
+  KJ_EXPECT(words.asBytes().end() <= mapping.end());
+
+  KJ_EXPECT_THROW_MESSAGE("out of range", reader.getMessageWords(100));
+}
+
+KJ_TEST("ArchiveReader without index") {
+  auto file = writeTestArchive(100, false);
+
+  // Without an index, the archive is an ordinary message stream.
+  {
+    auto mapping = file->mmap(0, file->stat().size);
+    auto words = kj::arrayPtr(reinterpret_cast<const word*>(mapping.begin()),
+                              mapping.size() / sizeof(word));
+    FlatArrayMessageReader first(words);
+    KJ_EXPECT(first.getRoot<TestAllTypes>().getInt32Field() == 0);
+    FlatArrayMessageReader second(kj::arrayPtr(first.getEnd(), words.end()));
+    KJ_EXPECT(second.getRoot<TestAllTypes>().getInt32Field() == 1);
+  }
+
+  ArchiveReader reader(*file);
+  KJ_EXPECT(!reader.hasIndex());
+
+  // Access scans only as far as needed, then the full scan picks up where it left off.
+  KJ_EXPECT(reader.getMessage(10)->getRoot<TestAllTypes>().getInt32Field() == 10);
+  KJ_EXPECT(reader.getMessage(3)->getRoot<TestAllTypes>().getInt32Field() == 3);
+  KJ_EXPECT(reader.size() == 100);
+  KJ_EXPECT(reader.getMessage(99)->getRoot<TestAllTypes>().getInt32Field() == 99);
+  KJ_EXPECT_THROW_MESSAGE("out of range", reader.getMessageWords(100));
+}
+
+KJ_TEST("ArchiveReader empty archives") {
+  {
+    auto file = writeTestArchive(0, true);
+    ArchiveReader reader(*file);
+    KJ_EXPECT(reader.hasIndex());
+    KJ_EXPECT(reader.size() == 0);
+  }
+  {
+    auto file = writeTestArchive(0, false);
+    ArchiveReader reader(*file);
+    KJ_EXPECT(!reader.hasIndex());
+    KJ_EXPECT(reader.size() == 0);
+  }
+}
+
+KJ_TEST("ArchiveReader rejects corrupt archives") {
+  auto file = writeTestArchive(10, false);
+  auto words = kj::heapArray<word>(file->stat().size / sizeof(word));
+  file->read(0, words.asBytes());
+
+  KJ_EXPECT_THROW_MESSAGE("truncated", ArchiveReader(words.slice(0, words.size() - 1)).size());
+
+  {
+    // An index pointing past the messages.
+    auto corrupt = kj::heapArray<word>(words.size() + 4);
+    memcpy(corrupt.begin(), words.begin(), words.asBytes().size());
+    auto trailer = reinterpret_cast<WireValue<uint64_t>*>(corrupt.end() - 4);
+    trailer[0].set(0);
+    trailer[1].set(corrupt.size());
+    trailer[2].set(2);
+    trailer[3].set(ARCHIVE_INDEX_MAGIC);
+    ArchiveReader reader(corrupt);
+    KJ_EXPECT(reader.hasIndex());
+    KJ_EXPECT(reader.size() == 2);
+    KJ_EXPECT_THROW_MESSAGE("archive index is corrupt", reader.getMessageWords(0));
+    KJ_EXPECT_THROW_MESSAGE("archive index is corrupt", reader.getMessageWords(1));
+  }
+}
+
+KJ_TEST("ArchiveReader::forEach()") {
+  for (bool writeIndex: {true, false}) {
+    auto file = writeTestArchive(1000, writeIndex);
+    ArchiveReader reader(*file);
+
+    for (uint threadCount: {1u, 4u}) {
+      auto seen = kj::heapArray<std::atomic<uint>>(1000);
+      for (auto& count: seen) count.store(0);
+
+      reader.forEach([&](size_t n, MessageReader& message) {
+        KJ_ASSERT(message.getRoot<TestAllTypes>().getInt32Field() == n);
+        seen[n].fetch_add(1);
+      }, threadCount);
+
+      for (auto& count: seen) {
+        KJ_EXPECT(count.load() == 1);
+      }
+    }
+
+    // An exception on any thread is rethrown.
+    KJ_EXPECT_THROW_MESSAGE("bad message", reader.forEach([&](size_t n, MessageReader&) {
+      KJ_REQUIRE(n != 10, "bad message");
+    }, 4));
+  }
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
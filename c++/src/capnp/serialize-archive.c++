@@ -0,0 +1,176 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "serialize-archive.h"
+#include <kj/debug.h>
+#include <kj/thread.h>
+
+namespace capnp {
+
+ArchiveWriter::ArchiveWriter(kj::OutputStream& output, bool writeIndex)
+    : output(output), writeIndex(writeIndex) {}
+
+ArchiveWriter::~ArchiveWriter() noexcept(false) {
+  if (!finished && !unwindDetector.isUnwinding()) {
+    finish();
+  }
+}
+
+void ArchiveWriter::add(MessageBuilder& builder) {
+  add(builder.getSegmentsForOutput());
+}
+
+void ArchiveWriter::add(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  KJ_REQUIRE(!finished, "can't add messages to an archive after finish()");
+
+  size_t size = computeSerializedSizeInWords(segments);
+  writeMessage(output, segments);
+  offsets.add(position);
+  position += size;
+}
+
+void ArchiveWriter::finish() {
+  KJ_REQUIRE(!finished, "finish() called twice");
+  finished = true;
+  if (!writeIndex) return;
+
+  auto trailer = kj::heapArray<_::WireValue<uint64_t>>(offsets.size() + 2);
+  for (auto i: kj::indices(offsets)) {
+    trailer[i].set(offsets[i]);
+  }
+  trailer[offsets.size()].set(offsets.size());
+  trailer[offsets.size() + 1].set(ARCHIVE_INDEX_MAGIC);
+  output.write(trailer.begin(), trailer.asBytes().size());
+}
+
+// =======================================================================================
+
+ArchiveReader::ArchiveReader(const kj::ReadableFile& file, ReaderOptions options)
+    : options(options) {
+  uint64_t size = file.stat().size;
+  KJ_REQUIRE(size % sizeof(word) == 0, "archive size is not a whole number of words", size);
+  if (size > 0) {
+    mapping = file.mmap(0, size);
+  }
+  init(kj::arrayPtr(reinterpret_cast<const word*>(mapping.begin()), size / sizeof(word)));
+}
+
+ArchiveReader::ArchiveReader(kj::ArrayPtr<const word> words, ReaderOptions options)
+    : options(options) {
+  init(words);
+}
+
+ArchiveReader::~ArchiveReader() noexcept(false) {}
+
+void ArchiveReader::init(kj::ArrayPtr<const word> words) {
+  messages = words;
+
+  if (words.size() < 2) return;
+  auto footer = reinterpret_cast<const _::WireValue<uint64_t>*>(words.end() - 2);
+  if (footer[1].get() != ARCHIVE_INDEX_MAGIC) return;
+
+  uint64_t count = footer[0].get();
+  KJ_REQUIRE(count <= words.size() - 2, "archive index is corrupt", count) { return; }
+  size_t indexStart = words.size() - 2 - count;
+  index = kj::arrayPtr(reinterpret_cast<const _::WireValue<uint64_t>*>(
+      words.begin() + indexStart), count);
+  messages = words.slice(0, indexStart);
+  KJ_REQUIRE(count == 0 || index[0].get() == 0, "archive index is corrupt") {
+    index = nullptr;
+    messages = words;
+    return;
+  }
+}
+
+bool ArchiveReader::scanTo(size_t n) {
+  // Scan message headers until the offset of message `n` is known. Returns false if the archive
+  // has fewer than `n + 1` messages.
+
+  while (scannedOffsets.size() <= n && scanPosition < messages.size()) {
+    auto remaining = messages.slice(scanPosition, messages.size());
+    size_t size = expectedSizeInWordsFromPrefix(remaining);
+    KJ_REQUIRE(size <= remaining.size(), "archive ends with a truncated message") {
+      // Treat the truncated message as if it weren't there.
+      scanPosition = messages.size();
+      break;
+    }
+    scannedOffsets.add(scanPosition);
+    scanPosition += size;
+  }
+
+  return scannedOffsets.size() > n;
+}
+
+size_t ArchiveReader::size() {
+  if (hasIndex()) {
+    return index.size();
+  } else {
+    scanTo(kj::maxValue);
+    return scannedOffsets.size();
+  }
+}
+
+kj::ArrayPtr<const word> ArchiveReader::getMessageWords(size_t n) {
+  if (!hasIndex()) {
+    KJ_REQUIRE(scanTo(n), "archive message number out of range", n);
+  }
+  return getKnownMessageWords(n);
+}
+
+kj::ArrayPtr<const word> ArchiveReader::getKnownMessageWords(size_t n) const {
+  size_t start, end;
+  if (hasIndex()) {
+    KJ_REQUIRE(n < index.size(), "archive message number out of range", n, index.size());
+    start = index[n].get();
+    end = n + 1 < index.size() ? index[n + 1].get() : messages.size();
+  } else {
+    start = scannedOffsets[n];
+    end = n + 1 < scannedOffsets.size() ? scannedOffsets[n + 1] : scanPosition;
+  }
+
+  KJ_REQUIRE(start < end && end <= messages.size(), "archive index is corrupt", n, start, end);
+  return messages.slice(start, end);
+}
+
+kj::Own<MessageReader> ArchiveReader::getMessage(size_t n) {
+  return kj::heap<FlatArrayMessageReader>(getMessageWords(n), options);
+}
+
+void ArchiveReader::forEach(kj::FunctionParam<void(size_t n, MessageReader& message)> func,
+                            uint threadCount) {
+  // Build the whole index up front so that the threads below only read it.
+  size_t count = size();
+
+  if (threadCount <= 1 || count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      FlatArrayMessageReader reader(getKnownMessageWords(i), options);
+      func(i, reader);
+    }
+    return;
+  }
+
+  kj::_::runInParallel(threadCount, count, [&](uint, size_t i) {
+    FlatArrayMessageReader reader(getKnownMessageWords(i), options);
+    func(i, reader);
+  });
+}
+
+}  // namespace capnp
@@ -0,0 +1,144 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// This file implements random access into an "archive": a file containing many messages
+// concatenated in the standard serialization format (see serialize.h). An archive is therefore
+// readable as an ordinary message stream, e.g. with StreamFdMessageReader or `capnp decode`.
+//
+// An archive may optionally end with an offset index, which allows a reader to find message N
+// without scanning all of the messages before it. The index is laid out as follows:
+//
+// * 64-bit little-endian offset, in words from the start of the file, of each message, in order
+//     (8*(message count) bytes).
+// * 64-bit little-endian message count (8 bytes).
+// * 64-bit little-endian magic number `ARCHIVE_INDEX_MAGIC` (8 bytes).
+//
+// Note that the index is *not* a valid message, so an archive that has one can only be read as a
+// plain stream if the reader stops after the last message. ArchiveReader handles archives with
+// or without an index; without one, it builds the index in memory on first use.
+
+#pragma once
+
+#include "serialize.h"
+#include <kj/filesystem.h>
+#include <kj/function.h>
+#include <kj/vector.h>
+
+CAPNP_BEGIN_HEADER
+
+namespace capnp {
+
+constexpr uint64_t ARCHIVE_INDEX_MAGIC = 0x5845444e49504e43ull;
+// Last word of an archive that ends with an offset index. (The bytes spell "CNPINDEX".)
+
+class ArchiveWriter {
+  // Writes an archive to an output stream. The stream must be positioned at the start of the
+  // archive, since message offsets are counted from the first byte written.
+
+public:
+  explicit ArchiveWriter(kj::OutputStream& output, bool writeIndex = true);
+  // If `writeIndex` is false, finish() writes nothing and the archive is just a message stream.
+
+  KJ_DISALLOW_COPY_AND_MOVE(ArchiveWriter);
+  ~ArchiveWriter() noexcept(false);
+  // Calls finish() if it hasn't been called already, unless unwinding.
+
+  void add(MessageBuilder& builder);
+  void add(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
+  // Append one message.
+
+  size_t size() const { return offsets.size(); }
+  // Number of messages added so far.
+
+  void finish();
+  // Write the offset index, if requested. No more messages may be added afterwards.
+
+private:
+  kj::OutputStream& output;
+  bool writeIndex;
+  bool finished = false;
+  uint64_t position = 0;
+  kj::Vector<uint64_t> offsets;
+  kj::UnwindDetector unwindDetector;
+};
+
+class ArchiveReader {
+  // Provides random access to the messages in an archive. Messages are read in place from a
+  // memory mapping of the file (or from a caller-provided array), so no message content is
+  // copied.
+  //
+  // The reader is not thread-safe, except for forEach(), which reads messages on several threads
+  // itself.
+
+public:
+  explicit ArchiveReader(const kj::ReadableFile& file, ReaderOptions options = ReaderOptions());
+  // Maps the whole file. Later changes to the file's size are not seen.
+
+  explicit ArchiveReader(kj::ArrayPtr<const word> words, ReaderOptions options = ReaderOptions());
+  // Reads an archive that's already in memory. The array must outlive the ArchiveReader.
+
+  KJ_DISALLOW_COPY_AND_MOVE(ArchiveReader);
+  ~ArchiveReader() noexcept(false);
+
+  bool hasIndex() const { return index.begin() != nullptr; }
+  // True if the archive ends with an offset index.
+
+  size_t size();
+  // Number of messages in the archive. O(1) if the archive has an index, otherwise the first call
+  // scans the message headers of the whole archive.
+
+  kj::ArrayPtr<const word> getMessageWords(size_t n);
+  // Get the serialized bytes of message `n`, e.g. to construct a FlatArrayMessageReader on the
+  // stack. O(1) if the archive has an index, otherwise this scans message headers up to `n` the
+  // first time.
+
+  kj::Own<MessageReader> getMessage(size_t n);
+  // Get a reader for message `n`. The returned reader points into the archive and must not
+  // outlive it.
+
+  void forEach(kj::FunctionParam<void(size_t n, MessageReader& message)> func,
+               uint threadCount = 1);
+  // Call `func` once for each message in the archive. If `threadCount` is greater than 1, messages
+  // are handed out to that many threads (including the calling thread), so `func` will be called
+  // concurrently and in no particular order. If any call throws, the remaining messages are
+  // skipped and the first exception is rethrown once all threads have stopped.
+
+private:
+  ReaderOptions options;
+  kj::Array<const byte> mapping;
+  kj::ArrayPtr<const word> messages;
+  // The part of the archive holding messages, i.e. excluding the index.
+
+  kj::ArrayPtr<const _::WireValue<uint64_t>> index;
+  // Offset index read from the end of the archive, if it had one.
+
+  kj::Vector<size_t> scannedOffsets;
+  size_t scanPosition = 0;
+  // Offsets found by scanning, if the archive has no index. Scanning stops at `scanPosition`.
+
+  void init(kj::ArrayPtr<const word> words);
+  bool scanTo(size_t n);
+  kj::ArrayPtr<const word> getKnownMessageWords(size_t n) const;
+};
+
+}  // namespace capnp
+
+CAPNP_END_HEADER
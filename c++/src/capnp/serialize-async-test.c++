@@ -557,8 +557,155 @@ KJ_TEST("BufferedMessageStream many small messages") {
   KJ_EXPECT(callbackCallCount == 16);
 }
 
-// TODO(test): We should probably test BufferedMessageStream's FD handling here... but really it
-//   gets tested well enough by rpc-twoparty-test.
+KJ_TEST("BufferedMessageStream batched reads") {
+  // Encode input data.
+  kj::VectorOutputStream data;
+  for (auto i: kj::zeroTo(16)) {
+    writeSmallMessage(data, kj::str("12345678-", i));
+  }
+  writeBigMessage(data);
+  writeSmallMessage(data, "foo");
+  writeSmallMessage(data, "bar");
+
+  // Run the test.
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+  auto writePromise = pipe.ends[1]->write(data.getArray().begin(), data.getArray().size())
+      .then([&]() { return pipe.ends[1]->shutdownWrite(); }).eagerlyEvaluate(nullptr);
+
+  uint callbackCallCount = 0;
+  auto callback = [&](MessageReader& reader) {
+    ++callbackCallCount;
+    return true;
+  };
+
+  BufferedMessageStream stream(*pipe.ends[0], callback, 16);
+
+  // Batched reads can be mixed with single reads.
+  expectSmallMessage(stream, "12345678-0", waitScope);
+  KJ_EXPECT(callbackCallCount == 1);
+
+  // Hold on to every message until the end, so that later reads must not overwrite them.
+  kj::Vector<kj::Own<MessageReader>> messages;
+  uint batchCount = 0;
+  for (;;) {
+    auto batch = stream.tryReadMessages().wait(waitScope);
+    if (batch.messages.size() == 0) break;
+    ++batchCount;
+    KJ_EXPECT(batch.fds.size() == 0);
+    for (auto& message: batch.messages) messages.add(kj::mv(message));
+  }
+  KJ_EXPECT(callbackCallCount == 1);
+
+  // A 16-word buffer holds up to three 5-word messages, so some batches have several.
+  KJ_ASSERT(messages.size() == 18);
+  KJ_EXPECT(batchCount < messages.size(), batchCount);
+
+  for (auto i: kj::zeroTo(15)) {
+    KJ_EXPECT(messages[i]->getRoot<test::TestAnyPointer>().getAnyPointerField().getAs<Text>()
+           == kj::str("12345678-", i + 1));
+  }
+  checkTestMessage(messages[15]->getRoot<test::TestAllTypes>());
+  KJ_EXPECT(messages[16]->getRoot<test::TestAnyPointer>().getAnyPointerField().getAs<Text>()
+         == "foo");
+  KJ_EXPECT(messages[17]->getRoot<test::TestAnyPointer>().getAnyPointerField().getAs<Text>()
+         == "bar");
+}
+
+KJ_TEST("BufferedMessageStream short-lived message read from a buffer shared with a batch") {
+  kj::VectorOutputStream data;
+  writeSmallMessage(data, "12345678-0");
+  writeSmallMessage(data, "12345678-1");
+  auto bytes = data.getArray();
+
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+  auto callback = [](MessageReader&) { return true; };
+  BufferedMessageStream stream(*pipe.ends[0], callback, 16);
+
+  // Deliver the first message plus the first word of the second, so the batch has to leave the
+  // second one partially read in the buffer that the batch's message points into.
+  auto writePromise = pipe.ends[1]->write(bytes.begin(), 6 * sizeof(word));
+  auto batch = stream.tryReadMessages().wait(waitScope);
+  writePromise.wait(waitScope);
+  KJ_ASSERT(batch.messages.size() == 1);
+
+  // Completing the second message consumes the whole buffer, but since the batch still shares it,
+  // the stream must not switch away from it while the returned message still points into it.
+  writePromise = pipe.ends[1]->write(bytes.begin() + 6 * sizeof(word),
+                                     bytes.size() - 6 * sizeof(word));
+  auto msg = stream.MessageStream::readMessage().wait(waitScope);
+  writePromise.wait(waitScope);
+
+  KJ_EXPECT(batch.messages[0]->getRoot<test::TestAnyPointer>().getAnyPointerField()
+           .getAs<Text>() == "12345678-0");
+  batch.messages = nullptr;
+  KJ_EXPECT(msg->getRoot<test::TestAnyPointer>().getAnyPointerField().getAs<Text>()
+         == "12345678-1");
+  msg = nullptr;
+
+  // The stream still works afterwards.
+  writePromise = pipe.ends[1]->write(bytes.begin(), bytes.size());
+  expectSmallMessage(stream, "12345678-0", waitScope);
+  expectSmallMessage(stream, "12345678-1", waitScope);
+  writePromise.wait(waitScope);
+}
+
+#if !_WIN32 && !__CYGWIN__  // Windows and Cygwin don't support SCM_RIGHTS.
+KJ_TEST("BufferedMessageStream batched reads return FDs") {
+  auto io = kj::setupAsyncIo();
+  auto pipe = io.provider->newCapabilityPipe();
+
+  int pipeFds[2];
+  KJ_SYSCALL(kj::miniposix::pipe(pipeFds));
+  kj::AutoCloseFd in(pipeFds[0]);
+  kj::AutoCloseFd out(pipeFds[1]);
+
+  auto sendMessage = [&](kj::StringPtr text, kj::ArrayPtr<const int> fds) {
+    MallocMessageBuilder message;
+    message.getRoot<test::TestAnyPointer>().getAnyPointerField().setAs<Text>(text);
+    capnp::writeMessage(*pipe.ends[0], fds, message).wait(io.waitScope);
+  };
+  int outFd = out.get();
+  sendMessage("foo", nullptr);
+  sendMessage("bar", kj::arrayPtr(&outFd, 1));
+  out = nullptr;
+
+  auto callback = [](MessageReader&) { return true; };
+  BufferedMessageStream stream(*pipe.ends[1], callback);
+
+  kj::Vector<kj::String> texts;
+  kj::Vector<kj::AutoCloseFd> received;
+  while (texts.size() < 2) {
+    auto batch = stream.tryReadMessages(1).wait(io.waitScope);
+    KJ_ASSERT(batch.messages.size() > 0);
+    for (auto& message: batch.messages) {
+      texts.add(kj::str(message->getRoot<test::TestAnyPointer>().getAnyPointerField()
+                                .getAs<Text>()));
+    }
+    for (auto& fd: batch.fds) {
+      // FDs are attached to the last message of the batch.
+      KJ_EXPECT(texts.back() == "bar");
+      received.add(kj::mv(fd));
+    }
+  }
+
+  KJ_EXPECT(texts[0] == "foo");
+  KJ_EXPECT(texts[1] == "bar");
+  KJ_ASSERT(received.size() == 1);
+
+  auto writer = io.lowLevelProvider->wrapOutputFd(received[0].release(),
+      kj::LowLevelAsyncIoProvider::TAKE_OWNERSHIP);
+  writer->write("baz", 3).wait(io.waitScope);
+  writer = nullptr;
+  KJ_EXPECT(io.lowLevelProvider->wrapInputFd(kj::mv(in))->readAllText().wait(io.waitScope)
+            == "baz");
+}
+#endif
 
 }  // namespace
 }  // namespace _ (private)
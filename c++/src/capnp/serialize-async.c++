@@ -557,6 +557,49 @@ kj::Promise<MessageReaderAndFds> MessageStream::readMessage(
 
 // =======================================================================================
 
+class BufferedMessageStream::Slab final: public kj::Refcounted {
+public:
+  Slab(kj::Own<SlabPool> pool, kj::Array<word> words): pool(kj::mv(pool)), words(kj::mv(words)) {}
+  ~Slab() noexcept(false);
+
+  kj::Own<SlabPool> pool;
+  kj::Array<word> words;
+};
+
+class BufferedMessageStream::SlabPool final: public kj::Refcounted {
+  // Recycles receive buffers, which may outlive the stream if messages still point into them.
+
+public:
+  explicit SlabPool(size_t slabWords): slabWords(slabWords) {}
+
+  kj::Own<Slab> allocate() {
+    kj::Array<word> words;
+    if (idle.empty()) {
+      words = kj::heapArray<word>(slabWords);
+    } else {
+      words = kj::mv(idle.back());
+      idle.removeLast();
+    }
+    return kj::refcounted<Slab>(kj::addRef(*this), kj::mv(words));
+  }
+
+  void recycle(kj::Array<word> words) {
+    if (idle.size() < MAX_IDLE_SLABS) {
+      idle.add(kj::mv(words));
+    }
+  }
+
+private:
+  static constexpr size_t MAX_IDLE_SLABS = 4;
+
+  size_t slabWords;
+  kj::Vector<kj::Array<word>> idle;
+};
+
+BufferedMessageStream::Slab::~Slab() noexcept(false) {
+  pool->recycle(kj::mv(words));
+}
+
 class BufferedMessageStream::MessageReaderImpl final : public FlatArrayMessageReader {
 public:
   MessageReaderImpl(BufferedMessageStream& parent, kj::ArrayPtr<const word> data,
@@ -569,6 +612,8 @@ public:
       : FlatArrayMessageReader(ownBuffer, options), state(kj::mv(ownBuffer)) {}
   MessageReaderImpl(kj::ArrayPtr<word> scratchBuffer, ReaderOptions options)
       : FlatArrayMessageReader(scratchBuffer, options) {}
+  MessageReaderImpl(kj::Own<Slab> slab, kj::ArrayPtr<const word> data, ReaderOptions options)
+      : FlatArrayMessageReader(data, options), state(kj::mv(slab)) {}
 
   ~MessageReaderImpl() noexcept(false) {
     KJ_IF_SOME(parent, state.tryGet<BufferedMessageStream*>()) {
@@ -577,24 +622,27 @@ public:
   }
 
 private:
-  kj::OneOf<BufferedMessageStream*, kj::Array<word>> state;
+  kj::OneOf<BufferedMessageStream*, kj::Array<word>, kj::Own<Slab>> state;
   // * BufferedMessageStream* if this reader aliases the original buffer.
   // * kj::Array<word> if this reader owns its own backing buffer.
+  // * kj::Own<Slab> if this reader shares the original buffer with later reads.
 };
 
 BufferedMessageStream::BufferedMessageStream(
     kj::AsyncIoStream& stream, IsShortLivedCallback isShortLivedCallback,
     size_t bufferSizeInWords)
     : stream(stream), isShortLivedCallback(kj::mv(isShortLivedCallback)),
-      buffer(kj::heapArray<word>(bufferSizeInWords)),
-      beginData(buffer.begin()), beginAvailable(buffer.asBytes().begin()) {}
+      pool(kj::refcounted<SlabPool>(bufferSizeInWords)), slab(pool->allocate()),
+      buffer(slab->words), beginData(buffer.begin()), beginAvailable(buffer.asBytes().begin()) {}
 
 BufferedMessageStream::BufferedMessageStream(
     kj::AsyncCapabilityStream& stream, IsShortLivedCallback isShortLivedCallback,
     size_t bufferSizeInWords)
     : stream(stream), capStream(stream), isShortLivedCallback(kj::mv(isShortLivedCallback)),
-      buffer(kj::heapArray<word>(bufferSizeInWords)),
-      beginData(buffer.begin()), beginAvailable(buffer.asBytes().begin()) {}
+      pool(kj::refcounted<SlabPool>(bufferSizeInWords)), slab(pool->allocate()),
+      buffer(slab->words), beginData(buffer.begin()), beginAvailable(buffer.asBytes().begin()) {}
+
+BufferedMessageStream::~BufferedMessageStream() noexcept(false) {}
 
 kj::Promise<kj::Maybe<MessageReaderAndFds>> BufferedMessageStream::tryReadMessage(
     kj::ArrayPtr<kj::AutoCloseFd> fdSpace, ReaderOptions options, kj::ArrayPtr<word> scratchSpace) {
@@ -675,9 +723,13 @@ kj::Promise<kj::Maybe<MessageReaderAndFds>> BufferedMessageStream::tryReadMessag
 
     beginData += expected;
     if (reinterpret_cast<byte*>(beginData) == beginAvailable) {
-      // The buffer is empty. Let's opportunistically reset the pointers.
-      beginData = buffer.begin();
-      beginAvailable = buffer.asBytes().begin();
+      // The buffer is empty. Let's opportunistically reset the pointers -- unless messages from
+      // tryReadMessages() still share the slab, in which case compacting would switch to a new
+      // slab and drop our reference to the one the reader we're returning points into. The next
+      // read will compact instead, once this reader is gone.
+      if (!slab->isShared()) {
+        compactBuffer();
+      }
     } else if (fdsSoFar > 0) {
       // The buffer is NOT empty, and we received FDs when we were filling it. These FDs must
       // actually belong to the last message in the buffer, because when the OS returns FDs
@@ -721,12 +773,12 @@ kj::Promise<kj::Maybe<MessageReaderAndFds>> BufferedMessageStream::tryReadMessag
 
     auto prefix = kj::arrayPtr(beginDataBytes, dataByteSize);
 
-    // We are consuming everything in the buffer here, so we can reset the pointers so the
-    // buffer appears empty on the next message read after this.
-    beginData = buffer.begin();
-    beginAvailable = buffer.asBytes().begin();
-
-    return readEntireMessage(prefix, expected, fdSpace, fdsSoFar, options);
+    // readEntireMessage() copies the prefix out before returning, after which we can reset the
+    // pointers so the buffer appears empty on the next message read after this.
+    auto promise = readEntireMessage(prefix, expected, fdSpace, fdsSoFar, options);
+    beginData = reinterpret_cast<word*>(beginAvailable);
+    compactBuffer();
+    return promise;
   }
 
   // Set minBytes to at least complete the current message.
@@ -742,11 +794,7 @@ kj::Promise<kj::Maybe<MessageReaderAndFds>> BufferedMessageStream::tryReadMessag
   if (maxBytes < buffer.asBytes().size() / 2) {
     // We have less than half the buffer remaining to read into. Move the buffered data to the
     // beginning of the buffer to make more space.
-    memmove(buffer.begin(), beginData, dataByteSize);
-    beginData = buffer.begin();
-    beginDataBytes = buffer.asBytes().begin();
-    beginAvailable = beginDataBytes + dataByteSize;
-
+    compactBuffer();
     maxBytes = buffer.asBytes().end() - beginAvailable;
   }
 
@@ -784,6 +832,104 @@ kj::Promise<kj::Maybe<MessageReaderAndFds>> BufferedMessageStream::tryReadMessag
   });
 }
 
+kj::Promise<BufferedMessageStream::MessageBatch> BufferedMessageStream::tryReadMessages(
+    uint maxFds, ReaderOptions options) {
+  KJ_REQUIRE(!hasOutstandingShortLivedMessage,
+      "can't read another message while the previous short-lived message still exists");
+
+  kj::Vector<kj::Own<MessageReader>> messages;
+  size_t expected;
+  for (;;) {
+    kj::ArrayPtr<word> data = kj::arrayPtr(beginData,
+        (beginAvailable - reinterpret_cast<byte*>(beginData)) / sizeof(word));
+    expected = expectedSizeInWordsFromPrefix(data);
+    if (expected > data.size()) break;
+
+    messages.add(kj::heap<MessageReaderImpl>(
+        kj::addRef(*slab), kj::arrayPtr(beginData, expected), options));
+    beginData += expected;
+  }
+
+  if (!messages.empty()) {
+    MessageBatch batch { messages.releaseAsArray(), nullptr };
+    if (reinterpret_cast<byte*>(beginData) == beginAvailable) {
+      // We've consumed everything, including the last message, to which any leftover FDs belong.
+      batch.fds = leftoverFds.releaseAsArray();
+    }
+    return kj::mv(batch);
+  }
+
+  auto fdSpace = kj::heapArray<kj::AutoCloseFd>(maxFds);
+
+  auto prefix = kj::arrayPtr(reinterpret_cast<byte*>(beginData), beginAvailable);
+  if (expected > buffer.size() / 2) {
+    // Too big for the buffer; read it separately. See tryReadMessageImpl().
+    auto promise = readEntireMessage(prefix, expected, fdSpace, 0, options);
+    beginData = reinterpret_cast<word*>(beginAvailable);
+    compactBuffer();
+    return promise.then([fdSpace = kj::mv(fdSpace)](kj::Maybe<MessageReaderAndFds> result) mutable {
+      MessageBatch batch;
+      KJ_IF_SOME(r, result) {
+        batch.messages = kj::arr(kj::mv(r.reader));
+        batch.fds = kj::heapArray<kj::AutoCloseFd>(r.fds.size());
+        for (auto i: kj::indices(r.fds)) {
+          batch.fds[i] = kj::mv(r.fds[i]);
+        }
+      }
+      return batch;
+    });
+  }
+
+  size_t minBytes = expected * sizeof(word) - prefix.size();
+  if (size_t(buffer.asBytes().end() - beginAvailable) < buffer.asBytes().size() / 2) {
+    compactBuffer();
+  }
+  size_t maxBytes = buffer.asBytes().end() - beginAvailable;
+  KJ_DASSERT(minBytes <= maxBytes);
+
+  auto promise = tryReadWithFds(beginAvailable, minBytes, maxBytes, fdSpace.begin(), maxFds);
+  return promise.then([this, minBytes, maxFds, options, fdSpace = kj::mv(fdSpace)]
+                      (kj::AsyncCapabilityStream::ReadResult result) mutable
+                      -> kj::Promise<MessageBatch> {
+    beginAvailable += result.byteCount;
+
+    // These belong to whichever message contains the last byte we just read; see
+    // tryReadMessageImpl().
+    for (auto i: kj::zeroTo(result.capCount)) {
+      leftoverFds.add(kj::mv(fdSpace[i]));
+    }
+
+    if (result.byteCount < minBytes) {
+      // Hit EOF, which is only OK on a message boundary. See tryReadMessageImpl().
+      if (beginAvailable > reinterpret_cast<kj::byte*>(beginData)) {
+        kj::throwRecoverableException(KJ_EXCEPTION(DISCONNECTED,
+            "stream disconnected prematurely"));
+      }
+      return MessageBatch();
+    }
+
+    return tryReadMessages(maxFds, options);
+  });
+}
+
+void BufferedMessageStream::compactBuffer() {
+  size_t dataByteSize = beginAvailable - reinterpret_cast<byte*>(beginData);
+
+  if (slab->isShared()) {
+    // Messages returned by tryReadMessages() still point into this slab, so we must not overwrite
+    // it.
+    auto newSlab = pool->allocate();
+    memcpy(newSlab->words.begin(), beginData, dataByteSize);
+    slab = kj::mv(newSlab);
+    buffer = slab->words;
+  } else {
+    memmove(buffer.begin(), beginData, dataByteSize);
+  }
+
+  beginData = buffer.begin();
+  beginAvailable = buffer.asBytes().begin() + dataByteSize;
+}
+
 kj::Promise<kj::Maybe<MessageReaderAndFds>> BufferedMessageStream::readEntireMessage(
     kj::ArrayPtr<const byte> prefix, size_t expectedSizeInWords,
     kj::ArrayPtr<kj::AutoCloseFd> fdSpace, size_t fdsSoFar,
@@ -177,6 +177,31 @@ public:
   explicit BufferedMessageStream(
       kj::AsyncCapabilityStream& stream, IsShortLivedCallback isShortLivedCallback,
       size_t bufferSizeInWords = 8192);
+  ~BufferedMessageStream() noexcept(false);
+
+  struct MessageBatch {
+    kj::Array<kj::Own<MessageReader>> messages;
+    // Empty on a clean EOF.
+
+    kj::Array<kj::AutoCloseFd> fds;
+    // FDs received along with the batch. As with tryReadMessage(), these are attached to the last
+    // message, since the OS never lets a read extend past a message that carries FDs.
+  };
+
+  kj::Promise<MessageBatch> tryReadMessages(
+      uint maxFds = 0, ReaderOptions options = ReaderOptions());
+  // Returns every complete message currently in the buffer, reading from the stream (typically
+  // with one syscall) only if there is none. Up to `maxFds` FDs are accepted per read; as with
+  // tryReadMessage(), any beyond that are discarded by the OS.
+  //
+  // Unlike tryReadMessage(), the returned messages are never copied: each one keeps a reference
+  // to the buffer it was read into, and the stream switches to a fresh buffer as long as any of
+  // them remain. Buffers are recycled once all their messages are dropped, so a stream of small
+  // messages that are processed promptly reaches a steady state with no allocation or copying.
+  // On the other hand, holding onto one small message pins its whole buffer, so messages that
+  // are kept for a long time should be copied out by the caller.
+  //
+  // The isShortLivedCallback is not called.
 
   // Implements MessageStream
   kj::Promise<kj::Maybe<MessageReaderAndFds>> tryReadMessage(
@@ -199,7 +224,13 @@ private:
   kj::Maybe<kj::AsyncCapabilityStream&> capStream;
   IsShortLivedCallback isShortLivedCallback;
 
-  kj::Array<word> buffer;
+  class Slab;
+  class SlabPool;
+  kj::Own<SlabPool> pool;
+  kj::Own<Slab> slab;
+  // Refcounted owner of `buffer`. Messages returned by tryReadMessages() hold references to it.
+
+  kj::ArrayPtr<word> buffer;
 
   word* beginData;
   // Pointer to location in `buffer` where the next message starts. This is always on a word
@@ -226,6 +257,10 @@ private:
   // Given a message prefix and expected size of the whole message, read the entire message into
   // a single array and return it.
 
+  void compactBuffer();
+  // Move the unconsumed data to the beginning of the buffer, to make room to read more after it.
+  // If messages still point into the current slab, switch to a fresh one instead.
+
   kj::Promise<kj::AsyncCapabilityStream::ReadResult> tryReadWithFds(
       void* buffer, size_t minBytes, size_t maxBytes, kj::AutoCloseFd* fdBuffer, size_t maxFds);
   // Executes AsyncCapabilityStream::tryReadWithFds() on the underlying stream, or falls back to
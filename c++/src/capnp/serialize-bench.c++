@@ -0,0 +1,190 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks for building, reading, validating, and encoding messages. Run with
+// `--benchmark-time <seconds>` to get useful timings; by default each benchmark runs once, as a
+// smoke test.
+
+#include "message.h"
+#include "serialize.h"
+#include "serialize-packed.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+#include "test-util.h"
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+void initLargeMessage(TestAllTypes::Builder root) {
+  // A message of a few hundred KB, made of many copies of the standard test message.
+
+  initTestMessage(root);
+  auto list = root.initStructList(200);
+  for (auto element: list) {
+    initTestMessage(element);
+  }
+}
+
+KJ_TEST("benchmark: build TestAllTypes") {
+  doBenchmark("MallocMessageBuilder", 0, [&]() {
+    MallocMessageBuilder builder;
+    initTestMessage(builder.initRoot<TestAllTypes>());
+  });
+
+  SegmentPool pool;
+  doBenchmark("PooledMessageBuilder", 0, [&]() {
+    PooledMessageBuilder builder(pool);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+  });
+}
+
+KJ_TEST("benchmark: read TestAllTypes") {
+  MallocMessageBuilder builder;
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  auto words = messageToFlatArray(builder);
+
+  doBenchmark("read all fields", words.asBytes().size(), [&]() {
+    FlatArrayMessageReader reader(words);
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+  });
+}
+
+KJ_TEST("benchmark: FlatArrayMessageReader validation") {
+  // totalSize() walks the whole message, so this measures the cost of bounds-checking every
+  // pointer in it.
+
+  auto run = [&](kj::StringPtr label, auto&& init) {
+    MallocMessageBuilder builder;
+    init(builder.initRoot<TestAllTypes>());
+    auto words = messageToFlatArray(builder);
+
+    doBenchmark(label, words.asBytes().size(), [&]() {
+      FlatArrayMessageReader reader(words);
+      KJ_ASSERT(reader.getRoot<TestAllTypes>().totalSize().wordCount > 0);
+    });
+  };
+
+  run("small message", [](TestAllTypes::Builder root) { initTestMessage(root); });
+  run("large message", [](TestAllTypes::Builder root) { initLargeMessage(root); });
+
+  MallocMessageBuilder builder;
+  initLargeMessage(builder.initRoot<TestAllTypes>());
+  auto words = messageToFlatArray(builder);
+  for (uint threadCount: {1, 4}) {
+    doBenchmark(kj::str("large message, validate() on ", threadCount, " thread(s)"),
+                words.asBytes().size(), [&]() {
+      FlatArrayMessageReader reader(words);
+      KJ_ASSERT(reader.validate(threadCount).wordCount > 0);
+    });
+  }
+}
+
+KJ_TEST("benchmark: scan List(Struct)") {
+  // Reads a text field from every element of a large struct list, once through the ordinary
+  // checked reader and once through List<T>::Reader::validate().
+
+  constexpr uint ELEMENTS = 10000;
+  MallocMessageBuilder builder(1 << 20);
+  auto list = builder.initRoot<TestAllTypes>().initStructList(ELEMENTS);
+  for (auto i: kj::indices(list)) {
+    list[i].setUInt32Field(i);
+    list[i].setTextField("some text");
+    list[i].initStructField().setUInt32Field(i);
+  }
+  auto words = messageToFlatArray(builder);
+
+  auto scan = [](List<TestAllTypes>::Reader list) {
+    uint64_t sum = 0;
+    for (auto element: list) {
+      sum += element.getUInt32Field() + element.getTextField().size() +
+             element.getStructField().getUInt32Field();
+    }
+    return sum;
+  };
+
+  doBenchmark("checked scan", words.asBytes().size(), [&]() {
+    FlatArrayMessageReader reader(words);
+    KJ_ASSERT(scan(reader.getRoot<TestAllTypes>().getStructList()) > 0);
+  });
+  doBenchmark("validate(), then scan", words.asBytes().size(), [&]() {
+    FlatArrayMessageReader reader(words);
+    KJ_ASSERT(scan(reader.getRoot<TestAllTypes>().getStructList().validate()) > 0);
+  });
+
+  // Validation pays off most when the list is scanned more than once.
+  doBenchmark("checked scan, 4 passes", words.asBytes().size(), [&]() {
+    FlatArrayMessageReader reader(words);
+    auto list = reader.getRoot<TestAllTypes>().getStructList();
+    for (auto pass KJ_UNUSED: kj::zeroTo(4)) {
+      KJ_ASSERT(scan(list) > 0);
+    }
+  });
+  doBenchmark("validate(), then scan 4 passes", words.asBytes().size(), [&]() {
+    FlatArrayMessageReader reader(words);
+    auto list = reader.getRoot<TestAllTypes>().getStructList().validate();
+    for (auto pass KJ_UNUSED: kj::zeroTo(4)) {
+      KJ_ASSERT(scan(list) > 0);
+    }
+  });
+}
+
+KJ_TEST("benchmark: packed vs. unpacked encoding") {
+  auto run = [&](kj::StringPtr size, auto&& init) {
+    MallocMessageBuilder builder;
+    init(builder.initRoot<TestAllTypes>());
+    kj::VectorOutputStream unpacked;
+    writeMessage(unpacked, builder);
+    kj::VectorOutputStream packed;
+    writePackedMessage(packed, builder);
+
+    // Throughput is reported in terms of the unpacked size in all cases, so that the numbers are
+    // directly comparable.
+    size_t messageBytes = unpacked.getArray().size();
+    kj::VectorOutputStream out;
+
+    doBenchmark(kj::str(size, ", unpacked encode"), messageBytes, [&]() {
+      out.clear();
+      writeMessage(out, builder);
+    });
+    doBenchmark(kj::str(size, ", packed encode"), messageBytes, [&]() {
+      out.clear();
+      writePackedMessage(out, builder);
+    });
+    doBenchmark(kj::str(size, ", unpacked decode"), messageBytes, [&]() {
+      kj::ArrayInputStream in(unpacked.getArray());
+      InputStreamMessageReader reader(in);
+      reader.getRoot<TestAllTypes>();
+    });
+    doBenchmark(kj::str(size, ", packed decode"), messageBytes, [&]() {
+      kj::ArrayInputStream in(packed.getArray());
+      PackedMessageReader reader(in);
+      reader.getRoot<TestAllTypes>();
+    });
+  };
+
+  run("small message", [](TestAllTypes::Builder root) { initTestMessage(root); });
+  run("large message", [](TestAllTypes::Builder root) { initLargeMessage(root); });
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
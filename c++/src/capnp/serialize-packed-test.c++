@@ -22,6 +22,7 @@
 #include "serialize-packed.h"
 #include <kj/debug.h>
 #include <kj/compat/gtest.h>
+#include <kj/vector.h>
 #include <string>
 #include <stdlib.h>
 #include "test-util.h"
@@ -219,6 +220,93 @@ TEST(Packed, SimplePacking) {
       {0xed,8,100,6,1,1,2, 0,2, 0xd4,1,2,3,1});
 }
 
+kj::Array<byte> referencePack(kj::ArrayPtr<const byte> unpacked) {
+  // Straightforward byte-at-a-time encoder used to check that the optimized encoder (which may
+  // use vector instructions) produces exactly the same bytes.
+
+  kj::Vector<byte> result;
+  const byte* in = unpacked.begin();
+  const byte* end = unpacked.end();
+  auto zeroCount = [](const byte* w) {
+    uint c = 0;
+    for (uint i = 0; i < 8; i++) c += w[i] == 0;
+    return c;
+  };
+
+  while (in < end) {
+    byte tag = 0;
+    for (uint i = 0; i < 8; i++) {
+      if (in[i] != 0) tag |= 1u << i;
+    }
+    result.add(tag);
+    for (uint i = 0; i < 8; i++) {
+      if (in[i] != 0) result.add(in[i]);
+    }
+    in += 8;
+
+    if (tag == 0) {
+      uint n = 0;
+      while (n < 255 && in < end && zeroCount(in) == 8) {
+        in += 8;
+        ++n;
+      }
+      result.add(n);
+    } else if (tag == 0xff) {
+      const byte* runStart = in;
+      while (in < end && in - runStart < 255 * 8 && zeroCount(in) < 2) {
+        in += 8;
+      }
+      result.add((in - runStart) / 8);
+      result.addAll(runStart, in);
+    }
+  }
+
+  return result.releaseAsArray();
+}
+
+TEST(Packed, MixedWords) {
+  // Exercise every kind of word, including runs longer than a single tag can describe, and
+  // check the result against the reference encoder.
+
+  kj::Vector<word> words;
+  uint32_t seed = 12345;
+  auto next = [&]() { return seed = seed * 1103515245 + 12345; };
+
+  auto addWord = [&](uint zeroMask) {
+    byte bytes[8];
+    for (uint i = 0; i < 8; i++) {
+      bytes[i] = zeroMask & (1u << i) ? 0 : (next() >> 16) % 255 + 1;
+    }
+    memcpy(&words.add(), bytes, sizeof(bytes));
+  };
+
+  for (uint tag = 0; tag < 256; tag++) {
+    addWord(~tag & 0xff);
+  }
+  for (uint i = 0; i < 300; i++) addWord(0xff);
+  for (uint i = 0; i < 300; i++) addWord(0);
+  for (uint i = 0; i < 300; i++) addWord(i % 7 == 0 ? 0x10 : 0);
+  for (uint i = 0; i < 1000; i++) {
+    uint r = next() >> 16;
+    switch (r % 4) {
+      case 0: addWord(0xff); break;
+      case 1: addWord(0); break;
+      case 2: addWord(1u << (r >> 8) % 8); break;
+      default: addWord((r >> 8) & 0xff); break;
+    }
+  }
+
+  auto unpacked = words.asPtr().asBytes();
+  auto expected = referencePack(unpacked);
+  expectPacksTo(unpacked, expected);
+
+  // Also pack some prefixes, so that runs are cut off by the end of the input.
+  for (uint n: {1u, 2u, 3u, 255u, 256u, 257u, 511u}) {
+    auto prefix = words.asPtr().slice(0, n).asBytes();
+    expectPacksTo(prefix, referencePack(prefix));
+  }
+}
+
 // =======================================================================================
 
 class TestMessageBuilder: public MallocMessageBuilder {
@@ -24,10 +24,192 @@
 #include "layout.h"
 #include <vector>
 
+#if !defined(CAPNP_PACKED_SSSE3)
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CAPNP_PACKED_SSSE3 1
+#else
+#define CAPNP_PACKED_SSSE3 0
+#endif
+#endif
+// Define CAPNP_PACKED_SSSE3=0 to force the portable byte-at-a-time packing code.
+
+#if CAPNP_PACKED_SSSE3
+#include <immintrin.h>
+#endif
+
 namespace capnp {
 
 namespace _ {  // private
 
+#if CAPNP_PACKED_SSSE3
+namespace {
+
+struct PackingTables {
+  // Per-tag lookup tables used by the SSSE3 kernels below. Each shuffle mask is an 8-byte
+  // PSHUFB control word; 0x80 lanes produce zero.
+
+  uint64_t compact[256];
+  // Gathers the non-zero bytes of a word (as described by the tag) to the front.
+
+  uint64_t expand[256];
+  // Scatters packed bytes back to their positions in the word, zero-filling the rest.
+
+  uint8_t popCount[256];
+
+  constexpr PackingTables(): compact(), expand(), popCount() {
+    for (uint tag = 0; tag < 256; tag++) {
+      uint64_t compactMask = 0;
+      uint64_t expandMask = 0;
+      uint n = 0;
+      for (uint i = 0; i < 8; i++) {
+        if (tag & (1u << i)) {
+          compactMask |= uint64_t(i) << (n * 8);
+          expandMask |= uint64_t(n) << (i * 8);
+          ++n;
+        } else {
+          expandMask |= uint64_t(0x80) << (i * 8);
+        }
+      }
+      for (uint i = n; i < 8; i++) {
+        compactMask |= uint64_t(0x80) << (i * 8);
+      }
+      compact[tag] = compactMask;
+      expand[tag] = expandMask;
+      popCount[tag] = n;
+    }
+  }
+};
+
+constexpr PackingTables PACKING_TABLES;
+
+#if defined(__SSSE3__)
+inline bool haveSsse3() { return true; }
+#else
+bool haveSsse3() {
+  static const bool result = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+  }();
+  return result;
+}
+#endif
+
+__attribute__((target("ssse3")))
+inline __m128i loadShuffleMask(const uint64_t& mask) {
+  return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&mask));
+}
+
+__attribute__((target("ssse3")))
+void unpackWordsSsse3(const uint8_t* __restrict__& inRef, const uint8_t* inEnd,
+                      uint8_t* __restrict__& outRef, uint8_t* outEnd) {
+  // Decodes as many complete words (including any run following a 0x00 or 0xff tag) as fit
+  // entirely within both buffers. Anything else -- a word straddling the end of the input, a run
+  // which needs another read, or malformed input -- is left for the scalar loop, which knows how
+  // to refill and how to report errors.
+
+  const uint8_t* __restrict__ in = inRef;
+  uint8_t* __restrict__ out = outRef;
+
+  // With at least 10 bytes we can always load the tag, eight payload bytes, and a run count.
+  while (inEnd - in >= 10 && out < outEnd) {
+    uint tag = in[0];
+
+    if (tag == 0) {
+      size_t runLength = in[1] * sizeof(word);
+      if (runLength > size_t(outEnd - out) - sizeof(word)) break;
+      memset(out, 0, sizeof(word) + runLength);
+      out += sizeof(word) + runLength;
+      in += 2;
+    } else if (tag == 0xffu) {
+      size_t runLength = in[9] * sizeof(word);
+      if (runLength > size_t(outEnd - out) - sizeof(word) ||
+          runLength > size_t(inEnd - in) - 10) break;
+      memcpy(out, in + 1, sizeof(word));
+      memcpy(out + sizeof(word), in + 10, runLength);
+      out += sizeof(word) + runLength;
+      in += 10 + runLength;
+    } else {
+      __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + 1));
+      __m128i unpacked = _mm_shuffle_epi8(packed, loadShuffleMask(PACKING_TABLES.expand[tag]));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), unpacked);
+      out += sizeof(word);
+      in += 1 + PACKING_TABLES.popCount[tag];
+    }
+  }
+
+  inRef = in;
+  outRef = out;
+}
+
+__attribute__((target("ssse3")))
+void packWordsSsse3(const uint8_t* __restrict__& inRef, const uint8_t* inEnd,
+                    uint8_t* __restrict__& outRef, uint8_t* outEnd) {
+  // Encodes words while at least 10 bytes of output space remain, producing exactly the same
+  // bytes as the scalar loop in PackedOutputStream::write(). Stops before an uncompressed run that
+  // doesn't fit in the output buffer, since only the scalar loop can hand that to the stream.
+
+  const uint8_t* __restrict__ in = inRef;
+  uint8_t* __restrict__ out = outRef;
+  const __m128i zero = _mm_setzero_si128();
+
+  while (inEnd - in >= 8 && outEnd - out >= 10) {
+    __m128i inWord = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+    uint tag = ~_mm_movemask_epi8(_mm_cmpeq_epi8(inWord, zero)) & 0xffu;
+
+    uint8_t* tagPos = out;
+    *out++ = tag;
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out),
+        _mm_shuffle_epi8(inWord, loadShuffleMask(PACKING_TABLES.compact[tag])));
+    out += PACKING_TABLES.popCount[tag];
+    in += sizeof(word);
+
+    if (tag == 0) {
+      const uint64_t* inWord = reinterpret_cast<const uint64_t*>(in);
+      const uint64_t* limit = reinterpret_cast<const uint64_t*>(inEnd);
+      if (limit - inWord > 255) {
+        limit = inWord + 255;
+      }
+      while (inWord < limit && *inWord == 0) {
+        ++inWord;
+      }
+      *out++ = inWord - reinterpret_cast<const uint64_t*>(in);
+      in = reinterpret_cast<const uint8_t*>(inWord);
+
+    } else if (tag == 0xffu) {
+      const uint8_t* runStart = in;
+      const uint8_t* limit = inEnd;
+      if ((size_t)(limit - in) > 255 * sizeof(word)) {
+        limit = in + 255 * sizeof(word);
+      }
+
+      while (in < limit) {
+        __m128i w = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+        uint zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(w, zero)) & 0xffu;
+        if (PACKING_TABLES.popCount[zeros] >= 2) break;
+        in += sizeof(word);
+      }
+
+      size_t count = in - runStart;
+      if (count > size_t(outEnd - out) - 1) {
+        // Leave this word to the scalar path, which can write the run straight through.
+        out = tagPos;
+        in = runStart - sizeof(word);
+        break;
+      }
+
+      *out++ = count / sizeof(word);
+      memcpy(out, runStart, count);
+      out += count;
+    }
+  }
+
+  inRef = in;
+  outRef = out;
+}
+
+}  // namespace
+#endif  // CAPNP_PACKED_SSSE3
+
 PackedInputStream::PackedInputStream(kj::BufferedInputStream& inner): inner(inner) {}
 PackedInputStream::~PackedInputStream() noexcept(false) {}
 
@@ -60,12 +242,26 @@ size_t PackedInputStream::tryRead(void* dst, size_t minBytes, size_t maxBytes) {
 #define BUFFER_END (reinterpret_cast<const uint8_t*>(buffer.end()))
 #define BUFFER_REMAINING ((size_t)(BUFFER_END - in))
 
+#if CAPNP_PACKED_SSSE3
+  bool useSsse3 = haveSsse3();
+#endif
+
   for (;;) {
     uint8_t tag;
 
     KJ_DASSERT((out - reinterpret_cast<uint8_t*>(dst)) % sizeof(word) == 0,
            "Output pointer should always be aligned here.");
 
+#if CAPNP_PACKED_SSSE3
+    if (useSsse3) {
+      unpackWordsSsse3(in, BUFFER_END, out, outEnd);
+      if (out == outEnd) {
+        inner.skip(in - reinterpret_cast<const uint8_t*>(buffer.begin()));
+        return maxBytes;
+      }
+    }
+#endif
+
     if (BUFFER_REMAINING < 10) {
       if (out >= outMin) {
         // We read at least the minimum amount, so go ahead and return.
@@ -311,7 +507,18 @@ void PackedOutputStream::write(const void* src, size_t size) {
   const uint8_t* __restrict__ in = reinterpret_cast<const uint8_t*>(src);
   const uint8_t* const inEnd = reinterpret_cast<const uint8_t*>(src) + size;
 
+#if CAPNP_PACKED_SSSE3
+  bool useSsse3 = haveSsse3();
+#endif
+
   while (in < inEnd) {
+#if CAPNP_PACKED_SSSE3
+    if (useSsse3) {
+      packWordsSsse3(in, inEnd, out, reinterpret_cast<uint8_t*>(buffer.end()));
+      if (in == inEnd) break;
+    }
+#endif
+
     if (reinterpret_cast<uint8_t*>(buffer.end()) - out < 10) {
       // Oops, we're out of space.  We need at least 10 bytes for the fast path, since we don't
       // bounds-check on every byte.
@@ -0,0 +1,255 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks for KJ's core async primitives. Run with `--benchmark-time <seconds>` to get useful
+// timings; by default each benchmark runs once, as a smoke test.
+
+#include "async.h"
+#include "timer.h"
+#include "mutex.h"
+#include "thread.h"
+#include "thread-pool.h"
+#include "vector.h"
+#include <kj/test.h>
+
+namespace kj {
+namespace {
+
+KJ_TEST("benchmark: promise continuations") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+
+  doBenchmark("100 .then()s", 0, [&]() {
+    Promise<uint> promise = 0u;
+    for (auto i KJ_UNUSED: kj::zeroTo(100)) {
+      promise = promise.then([](uint n) { return n + 1; });
+    }
+    KJ_ASSERT(promise.wait(waitScope) == 100);
+  });
+
+  doBenchmark("evalLater()", 0, [&]() {
+    evalLater([]() {}).wait(waitScope);
+  });
+
+  doBenchmark("newPromiseAndFulfiller()", 0, [&]() {
+    auto paf = newPromiseAndFulfiller<uint>();
+    paf.fulfiller->fulfill(123);
+    KJ_ASSERT(paf.promise.wait(waitScope) == 123);
+  });
+}
+
+class ErrorHandlerImpl: public TaskSet::ErrorHandler {
+public:
+  void taskFailed(Exception&& exception) override {
+    KJ_FAIL_EXPECT(exception);
+  }
+};
+
+KJ_TEST("benchmark: TaskSet") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  ErrorHandlerImpl errorHandler;
+  TaskSet tasks(errorHandler);
+
+  doBenchmark("100 tasks, then onEmpty()", 0, [&]() {
+    for (auto i KJ_UNUSED: kj::zeroTo(100)) {
+      tasks.add(evalLater([]() {}));
+    }
+    tasks.onEmpty().wait(waitScope);
+  });
+}
+
+KJ_TEST("benchmark: cross-thread Executor") {
+  MutexGuarded<Maybe<const Executor&>> executor;
+  Own<PromiseFulfiller<void>> stop;
+
+  Thread thread([&]() {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    auto paf = newPromiseAndFulfiller<void>();
+    stop = kj::mv(paf.fulfiller);
+    *executor.lockExclusive() = getCurrentThreadExecutor();
+    paf.promise.wait(waitScope);
+  });
+
+  const Executor& remote = executor.when(
+      [](const Maybe<const Executor&>& value) { return value != kj::none; },
+      [](const Maybe<const Executor&>& value) -> const Executor& {
+    return KJ_ASSERT_NONNULL(value);
+  });
+
+  uint count = 0;
+  doBenchmark("executeSync()", 0, [&]() {
+    remote.executeSync([&]() { ++count; });
+  });
+
+  {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    doBenchmark("executeAsync()", 0, [&]() {
+      remote.executeAsync([&]() { ++count; }).wait(waitScope);
+    });
+  }
+
+  remote.executeSync([&]() { stop->fulfill(); });
+}
+
+KJ_TEST("benchmark: many threads sending to one Executor") {
+  // Each producer thread sends a batch of executeAsync() calls to a single consumer thread, as
+  // many logging or metrics sinks do.
+
+  MutexGuarded<Maybe<const Executor&>> executor;
+  Own<PromiseFulfiller<void>> stop;
+
+  Thread thread([&]() {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    auto paf = newPromiseAndFulfiller<void>();
+    stop = kj::mv(paf.fulfiller);
+    *executor.lockExclusive() = getCurrentThreadExecutor();
+    paf.promise.wait(waitScope);
+  });
+
+  const Executor& remote = executor.when(
+      [](const Maybe<const Executor&>& value) { return value != kj::none; },
+      [](const Maybe<const Executor&>& value) -> const Executor& {
+    return KJ_ASSERT_NONNULL(value);
+  });
+
+  static constexpr uint BATCH = 100;
+  uint count = 0;  // only touched on the consumer thread
+
+  for (uint producers: {1u, 4u, 16u, 64u}) {
+    doBenchmark(str(producers, " producers x ", BATCH, " executeAsync()"), 0, [&]() {
+      Vector<Own<Thread>> threads(producers);
+      for (uint i = 0; i < producers; i++) {
+        threads.add(heap<Thread>([&]() {
+          EventLoop loop;
+          WaitScope waitScope(loop);
+          auto promises = heapArrayBuilder<Promise<void>>(BATCH);
+          for (uint j = 0; j < BATCH; j++) {
+            promises.add(remote.executeAsync([&]() { ++count; }));
+          }
+          joinPromises(promises.finish()).wait(waitScope);
+        }));
+      }
+    });
+  }
+
+  remote.executeSync([&]() { stop->fulfill(); });
+}
+
+KJ_TEST("benchmark: ThreadPool vs. executeAsync()") {
+  // Fans out batches of small CPU-bound jobs, either to a ThreadPool or round-robin across the
+  // same number of threads running event loops, via executeAsync().
+
+  static constexpr uint THREADS = 4;
+  static constexpr uint BATCH = 100;
+
+  auto job = [](uint i) {
+    uint64_t x = i;
+    for (uint j = 0; j < 1000; j++) x = x * 6364136223846793005ull + 1442695040888963407ull;
+    return x;
+  };
+
+  MutexGuarded<Vector<const Executor*>> executors;
+  Vector<Own<PromiseFulfiller<void>>> stops;
+  stops.resize(THREADS);
+  Vector<Own<Thread>> threads;
+  for (uint i = 0; i < THREADS; i++) {
+    threads.add(heap<Thread>([&executors, &stop = stops[i]]() {
+      EventLoop loop;
+      WaitScope waitScope(loop);
+      auto paf = newPromiseAndFulfiller<void>();
+      stop = kj::mv(paf.fulfiller);
+      executors.lockExclusive()->add(&getCurrentThreadExecutor());
+      paf.promise.wait(waitScope);
+    }));
+  }
+  auto remotes = executors.when(
+      [](const Vector<const Executor*>& value) { return value.size() == THREADS; },
+      [](const Vector<const Executor*>& value) { return KJ_MAP(e, value) { return e; }; });
+
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  ThreadPool pool(THREADS);
+
+  doBenchmark("ThreadPool::run(), batch of 100", 0, [&]() {
+    auto promises = heapArrayBuilder<Promise<uint64_t>>(BATCH);
+    for (uint i = 0; i < BATCH; i++) {
+      promises.add(pool.run([&job, i]() { return job(i); }));
+    }
+    joinPromises(promises.finish()).wait(waitScope);
+  });
+
+  doBenchmark("executeAsync(), batch of 100", 0, [&]() {
+    auto promises = heapArrayBuilder<Promise<uint64_t>>(BATCH);
+    for (uint i = 0; i < BATCH; i++) {
+      promises.add(remotes[i % THREADS]->executeAsync([&job, i]() { return job(i); }));
+    }
+    joinPromises(promises.finish()).wait(waitScope);
+  });
+
+  doBenchmark("ThreadPool::run(), one at a time", 0, [&]() {
+    pool.run([&job]() { return job(0); }).wait(waitScope);
+  });
+
+  for (uint i = 0; i < THREADS; i++) {
+    remotes[i]->executeSync([&stop = stops[i]]() { stop->fulfill(); });
+  }
+}
+
+KJ_TEST("benchmark: timer churn") {
+  // Schedules a million timers at scattered times, cancels half of them, then fires the rest.
+  // This exercises the timer queue the way a busy server with many idle timeouts does.
+
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  TimerImpl timer(kj::origin<TimePoint>());
+
+  constexpr uint COUNT = 1'000'000;
+  Vector<Promise<void>> kept(COUNT / 2);
+  uint fired = 0;
+
+  doBenchmark("1M timers, half canceled", 0, [&]() {
+    TimePoint base = timer.now();
+    {
+      Vector<Promise<void>> canceled(COUNT / 2);
+      for (uint i: kj::zeroTo(COUNT)) {
+        auto promise = timer.atTime(base + (i * 7919u % COUNT + 1) * kj::MICROSECONDS);
+        if (i % 2 == 0) {
+          kept.add(promise.then([&]() { ++fired; }));
+        } else {
+          canceled.add(kj::mv(promise));
+        }
+      }
+    }
+
+    timer.advanceTo(base + (COUNT + 1) * kj::MICROSECONDS);
+    joinPromises(kept.releaseAsArray()).wait(waitScope);
+    kept = Vector<Promise<void>>(COUNT / 2);
+  });
+
+  KJ_ASSERT(fired > 0 && fired % (COUNT / 2) == 0);
+}
+
+}  // namespace
+}  // namespace kj
@@ -1728,13 +1728,18 @@ private:
   // Membership in one of the linked lists in the target Executor's work list or cancel list. These
   // fields are protected by the target Executor's mutex.
 
+  XThreadEvent* inboxNext = nullptr;
+  // Next event in the target Executor's lock-free inbox, where the event waits after it is sent
+  // until someone holding the target Executor's mutex moves it to the start list.
+
   enum {
     UNUSED,
     // Object was never queued on another thread.
 
     QUEUED,
-    // Target thread has not yet dequeued the event from the state.start list. The requesting
-    // thread can cancel execution by removing the event from the list.
+    // Target thread has not yet dequeued the event from its inbox or the state.start list. The
+    // requesting thread can cancel execution by moving the inbox to the list, then removing the
+    // event from the list.
 
     EXECUTING,
     // Target thread has dequeued the event from state.start and moved it to state.executing. To
@@ -0,0 +1,259 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks for KJ's async I/O. Run with `--benchmark-time <seconds>` to get useful timings; by
+// default each benchmark runs once, as a smoke test.
+
+#if _WIN32
+#include "win32-api-version.h"
+#endif
+
+#include "async-io.h"
+#include "debug.h"
+#include "io.h"
+#include "time.h"
+#include "vector.h"
+#include <kj/test.h>
+#include <algorithm>
+#include <string.h>
+
+#if _WIN32
+#include <winsock2.h>
+#include "windows-sanity.h"
+#else
+#include "async-unix.h"
+#include <sys/socket.h>
+#endif
+
+#if __linux__
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace kj {
+namespace {
+
+enum class Backend { DEFAULT, IO_URING };
+
+bool setupBackend(AsyncIoContext& io, Backend backend) {
+  // Returns false if the backend isn't available, in which case the benchmark should be skipped.
+
+  switch (backend) {
+    case Backend::DEFAULT:
+      return true;
+    case Backend::IO_URING:
+#if KJ_USE_IO_URING
+      if (io.unixEventPort.enableIoUring()) return true;
+      KJ_LOG(WARNING, "io_uring unavailable on this kernel; skipping benchmark");
+#endif
+      return false;
+  }
+  KJ_UNREACHABLE;
+}
+
+#if __linux__
+Maybe<AutoCloseFd> openSyscallCounter() {
+  // Opens a perf counter of the system calls made by this thread. This needs tracefs and
+  // permission to use perf_event_open(), which containers often lack.
+
+  for (StringPtr path: { "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id"_kj,
+                         "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"_kj }) {
+    int idFd = open(path.cStr(), O_RDONLY | O_CLOEXEC);
+    if (idFd < 0) continue;
+    auto text = FdInputStream(AutoCloseFd(idFd)).readAllText();
+    auto id = heapString(text.slice(0, text.findFirst('\n').orDefault(text.size())))
+        .parseAs<uint64_t>();
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_TRACEPOINT;
+    attr.size = sizeof(attr);
+    attr.config = id;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (fd >= 0) return AutoCloseFd(fd);
+  }
+  return kj::none;
+}
+#endif
+
+class IterationStats {
+  // Collects what doBenchmark() doesn't: the latency of each iteration, and how many system calls
+  // each one makes. Where system calls can't be counted, context switches are counted instead,
+  // since they show when an iteration had to block in the kernel.
+
+public:
+  IterationStats() {
+#if __linux__
+    syscallCounter = openSyscallCounter();
+    startCount = readCount();
+#endif
+  }
+
+  template <typename Func>
+  void measure(Func&& func) {
+    auto start = systemPreciseMonotonicClock().now();
+    func();
+    samples.add((systemPreciseMonotonicClock().now() - start) / NANOSECONDS);
+  }
+
+  void report(StringPtr label) {
+    // Prints the percentiles alongside doBenchmark()'s report. Skipped for short runs (such as the
+    // default single iteration), whose percentiles would be meaningless.
+
+    if (samples.size() < 100) return;
+
+    auto text = kj::str("[ BENCH ] ", label, ": p50 ", percentile(50), " ns, p99 ",
+                        percentile(99), " ns");
+#if __linux__
+    uint64_t tenths = (readCount() - startCount) * 10 / samples.size();
+    text = kj::str(text, ", ", tenths / 10, '.', tenths % 10,
+        syscallCounter == kj::none ? " context switches/iter" : " syscalls/iter");
+#endif
+    text = kj::str(text, '\n');
+    FdOutputStream(STDOUT_FILENO).write(text.begin(), text.size());
+  }
+
+private:
+  Vector<uint64_t> samples;
+#if __linux__
+  Maybe<AutoCloseFd> syscallCounter;
+  uint64_t startCount;
+
+  uint64_t readCount() {
+    KJ_IF_SOME(fd, syscallCounter) {
+      uint64_t count;
+      KJ_SYSCALL(read(fd, &count, sizeof(count)));
+      return count;
+    }
+
+    struct rusage usage;
+    KJ_SYSCALL(getrusage(RUSAGE_THREAD, &usage));
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+  }
+#endif
+
+  uint64_t percentile(uint p) {
+    auto index = (samples.size() - 1) * p / 100;
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+  }
+};
+
+KJ_TEST("benchmark: socketpair ping-pong") {
+  auto run = [&](StringPtr label, Backend backend) {
+    auto io = setupAsyncIo();
+    if (!setupBackend(io, backend)) return;
+
+    auto pipe = io.provider->newTwoWayPipe();
+    byte ping[64];
+    byte pong[64];
+    memset(ping, 'x', sizeof(ping));
+
+    IterationStats stats;
+    doBenchmark(label, sizeof(ping) * 2, [&]() {
+      stats.measure([&]() {
+        auto echo = pipe.ends[1]->read(pong, sizeof(pong)).then([&]() {
+          return pipe.ends[1]->write(pong, sizeof(pong));
+        });
+        pipe.ends[0]->write(ping, sizeof(ping)).wait(io.waitScope);
+        pipe.ends[0]->read(pong, sizeof(pong)).wait(io.waitScope);
+        echo.wait(io.waitScope);
+      });
+    });
+    stats.report(label);
+  };
+
+  run("64-byte round trip, default backend", Backend::DEFAULT);
+  run("64-byte round trip, io_uring", Backend::IO_URING);
+}
+
+KJ_TEST("benchmark: socketpair streaming") {
+  constexpr size_t CHUNK = 64 * 1024;
+  constexpr size_t TOTAL = 16 * CHUNK;
+
+  auto run = [&](StringPtr label, Backend backend) {
+    auto io = setupAsyncIo();
+    if (!setupBackend(io, backend)) return;
+
+    auto pipe = io.provider->newTwoWayPipe();
+    auto out = heapArray<byte>(CHUNK);
+    auto in = heapArray<byte>(TOTAL);
+    memset(out.begin(), 'x', out.size());
+
+    IterationStats stats;
+    doBenchmark(label, TOTAL, [&]() {
+      stats.measure([&]() {
+        auto readPromise = pipe.ends[1]->read(in.begin(), in.size());
+        for (auto i KJ_UNUSED: kj::zeroTo(TOTAL / CHUNK)) {
+          pipe.ends[0]->write(out.begin(), out.size()).wait(io.waitScope);
+        }
+        readPromise.wait(io.waitScope);
+      });
+    });
+    stats.report(label);
+  };
+
+  run("64 KiB writes, default backend", Backend::DEFAULT);
+  run("64 KiB writes, io_uring", Backend::IO_URING);
+}
+
+#if __linux__ && defined(SO_ZEROCOPY)
+KJ_TEST("benchmark: TCP send, copied vs. zero-copy") {
+  auto run = [&](StringPtr label, bool zeroCopy) {
+    auto io = setupAsyncIo();
+    auto& network = io.provider->getNetwork();
+
+    auto listener = network.parseAddress("127.0.0.1").wait(io.waitScope)->listen();
+    auto serverPromise = listener->accept();
+    auto client = network.parseAddress("127.0.0.1", listener->getPort()).wait(io.waitScope)
+        ->connect().wait(io.waitScope);
+    auto server = serverPromise.wait(io.waitScope);
+
+    if (zeroCopy) {
+      int one = 1;
+      client->setsockopt(SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+    }
+
+    auto out = heapArray<byte>(1 << 20);
+    auto in = heapArray<byte>(out.size());
+    memset(out.begin(), 'x', out.size());
+
+    IterationStats stats;
+    doBenchmark(label, out.size(), [&]() {
+      stats.measure([&]() {
+        auto readPromise = server->read(in.begin(), in.size());
+        client->write(out.begin(), out.size()).wait(io.waitScope);
+        readPromise.wait(io.waitScope);
+      });
+    });
+    stats.report(label);
+  };
+
+  run("1 MiB writes, copied", false);
+  run("1 MiB writes, MSG_ZEROCOPY", true);
+}
+#endif  // __linux__ && defined(SO_ZEROCOPY)
+
+}  // namespace
+}  // namespace kj
@@ -42,6 +42,7 @@
 #define inet_pton InetPtonA
 #define inet_ntop InetNtopA
 #else
+#include "async-unix.h"
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -640,6 +641,34 @@ TEST(AsyncIo, CapabilityPipeMultiStreamMessage) {
   KJ_EXPECT(receiveStreams[1]->readAllText().wait(ioContext.waitScope) == "qux");
 }
 
+KJ_TEST("writeWithAncillary() sends control messages") {
+  auto io = setupAsyncIo();
+
+  auto capPipe = io.provider->newCapabilityPipe();
+
+  int pipeFds[2];
+  KJ_SYSCALL(miniposix::pipe(pipeFds));
+  kj::AutoCloseFd in(pipeFds[0]);
+  kj::AutoCloseFd out(pipeFds[1]);
+
+  int sendFd = out.get();
+  AncillaryMessage message(SOL_SOCKET, SCM_RIGHTS, kj::arrayPtr(&sendFd, 1).asBytes());
+  capPipe.ends[0]->writeWithAncillary("foo"_kj.asBytes(), kj::arrayPtr(&message, 1))
+      .wait(io.waitScope);
+  out = nullptr;
+
+  char buffer[4];
+  AutoCloseFd fdBuffer[1];
+  auto result = capPipe.ends[1]->tryReadWithFds(buffer, 3, 3, fdBuffer, 1).wait(io.waitScope);
+  KJ_ASSERT(result.byteCount == 3);
+  KJ_ASSERT(result.capCount == 1);
+  KJ_EXPECT(kj::StringPtr(buffer, 3) == "foo");
+
+  kj::FdOutputStream(fdBuffer[0].get()).write("bar", 3);
+  fdBuffer[0] = nullptr;
+  KJ_EXPECT(kj::FdInputStream(in.get()).readAllText() == "bar");
+}
+
 TEST(AsyncIo, ScmRightsTruncatedOdd) {
   // Test that if we send two FDs over a unix socket, but the receiving end only receives one, we
   // don't leak the other FD.
@@ -3004,6 +3033,101 @@ KJ_TEST("import socket FD that's already broken") {
   KJ_EXPECT(buffer == "foo"_kj);
 }
 
+#if __linux__ && defined(SO_ZEROCOPY)
+KJ_TEST("zero-copy socket writes") {
+  auto io = setupAsyncIo();
+  auto& network = io.provider->getNetwork();
+
+  auto listener = network.parseAddress("127.0.0.1").wait(io.waitScope)->listen();
+  auto serverPromise = listener->accept();
+  auto client = network.parseAddress("127.0.0.1", listener->getPort()).wait(io.waitScope)
+      ->connect().wait(io.waitScope);
+  auto server = serverPromise.wait(io.waitScope);
+
+  int one = 1;
+  client->setsockopt(SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+
+  // Big enough to exceed the zero-copy threshold and the socket buffers, gathered from pieces of
+  // uneven size.
+  auto data = kj::heapArray<byte>(1 << 20);
+  for (auto i: kj::indices(data)) data[i] = i * 7 + (i >> 11);
+  ArrayPtr<const byte> pieces[3] = {
+    data.slice(0, 1000), data.slice(1000, 500000), data.slice(500000, data.size())
+  };
+
+  auto readPromise = server->readAllBytes();
+  client->write(kj::arrayPtr(pieces, 3)).wait(io.waitScope);
+
+  // Completion notifications must not look like a disconnect.
+  auto disconnected = client->whenWriteDisconnected();
+  KJ_EXPECT(!disconnected.poll(io.waitScope));
+
+  // A small write after that takes the regular path.
+  client->write("foo", 3).wait(io.waitScope);
+  client->shutdownWrite();
+
+  auto received = readPromise.wait(io.waitScope);
+  KJ_ASSERT(received.size() == data.size() + 3);
+  KJ_EXPECT(received.slice(0, data.size()) == data);
+  KJ_EXPECT(received.slice(data.size(), received.size()) == "foo"_kj.asBytes());
+}
+
+KJ_TEST("canceling a zero-copy write neither blocks nor resets the connection") {
+  auto io = setupAsyncIo();
+  auto& network = io.provider->getNetwork();
+
+  auto listener = network.parseAddress("127.0.0.1").wait(io.waitScope)->listen();
+  auto serverPromise = listener->accept();
+  auto client = network.parseAddress("127.0.0.1", listener->getPort()).wait(io.waitScope)
+      ->connect().wait(io.waitScope);
+  auto server = serverPromise.wait(io.waitScope);
+
+  int one = 1;
+  client->setsockopt(SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+
+  // Far more than the socket buffers hold, so the write is still in progress when canceled.
+  auto data = kj::heapArray<byte>(64 << 20);
+  for (auto i: kj::indices(data)) data[i] = i * 7 + (i >> 11);
+
+  {
+    auto writePromise = client->write(data.begin(), data.size());
+    KJ_EXPECT(!writePromise.poll(io.waitScope));
+    // Canceled here, with data the server hasn't read yet still pinned. The kernel goes on
+    // sending it, and the stream collects the completions as they come in.
+  }
+
+  // The connection is still intact: the server receives whatever was queued, then a clean EOF.
+  auto readPromise = server->readAllBytes();
+  auto disconnected = client->whenWriteDisconnected();
+  client->shutdownWrite();
+  auto received = readPromise.wait(io.waitScope);
+
+  KJ_EXPECT(received.size() > 0);
+  KJ_EXPECT(received.size() < data.size(), received.size());
+  KJ_EXPECT(received == data.slice(0, received.size()));
+
+  // The completions that arrive in the meantime must not look like a disconnect.
+  KJ_EXPECT(!disconnected.poll(io.waitScope));
+}
+
+KJ_TEST("zero-copy flag is ignored on sockets that don't support it") {
+  auto io = setupAsyncIo();
+
+  int fds[2];
+  KJ_SYSCALL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  auto a = io.lowLevelProvider->wrapSocketFd(fds[0],
+      LowLevelAsyncIoProvider::TAKE_OWNERSHIP | LowLevelAsyncIoProvider::ZEROCOPY_SEND);
+  auto b = io.lowLevelProvider->wrapSocketFd(fds[1], LowLevelAsyncIoProvider::TAKE_OWNERSHIP);
+
+  auto data = kj::heapArray<byte>(100000);
+  for (auto i: kj::indices(data)) data[i] = i * 13;
+
+  auto readPromise = b->readAllBytes();
+  a->write(data.begin(), data.size()).then([&]() { a->shutdownWrite(); }).wait(io.waitScope);
+  KJ_EXPECT(readPromise.wait(io.waitScope) == data);
+}
+#endif  // __linux__ && defined(SO_ZEROCOPY)
+
 #endif  // !__CYGWIN__
 #endif  // !_WIN32
 
@@ -3459,5 +3583,128 @@ KJ_TEST("pump file to socket") {
   doTest(fs->getCurrent().createTemporary());
 }
 
+#if KJ_USE_IO_URING
+
+KJ_TEST("io_uring stream reads and writes") {
+  auto ioContext = setupAsyncIo();
+  auto& ws = ioContext.waitScope;
+  if (!ioContext.unixEventPort.enableIoUring()) {
+    KJ_LOG(WARNING, "io_uring not supported by this kernel; skipping test");
+    return;
+  }
+
+  auto pipe = ioContext.provider->newTwoWayPipe();
+
+  {
+    char buffer[4];
+    auto readPromise = pipe.ends[1]->tryRead(buffer, 3, 4);
+    KJ_EXPECT(!readPromise.poll(ws));
+    pipe.ends[0]->write("foo", 3).wait(ws);
+    KJ_EXPECT(readPromise.wait(ws) == 3);
+    KJ_EXPECT(kj::heapString(buffer, 3) == "foo");
+  }
+
+  {
+    // Gather write large enough to need several partial sends, read back with a minimum that
+    // requires several partial receives.
+    auto big = bigString(1'000'000);
+    auto bytes = big.asBytes();
+    ArrayPtr<const byte> pieces[3] = {
+      bytes.slice(0, 1), bytes.slice(1, 500'000), bytes.slice(500'000, bytes.size())
+    };
+    auto writePromise = pipe.ends[0]->write(pieces);
+
+    auto buffer = kj::heapArray<byte>(bytes.size());
+    KJ_EXPECT(pipe.ends[1]->tryRead(buffer.begin(), buffer.size(), buffer.size()).wait(ws)
+        == buffer.size());
+    writePromise.wait(ws);
+    KJ_EXPECT(buffer == bytes);
+  }
+
+  {
+    pipe.ends[0]->shutdownWrite();
+    char buffer[4];
+    KJ_EXPECT(pipe.ends[1]->tryRead(buffer, 1, 4).wait(ws) == 0);
+  }
+
+  KJ_EXPECT(KJ_ASSERT_NONNULL(ioContext.unixEventPort.getIoUring()).getInFlightCount() == 0);
+}
+
+KJ_TEST("io_uring read cancellation") {
+  auto ioContext = setupAsyncIo();
+  auto& ws = ioContext.waitScope;
+  if (!ioContext.unixEventPort.enableIoUring()) {
+    KJ_LOG(WARNING, "io_uring not supported by this kernel; skipping test");
+    return;
+  }
+  auto& ring = KJ_ASSERT_NONNULL(ioContext.unixEventPort.getIoUring());
+
+  auto pipe = ioContext.provider->newTwoWayPipe();
+
+  {
+    char buffer[4];
+    auto readPromise = pipe.ends[1]->tryRead(buffer, 1, 4);
+    KJ_EXPECT(!readPromise.poll(ws));
+    KJ_EXPECT(ring.getInFlightCount() == 1);
+  }
+  KJ_EXPECT(ring.getInFlightCount() == 0);
+
+  // Data written after the cancellation goes to the next read.
+  pipe.ends[0]->write("bar", 3).wait(ws);
+  char buffer[4];
+  KJ_EXPECT(pipe.ends[1]->tryRead(buffer, 3, 4).wait(ws) == 3);
+  KJ_EXPECT(kj::heapString(buffer, 3) == "bar");
+}
+
+KJ_TEST("io_uring accept") {
+  auto ioContext = setupAsyncIo();
+  auto& ws = ioContext.waitScope;
+  if (!ioContext.unixEventPort.enableIoUring()) {
+    KJ_LOG(WARNING, "io_uring not supported by this kernel; skipping test");
+    return;
+  }
+  auto& network = ioContext.provider->getNetwork();
+
+  auto listener = network.parseAddress("127.0.0.1").wait(ws)->listen();
+  auto acceptPromise = listener->accept();
+  KJ_EXPECT(!acceptPromise.poll(ws));
+
+  auto client = network.parseAddress("127.0.0.1", listener->getPort()).wait(ws)
+      ->connect().wait(ws);
+  auto server = acceptPromise.wait(ws);
+
+  client->write("foo", 3).wait(ws);
+  char buffer[4];
+  KJ_EXPECT(server->tryRead(buffer, 3, 4).wait(ws) == 3);
+  KJ_EXPECT(kj::heapString(buffer, 3) == "foo");
+
+  // Canceling a pending accept works too.
+  {
+    auto promise = listener->accept();
+    KJ_EXPECT(!promise.poll(ws));
+  }
+  KJ_EXPECT(KJ_ASSERT_NONNULL(ioContext.unixEventPort.getIoUring()).getInFlightCount() == 0);
+}
+
+KJ_TEST("io_uring falls back to epoll for non-sockets") {
+  auto ioContext = setupAsyncIo();
+  auto& ws = ioContext.waitScope;
+  if (!ioContext.unixEventPort.enableIoUring()) {
+    KJ_LOG(WARNING, "io_uring not supported by this kernel; skipping test");
+    return;
+  }
+
+  auto pipe = ioContext.provider->newOneWayPipe();
+
+  char buffer[4];
+  auto readPromise = pipe.in->tryRead(buffer, 3, 4);
+  KJ_EXPECT(!readPromise.poll(ws));
+  pipe.out->write("baz", 3).wait(ws);
+  KJ_EXPECT(readPromise.wait(ws) == 3);
+  KJ_EXPECT(kj::heapString(buffer, 3) == "baz");
+}
+
+#endif  // KJ_USE_IO_URING
+
 }  // namespace
 }  // namespace kj
@@ -60,6 +60,13 @@
 
 #if __linux__
 #include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#endif
+
+#if __linux__ && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define KJ_HAS_ZEROCOPY_SEND 1
+#else
+#define KJ_HAS_ZEROCOPY_SEND 0
 #endif
 
 #if !defined(SO_PEERCRED) && defined(LOCAL_PEERCRED)
@@ -151,7 +158,19 @@ public:
   AsyncStreamFd(UnixEventPort& eventPort, int fd, uint flags, uint observerFlags)
       : OwnedFileDescriptor(fd, flags),
         eventPort(eventPort),
-        observer(eventPort, fd, observerFlags) {}
+#if KJ_USE_IO_URING
+        ioUring(eventPort.getIoUring()),
+#endif
+        observer(eventPort, fd, observerFlags) {
+#if KJ_HAS_ZEROCOPY_SEND
+    if (flags & LowLevelAsyncIoProvider::ZEROCOPY_SEND) {
+      // This fails for sockets that don't support zero-copy (e.g. Unix sockets), in which case we
+      // just keep copying.
+      int one = 1;
+      zeroCopySend = ::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+    }
+#endif
+  }
   virtual ~AsyncStreamFd() noexcept(false) {}
 
   Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
@@ -182,6 +201,18 @@ public:
   }
 
   Promise<void> write(const void* buffer, size_t size) override {
+#if KJ_HAS_ZEROCOPY_SEND
+    if (zeroCopySend && size >= ZEROCOPY_MIN_BYTES) {
+      return startZeroCopyWrite(arrayPtr(reinterpret_cast<const byte*>(buffer), size), nullptr);
+    }
+#endif
+
+#if KJ_USE_IO_URING
+    KJ_IF_SOME(ring, ioUring) {
+      return writeIoUring(ring, arrayPtr(reinterpret_cast<const byte*>(buffer), size), nullptr);
+    }
+#endif
+
     ssize_t n;
     KJ_NONBLOCKING_SYSCALL(n = ::write(fd, buffer, size)) {
       // Error.
@@ -478,7 +509,7 @@ public:
     KJ_IF_SOME(p, writeDisconnectedPromise) {
       return p.addBranch();
     } else {
-      auto fork = observer.whenWriteDisconnected().fork();
+      auto fork = observeWriteDisconnected().fork();
       auto result = fork.addBranch();
       writeDisconnectedPromise = kj::mv(fork);
       return kj::mv(result);
@@ -505,6 +536,14 @@ public:
 
   void setsockopt(int level, int option, const void* value, uint length) override {
     KJ_SYSCALL(::setsockopt(fd, level, option, value, length));
+#if KJ_HAS_ZEROCOPY_SEND
+    if (level == SOL_SOCKET && option == SO_ZEROCOPY && length >= sizeof(int)) {
+      // SO_ZEROCOPY only permits MSG_ZEROCOPY; we also need to start passing it.
+      int enabled;
+      memcpy(&enabled, value, sizeof(enabled));
+      zeroCopySend = enabled != 0;
+    }
+#endif
   }
 
   void getsockname(struct sockaddr* addr, uint* length) override {
@@ -528,6 +567,71 @@ public:
     ancillaryMsgCallback = kj::mv(fn);
   }
 
+  Promise<void> writeWithAncillary(
+      ArrayPtr<const byte> data, ArrayPtr<const AncillaryMessage> messages) override {
+    KJ_REQUIRE(data.size() > 0, "can't write ancillary messages without bytes");
+
+    struct iovec iov;
+    iov.iov_base = const_cast<byte*>(data.begin());
+    iov.iov_len = data.size();
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    // See writeInternal() for why we round up to whole words.
+    size_t msgBytes = 0;
+    for (auto& message: messages) {
+      msgBytes += CMSG_SPACE(message.asArray<byte>().size());
+    }
+    size_t msgWords = (msgBytes + sizeof(void*) - 1) / sizeof(void*);
+    KJ_STACK_ARRAY(void*, cmsgSpace, msgWords, 16, 256);
+    auto cmsgBytes = cmsgSpace.asBytes();
+    memset(cmsgBytes.begin(), 0, cmsgBytes.size());
+    if (msgBytes > 0) {
+      msg.msg_control = cmsgBytes.begin();
+      msg.msg_controllen = msgBytes;
+
+      struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+      for (auto& message: messages) {
+        auto payload = message.asArray<byte>();
+        cmsg->cmsg_level = message.getLevel();
+        cmsg->cmsg_type = message.getType();
+        cmsg->cmsg_len = CMSG_LEN(payload.size());
+        memcpy(CMSG_DATA(cmsg), payload.begin(), payload.size());
+        cmsg = CMSG_NXTHDR(&msg, cmsg);
+      }
+    }
+
+    ssize_t n;
+    KJ_NONBLOCKING_SYSCALL(n = ::sendmsg(fd, &msg, 0)) {
+      // Error.
+
+      // We can't "return kj::READY_NOW;" inside this block because it causes a memory leak due to
+      // a bug that exists in both Clang and GCC:
+      //   http://gcc.gnu.org/bugzilla/show_bug.cgi?id=33799
+      //   http://llvm.org/bugs/show_bug.cgi?id=12286
+      goto error;
+    }
+
+    if (false) {
+    error:
+      return kj::READY_NOW;
+    }
+
+    if (n < 0) {
+      // Got EAGAIN. Nothing was written.
+      return observer.whenBecomesWritable().then([this, data, messages]() {
+        return writeWithAncillary(data, messages);
+      });
+    } else if (size_t(n) < data.size()) {
+      return write(data.begin() + n, data.size() - n);
+    } else {
+      return kj::READY_NOW;
+    }
+  }
+
   Promise<void> waitConnected() {
     // Wait until initial connection has completed. This actually just waits until it is writable.
 
@@ -553,10 +657,64 @@ public:
 
 private:
   UnixEventPort& eventPort;
+#if KJ_USE_IO_URING
+  Maybe<UnixEventPort::IoUring&> ioUring;
+  // Non-null if the event port had io_uring enabled when this stream was created, and we haven't
+  // since discovered that the fd isn't a socket.
+#endif
   UnixEventPort::FdObserver observer;
   Maybe<ForkedPromise<void>> writeDisconnectedPromise;
   Maybe<Function<void(ArrayPtr<AncillaryMessage>)>> ancillaryMsgCallback;
 
+#if KJ_HAS_ZEROCOPY_SEND
+  static constexpr size_t ZEROCOPY_MIN_BYTES = 16384;
+  // Writes smaller than this are copied even in zero-copy mode. Per the kernel's documentation,
+  // page pinning and completion notification only pay off for writes of around 10KiB and up.
+
+  bool zeroCopySend = false;
+  // Whether large writes should pass MSG_ZEROCOPY.
+
+  uint32_t zeroCopySent = 0;
+  uint32_t zeroCopyCompleted = 0;
+  // The kernel numbers the MSG_ZEROCOPY sends on a socket consecutively, and reports ranges of
+  // them as complete on the socket's error queue. These count the sends made so far and how many
+  // of them have been reported complete. (Both wrap around together.)
+
+  static constexpr Duration ZEROCOPY_ABANDON_TIMEOUT = 30 * SECONDS;
+  // How long to keep collecting completions for the sends of a canceled zero-copy write.
+
+  Maybe<Promise<void>> abandonedZeroCopySends;
+  // Collects completions for the sends of a canceled zero-copy write. See abandonZeroCopySends().
+
+  bool collectingAbandonedZeroCopySends = false;
+#endif
+
+  Promise<void> observeWriteDisconnected() {
+#if KJ_HAS_ZEROCOPY_SEND
+    return observer.whenWriteDisconnected().then([this]() -> Promise<void> {
+      if (zeroCopySent == 0) return READY_NOW;
+
+      // Zero-copy completions arrive as EPOLLERR, which FdObserver can't tell apart from a real
+      // error. Collect any pending completions, then see whether the socket still reports an
+      // error or hangup.
+      receiveZeroCopyCompletions();
+      auto next = observeWriteDisconnected();
+
+      struct pollfd pollfd;
+      memset(&pollfd, 0, sizeof(pollfd));
+      pollfd.fd = fd;
+      KJ_SYSCALL(::poll(&pollfd, 1, 0));
+      if (pollfd.revents & (POLLHUP | POLLERR)) {
+        return READY_NOW;
+      } else {
+        return kj::mv(next);
+      }
+    });
+#else
+    return observer.whenWriteDisconnected();
+#endif
+  }
+
   Promise<ReadResult> tryReadInternal(void* buffer, size_t minBytes, size_t maxBytes,
                                       AutoCloseFd* fdBuffer, size_t maxFds,
                                       ReadResult alreadyRead) {
@@ -564,6 +722,14 @@ private:
     // maxBytes, and buffer have already been adjusted to account for them, but this count must
     // be included in the final return value.
 
+#if KJ_USE_IO_URING
+    if (maxFds == 0 && ancillaryMsgCallback == kj::none) {
+      KJ_IF_SOME(ring, ioUring) {
+        return tryReadIoUring(ring, buffer, minBytes, maxBytes, alreadyRead);
+      }
+    }
+#endif
+
     ssize_t n;
     if (maxFds == 0 && ancillaryMsgCallback == kj::none) {
       KJ_NONBLOCKING_SYSCALL(n = ::read(fd, buffer, maxBytes)) {
@@ -752,6 +918,24 @@ private:
   Promise<void> writeInternal(ArrayPtr<const byte> firstPiece,
                               ArrayPtr<const ArrayPtr<const byte>> morePieces,
                               ArrayPtr<const int> fds) {
+#if KJ_HAS_ZEROCOPY_SEND
+    if (zeroCopySend && fds.size() == 0) {
+      size_t total = firstPiece.size();
+      for (auto& piece: morePieces) total += piece.size();
+      if (total >= ZEROCOPY_MIN_BYTES) {
+        return startZeroCopyWrite(firstPiece, morePieces);
+      }
+    }
+#endif
+
+#if KJ_USE_IO_URING
+    if (fds.size() == 0) {
+      KJ_IF_SOME(ring, ioUring) {
+        return writeIoUring(ring, firstPiece, morePieces);
+      }
+    }
+#endif
+
     const size_t iovmax = kj::miniposix::iovMax();
     // If there are more than IOV_MAX pieces, we'll only write the first IOV_MAX for now, and
     // then we'll loop later.
@@ -878,6 +1062,318 @@ private:
       }
     }
   }
+
+#if KJ_HAS_ZEROCOPY_SEND
+  class ZeroCopyWriteGuard {
+    // Attached to a zero-copy write. If the write is canceled or fails, the kernel may still be
+    // reading the caller's buffers. Waiting for it to let go could take forever, so instead we
+    // hand the outstanding sends over to a task on the event loop.
+
+  public:
+    ZeroCopyWriteGuard(AsyncStreamFd& stream): stream(stream) {}
+    ~ZeroCopyWriteGuard() noexcept(false) {
+      if (!done) stream.abandonZeroCopySends();
+    }
+
+    bool done = false;
+
+  private:
+    AsyncStreamFd& stream;
+  };
+
+  Promise<void> startZeroCopyWrite(ArrayPtr<const byte> firstPiece,
+                                   ArrayPtr<const ArrayPtr<const byte>> morePieces) {
+    auto guard = heap<ZeroCopyWriteGuard>(*this);
+    auto& guardRef = *guard;
+    return writeZeroCopy(firstPiece, morePieces)
+        .then([&guardRef]() { guardRef.done = true; })
+        .attach(kj::mv(guard));
+  }
+
+  void abandonZeroCopySends() {
+    // Called when a zero-copy write goes away before the kernel has released its buffers. Data
+    // the kernel hasn't transmitted yet keeps its pages pinned until the peer acknowledges it,
+    // which a stalled peer may never do, so we can't wait for that here. Instead, collect the
+    // completions as the event port reports them, giving up after ZEROCOPY_ABANDON_TIMEOUT.
+
+    receiveZeroCopyCompletions();
+    if (zeroCopyCompleted == zeroCopySent || collectingAbandonedZeroCopySends) return;
+
+    // An FdObserver only tracks one writability waiter, and the stream's own belongs to whatever
+    // gets written next, so watch a duplicate of the socket. The task belongs to this stream, so
+    // the duplicate doesn't keep the connection open after the stream is gone.
+    int dupFd;
+    KJ_SYSCALL(dupFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0));
+    AutoCloseFd ownDupFd(dupFd);
+    auto dupObserver = heap<UnixEventPort::FdObserver>(
+        eventPort, dupFd, UnixEventPort::FdObserver::OBSERVE_WRITE);
+
+    auto timeout = eventPort.getTimer().afterDelay(ZEROCOPY_ABANDON_TIMEOUT)
+        .then([this]() {
+      KJ_LOG(WARNING, "kernel still hasn't released the buffers of a canceled zero-copy write",
+          zeroCopySent - zeroCopyCompleted);
+    });
+
+    collectingAbandonedZeroCopySends = true;
+    abandonedZeroCopySends = collectAbandonedZeroCopySends(*dupObserver)
+        .exclusiveJoin(kj::mv(timeout))
+        // Attachments are destroyed last to first, so the observer goes before its fd.
+        .attach(kj::mv(ownDupFd), kj::mv(dupObserver))
+        .then([this]() { collectingAbandonedZeroCopySends = false; })
+        .eagerlyEvaluate([this](Exception&& e) {
+      collectingAbandonedZeroCopySends = false;
+      KJ_LOG(ERROR, "failed to collect zero-copy completions", e);
+    });
+  }
+
+  Promise<void> collectAbandonedZeroCopySends(UnixEventPort::FdObserver& dupObserver) {
+    receiveZeroCopyCompletions();
+    if (zeroCopyCompleted == zeroCopySent) {
+      return READY_NOW;
+    }
+
+    return dupObserver.whenBecomesWritable().then([this, &dupObserver]() {
+      return collectAbandonedZeroCopySends(dupObserver);
+    });
+  }
+
+  Promise<void> writeZeroCopy(ArrayPtr<const byte> firstPiece,
+                              ArrayPtr<const ArrayPtr<const byte>> morePieces) {
+    // Like writeInternal() without FDs, but passes MSG_ZEROCOPY so that the kernel sends straight
+    // out of the caller's buffers. Once everything has been handed to the kernel, waits for it to
+    // report that it has released them.
+
+    const size_t iovmax = kj::miniposix::iovMax();
+    KJ_STACK_ARRAY(struct iovec, iov, kj::min(1 + morePieces.size(), iovmax), 16, 128);
+    size_t iovTotal = 0;
+
+    // sendmsg() interface is not const-correct.  :(
+    iov[0].iov_base = const_cast<byte*>(firstPiece.begin());
+    iov[0].iov_len = firstPiece.size();
+    iovTotal += iov[0].iov_len;
+    for (uint i = 1; i < iov.size(); i++) {
+      iov[i].iov_base = const_cast<byte*>(morePieces[i - 1].begin());
+      iov[i].iov_len = morePieces[i - 1].size();
+      iovTotal += iov[i].iov_len;
+    }
+
+    if (iovTotal == 0) {
+      return whenZeroCopySendsComplete();
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov.begin();
+    msg.msg_iovlen = iov.size();
+
+    ssize_t n;
+    KJ_SYSCALL_HANDLE_ERRORS(n = ::sendmsg(fd, &msg, MSG_ZEROCOPY)) {
+      case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+      case EWOULDBLOCK:
+#endif
+        return observer.whenBecomesWritable().then([=,this]() {
+          return writeZeroCopy(firstPiece, morePieces);
+        });
+      case ENOBUFS:
+        // Un-acknowledged zero-copy sends are charged against the socket's optmem limit. Let the
+        // outstanding ones complete, or if there are none, give up on zero-copy for this socket.
+        if (zeroCopyCompleted == zeroCopySent) {
+          zeroCopySend = false;
+          return writeInternal(firstPiece, morePieces, nullptr);
+        }
+        return whenZeroCopySendsComplete().then([=,this]() {
+          return writeZeroCopy(firstPiece, morePieces);
+        });
+      default:
+        KJ_FAIL_SYSCALL("sendmsg(MSG_ZEROCOPY)", error);
+    }
+
+    KJ_ASSERT(n > 0, "non-empty sendmsg() returned 0");
+    ++zeroCopySent;
+
+    // Discard all data that was written, then issue a new write for what's left (if any).
+    for (;;) {
+      if (n < firstPiece.size()) {
+        // As with writeInternal(), a short write doesn't necessarily mean the buffer is full.
+        return writeZeroCopy(firstPiece.slice(n, firstPiece.size()), morePieces);
+      } else if (morePieces.size() == 0) {
+        KJ_DASSERT(n == firstPiece.size(), n);
+        return whenZeroCopySendsComplete();
+      } else {
+        n -= firstPiece.size();
+        firstPiece = morePieces[0];
+        morePieces = morePieces.slice(1, morePieces.size());
+      }
+    }
+  }
+
+  Promise<void> whenZeroCopySendsComplete() {
+    receiveZeroCopyCompletions();
+    if (zeroCopyCompleted == zeroCopySent) {
+      return READY_NOW;
+    }
+
+    // The kernel raises EPOLLERR when it queues a completion, which FdObserver reports as
+    // writability.
+    return observer.whenBecomesWritable().then([this]() {
+      return whenZeroCopySendsComplete();
+    });
+  }
+
+  void receiveZeroCopyCompletions() {
+    // Drains MSG_ZEROCOPY completion notifications from the socket's error queue.
+
+    for (;;) {
+      void* controlSpace[16];
+      // Room for a cmsghdr, a sock_extended_err, and the offender address, aligned as cmsghdr
+      // requires.
+
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = controlSpace;
+      msg.msg_controllen = sizeof(controlSpace);
+
+      ssize_t n;
+      KJ_NONBLOCKING_SYSCALL(n = ::recvmsg(fd, &msg, MSG_ERRQUEUE)) {
+        return;
+      }
+      if (n < 0) {
+        // The queue is empty.
+        return;
+      }
+
+      for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+           cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+            !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+          continue;
+        }
+
+        struct sock_extended_err err;
+        memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+        if (err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0) {
+          continue;
+        }
+
+        // ee_info..ee_data is the inclusive range of sends that completed.
+        zeroCopyCompleted += err.ee_data - err.ee_info + 1;
+
+        if (err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+          // The kernel ended up copying the data anyway (e.g. on loopback, or for a device without
+          // scatter-gather support), so zero-copy only added overhead. As the kernel docs
+          // suggest, stop asking for it.
+          zeroCopySend = false;
+        }
+      }
+    }
+  }
+#endif  // KJ_HAS_ZEROCOPY_SEND
+
+#if KJ_USE_IO_URING
+  Promise<ReadResult> tryReadIoUring(UnixEventPort::IoUring& ring,
+                                     void* buffer, size_t minBytes, size_t maxBytes,
+                                     ReadResult alreadyRead) {
+    auto promise = ring.recv(fd, arrayPtr(reinterpret_cast<byte*>(buffer), maxBytes));
+    return promise.then([this,buffer,minBytes,maxBytes,alreadyRead](int n) mutable
+                        -> Promise<ReadResult> {
+      if (n < 0) {
+        switch (-n) {
+          case ENOTSOCK:
+            // Probably a pipe. io_uring's plain read operation honors O_NONBLOCK, so it would
+            // buy us nothing over the epoll path; use that for this stream from now on.
+            ioUring = kj::none;
+            return tryReadInternal(buffer, minBytes, maxBytes, nullptr, 0, alreadyRead);
+          case EINTR:
+            return tryReadInternal(buffer, minBytes, maxBytes, nullptr, 0, alreadyRead);
+          case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+          case EWOULDBLOCK:
+#endif
+            return observer.whenBecomesReadable().then([=,this]() {
+              return tryReadInternal(buffer, minBytes, maxBytes, nullptr, 0, alreadyRead);
+            });
+          default:
+            KJ_FAIL_SYSCALL("recv(io_uring)", -n);
+        }
+      } else if (n == 0) {
+        // EOF -OR- maxBytes == 0.
+        return alreadyRead;
+      } else if (implicitCast<size_t>(n) >= minBytes) {
+        alreadyRead.byteCount += n;
+        return alreadyRead;
+      } else {
+        // Short read; keep going. Unlike the epoll path, this doesn't cost a wasted syscall when
+        // the buffer turns out to be empty, since the kernel just waits for more data.
+        buffer = reinterpret_cast<byte*>(buffer) + n;
+        minBytes -= n;
+        maxBytes -= n;
+        alreadyRead.byteCount += n;
+        return tryReadInternal(buffer, minBytes, maxBytes, nullptr, 0, alreadyRead);
+      }
+    });
+  }
+
+  Promise<void> writeIoUring(UnixEventPort::IoUring& ring,
+                             ArrayPtr<const byte> firstPiece,
+                             ArrayPtr<const ArrayPtr<const byte>> morePieces) {
+    // If there are more than IOV_MAX pieces, we'll only write the first IOV_MAX for now, and
+    // then we'll loop later.
+    KJ_STACK_ARRAY(ArrayPtr<const byte>, pieces,
+        kj::min(1 + morePieces.size(), kj::miniposix::iovMax()), 16, 128);
+    size_t total = 0;
+
+    pieces[0] = firstPiece;
+    total += firstPiece.size();
+    for (uint i = 1; i < pieces.size(); i++) {
+      pieces[i] = morePieces[i - 1];
+      total += pieces[i].size();
+    }
+
+    if (total == 0) {
+      return kj::READY_NOW;
+    }
+
+    return ring.send(fd, pieces)
+        .then([this,firstPiece,morePieces](int n) mutable -> Promise<void> {
+      if (n < 0) {
+        switch (-n) {
+          case ENOTSOCK:
+            // See comment in tryReadIoUring().
+            ioUring = kj::none;
+            return writeInternal(firstPiece, morePieces, nullptr);
+          case EINTR:
+            return writeInternal(firstPiece, morePieces, nullptr);
+          case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+          case EWOULDBLOCK:
+#endif
+            return observer.whenBecomesWritable().then([=,this]() {
+              return writeInternal(firstPiece, morePieces, nullptr);
+            });
+          default:
+            KJ_FAIL_SYSCALL("sendmsg(io_uring)", -n);
+        }
+      }
+
+      KJ_ASSERT(n > 0, "non-empty sendmsg() returned 0");
+
+      // Discard all data that was written, then issue a new write for what's left (if any).
+      for (;;) {
+        if (implicitCast<size_t>(n) < firstPiece.size()) {
+          return writeInternal(firstPiece.slice(n, firstPiece.size()), morePieces, nullptr);
+        } else if (morePieces.size() == 0) {
+          KJ_DASSERT(n == firstPiece.size(), n);
+          return READY_NOW;
+        } else {
+          n -= firstPiece.size();
+          firstPiece = morePieces[0];
+          morePieces = morePieces.slice(1, morePieces.size());
+        }
+      }
+    });
+  }
+#endif  // KJ_USE_IO_URING
 };
 
 #if __linux__ && !__ANDROID__
@@ -1317,6 +1813,9 @@ public:
                        UnixEventPort& eventPort, int fd,
                        LowLevelAsyncIoProvider::NetworkFilter& filter, uint flags)
       : OwnedFileDescriptor(fd, flags), lowLevel(lowLevel), eventPort(eventPort), filter(filter),
+#if KJ_USE_IO_URING
+        ioUring(eventPort.getIoUring()),
+#endif
         observer(eventPort, fd, UnixEventPort::FdObserver::OBSERVE_READ) {}
 
   Promise<Own<AsyncIoStream>> accept() override {
@@ -1328,6 +1827,12 @@ public:
   }
 
   Promise<AuthenticatedStream> acceptImpl(bool authenticated) {
+#if KJ_USE_IO_URING
+    KJ_IF_SOME(ring, ioUring) {
+      return acceptIoUring(ring, authenticated);
+    }
+#endif
+
     int newFd;
 
     struct sockaddr_storage addr;
@@ -1342,38 +1847,8 @@ public:
 #endif
 
     if (newFd >= 0) {
-      kj::AutoCloseFd ownFd(newFd);
-      if (!filter.shouldAllow(reinterpret_cast<struct sockaddr*>(&addr), addrlen)) {
-        // Ignore disallowed address.
-        return acceptImpl(authenticated);
-      } else {
-        // TODO(perf):  As a hack for the 0.4 release we are always setting
-        //   TCP_NODELAY because Nagle's algorithm pretty much kills Cap'n Proto's
-        //   RPC protocol.  Later, we should extend the interface to provide more
-        //   control over this.  Perhaps write() should have a flag which
-        //   specifies whether to pass MSG_MORE.
-        int one = 1;
-        KJ_SYSCALL_HANDLE_ERRORS(::setsockopt(
-              ownFd.get(), IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(one))) {
-          case EOPNOTSUPP:
-          case ENOPROTOOPT: // (returned for AF_UNIX in cygwin)
-#if __FreeBSD__
-          case EINVAL: // (returned for AF_UNIX in FreeBSD)
-#endif
-            break;
-          default:
-            KJ_FAIL_SYSCALL("setsocketopt(IPPROTO_TCP, TCP_NODELAY)", error);
-        }
-
-        AuthenticatedStream result;
-        result.stream = heap<AsyncStreamFd>(eventPort, ownFd.release(), NEW_FD_FLAGS,
-                                            UnixEventPort::FdObserver::OBSERVE_READ_WRITE);
-        if (authenticated) {
-          result.peerIdentity = SocketAddress(reinterpret_cast<struct sockaddr*>(&addr), addrlen)
-              .getIdentity(lowLevel, filter, *result.stream);
-        }
-        return kj::mv(result);
-      }
+      return wrapAccepted(kj::AutoCloseFd(newFd), reinterpret_cast<struct sockaddr*>(&addr),
+                          addrlen, authenticated);
     } else {
       int error = errno;
 
@@ -1387,30 +1862,109 @@ public:
             return acceptImpl(authenticated);
           });
 
-        case EINTR:
-        case ENETDOWN:
+        default:
+          if (isTransientAcceptError(error)) goto retry;
+          KJ_FAIL_SYSCALL("accept", error);
+      }
+
+    }
+  }
+
+  static bool isTransientAcceptError(int error) {
+    switch (error) {
+      case EINTR:
+      case ENETDOWN:
 #ifdef EPROTO
-        // EPROTO is not defined on OpenBSD.
-        case EPROTO:
+      // EPROTO is not defined on OpenBSD.
+      case EPROTO:
 #endif
-        case EHOSTDOWN:
-        case EHOSTUNREACH:
-        case ENETUNREACH:
-        case ECONNABORTED:
-        case ETIMEDOUT:
-          // According to the Linux man page, accept() may report an error if the accepted
-          // connection is already broken.  In this case, we really ought to just ignore it and
-          // keep waiting.  But it's hard to say exactly what errors are such network errors and
-          // which ones are permanent errors.  We've made a guess here.
-          goto retry;
+      case EHOSTDOWN:
+      case EHOSTUNREACH:
+      case ENETUNREACH:
+      case ECONNABORTED:
+      case ETIMEDOUT:
+        // According to the Linux man page, accept() may report an error if the accepted
+        // connection is already broken.  In this case, we really ought to just ignore it and
+        // keep waiting.  But it's hard to say exactly what errors are such network errors and
+        // which ones are permanent errors.  We've made a guess here.
+        return true;
+      default:
+        return false;
+    }
+  }
 
+  Promise<AuthenticatedStream> wrapAccepted(kj::AutoCloseFd ownFd,
+                                            struct sockaddr* addr, socklen_t addrlen,
+                                            bool authenticated) {
+    if (!filter.shouldAllow(addr, addrlen)) {
+      // Ignore disallowed address.
+      return acceptImpl(authenticated);
+    } else {
+      // TODO(perf):  As a hack for the 0.4 release we are always setting
+      //   TCP_NODELAY because Nagle's algorithm pretty much kills Cap'n Proto's
+      //   RPC protocol.  Later, we should extend the interface to provide more
+      //   control over this.  Perhaps write() should have a flag which
+      //   specifies whether to pass MSG_MORE.
+      int one = 1;
+      KJ_SYSCALL_HANDLE_ERRORS(::setsockopt(
+            ownFd.get(), IPPROTO_TCP, TCP_NODELAY, (char*)&one, sizeof(one))) {
+        case EOPNOTSUPP:
+        case ENOPROTOOPT: // (returned for AF_UNIX in cygwin)
+#if __FreeBSD__
+        case EINVAL: // (returned for AF_UNIX in FreeBSD)
+#endif
+          break;
         default:
-          KJ_FAIL_SYSCALL("accept", error);
+          KJ_FAIL_SYSCALL("setsocketopt(IPPROTO_TCP, TCP_NODELAY)", error);
       }
 
+      AuthenticatedStream result;
+      result.stream = heap<AsyncStreamFd>(eventPort, ownFd.release(), NEW_FD_FLAGS,
+                                          UnixEventPort::FdObserver::OBSERVE_READ_WRITE);
+      if (authenticated) {
+        result.peerIdentity = SocketAddress(addr, addrlen)
+            .getIdentity(lowLevel, filter, *result.stream);
+      }
+      return kj::mv(result);
     }
   }
 
+#if KJ_USE_IO_URING
+  Promise<AuthenticatedStream> acceptIoUring(UnixEventPort::IoUring& ring, bool authenticated) {
+    struct AddressBuffer {
+      struct sockaddr_storage addr;
+      uint addrlen = sizeof(addr);
+    };
+    auto buffer = kj::heap<AddressBuffer>();
+    auto promise = ring.accept(fd, reinterpret_cast<struct sockaddr*>(&buffer->addr),
+                               &buffer->addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    return promise.then([this,authenticated,buffer=kj::mv(buffer)](int result) mutable
+                        -> Promise<AuthenticatedStream> {
+      if (result >= 0) {
+        return wrapAccepted(kj::AutoCloseFd(result),
+                            reinterpret_cast<struct sockaddr*>(&buffer->addr),
+                            buffer->addrlen, authenticated);
+      }
+
+      int error = -result;
+      switch (error) {
+        case EAGAIN:
+#if EAGAIN != EWOULDBLOCK
+        case EWOULDBLOCK:
+#endif
+          return observer.whenBecomesReadable().then([this,authenticated]() {
+            return acceptImpl(authenticated);
+          });
+
+        default:
+          if (isTransientAcceptError(error)) return acceptImpl(authenticated);
+          KJ_FAIL_SYSCALL("accept(io_uring)", error);
+      }
+    });
+  }
+#endif  // KJ_USE_IO_URING
+
   uint getPort() override {
     return SocketAddress::getLocalAddress(fd).getPort();
   }
@@ -1433,6 +1987,9 @@ public:
   LowLevelAsyncIoProvider& lowLevel;
   UnixEventPort& eventPort;
   LowLevelAsyncIoProvider::NetworkFilter& filter;
+#if KJ_USE_IO_URING
+  Maybe<UnixEventPort::IoUring&> ioUring;
+#endif
   UnixEventPort::FdObserver observer;
 };
 
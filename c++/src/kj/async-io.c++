@@ -229,6 +229,11 @@ Maybe<Promise<uint64_t>> AsyncOutputStream::tryPumpFrom(
   return kj::none;
 }
 
+Promise<void> AsyncOutputStream::writeWithAncillary(
+    ArrayPtr<const byte> data, ArrayPtr<const AncillaryMessage> messages) {
+  KJ_UNIMPLEMENTED("writeWithAncillary is not implemented by this AsyncOutputStream");
+}
+
 namespace {
 
 class AsyncPipe final: public AsyncCapabilityStream, public Refcounted {
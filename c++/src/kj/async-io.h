@@ -124,6 +124,15 @@ public:
   //
   // The default implementation always returns null.
 
+  virtual Promise<void> writeWithAncillary(
+      ArrayPtr<const byte> data, ArrayPtr<const AncillaryMessage> messages);
+  // Write `data` together with the given ancillary messages (aka control messages), as with the
+  // sendmsg() system call. This is the write-side counterpart of
+  // AsyncInputStream::registerAncillaryMessageHandler(). `data` must not be empty. The messages
+  // accompany the first system call that sends any of `data`; if the kernel accepts only part of
+  // it, the rest is written as a regular write().
+  // Only supported on Unix (the default impl throws UNIMPLEMENTED). Most apps will not use this.
+
   virtual Promise<void> whenWriteDisconnected() = 0;
   // Returns a promise that resolves when the stream has become disconnected such that new write()s
   // will fail with a DISCONNECTED exception. This is particularly useful, for example, to cancel
@@ -815,13 +824,32 @@ public:
     // On Linux, all system calls which yield new file descriptors have flags or variants which
     // set the close-on-exec flag immediately.  Unfortunately, other OS's do not.
 
-    ALREADY_NONBLOCK = 1 << 2
+    ALREADY_NONBLOCK = 1 << 2,
     // Indicates that the file descriptor is known already to be in non-blocking mode, so the flag
     // need not be set again.  Otherwise, all wrap*Fd() methods will enable non-blocking mode
     // automatically.
     //
     // On Linux, all system calls which yield new file descriptors have flags or variants which
     // enable non-blocking mode immediately.  Unfortunately, other OS's do not.
+
+    ZEROCOPY_SEND = 1 << 3
+    // Linux only (ignored elsewhere): send large writes on a socket with MSG_ZEROCOPY, so that the
+    // kernel transmits directly out of the caller's buffers rather than copying them. A
+    // zero-copy write's promise resolves only once the kernel reports that it has released the
+    // buffers, not merely when the data has been queued. If such a write is canceled or fails
+    // while the kernel still holds the buffers, destroying the promise does not wait: the kernel
+    // keeps transmitting out of the buffers until the peer acknowledges the data, so the caller
+    // must not fill that memory with anything it wouldn't send on this connection. Meanwhile,
+    // the stream collects the outstanding completions in the background for up to 30 seconds.
+    //
+    // Writes under 16KiB, and writes carrying file descriptors, are copied as usual, since
+    // pinning pages costs more than copying that little. If the socket doesn't support
+    // zero-copy (among stream sockets, only TCP does), this flag has no effect. If the kernel
+    // reports that it had to copy the data anyway (e.g. over loopback), the stream stops
+    // requesting zero-copy.
+    //
+    // The same mode can be enabled on an existing stream by calling its
+    // setsockopt(SOL_SOCKET, SO_ZEROCOPY, ...).
 #endif
   };
 
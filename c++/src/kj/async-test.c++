@@ -21,9 +21,12 @@
 
 #include "async.h"
 #include "debug.h"
+#include "timer.h"
+#include "vector.h"
 #include <kj/compat/gtest.h>
 #include "mutex.h"
 #include "thread.h"
+#include <algorithm>
 
 #if !_WIN32
 #include <errno.h>
@@ -1847,5 +1850,104 @@ KJ_TEST("constPromise") {
   KJ_EXPECT(i == 123);
 }
 
+KJ_TEST("TimerImpl fires timers in time order across wheel levels") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  TimerImpl timer(origin<TimePoint>() + 12345 * MILLISECONDS);
+  auto start = timer.now();
+
+  struct Expected {
+    TimePoint time;
+    uint index;
+  };
+  Vector<Expected> expected;
+  Vector<uint> fired;
+  Vector<Promise<void>> promises;
+
+  Duration delays[] = {
+    0 * SECONDS, 1 * NANOSECONDS, 500 * MICROSECONDS, 1 * MILLISECONDS, 1 * MILLISECONDS,
+    65 * MILLISECONDS, 5 * SECONDS, 5 * SECONDS, 10 * 60 * SECONDS, 3 * 24 * 3600 * SECONDS,
+    -10 * MILLISECONDS, 4100 * MILLISECONDS, 64 * MILLISECONDS, 2 * 3600 * SECONDS,
+  };
+  for (auto delay: delays) {
+    uint index = expected.size();
+    auto time = start + delay;
+    expected.add(Expected { time, index });
+    promises.add(timer.atTime(time).then([&fired, &timer, time, index]() {
+      KJ_EXPECT(timer.now() >= time);
+      fired.add(index);
+    }).eagerlyEvaluate(nullptr));
+  }
+
+  std::stable_sort(expected.begin(), expected.end(), [](const Expected& a, const Expected& b) {
+    return a.time < b.time;
+  });
+
+  // Advance in uneven steps, including ones that land exactly on timer times.
+  auto now = start;
+  Duration steps[] = {
+    0 * SECONDS, 1 * NANOSECONDS, 1 * MILLISECONDS, 63 * MILLISECONDS, 1 * MILLISECONDS,
+    5 * SECONDS, 3600 * SECONDS, 4 * 24 * 3600 * SECONDS,
+  };
+  for (auto step: steps) {
+    now = now + step;
+    timer.advanceTo(now);
+    waitScope.poll();
+
+    for (auto& e: expected) {
+      bool shouldHaveFired = e.time <= now;
+      bool hasFired = false;
+      for (auto f: fired) {
+        if (f == e.index) hasFired = true;
+      }
+      KJ_EXPECT(hasFired == shouldHaveFired, e.index, (e.time - start) / NANOSECONDS);
+    }
+  }
+
+  KJ_ASSERT(fired.size() == expected.size());
+  for (auto i: kj::indices(expected)) {
+    KJ_EXPECT(fired[i] == expected[i].index, i);
+  }
+  KJ_EXPECT(timer.nextEvent() == kj::none);
+}
+
+KJ_TEST("TimerImpl cancellation and nextEvent()") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  TimerImpl timer(origin<TimePoint>());
+  auto start = timer.now();
+
+  uint firedCount = 0;
+  Duration lastKept = 0 * SECONDS;
+  Vector<Promise<void>> promises;
+  for (uint i = 0; i < 10000; i++) {
+    auto delay = (i * 7919 % 100000) * MILLISECONDS + 1 * SECONDS;
+    if (i % 10 == 0) lastKept = kj::max(lastKept, delay);
+    promises.add(timer.afterDelay(delay).then([&]() { ++firedCount; }).eagerlyEvaluate(nullptr));
+  }
+
+  // Cancel everything except every tenth timer.
+  Vector<Promise<void>> kept;
+  for (auto i: kj::indices(promises)) {
+    if (i % 10 == 0) kept.add(kj::mv(promises[i]));
+  }
+  promises.clear();
+
+  // nextEvent() may give an early estimate, but must never overshoot, and repeatedly advancing to
+  // it must reach every event.
+  uint wakeups = 0;
+  while (timer.nextEvent() != kj::none) {
+    auto next = KJ_ASSERT_NONNULL(timer.nextEvent());
+    KJ_ASSERT(next >= timer.now());
+    timer.advanceTo(next);
+    waitScope.poll();
+    ++wakeups;
+  }
+
+  KJ_EXPECT(firedCount == 1000);
+  KJ_EXPECT(wakeups < 2000, wakeups);
+  KJ_EXPECT(timer.now() == start + lastKept, (timer.now() - start) / MILLISECONDS);
+}
+
 }  // namespace
 }  // namespace kj
@@ -36,6 +36,12 @@
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/timerfd.h>
+#if KJ_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#endif
 #elif KJ_USE_KQUEUE
 #include <sys/event.h>
 #include <fcntl.h>
@@ -544,6 +550,13 @@ void UnixEventPort::wake() const {
 bool UnixEventPort::wait() {
   sleeping = false;
 
+#if KJ_USE_IO_URING
+  KJ_IF_SOME(ring, ioUring) {
+    // Submit all I/O started during this turn of the event loop.
+    ring->submit();
+  }
+#endif
+
 #ifdef KJ_DEBUG
   // In debug mode, verify the current signal mask matches the original.
   {
@@ -662,6 +675,11 @@ bool UnixEventPort::processEpollEvents(struct epoll_event events[], int n) {
       // The purpose of this event is just to wake up the event loop when needed. We'll check the
       // timer queue separately, so we don't need to do anything special in response to this event
       // here.
+#if KJ_USE_IO_URING
+    } else if (events[i].data.u64 == 2) {
+      // io_uring has posted completions.
+      KJ_ASSERT_NONNULL(ioUring)->processCompletions();
+#endif
     } else {
       FdObserver* observer = reinterpret_cast<FdObserver*>(events[i].data.ptr);
       observer->fire(events[i].events);
@@ -722,6 +740,12 @@ bool UnixEventPort::poll() {
     }
   }
 
+#if KJ_USE_IO_URING
+  KJ_IF_SOME(ring, ioUring) {
+    ring->submit();
+  }
+#endif
+
   struct epoll_event events[16];
   int n;
   KJ_SYSCALL(n = epoll_wait(epollFd, events, kj::size(events), 0));
@@ -737,6 +761,12 @@ void UnixEventPort::preparePollableFdForSleep() {
   KJ_ASSERT(signalHead == nullptr,
       "preparePollableFdForSleep() cannot be used when waiting for signals");
 
+#if KJ_USE_IO_URING
+  KJ_IF_SOME(ring, ioUring) {
+    ring->submit();
+  }
+#endif
+
   if (runnable) {
     // There is still immediate work in the queue, so force the epoll to be ready immediately. (See
     // comments in setRunnable() regarding using wake() for this.)
@@ -808,6 +838,314 @@ kj::TimePoint UnixEventPort::getTimeWhileSleeping() {
   return clock.now();
 }
 
+#if KJ_USE_IO_URING
+// =======================================================================================
+// io_uring implementation
+
+namespace {
+
+int ioUringSetup(uint entries, struct io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(int ringFd, uint toSubmit, uint minComplete, uint flags) {
+  return syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+class RingMmapDisposer: public ArrayDisposer {
+protected:
+  void disposeImpl(void* firstElement, size_t elementSize, size_t elementCount,
+                   size_t capacity, void (*destroyElement)(void*)) const override {
+    KJ_SYSCALL(munmap(firstElement, elementSize * elementCount)) { break; }
+  }
+};
+
+constexpr RingMmapDisposer ringMmapDisposer = RingMmapDisposer();
+
+Array<byte> mapRing(int ringFd, size_t size, off_t offset) {
+  void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ringFd, offset);
+  if (mapping == MAP_FAILED) {
+    KJ_FAIL_SYSCALL("mmap(io_uring)", errno, size, offset);
+  }
+  return Array<byte>(reinterpret_cast<byte*>(mapping), size, ringMmapDisposer);
+}
+
+template <typename T>
+T* ringField(ArrayPtr<byte> ring, uint offset) {
+  return reinterpret_cast<T*>(ring.begin() + offset);
+}
+
+}  // namespace
+
+class UnixEventPort::IoUring::Op {
+  // Promise adapter for a single io_uring operation. The operation's `user_data` points back at
+  // this object, so the kernel must be done with it before it is destroyed.
+
+public:
+  template <typename Prepare>
+  Op(PromiseFulfiller<int>& fulfiller, IoUring& ring, Prepare&& prepare)
+      : fulfiller(fulfiller), ring(ring) {
+    auto& sqe = ring.nextSqe();
+    prepare(sqe, *this);
+    sqe.user_data = reinterpret_cast<uintptr_t>(this);
+    ring.commitSqe();
+    ++ring.inFlight;
+  }
+
+  ~Op() noexcept(false) {
+    if (!done) {
+      ring.cancel(*this);
+    }
+  }
+
+  void complete(int result) {
+    done = true;
+    --ring.inFlight;
+    if (!canceling) {
+      fulfiller.fulfill(kj::cp(result));
+    }
+  }
+
+  struct msghdr msg;
+  Array<struct iovec> iov;
+  // Space for operations which need to pass the kernel more than fits in the SQE.
+
+private:
+  PromiseFulfiller<int>& fulfiller;
+  IoUring& ring;
+  bool done = false;
+  bool canceling = false;
+
+  friend class IoUring;
+};
+
+bool UnixEventPort::enableIoUring(uint entries) {
+  if (ioUring != kj::none) return true;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int fd = ioUringSetup(entries, &params);
+  if (fd < 0) {
+    int error = errno;
+    switch (error) {
+      case ENOSYS:  // kernel built without io_uring
+      case EPERM:   // disabled via the kernel.io_uring_disabled sysctl
+      case EACCES:  // disabled by an LSM
+      case ENOMEM:  // old kernels charge rings against RLIMIT_MEMLOCK
+        return false;
+      default:
+        KJ_FAIL_SYSCALL("io_uring_setup()", error, entries);
+    }
+  }
+  AutoCloseFd ownFd(fd);
+
+  // NODROP: Completions are never lost when the completion queue fills up. We don't bound the
+  //   number of operations in flight, so we depend on this.
+  // FAST_POLL: Socket operations that can't complete immediately wait for readiness inside the
+  //   kernel, rather than tying up a worker thread. This also implies that the send, recv, and
+  //   accept opcodes are available.
+  constexpr uint REQUIRED_FEATURES = IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+  if ((params.features & REQUIRED_FEATURES) != REQUIRED_FEATURES) {
+    return false;
+  }
+
+  auto ring = kj::heap<IoUring>(ownFd.release(), &params);
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.u64 = 2;
+  KJ_SYSCALL(epoll_ctl(epollFd, EPOLL_CTL_ADD, ring->ringFd, &event));
+
+  ioUring = kj::mv(ring);
+  return true;
+}
+
+kj::Maybe<UnixEventPort::IoUring&> UnixEventPort::getIoUring() {
+  KJ_IF_SOME(ring, ioUring) {
+    return *ring;
+  } else {
+    return kj::none;
+  }
+}
+
+UnixEventPort::IoUring::IoUring(int fd, const void* paramsPtr)
+    : ringFd(fd) {
+  auto& params = *reinterpret_cast<const struct io_uring_params*>(paramsPtr);
+
+  size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(uint);
+  size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sqRing = mapRing(ringFd, kj::max(sqSize, cqSize), IORING_OFF_SQ_RING);
+  } else {
+    sqRing = mapRing(ringFd, sqSize, IORING_OFF_SQ_RING);
+    cqRing = mapRing(ringFd, cqSize, IORING_OFF_CQ_RING);
+  }
+  sqeArray = mapRing(ringFd, params.sq_entries * sizeof(struct io_uring_sqe), IORING_OFF_SQES);
+  sqes = reinterpret_cast<struct io_uring_sqe*>(sqeArray.begin());
+
+  sqHead = ringField<uint>(sqRing, params.sq_off.head);
+  sqTail = ringField<uint>(sqRing, params.sq_off.tail);
+  sqMask = ringField<uint>(sqRing, params.sq_off.ring_mask);
+  sqFlags = ringField<uint>(sqRing, params.sq_off.flags);
+  sqArray = ringField<uint>(sqRing, params.sq_off.array);
+  sqEntries = params.sq_entries;
+
+  ArrayPtr<byte> cq = cqRing.size() == 0 ? sqRing.asPtr() : cqRing.asPtr();
+  cqHead = ringField<uint>(cq, params.cq_off.head);
+  cqTail = ringField<uint>(cq, params.cq_off.tail);
+  cqMask = ringField<uint>(cq, params.cq_off.ring_mask);
+  cqes = ringField<struct io_uring_cqe>(cq, params.cq_off.cqes);
+}
+
+UnixEventPort::IoUring::~IoUring() noexcept(false) {
+  KJ_REQUIRE(inFlight == 0, "io_uring destroyed while operations were still in flight") {
+    break;
+  }
+}
+
+struct io_uring_sqe& UnixEventPort::IoUring::nextSqe() {
+  if (*sqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+    // Submission queue is full; we'll have to submit early.
+    submit();
+  }
+
+  uint index = *sqTail & *sqMask;
+  auto& sqe = sqes[index];
+  memset(&sqe, 0, sizeof(sqe));
+  sqArray[index] = index;
+  return sqe;
+}
+
+void UnixEventPort::IoUring::commitSqe() {
+  // The release store guarantees the kernel sees the SQE contents before it sees the new tail.
+  __atomic_store_n(sqTail, *sqTail + 1, __ATOMIC_RELEASE);
+  ++unsubmitted;
+}
+
+void UnixEventPort::IoUring::submit() {
+  while (unsubmitted > 0) {
+    int n = ioUringEnter(ringFd, unsubmitted, 0, 0);
+    if (n < 0) {
+      int error = errno;
+      switch (error) {
+        case EINTR:
+          continue;
+        case EAGAIN:
+        case EBUSY:
+          // The kernel couldn't allocate memory for the requests, or its completion backlog is
+          // full. Either way, draining completions should help.
+          processCompletions();
+          continue;
+        default:
+          KJ_FAIL_SYSCALL("io_uring_enter()", error);
+      }
+    }
+
+    KJ_ASSERT(n > 0, "io_uring_enter() didn't consume any submissions", unsubmitted);
+    unsubmitted -= n;
+  }
+}
+
+void UnixEventPort::IoUring::processCompletions() {
+  for (;;) {
+    uint head = *cqHead;
+    uint tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+#ifdef IORING_SQ_CQ_OVERFLOW
+      if (__atomic_load_n(sqFlags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+        // Completions overflowed into the kernel's backlog. Ask it to move them to the ring.
+        KJ_SYSCALL(ioUringEnter(ringFd, 0, 0, IORING_ENTER_GETEVENTS));
+        continue;
+      }
+#endif
+      break;
+    }
+
+    for (; head != tail; ++head) {
+      auto& cqe = cqes[head & *cqMask];
+      if (cqe.user_data != 0) {
+        reinterpret_cast<Op*>(cqe.user_data)->complete(cqe.res);
+      }
+    }
+
+    __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  }
+}
+
+void UnixEventPort::IoUring::cancel(Op& op) {
+  op.canceling = true;
+
+  auto& sqe = nextSqe();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = reinterpret_cast<uintptr_t>(&op);
+  sqe.user_data = 0;  // We don't care about the cancellation's own completion.
+  commitSqe();
+  submit();
+
+  while (!op.done) {
+    // The kernel may still be using the operation's buffers, so we have no choice but to block
+    // until it confirms the operation has ended. Cancellation of an operation which is merely
+    // waiting for readiness completes promptly.
+    KJ_SYSCALL(ioUringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS));
+    processCompletions();
+  }
+}
+
+Promise<int> UnixEventPort::IoUring::recv(int fd, ArrayPtr<byte> buffer) {
+  return newAdaptedPromise<int, Op>(*this, [&](struct io_uring_sqe& sqe, Op&) {
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(buffer.begin());
+    sqe.len = kj::min(buffer.size(), size_t(std::numeric_limits<int>::max()));
+  });
+}
+
+Promise<int> UnixEventPort::IoUring::send(int fd, ArrayPtr<const ArrayPtr<const byte>> pieces) {
+  return newAdaptedPromise<int, Op>(*this, [&](struct io_uring_sqe& sqe, Op& op) {
+    sqe.fd = fd;
+    sqe.msg_flags = MSG_NOSIGNAL;
+
+    if (pieces.size() == 1) {
+      sqe.opcode = IORING_OP_SEND;
+      sqe.addr = reinterpret_cast<uintptr_t>(pieces[0].begin());
+      sqe.len = kj::min(pieces[0].size(), size_t(std::numeric_limits<int>::max()));
+    } else {
+      op.iov = KJ_MAP(piece, pieces) {
+        struct iovec iov;
+        iov.iov_base = const_cast<byte*>(piece.begin());
+        iov.iov_len = piece.size();
+        return iov;
+      };
+      memset(&op.msg, 0, sizeof(op.msg));
+      op.msg.msg_iov = op.iov.begin();
+      op.msg.msg_iovlen = op.iov.size();
+
+      sqe.opcode = IORING_OP_SENDMSG;
+      sqe.addr = reinterpret_cast<uintptr_t>(&op.msg);
+      sqe.len = 1;
+    }
+  });
+}
+
+Promise<int> UnixEventPort::IoUring::accept(
+    int fd, struct sockaddr* addr, uint* addrlen, int flags) {
+  static_assert(sizeof(socklen_t) == sizeof(uint), "socklen_t is not uint?");
+
+  return newAdaptedPromise<int, Op>(*this, [&](struct io_uring_sqe& sqe, Op&) {
+    sqe.opcode = IORING_OP_ACCEPT;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uintptr_t>(addr);
+    sqe.addr2 = reinterpret_cast<uintptr_t>(addrlen);
+    sqe.accept_flags = flags;
+  });
+}
+
+#endif  // KJ_USE_IO_URING
+
 #elif KJ_USE_KQUEUE
 // =======================================================================================
 // kqueue FdObserver implementation
@@ -47,6 +47,19 @@ KJ_BEGIN_HEADER
 #error "Both KJ_USE_EPOLL and KJ_USE_KQUEUE are set. Please choose only one of these."
 #endif
 
+#if KJ_USE_EPOLL && !defined(KJ_USE_IO_URING)
+#if __has_include(<linux/io_uring.h>)
+// io_uring support is compiled in whenever the kernel headers are available, but it is only used
+// if the application calls `UnixEventPort::enableIoUring()`. Build with `-DKJ_USE_IO_URING=0` to
+// leave it out entirely.
+#define KJ_USE_IO_URING 1
+#endif
+#endif
+
+#if KJ_USE_IO_URING && !KJ_USE_EPOLL
+#error "KJ_USE_IO_URING requires KJ_USE_EPOLL."
+#endif
+
 #if __CYGWIN__ && !defined(KJ_USE_PIPE_FOR_WAKEUP)
 // Cygwin has serious issues with the intersection of signals and threads, reported here:
 //     https://cygwin.com/ml/cygwin/2019-07/msg00052.html
@@ -57,6 +70,11 @@ KJ_BEGIN_HEADER
 
 #if KJ_USE_EPOLL
 struct epoll_event;
+#if KJ_USE_IO_URING
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct sockaddr;
+#endif
 #elif KJ_USE_KQUEUE
 struct kevent;
 struct timespec;
@@ -233,6 +251,37 @@ public:
   // attempting.
 #endif
 
+#if KJ_USE_IO_URING
+  class IoUring;
+  // Completion-based I/O submission queue backed by Linux's io_uring. See definition below.
+
+  bool enableIoUring(uint entries = 256);
+  // Opts this event port into performing stream reads and writes, and socket accepts, through
+  // io_uring. Without io_uring, each such operation costs a readiness notification from epoll
+  // plus at least one read()/write()/accept() syscall; with it, all operations started during one
+  // turn of the event loop are submitted together in a single io_uring_enter() call just before
+  // the loop goes to sleep, and their results are delivered through the same epoll_wait() that
+  // the port was going to make anyway.
+  //
+  // `entries` is the size of the submission queue, i.e. the maximum number of operations that
+  // can be batched before an early submission is forced. It does not limit the number of
+  // operations in flight.
+  //
+  // Only streams and listeners created (by `LowLevelAsyncIoProvider`) after this call use
+  // io_uring; to cover everything, call it right after constructing the port, e.g.:
+  //
+  //     auto io = kj::setupAsyncIo();
+  //     io.unixEventPort.enableIoUring();
+  //
+  // Returns false, leaving the port in its normal epoll-only mode, if the kernel does not support
+  // io_uring (or lacks features that KJ relies on), or if io_uring has been disabled by policy
+  // (e.g. the kernel.io_uring_disabled sysctl, or a seccomp filter). Calling this more than once
+  // has no further effect.
+
+  kj::Maybe<IoUring&> getIoUring();
+  // Returns the io_uring previously enabled with `enableIoUring()`, if any.
+#endif
+
   // implements EventPort ------------------------------------------------------
   bool wait() override;
   bool poll() override;
@@ -269,6 +318,10 @@ private:
   bool timerfdIsArmed = false;
 
   bool processEpollEvents(struct epoll_event events[], int n);
+
+#if KJ_USE_IO_URING
+  kj::Maybe<kj::Own<IoUring>> ioUring;
+#endif
 #elif KJ_USE_KQUEUE
   AutoCloseFd kqueueFd;
 
@@ -441,6 +494,91 @@ private:
   friend class UnixEventPort;
 };
 
+#if KJ_USE_IO_URING
+
+class UnixEventPort::IoUring {
+  // Submits socket I/O to the kernel via io_uring and delivers completions through the owning
+  // UnixEventPort. Obtain one with `UnixEventPort::enableIoUring()`. This is a fairly low-level
+  // interface; most applications should simply enable it and then use the usual
+  // `AsyncIoStream` / `ConnectionReceiver` interfaces, which will use it automatically.
+  //
+  // Operations are queued in the submission ring and are not actually submitted until the event
+  // port next polls or sleeps (or `submit()` is called explicitly), so that all I/O started in
+  // one turn of the event loop costs one syscall.
+  //
+  // Each operation returns a promise for the raw result of the operation, as the kernel reported
+  // it: non-negative on success, or a negated errno on failure. Note that io_uring does not
+  // consult the O_NONBLOCK flag for socket operations, so it will not normally return -EAGAIN,
+  // but callers should still handle it (e.g. by falling back to an FdObserver).
+  //
+  // Destroying an operation's promise before it completes cancels the operation and then blocks
+  // until the kernel confirms that it is no longer touching the operation's buffers. Hence,
+  // buffers passed to an operation need only remain valid until the promise either completes or
+  // is destroyed, just like with any other KJ async I/O interface.
+
+public:
+  IoUring(int ringFd, const void* params);
+  // Use `UnixEventPort::enableIoUring()` rather than constructing this directly. `params` is the
+  // `struct io_uring_params` filled in by io_uring_setup().
+
+  ~IoUring() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(IoUring);
+
+  Promise<int> recv(int fd, ArrayPtr<byte> buffer);
+  // Equivalent to recv(fd, buffer.begin(), buffer.size(), 0). `fd` must be a socket; if it is not,
+  // the result is -ENOTSOCK.
+
+  Promise<int> send(int fd, ArrayPtr<const ArrayPtr<const byte>> pieces);
+  // Equivalent to sendmsg() with one iovec per piece and MSG_NOSIGNAL. `pieces` is copied, so it
+  // does not need to outlive the call, but the bytes it points to do. `fd` must be a socket.
+
+  Promise<int> accept(int fd, struct sockaddr* addr, uint* addrlen, int flags);
+  // Equivalent to accept4(fd, addr, addrlen, flags).
+
+  void submit();
+  // Submits all queued operations to the kernel immediately.
+
+  inline uint getInFlightCount() { return inFlight; }
+  // Number of operations that have been started but have not yet completed.
+
+private:
+  class Op;
+
+  AutoCloseFd ringFd;
+
+  // Memory shared with the kernel.
+  Array<byte> sqRing;
+  Array<byte> cqRing;  // empty if the kernel maps both rings together in `sqRing`
+  Array<byte> sqeArray;
+  struct io_uring_sqe* sqes;
+
+  // Pointers into sqRing.
+  uint* sqHead;
+  uint* sqTail;
+  uint* sqMask;
+  uint* sqFlags;
+  uint* sqArray;
+  uint sqEntries;
+
+  // Pointers into cqRing.
+  uint* cqHead;
+  uint* cqTail;
+  uint* cqMask;
+  struct io_uring_cqe* cqes;
+
+  uint unsubmitted = 0;
+  uint inFlight = 0;
+
+  struct io_uring_sqe& nextSqe();
+  void commitSqe();
+  void processCompletions();
+  void cancel(Op& op);
+
+  friend class UnixEventPort;
+};
+
+#endif  // KJ_USE_IO_URING
+
 }  // namespace kj
 
 KJ_END_HEADER
@@ -568,6 +568,69 @@ KJ_TEST("call own thread's executor") {
   }
 }
 
+KJ_TEST("many threads sending to one executor") {
+  // Senders don't take the executor's lock, so check that events from many threads at once all
+  // arrive, in order per thread, and that canceling some doesn't disturb the rest.
+
+  static constexpr uint SENDERS = 16;
+  static constexpr uint EVENTS = 100;
+
+  MutexGuarded<kj::Maybe<const Executor&>> executor;
+  Own<PromiseFulfiller<void>> stop;  // accessed only from the receiving thread
+  Vector<uint> received[SENDERS];  // accessed only from the receiving thread
+
+  Thread thread([&]() noexcept {
+    KJ_XTHREAD_TEST_SETUP_LOOP;
+
+    auto paf = newPromiseAndFulfiller<void>();
+    stop = kj::mv(paf.fulfiller);
+    *executor.lockExclusive() = getCurrentThreadExecutor();
+    paf.promise.wait(waitScope);
+  });
+
+  ([&]() noexcept {
+    const Executor& exec = executor.when(
+        [](const Maybe<const Executor&>& value) { return value != kj::none; },
+        [](const Maybe<const Executor&>& value) -> const Executor& {
+      return KJ_ASSERT_NONNULL(value);
+    });
+
+    {
+      Vector<Own<Thread>> senders;
+      for (uint i = 0; i < SENDERS; i++) {
+        senders.add(heap<Thread>([&, i]() noexcept {
+          KJ_XTHREAD_TEST_SETUP_LOOP;
+
+          Vector<Promise<void>> promises;
+          for (uint j = 0; j < EVENTS; j++) {
+            auto promise = exec.executeAsync([&received, i, j]() { received[i].add(j); });
+            if (j % 3 != 2) {
+              promises.add(kj::mv(promise));
+            }
+          }
+          joinPromises(promises.releaseAsArray()).wait(waitScope);
+        }));
+      }
+    }
+
+    // Check results on the receiving thread, where `received` lives.
+    exec.executeSync([&]() {
+      for (auto& events: received) {
+        uint next = 0;
+        for (uint j: events) {
+          KJ_ASSERT(j >= next, "events arrived out of order", j, next);
+          for (; next < j; next++) {
+            KJ_ASSERT(next % 3 == 2, "event went missing", next);
+          }
+          next = j + 1;
+        }
+        KJ_ASSERT(next == EVENTS);
+      }
+      stop->fulfill();
+    });
+  })();
+}
+
 KJ_TEST("synchronous cross-thread event disconnected") {
   MutexGuarded<kj::Maybe<const Executor&>> executor;  // to get the Executor from the other thread
   Own<PromiseFulfiller<void>> fulfiller;  // accessed only from the subthread
@@ -741,7 +741,7 @@ LoggingErrorHandler LoggingErrorHandler::instance = LoggingErrorHandler();
 // =======================================================================================
 
 struct Executor::Impl {
-  Impl(EventLoop& loop): state(loop) {}
+  Impl(EventLoop& loop): state(loop), loop(loop), liveLoop(&loop) {}
 
   struct State {
     // Queues of notifications from other threads that need this thread's attention.
@@ -813,6 +813,93 @@ struct Executor::Impl {
   kj::MutexGuarded<State> state;
   // After modifying state from another thread, the loop's port.wake() must be called.
 
+  EventLoop& loop;
+
+  mutable EventLoop* liveLoop;
+  // Same as `loop`, but becomes null (atomically) when the loop is destroyed. Lets senders check
+  // liveness without locking.
+
+  mutable _::XThreadEvent* inbox = nullptr;
+  // Stack of events sent to this executor which haven't been moved to `state.start` yet, linked
+  // through `XThreadEvent::inboxNext`, most recent first. Senders push onto it with a
+  // compare-and-swap, so that many threads can send to one loop without contending on the mutex.
+  // Only code holding the mutex may take events off, by atomically taking the whole stack (see
+  // drainInbox()). Once the loop is destroyed, the inbox is CLOSED_INBOX and pushes fail.
+
+  mutable uint sendersInFlight = 0;
+  // Number of threads in sendToInbox() that may still wake `loop`. disconnect() waits for it to
+  // drop to zero after closing the inbox, so that they don't touch a destroyed loop.
+
+  mutable bool wakePending = false;
+  // True if some thread has woken the loop's port and the loop hasn't polled the executor since.
+  // Other threads can then skip their wake() (usually a syscall), since the pending poll will see
+  // their work too.
+
+  static _::XThreadEvent* const CLOSED_INBOX;
+
+  bool sendToInbox(_::XThreadEvent& event) const {
+    // Returns false if the loop has been destroyed.
+
+    __atomic_add_fetch(&sendersInFlight, 1, __ATOMIC_SEQ_CST);
+    KJ_DEFER(__atomic_sub_fetch(&sendersInFlight, 1, __ATOMIC_SEQ_CST));
+
+    _::XThreadEvent* head = __atomic_load_n(&inbox, __ATOMIC_SEQ_CST);
+    do {
+      if (head == CLOSED_INBOX) return false;
+      event.inboxNext = head;
+    } while (!__atomic_compare_exchange_n(&inbox, &head, &event, true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    KJ_IF_SOME(p, loop.port) {
+      wake(p);
+    } else {
+      // Event loop will be waiting on executor.wait(), which rechecks its condition when we
+      // unlock the mutex.
+      state.lockExclusive();
+    }
+    return true;
+  }
+
+  void wake(const EventPort& port) const {
+    // Wake the loop to poll this executor, unless that's already pending. Call after adding work.
+    if (!__atomic_exchange_n(&wakePending, true, __ATOMIC_SEQ_CST)) {
+      port.wake();
+    }
+  }
+
+  bool isInboxEmpty() const {
+    auto head = __atomic_load_n(&inbox, __ATOMIC_SEQ_CST);
+    return head == nullptr || head == CLOSED_INBOX;
+  }
+
+  void drainInbox(State& lockedState) const {
+    // Move the inbox to `start`. Must be called with the mutex locked.
+
+    _::XThreadEvent* head = __atomic_load_n(&inbox, __ATOMIC_SEQ_CST);
+    do {
+      if (head == nullptr || head == CLOSED_INBOX) return;
+    } while (!__atomic_compare_exchange_n(&inbox, &head, nullptr, true,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+    addToStart(lockedState, head);
+  }
+
+  static void addToStart(State& lockedState, _::XThreadEvent* head) {
+    // Reverse the stack so that events are started in the order they were sent.
+    _::XThreadEvent* reversed = nullptr;
+    while (head != nullptr) {
+      auto next = head->inboxNext;
+      head->inboxNext = reversed;
+      reversed = head;
+      head = next;
+    }
+    while (reversed != nullptr) {
+      auto next = reversed->inboxNext;
+      reversed->inboxNext = nullptr;
+      lockedState.start.add(*reversed);
+      reversed = next;
+    }
+  }
+
   void processAsyncCancellations(Vector<_::XThreadEvent*>& eventsToCancelOutsideLock) {
     // After calling dispatchAll() or dispatchCancels() with the lock held, it may be that some
     // cancellations require dropping the lock before destroying the promiseNode. In that case
@@ -833,7 +920,24 @@ struct Executor::Impl {
   }
 
   void disconnect() {
-    state.lockExclusive()->loop = nullptr;
+    __atomic_store_n(&liveLoop, nullptr, __ATOMIC_SEQ_CST);
+    {
+      // Stop accepting new events. This must happen under the lock, so that anyone canceling a
+      // QUEUED event finds it either in the inbox or in `start`.
+      auto lock = state.lockExclusive();
+      lock->loop = nullptr;
+      addToStart(*lock, __atomic_exchange_n(&inbox, CLOSED_INBOX, __ATOMIC_SEQ_CST));
+    }
+
+    // Senders which got in before the inbox closed may still be waking the loop. Wait for them,
+    // since the loop is about to be destroyed. (Without holding the lock, which they may need.)
+    while (__atomic_load_n(&sendersInFlight, __ATOMIC_SEQ_CST) != 0) {
+#if _WIN32
+      Sleep(0);
+#else
+      sched_yield();
+#endif
+    }
 
     // Now that `loop` is set null in `state`, other threads will no longer try to manipulate our
     // lists, so we can access them without a lock. That's convenient because a bunch of the things
@@ -889,6 +993,8 @@ struct Executor::Impl {
     }
   }};
 
+_::XThreadEvent* const Executor::Impl::CLOSED_INBOX = reinterpret_cast<_::XThreadEvent*>(1);
+
 namespace _ {  // (private)
 
 XThreadEvent::XThreadEvent(
@@ -921,6 +1027,7 @@ void XThreadEvent::ensureDoneOrCanceled() {
         // Nothing to do.
         break;
       case QUEUED:
+        targetExecutor->impl->drainInbox(*lock);
         lock->start.remove(*this);
         // No wake needed since we removed work rather than adding it.
         state = DONE;
@@ -1067,7 +1174,7 @@ void XThreadEvent::sendReply() noexcept {
     // `DONE`, which we don't set until later on. That's nice because wake() probably makes a
     // syscall and we'd rather not hold the lock through syscalls.
     KJ_IF_SOME(p, replyLoop->port) {
-      p.wake();
+      e.impl->wake(p);
     }
   }
 }
@@ -1234,7 +1341,7 @@ XThreadPaf::FulfillScope::~FulfillScope() noexcept {  // intentionally noexcept
       KJ_IF_SOME(p, l.port) {
         // TODO(perf): It's annoying we have to call wake() with the lock held, but we have to
         //   prevent the destination EventLoop from being destroyed first.
-        p.wake();
+        obj->executor.impl->wake(p);
       }
     } else {
       // This will abort due to the method being `noexcept`, which is what we want because this
@@ -1267,17 +1374,21 @@ public:
 Executor::Executor(EventLoop& loop, Badge<EventLoop>): impl(kj::heap<Impl>(loop)) {}
 Executor::~Executor() noexcept(false) {}
 
+bool Executor::isCurrentThread() const {
+  EventLoop* thisThread = threadLocalEventLoop;
+  return thisThread != nullptr &&
+      thisThread->executor.map([this](auto& e) { return e == this; }).orDefault(false);
+}
+
 bool Executor::isLive() const {
-  return impl->state.lockShared()->loop != kj::none;
+  return __atomic_load_n(&impl->liveLoop, __ATOMIC_SEQ_CST) != nullptr;
 }
 
 void Executor::send(_::XThreadEvent& event, bool sync) const {
   KJ_ASSERT(event.state == _::XThreadEvent::UNUSED);
 
   if (sync) {
-    EventLoop* thisThread = threadLocalEventLoop;
-    if (thisThread != nullptr &&
-        thisThread->executor.map([this](auto& e) { return e == this; }).orDefault(false)) {
+    if (isCurrentThread()) {
       // Invoking a sync request on our own thread. Just execute it directly; if we try to queue
       // it to the loop, we'll deadlock.
       auto promiseNode = event.execute();
@@ -1297,25 +1408,15 @@ void Executor::send(_::XThreadEvent& event, bool sync) const {
     // would be extra code complexity for probably little benefit.
   }
 
-  auto lock = impl->state.lockExclusive();
-  const EventLoop* loop;
-  KJ_IF_SOME(l, lock->loop) {
-    loop = &l;
-  } else {
+  event.state = _::XThreadEvent::QUEUED;
+  if (!impl->sendToInbox(event)) {
+    event.state = _::XThreadEvent::UNUSED;
     event.setDisconnected();
     return;
   }
 
-  event.state = _::XThreadEvent::QUEUED;
-  lock->start.add(event);
-
-  KJ_IF_SOME(p, loop->port) {
-    p.wake();
-  } else {
-    // Event loop will be waiting on executor.wait(), which will be woken when we unlock the mutex.
-  }
-
   if (sync) {
+    auto lock = impl->state.lockExclusive();
     lock.wait([&](auto&) { return event.state == _::XThreadEvent::DONE; });
   }
 }
@@ -1326,10 +1427,11 @@ void Executor::wait() {
 
   auto lock = impl->state.lockExclusive();
 
-  lock.wait([](const Impl::State& state) {
-    return state.isDispatchNeeded();
+  lock.wait([this](const Impl::State& state) {
+    return state.isDispatchNeeded() || !impl->isInboxEmpty();
   });
 
+  impl->drainInbox(*lock);
   lock->dispatchAll(eventsToCancelOutsideLock);
 }
 
@@ -1337,7 +1439,11 @@ bool Executor::poll() {
   Vector<_::XThreadEvent*> eventsToCancelOutsideLock;
   KJ_DEFER(impl->processAsyncCancellations(eventsToCancelOutsideLock));
 
+  // Anything added before this point will be seen below, so later senders need to wake us again.
+  __atomic_store_n(&impl->wakePending, false, __ATOMIC_SEQ_CST);
+
   auto lock = impl->state.lockExclusive();
+  impl->drainInbox(*lock);
   if (lock->isDispatchNeeded()) {
     lock->dispatchAll(eventsToCancelOutsideLock);
     return true;
@@ -1347,8 +1453,9 @@ bool Executor::poll() {
 }
 
 EventLoop& Executor::getLoop() const {
-  KJ_IF_SOME(l, impl->state.lockShared()->loop) {
-    return l;
+  EventLoop* loop = __atomic_load_n(&impl->liveLoop, __ATOMIC_SEQ_CST);
+  if (loop != nullptr) {
+    return *loop;
   } else {
     kj::throwFatalException(KJ_EXCEPTION(DISCONNECTED, "Executor's event loop has exited"));
   }
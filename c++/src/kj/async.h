@@ -999,6 +999,11 @@ public:
   // If the target event loop has exited, then `execute{Async,Sync}` will throw DISCONNECTED
   // exceptions.
 
+  bool isCurrentThread() const;
+  // Returns true if the calling thread is the one running this executor's event loop. Unlike
+  // comparing against getCurrentThreadExecutor(), this is safe to call on a thread with no event
+  // loop, in which case it returns false.
+
   bool isLive() const;
   // Returns true if the remote event loop still exists, false if it has been destroyed. In the
   // latter case, `execute{Async,Sync}()` will definitely throw. Of course, if this returns true,
@@ -82,7 +82,7 @@ KJ_BEGIN_HEADER
                "-stdlib=libc++ to your CXXFLAGS."
     #endif
   #else
-    #error "This library does not currently support GCC due to https://gcc.gnu.org/bugzilla/show_bug.cgi?id=102051."
+    // LOCAL-ONLY #error "This library does not currently support GCC due to https://gcc.gnu.org/bugzilla/show_bug.cgi?id=102051."
     // #if __GNUC__ < 10
     //   #warning "This library requires at least GCC 10.0."
     // #endif
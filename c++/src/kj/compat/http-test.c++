@@ -134,6 +134,62 @@ KJ_TEST("HttpHeaderTable") {
   KJ_EXPECT(table->stringToId("barfoo") == nullptr);
 }
 
+KJ_TEST("HttpHeaderTable with many headers") {
+  HttpHeaderTable::Builder builder;
+
+  kj::Vector<kj::String> names;
+  kj::Vector<HttpHeaderId> ids;
+  for (uint i = 0; i < 300; i++) {
+    names.add(kj::str("X-Header-", i));
+    ids.add(builder.add(names.back()));
+  }
+  auto caret = builder.add("A^B");
+  auto tilde = builder.add("A~B");
+
+  auto table = builder.build();
+
+  for (auto i: kj::indices(names)) {
+    auto upper = kj::heapString(names[i]);
+    for (char& c: upper) {
+      if ('a' <= c && c <= 'z') c -= 'a' - 'A';
+    }
+    KJ_EXPECT(KJ_ASSERT_NONNULL(table->stringToId(upper)) == ids[i]);
+  }
+  KJ_EXPECT(KJ_ASSERT_NONNULL(table->stringToId("host")) == HttpHeaderId::HOST);
+  KJ_EXPECT(table->stringToId("X-Header-300") == kj::none);
+
+  // '^' and '~' differ only in bit 0x20, like upper and lower case letters.
+  KJ_EXPECT(caret != tilde);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(table->stringToId("a^b")) == caret);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(table->stringToId("a~b")) == tilde);
+}
+
+KJ_TEST("HttpHeaders parse long and continued values") {
+  HttpHeaderTable table;
+  HttpHeaders headers(table);
+
+  // Values long enough to span several scanning blocks, with line breaks at varying offsets.
+  auto longValue = kj::str(kj::repeat('x', 100));
+  auto text = kj::str(
+      "GET / HTTP/1.1\r\n"
+      "Host: ", longValue, "\r\n"
+      "Cookie: a=", longValue, "\r\n\t b=", longValue, "\n c=1\r\n"
+      "User-Agent: ", kj::repeat('y', 33), "\n"
+      "\r\n");
+  auto result = headers.tryParseRequest(text.asArray());
+  KJ_ASSERT(result.is<HttpHeaders::Request>());
+
+  KJ_EXPECT(KJ_ASSERT_NONNULL(headers.get(HttpHeaderId::HOST)) == longValue);
+
+  kj::Vector<kj::String> values;
+  headers.forEach([&](kj::StringPtr name, kj::StringPtr value) {
+    if (name == "Cookie" || name == "User-Agent") values.add(kj::str(name, ": ", value));
+  });
+  KJ_ASSERT(values.size() == 2);
+  KJ_EXPECT(values[0] == kj::str("Cookie: a=", longValue, "  \t b=", longValue, "  c=1"));
+  KJ_EXPECT(values[1] == kj::str("User-Agent: ", kj::repeat('y', 33)));
+}
+
 KJ_TEST("HttpHeaders::parseRequest") {
   HttpHeaderTable::Builder builder;
 
@@ -399,6 +455,95 @@ KJ_TEST("HttpHeaders Set-Cookie handling") {
       "\r\n", text);
 }
 
+KJ_TEST("FrozenHttpHeaders") {
+  HttpHeaderTable::Builder builder;
+  auto hServer = builder.add("Server");
+  auto hCacheControl = builder.add("Cache-Control");
+  auto table = builder.build();
+
+  kj::Own<FrozenHttpHeaders> frozen;
+  {
+    HttpHeaders base(*table);
+    base.set(hServer, kj::str("test-server"));
+    base.set(HttpHeaderId::CONTENT_TYPE, "text/plain");
+    base.add("X-Static", "yes");
+    frozen = kj::heap<FrozenHttpHeaders>(base);
+    // `base` and its strings may go away now; the frozen copy owns everything.
+  }
+  KJ_EXPECT(frozen->getSerialized() ==
+      "Content-Type: text/plain\r\n"
+      "Server: test-server\r\n"
+      "X-Static: yes\r\n"_kj);
+
+  HttpHeaders headers(*table);
+  headers.setFrozen(*frozen);
+  headers.set(HttpHeaderId::DATE, "today");
+  headers.add("X-Dynamic", "1");
+
+  KJ_EXPECT(headers.size() == 5);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(headers.get(hServer)) == "test-server");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(headers.get(HttpHeaderId::DATE)) == "today");
+  KJ_EXPECT(headers.get(hCacheControl) == kj::none);
+
+  KJ_EXPECT(headers.serializeResponse(200, "OK") ==
+      "HTTP/1.1 200 OK\r\n"
+      "Date: today\r\n"
+      "X-Dynamic: 1\r\n"
+      "Content-Type: text/plain\r\n"
+      "Server: test-server\r\n"
+      "X-Static: yes\r\n"
+      "\r\n");
+
+  // A header can't be both frozen and set directly.
+  KJ_EXPECT_THROW_MESSAGE("can't override a frozen header", headers.set(hServer, "other"));
+  KJ_EXPECT_THROW_MESSAGE("can't override a frozen header", headers.add("server", "other"));
+  headers.add("X-Static", "again");
+
+  auto cloned = headers.clone();
+  auto unsetOne = headers.cloneShallow();
+  KJ_EXPECT(unsetOne.size() == 6);
+
+  // Unsetting a frozen header copies the rest in, so it's really gone everywhere.
+  unsetOne.unset(HttpHeaderId::CONTENT_TYPE);
+  KJ_EXPECT(unsetOne.size() == 5);
+  KJ_EXPECT(unsetOne.get(HttpHeaderId::CONTENT_TYPE) == kj::none);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(unsetOne.get(hServer)) == "test-server");
+  uint count = 0;
+  unsetOne.forEach([&](kj::StringPtr name, kj::StringPtr) {
+    KJ_EXPECT(name != "Content-Type");
+    ++count;
+  });
+  KJ_EXPECT(count == 5);
+  KJ_EXPECT(unsetOne.serializeResponse(200, "OK") ==
+      "HTTP/1.1 200 OK\r\n"
+      "Date: today\r\n"
+      "Server: test-server\r\n"
+      "X-Dynamic: 1\r\n"
+      "X-Static: again\r\n"
+      "X-Static: yes\r\n"
+      "\r\n");
+  unsetOne.set(hServer, "other");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(unsetOne.get(hServer)) == "other");
+
+  // The frozen block itself is unaffected.
+  KJ_EXPECT(KJ_ASSERT_NONNULL(headers.get(HttpHeaderId::CONTENT_TYPE)) == "text/plain");
+
+  // Neither the clone nor the unset copy borrow the frozen block anymore.
+  headers.clear();
+  frozen = nullptr;
+  KJ_EXPECT(cloned.size() == 6);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(cloned.get(hServer)) == "test-server");
+  cloned.set(hServer, "other");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(cloned.get(hServer)) == "other");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(unsetOne.get(HttpHeaderId::DATE)) == "today");
+
+  {
+    HttpHeaders base(*table);
+    base.set(HttpHeaderId::CONTENT_LENGTH, "123");
+    KJ_EXPECT_THROW_MESSAGE("connection headers can't be frozen", FrozenHttpHeaders{base});
+  }
+}
+
 // =======================================================================================
 
 class ReadFragmenter final: public kj::AsyncIoStream {
@@ -2058,6 +2203,94 @@ KJ_TEST("WebSocket unknown opcode") {
   assertContainsWebSocketClose(rawCloseMessage.slice(0, nread), 1002, "Unknown opcode 5"_kjc);
 }
 
+KJ_TEST("WebSocket accepts invalid UTF-8 in text messages by default") {
+  KJ_HTTP_TEST_SETUP_IO;
+  auto pipe = KJ_HTTP_TEST_CREATE_2PIPE;
+
+  auto client = kj::mv(pipe.ends[0]);
+  auto server = newWebSocket(kj::mv(pipe.ends[1]), kj::none);
+
+  byte DATA[] = {
+    0x81, 0x03, 'a', 0xc0, 0x80  // overlong encoding of NUL
+  };
+  auto clientTask = client->write(DATA, sizeof(DATA));
+
+  auto message = server->receive().wait(waitScope);
+  KJ_ASSERT(message.is<kj::String>());
+  KJ_EXPECT(message.get<kj::String>().asBytes() == kj::arrayPtr(DATA + 2, 3));
+  clientTask.wait(waitScope);
+}
+
+KJ_TEST("WebSocket invalid UTF-8 in text message") {
+  KJ_HTTP_TEST_SETUP_IO;
+  auto pipe = KJ_HTTP_TEST_CREATE_2PIPE;
+
+  WebSocketErrorCatcher errorCatcher;
+  WebSocketSettings settings;
+  settings.validateUtf8 = true;
+  auto client = kj::mv(pipe.ends[0]);
+  auto server = newWebSocket(kj::mv(pipe.ends[1]), kj::none, kj::none, errorCatcher, settings);
+
+  byte DATA[] = {
+    0x81, 0x03, 'a', 0xc0, 0x80  // overlong encoding of NUL
+  };
+
+  auto rawCloseMessage = kj::heapArray<kj::byte>(129);
+  auto clientTask = client->write(DATA, sizeof(DATA)).then([&]() {
+    return client->tryRead(rawCloseMessage.begin(), 2, rawCloseMessage.size());
+  });
+
+  {
+    bool gotException = false;
+    auto serverTask = server->receive().then([](auto&& m) {}, [&gotException](kj::Exception&& ex) { gotException = true; });
+    serverTask.wait(waitScope);
+    KJ_ASSERT(gotException);
+    KJ_ASSERT(errorCatcher.errors.size() == 1);
+    KJ_ASSERT(errorCatcher.errors[0].statusCode == 1007);
+  }
+
+  auto nread = clientTask.wait(waitScope);
+  assertContainsWebSocketClose(rawCloseMessage.slice(0, nread), 1007, "Invalid UTF-8"_kjc);
+}
+
+KJ_TEST("WebSocket unmasks messages of all sizes") {
+  // Exercises the unaligned head and tail handling of the word-at-a-time unmasking.
+
+  KJ_HTTP_TEST_SETUP_IO;
+  auto pipe = KJ_HTTP_TEST_CREATE_2PIPE;
+
+  auto client = kj::mv(pipe.ends[0]);
+  auto server = newWebSocket(kj::mv(pipe.ends[1]), kj::none);
+
+  const byte MASK[4] = { 12, 34, 56, 78 };
+  for (size_t size: { 1, 3, 7, 8, 9, 15, 16, 17, 31, 33, 125, 1000, 4099 }) {
+    kj::Vector<byte> frame;
+    frame.add(0x82);
+    if (size < 126) {
+      frame.add(0x80 | size);
+    } else {
+      frame.add(0x80 | 126);
+      frame.add(size >> 8);
+      frame.add(size & 0xff);
+    }
+    frame.addAll(kj::arrayPtr(MASK, 4));
+    for (auto i: kj::zeroTo(size)) {
+      frame.add(static_cast<byte>(i * 7) ^ MASK[i % 4]);
+    }
+
+    auto clientTask = client->write(frame.begin(), frame.size());
+    auto message = server->receive().wait(waitScope);
+    clientTask.wait(waitScope);
+
+    KJ_ASSERT(message.is<kj::Array<byte>>());
+    auto& payload = message.get<kj::Array<byte>>();
+    KJ_ASSERT(payload.size() == size);
+    for (auto i: kj::zeroTo(size)) {
+      KJ_ASSERT(payload[i] == static_cast<byte>(i * 7), size, i);
+    }
+  }
+}
+
 KJ_TEST("WebSocket unsolicited pong") {
   KJ_HTTP_TEST_SETUP_IO;
   auto pipe = KJ_HTTP_TEST_CREATE_2PIPE;
@@ -4158,6 +4391,218 @@ KJ_TEST("HttpServer threw exception") {
   KJ_EXPECT(text.startsWith("HTTP/1.1 500 Internal Server Error"), text);
 }
 
+class WriteCountingStream final: public kj::AsyncIoStream {
+  // An AsyncIoStream wrapper which counts calls to write().
+
+public:
+  WriteCountingStream(kj::Own<kj::AsyncIoStream> inner, uint& count)
+      : inner(kj::mv(inner)), count(count) {}
+
+  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    return inner->tryRead(buffer, minBytes, maxBytes);
+  }
+  kj::Promise<void> write(const void* buffer, size_t size) override {
+    ++count;
+    return inner->write(buffer, size);
+  }
+  kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
+    ++count;
+    return inner->write(pieces);
+  }
+  Promise<void> whenWriteDisconnected() override {
+    return inner->whenWriteDisconnected();
+  }
+  void shutdownWrite() override {
+    return inner->shutdownWrite();
+  }
+  void abortRead() override {
+    return inner->abortRead();
+  }
+
+private:
+  kj::Own<AsyncIoStream> inner;
+  uint& count;
+};
+
+KJ_TEST("HttpServer writes headers and a small body together") {
+  KJ_HTTP_TEST_SETUP_IO;
+  kj::TimerImpl timer(kj::origin<kj::TimePoint>());
+  auto pipe = KJ_HTTP_TEST_CREATE_2PIPE;
+
+  HttpHeaderTable::Builder builder;
+  auto hServer = builder.add("Server");
+  auto table = builder.build();
+
+  HttpHeaders base(*table);
+  base.set(hServer, "test-server");
+  base.set(HttpHeaderId::CONTENT_TYPE, "text/plain");
+  FrozenHttpHeaders frozen(base);
+
+  class StaticService final: public HttpService {
+  public:
+    StaticService(const HttpHeaderTable& table, const FrozenHttpHeaders& frozen)
+        : table(table), frozen(frozen) {}
+
+    kj::Promise<void> request(
+        HttpMethod method, kj::StringPtr url, const HttpHeaders& headers,
+        kj::AsyncInputStream& requestBody, Response& response) override {
+      HttpHeaders responseHeaders(table);
+      responseHeaders.setFrozen(frozen);
+      responseHeaders.set(HttpHeaderId::DATE, "today");
+      auto stream = response.send(200, "OK", responseHeaders, 5);
+      auto promise = stream->write("hello", 5);
+      return promise.attach(kj::mv(stream));
+    }
+
+  private:
+    const HttpHeaderTable& table;
+    const FrozenHttpHeaders& frozen;
+  };
+
+  StaticService service(*table, frozen);
+  HttpServer server(timer, *table, service);
+
+  uint writeCount = 0;
+  auto listenTask = server.listenHttp(
+      kj::heap<WriteCountingStream>(kj::mv(pipe.ends[0]), writeCount));
+
+  auto request = "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n"_kj;
+  pipe.ends[1]->write(request.begin(), request.size()).wait(waitScope);
+  pipe.ends[1]->shutdownWrite();
+  auto text = pipe.ends[1]->readAllText().wait(waitScope);
+
+  KJ_EXPECT(text ==
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Length: 5\r\n"
+      "Date: today\r\n"
+      "Content-Type: text/plain\r\n"
+      "Server: test-server\r\n"
+      "\r\n"
+      "hello", text);
+  KJ_EXPECT(writeCount == 1, writeCount);
+}
+
+KJ_TEST("HttpServer handles pipelined requests concurrently") {
+  KJ_HTTP_TEST_SETUP_IO;
+  kj::TimerImpl timer(kj::origin<kj::TimePoint>());
+  auto pipe = KJ_HTTP_TEST_CREATE_2PIPE;
+
+  HttpHeaderTable table;
+
+  class DelayedService final: public HttpService {
+    // Each request waits until the test lets it go, then echoes the URL and request body.
+
+  public:
+    DelayedService(const HttpHeaderTable& table): table(table) {}
+
+    kj::Promise<void> request(
+        HttpMethod method, kj::StringPtr url, const HttpHeaders& headers,
+        kj::AsyncInputStream& requestBody, Response& response) override {
+      auto paf = kj::newPromiseAndFulfiller<void>();
+      fulfillers.add(kj::mv(paf.fulfiller));
+      return paf.promise.then([&requestBody]() {
+        return requestBody.readAllText();
+      }).then([this, url, &response](kj::String body) {
+        auto text = kj::str(url, body);
+        auto stream = response.send(200, "OK", HttpHeaders(table), text.size());
+        auto promise = stream->write(text.begin(), text.size());
+        return promise.attach(kj::mv(stream), kj::mv(text));
+      });
+    }
+
+    kj::Vector<kj::Own<kj::PromiseFulfiller<void>>> fulfillers;
+
+  private:
+    const HttpHeaderTable& table;
+  };
+
+  DelayedService service(table);
+  HttpServerSettings settings;
+  settings.maxPipelinedRequests = 4;
+  settings.pipelineBufferBytes = 2;  // Room for one early response body, but not two.
+  HttpServer server(timer, table, service, settings);
+  auto listenTask = server.listenHttp(kj::mv(pipe.ends[0]));
+
+  // The POST has a body, so it has to wait for the GETs to finish before it's handled.
+  auto requests =
+      "GET /a HTTP/1.1\r\n\r\n"
+      "GET /b HTTP/1.1\r\n\r\n"
+      "GET /c HTTP/1.1\r\n\r\n"
+      "POST /d HTTP/1.1\r\nContent-Length: 3\r\n\r\nxyz"_kj;
+  pipe.ends[1]->write(requests.begin(), requests.size()).wait(waitScope);
+  waitScope.poll();
+  KJ_ASSERT(service.fulfillers.size() == 3);
+
+  // Let the handlers finish in reverse order.
+  service.fulfillers[2]->fulfill();
+  waitScope.poll();
+  service.fulfillers[1]->fulfill();
+  waitScope.poll();
+  KJ_EXPECT(service.fulfillers.size() == 3);
+  service.fulfillers[0]->fulfill();
+
+  // The POST is handled once the GETs' responses have gone out.
+  expectRead(*pipe.ends[1],
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n/a"
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n/b"
+      "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n/c"_kj).wait(waitScope);
+  waitScope.poll();
+  KJ_ASSERT(service.fulfillers.size() == 4);
+  service.fulfillers[3]->fulfill();
+
+  pipe.ends[1]->shutdownWrite();
+  auto text = pipe.ends[1]->readAllText().wait(waitScope);
+  KJ_EXPECT(text == "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\n/dxyz", text);
+}
+
+KJ_TEST("HttpServer doesn't hold back pipelined responses while a request trickles in") {
+  KJ_HTTP_TEST_SETUP_IO;
+  kj::TimerImpl timer(kj::origin<kj::TimePoint>());
+  auto pipe = KJ_HTTP_TEST_CREATE_2PIPE;
+
+  HttpHeaderTable table;
+
+  class EchoUrlService final: public HttpService {
+  public:
+    EchoUrlService(const HttpHeaderTable& table): table(table) {}
+
+    kj::Promise<void> request(
+        HttpMethod method, kj::StringPtr url, const HttpHeaders& headers,
+        kj::AsyncInputStream& requestBody, Response& response) override {
+      auto stream = response.send(200, "OK", HttpHeaders(table), url.size());
+      auto promise = stream->write(url.begin(), url.size());
+      return promise.attach(kj::mv(stream));
+    }
+
+  private:
+    const HttpHeaderTable& table;
+  };
+
+  EchoUrlService service(table);
+  HttpServerSettings settings;
+  settings.maxPipelinedRequests = 4;
+  HttpServer server(timer, table, service, settings);
+  auto listenTask = server.listenHttp(kj::mv(pipe.ends[0]));
+
+  // The first request arrives along with only the start of the second.
+  auto first = "GET /a HTTP/1.1\r\n\r\nGET /b HT"_kj;
+  pipe.ends[1]->write(first.begin(), first.size()).wait(waitScope);
+
+  // The response to the first goes out without waiting for the rest of the second.
+  auto expected = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n/a"_kj;
+  auto buffer = kj::heapArray<char>(expected.size());
+  auto readPromise = pipe.ends[1]->read(buffer.begin(), buffer.size());
+  KJ_ASSERT(readPromise.poll(waitScope));
+  readPromise.wait(waitScope);
+  KJ_EXPECT(kj::heapString(buffer.begin(), buffer.size()) == expected);
+
+  auto rest = "TP/1.1\r\n\r\n"_kj;
+  pipe.ends[1]->write(rest.begin(), rest.size()).wait(waitScope);
+  pipe.ends[1]->shutdownWrite();
+  auto text = pipe.ends[1]->readAllText().wait(waitScope);
+  KJ_EXPECT(text == "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\n/b", text);
+}
+
 KJ_TEST("HttpServer bad requests") {
   struct TestCase {
     kj::StringPtr request;
@@ -5752,6 +6197,144 @@ KJ_TEST("HttpClient connection management") {
   KJ_EXPECT(cumulative == 9);
 }
 
+KJ_TEST("HttpClient connection pool") {
+  KJ_HTTP_TEST_SETUP_IO;
+  KJ_HTTP_TEST_SETUP_LOOPBACK_LISTENER_AND_ADDR;
+
+  kj::TimerImpl serverTimer(kj::origin<kj::TimePoint>());
+  kj::TimerImpl clientTimer(kj::origin<kj::TimePoint>());
+  HttpHeaderTable headerTable;
+
+  DummyService service(headerTable);
+  HttpServer server(serverTimer, headerTable, service);
+  auto listenTask = server.listenHttp(*listener);
+
+  // Two clients standing in for two different hosts.
+  uint count1 = 0, cumulative1 = 0;
+  uint count2 = 0, cumulative2 = 0;
+  CountingNetworkAddress countingAddr1(*addr, count1, cumulative1);
+  CountingNetworkAddress countingAddr2(*addr, count2, cumulative2);
+
+  HttpConnectionPool pool(3);
+  HttpClientSettings clientSettings;
+  clientSettings.maxIdleConnectionsPerHost = 2;
+  clientSettings.connectionPool = pool;
+  auto client1 = newHttpClient(clientTimer, headerTable, countingAddr1, clientSettings);
+  auto client2 = newHttpClient(clientTimer, headerTable, countingAddr2, clientSettings);
+
+  auto doRequest = [&](HttpClient& client) {
+    return client.request(HttpMethod::GET, "/", HttpHeaders(headerTable)).response
+        .then([](HttpClient::Response&& response) {
+      auto promise = response.body->readAllText();
+      return promise.attach(kj::mv(response.body));
+    }).ignoreResult();
+  };
+
+  // Prewarming opens connections up to the per-host limit.
+  client1->prewarm("/", 5).wait(waitScope);
+  KJ_EXPECT(count1 == 2);
+  KJ_EXPECT(pool.getStats().idleConnections == 2);
+
+  // Requests use the prewarmed connections.
+  doRequest(*client1).wait(waitScope);
+  KJ_EXPECT(cumulative1 == 2);
+  KJ_EXPECT(pool.getStats().hits == 1);
+  KJ_EXPECT(pool.getStats().misses == 0);
+
+  // Three requests in parallel need a third connection. Once they're done, one idle connection
+  // is closed to stay within the per-host limit.
+  {
+    auto promises = kj::heapArrayBuilder<kj::Promise<void>>(3);
+    for (auto i KJ_UNUSED: kj::zeroTo(3)) {
+      promises.add(doRequest(*client1));
+    }
+    kj::joinPromises(promises.finish()).wait(waitScope);
+  }
+  KJ_EXPECT(cumulative1 == 3);
+  KJ_EXPECT(count1 == 2);
+  KJ_EXPECT(pool.getStats().hits == 3);
+  KJ_EXPECT(pool.getStats().misses == 1);
+  KJ_EXPECT(pool.getStats().evictions == 1);
+
+  // Warming up the other host exceeds the pool's limit, so the first host's least-recently-used
+  // connection is closed.
+  client2->prewarm("/", 2).wait(waitScope);
+  KJ_EXPECT(count1 == 1);
+  KJ_EXPECT(count2 == 2);
+  KJ_EXPECT(pool.getStats().idleConnections == 3);
+  KJ_EXPECT(pool.getStats().evictions == 2);
+
+  // Prewarming again doesn't open more connections than needed.
+  client2->prewarm("/", 2).wait(waitScope);
+  KJ_EXPECT(cumulative2 == 2);
+
+  // Idle connections still time out.
+  clientTimer.advanceTo(clientTimer.now() + clientSettings.idleTimeout * 2);
+  waitScope.poll();
+  KJ_EXPECT(count1 == 0);
+  KJ_EXPECT(count2 == 0);
+  KJ_EXPECT(pool.getStats().idleConnections == 0);
+  KJ_EXPECT(pool.getStats().expirations == 3);
+}
+
+KJ_TEST("HttpClient prewarm is best-effort") {
+  KJ_HTTP_TEST_SETUP_IO;
+  kj::TimerImpl clientTimer(kj::origin<kj::TimePoint>());
+  HttpHeaderTable headerTable;
+
+  class StuckNetworkAddress final: public kj::NetworkAddress {
+    // Connection attempts either fail immediately or never complete.
+  public:
+    bool fail = true;
+    uint attempts = 0;
+
+    kj::Promise<kj::Own<kj::AsyncIoStream>> connect() override {
+      ++attempts;
+      if (fail) {
+        return KJ_EXCEPTION(DISCONNECTED, "connection refused");
+      } else {
+        return kj::NEVER_DONE;
+      }
+    }
+
+    kj::Own<kj::ConnectionReceiver> listen() override { KJ_UNIMPLEMENTED("test"); }
+    kj::Own<kj::NetworkAddress> clone() override { KJ_UNIMPLEMENTED("test"); }
+    kj::String toString() override { KJ_UNIMPLEMENTED("test"); }
+  };
+
+  StuckNetworkAddress addr;
+  HttpClientSettings clientSettings;
+  clientSettings.maxIdleConnectionsPerHost = 2;
+
+  {
+    // Failures are logged, not thrown.
+    auto client = newHttpClient(clientTimer, headerTable, addr, clientSettings);
+    KJ_EXPECT_LOG(WARNING, "failed to prewarm HTTP connection");
+    KJ_EXPECT_LOG(WARNING, "failed to prewarm HTTP connection");
+    client->prewarm("/", 2).wait(waitScope);
+    KJ_EXPECT(addr.attempts == 2);
+  }
+
+  {
+    // The caller can drop the promise, and the client can be destroyed, while attempts are
+    // still in flight.
+    addr.fail = false;
+    auto client = newHttpClient(clientTimer, headerTable, addr, clientSettings);
+    auto promise = client->prewarm("/", 1);
+    KJ_EXPECT(!promise.poll(waitScope));
+    promise = nullptr;
+    KJ_EXPECT(addr.attempts == 3);
+
+    // The first attempt is still counted, so this only starts one more.
+    promise = client->prewarm("/", 2);
+    KJ_EXPECT(addr.attempts == 4);
+    KJ_EXPECT(!promise.poll(waitScope));
+
+    // Destroying the client cancels the attempts, which resolves the promise.
+    client = nullptr;
+    promise.wait(waitScope);
+  }
+}
 KJ_TEST("HttpClient disable connection reuse") {
   KJ_HTTP_TEST_SETUP_IO;
   KJ_HTTP_TEST_SETUP_LOOPBACK_LISTENER_AND_ADDR;
@@ -6566,7 +7149,15 @@ KJ_TEST("HttpServer handles disconnected exception for clients disconnecting aft
       }
     }
     Promise<void> write(ArrayPtr<const ArrayPtr<const byte>> pieces) override {
-      return inner.write(pieces);
+      // HttpOutputStream coalesces the headers with a small body into one write, so this is the
+      // same two writes as above arriving together: let the headers through, then fail the body.
+      KJ_ASSERT(writeCount == 0 && pieces.size() == 2, "Unexpected write", pieces.size());
+      writeCount += 2;
+      auto promise = inner.write(pieces[0].begin(), pieces[0].size());
+      inner.shutdownWrite();
+      return promise.then([]() -> Promise<void> {
+        return KJ_EXCEPTION(DISCONNECTED, "a_disconnected_exception");
+      });
     }
 
     Maybe<Promise<uint64_t>> tryPumpFrom(AsyncInputStream& input, uint64_t amount) override {
@@ -25,12 +25,18 @@
 #include <kj/debug.h>
 #include <kj/parse/char.h>
 #include <kj/string.h>
-#include <unordered_map>
 #include <stdlib.h>
 #include <kj/encoding.h>
-#include <deque>
+#include <kj/list.h>
+#include <list>
 #include <queue>
+#include <deque>
 #include <map>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #if KJ_HAS_ZLIB
 #include <zlib.h>
 #endif // KJ_HAS_ZLIB
@@ -531,36 +537,111 @@ kj::StringPtr HttpHeaderId::toString() const {
 
 namespace {
 
-struct HeaderNameHash {
-  size_t operator()(kj::StringPtr s) const {
-    size_t result = 5381;
-    for (byte b: s.asBytes()) {
-      // Masking bit 0x20 makes our hash case-insensitive while conveniently avoiding any
-      // collisions that would matter for header names.
-      result = ((result << 5) + result) ^ (b & ~0x20);
-    }
-    return result;
+constexpr uint hashHeaderName(const char* name, size_t size) {
+  // djb2. Masking bit 0x20 makes our hash case-insensitive while conveniently avoiding any
+  // collisions that would matter for header names. constexpr so that the builtin headers' hashes
+  // can be computed at compile time.
+  uint result = 5381;
+  for (size_t i = 0; i < size; i++) {
+    result = ((result << 5) + result) ^ (static_cast<byte>(name[i]) & ~0x20);
   }
+  return result;
+}
 
-  bool operator()(kj::StringPtr a, kj::StringPtr b) const {
-    // TODO(perf): I wonder if we can beat strcasecmp() by masking bit 0x20 from each byte. We'd
-    //   need to prohibit one of the technically-legal characters '^' or '~' from header names
-    //   since they'd otherwise be ambiguous, but otherwise there is no ambiguity.
-#if _MSC_VER
-    return _stricmp(a.cStr(), b.cStr()) == 0;
-#else
-    return strcasecmp(a.cStr(), b.cStr()) == 0;
-#endif
+bool headerNameEquals(kj::StringPtr a, kj::StringPtr b) {
+  // Case-insensitive comparison, faster than strcasecmp() since it doesn't consult the locale and
+  // rejects on length first. Two bytes differing only in bit 0x20 are equal only if they are
+  // letters, so '^' and '~' are not confused.
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    char x = a[i];
+    char y = b[i];
+    if (x != y) {
+      char lower = x | 0x20;
+      if ((x ^ y) != 0x20 || lower < 'a' || lower > 'z') return false;
+    }
   }
+  return true;
+}
+
+constexpr uint BUILTIN_HEADER_HASHES[] = {
+  // Indexed by header ID, like BUILTIN_HEADER_NAMES.
+#define HEADER_HASH(id, name) hashHeaderName(name, sizeof(name) - 1),
+  KJ_HTTP_FOR_EACH_BUILTIN_HEADER(HEADER_HASH)
+#undef HEADER_HASH
 };
 
 }  // namespace
 
 struct HttpHeaderTable::IdsByNameMap {
-  // TODO(perf): If we were cool we could maybe use a perfect hash here, since our hashtable is
-  //   static once built.
+  // Open-addressed hash table mapping header names to IDs. Since the table is static once built,
+  // we spend memory to make it (nearly) perfect: whenever an insertion collides, the table is
+  // grown, up to MAX_SLOTS_PER_NAME slots per name, until every name sits in its home slot. In
+  // practice this means a lookup costs one hash, one probe, and one comparison. Linear probing
+  // still backs this up in case a collision-free size can't be found.
+
+  static constexpr uint EMPTY = kj::maxValue;
+  static constexpr uint MAX_SLOTS_PER_NAME = 16;
+
+  struct Slot {
+    uint hash;
+    uint id = EMPTY;
+  };
+
+  kj::Array<Slot> slots = kj::heapArray<Slot>(16);
+  uint shift = 28;  // 32 - log2(slots.size())
+  uint count = 0;
+
+  inline size_t home(uint hash) const {
+    // Fibonacci hashing, so that the well-mixed high bits pick the slot.
+    return (hash * 2654435769u) >> shift;
+  }
+
+  kj::Maybe<uint> find(uint hash, kj::StringPtr name,
+                       kj::ArrayPtr<const kj::StringPtr> namesById) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = home(hash);; i = (i + 1) & mask) {
+      auto& slot = slots[i];
+      if (slot.id == EMPTY) return kj::none;
+      if (slot.hash == hash && headerNameEquals(namesById[slot.id], name)) return slot.id;
+    }
+  }
+
+  bool place(uint hash, uint id) {
+    // Returns true if the entry landed in its home slot.
+    size_t mask = slots.size() - 1;
+    size_t i = home(hash);
+    bool perfect = slots[i].id == EMPTY;
+    while (slots[i].id != EMPTY) i = (i + 1) & mask;
+    slots[i].hash = hash;
+    slots[i].id = id;
+    return perfect;
+  }
+
+  bool rehash(size_t size) {
+    // Returns true if every entry landed in its home slot.
+    auto oldSlots = kj::mv(slots);
+    slots = kj::heapArray<Slot>(size);
+    shift = 32;
+    for (size_t n = size; n > 1; n >>= 1) --shift;
+    bool perfect = true;
+    for (auto& slot: oldSlots) {
+      if (slot.id != EMPTY) perfect = place(slot.hash, slot.id) && perfect;
+    }
+    return perfect;
+  }
 
-  std::unordered_map<kj::StringPtr, uint, HeaderNameHash, HeaderNameHash> map;
+  void insert(uint hash, uint id) {
+    ++count;
+    bool perfect = place(hash, id);
+    size_t size = slots.size();
+    if (count * 2 > size) {
+      perfect = rehash(size *= 2) && perfect;
+    }
+    while (!perfect && size < count * MAX_SLOTS_PER_NAME) {
+      perfect = rehash(size *= 2);
+    }
+  }
 };
 
 HttpHeaderTable::Builder::Builder()
@@ -571,30 +652,31 @@ HttpHeaderTable::Builder::Builder()
 HttpHeaderId HttpHeaderTable::Builder::add(kj::StringPtr name) {
   requireValidHeaderName(name);
 
-  auto insertResult = table->idsByName->map.insert(std::make_pair(name, table->namesById.size()));
-  if (insertResult.second) {
-    table->namesById.add(name);
+  uint hash = hashHeaderName(name.begin(), name.size());
+  KJ_IF_SOME(id, table->idsByName->find(hash, name, table->namesById)) {
+    return HttpHeaderId(table, id);
   }
-  return HttpHeaderId(table, insertResult.first->second);
+
+  uint id = table->namesById.size();
+  table->namesById.add(name);
+  table->idsByName->insert(hash, id);
+  return HttpHeaderId(table, id);
 }
 
 HttpHeaderTable::HttpHeaderTable()
     : idsByName(kj::heap<IdsByNameMap>()) {
 #define ADD_HEADER(id, name) \
   namesById.add(name); \
-  idsByName->map.insert(std::make_pair(name, HttpHeaders::BuiltinIndices::id));
+  idsByName->insert(BUILTIN_HEADER_HASHES[HttpHeaders::BuiltinIndices::id], \
+                    HttpHeaders::BuiltinIndices::id);
   KJ_HTTP_FOR_EACH_BUILTIN_HEADER(ADD_HEADER);
 #undef ADD_HEADER
 }
 HttpHeaderTable::~HttpHeaderTable() noexcept(false) {}
 
 kj::Maybe<HttpHeaderId> HttpHeaderTable::stringToId(kj::StringPtr name) const {
-  auto iter = idsByName->map.find(name);
-  if (iter == idsByName->map.end()) {
-    return kj::none;
-  } else {
-    return HttpHeaderId(this, iter->second);
-  }
+  return idsByName->find(hashHeaderName(name.begin(), name.size()), name, namesById)
+      .map([this](uint id) { return HttpHeaderId(this, id); });
 }
 
 // =======================================================================================
@@ -626,6 +708,7 @@ void HttpHeaders::clear() {
   }
 
   unindexedHeaders.clear();
+  frozen = kj::none;
 }
 
 size_t HttpHeaders::size() const {
@@ -635,23 +718,21 @@ size_t HttpHeaders::size() const {
       ++result;
     }
   }
+  KJ_IF_SOME(f, frozen) {
+    result += f.getHeaders().size();
+  }
   return result;
 }
 
 HttpHeaders HttpHeaders::clone() const {
   HttpHeaders result(*table);
 
-  for (auto i: kj::indices(indexedHeaders)) {
-    if (indexedHeaders[i] != nullptr) {
-      result.indexedHeaders[i] = result.cloneToOwn(indexedHeaders[i]);
-    }
-  }
-
-  result.unindexedHeaders.resize(unindexedHeaders.size());
-  for (auto i: kj::indices(unindexedHeaders)) {
-    result.unindexedHeaders[i].name = result.cloneToOwn(unindexedHeaders[i].name);
-    result.unindexedHeaders[i].value = result.cloneToOwn(unindexedHeaders[i].value);
-  }
+  // The clone owns everything, so frozen headers are copied in as ordinary headers.
+  forEach([&](HttpHeaderId id, kj::StringPtr value) {
+    result.indexedHeaders[id.id] = result.cloneToOwn(value);
+  }, [&](kj::StringPtr name, kj::StringPtr value) {
+    result.unindexedHeaders.add(Header { result.cloneToOwn(name), result.cloneToOwn(value) });
+  });
 
   return result;
 }
@@ -670,6 +751,8 @@ HttpHeaders HttpHeaders::cloneShallow() const {
     result.unindexedHeaders[i] = unindexedHeaders[i];
   }
 
+  result.frozen = frozen;
+
   return result;
 }
 
@@ -696,6 +779,7 @@ bool HttpHeaders::isWebSocket() const {
 void HttpHeaders::set(HttpHeaderId id, kj::StringPtr value) {
   id.requireFrom(*table);
   requireValidHeaderValue(value);
+  requireNotFrozen(id);
 
   indexedHeaders[id.id] = value;
 }
@@ -725,16 +809,13 @@ void HttpHeaders::add(kj::String&& name, kj::String&& value) {
 
 void HttpHeaders::addNoCheck(kj::StringPtr name, kj::StringPtr value) {
   KJ_IF_SOME(id, table->stringToId(name)) {
+    requireNotFrozen(id);
     if (indexedHeaders[id.id] == nullptr) {
       indexedHeaders[id.id] = value;
     } else {
       // Duplicate HTTP headers are equivalent to the values being separated by a comma.
 
-#if _MSC_VER
-      if (_stricmp(name.cStr(), "set-cookie") == 0) {
-#else
-      if (strcasecmp(name.cStr(), "set-cookie") == 0) {
-#endif
+      if (headerNameEquals(name, "set-cookie")) {
         // Uh-oh, Set-Cookie will be corrupted if we try to concatenate it. We'll make it an
         // unindexed header, which is weird, but the alternative is guaranteed corruption, so...
         // TODO(cleanup): Maybe HttpHeaders should just special-case set-cookie in general?
@@ -763,6 +844,44 @@ void HttpHeaders::takeOwnership(HttpHeaders&& otherHeaders) {
   otherHeaders.ownedStrings.clear();
 }
 
+void HttpHeaders::setFrozen(const FrozenHttpHeaders& newFrozen) {
+  auto& frozenHeaders = newFrozen.getHeaders();
+  KJ_REQUIRE(frozenHeaders.table == table, "frozen headers use a different HttpHeaderTable");
+  for (auto i: kj::indices(indexedHeaders)) {
+    KJ_REQUIRE(indexedHeaders[i] == nullptr || frozenHeaders.indexedHeaders[i] == nullptr,
+        "header is both frozen and set directly", table->idToString(HttpHeaderId(table, i)));
+  }
+  frozen = newFrozen;
+}
+
+void HttpHeaders::requireNotFrozen(HttpHeaderId id) const {
+  KJ_IF_SOME(f, frozen) {
+    KJ_REQUIRE(f.getHeaders().indexedHeaders[id.id] == nullptr,
+        "can't override a frozen header", id);
+  }
+}
+
+void HttpHeaders::thaw() {
+  // Copy the frozen headers in as ordinary ones so that one of them can be removed. This is the
+  // rare path, so we simply take our own copies rather than keep borrowing the frozen strings.
+  auto& f = KJ_ASSERT_NONNULL(frozen);
+  frozen = kj::none;
+  f.getHeaders().forEach([&](HttpHeaderId id, kj::StringPtr value) {
+    indexedHeaders[id.id] = cloneToOwn(value);
+  }, [&](kj::StringPtr name, kj::StringPtr value) {
+    unindexedHeaders.add(Header { cloneToOwn(name), cloneToOwn(value) });
+  });
+}
+
+FrozenHttpHeaders::FrozenHttpHeaders(const HttpHeaders& original)
+    : headers(original.clone()) {
+  for (auto i: kj::zeroTo(HttpHeaders::WEBSOCKET_CONNECTION_HEADERS_COUNT)) {
+    KJ_REQUIRE(headers.indexedHeaders[i] == nullptr, "connection headers can't be frozen",
+        BUILTIN_HEADER_NAMES[i]);
+  }
+  text = headers.toString();
+}
+
 // -----------------------------------------------------------------------------
 
 static inline const char* skipSpace(const char* p) {
@@ -836,11 +955,50 @@ static kj::Maybe<uint> consumeNumber(char*& ptr) {
   return result;
 }
 
-static kj::StringPtr consumeLine(char*& ptr) {
+static char* findLineBreak(char* p, const char* end) {
+  // Returns the first '\0', '\r', or '\n' in [p, end), or `end` (which points at the header
+  // blob's NUL terminator) if there is none. Header values are long enough (cookies, user agents)
+  // that scanning a block at a time pays off.
+
+#if defined(__SSE2__)
+  const __m128i nul = _mm_setzero_si128();
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    int bits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, nul),
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, lf))));
+    if (bits != 0) return p + __builtin_ctz(bits);
+    p += 16;
+  }
+#endif
+
+  // Word-at-a-time: a block contains one of our bytes iff XORing with it yields a zero byte.
+  constexpr uint64_t ONES = 0x0101010101010101ull;
+  constexpr uint64_t HIGHS = 0x8080808080808080ull;
+  while (end - p >= 8) {
+    uint64_t chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+    uint64_t xcr = chunk ^ (ONES * '\r');
+    uint64_t xlf = chunk ^ (ONES * '\n');
+    uint64_t found = ((chunk - ONES) & ~chunk) |
+                     ((xcr - ONES) & ~xcr) |
+                     ((xlf - ONES) & ~xlf);
+    if ((found & HIGHS) != 0) break;
+    p += 8;
+  }
+
+  while (p < end && *p != '\0' && *p != '\r' && *p != '\n') ++p;
+  return p;
+}
+
+static kj::StringPtr consumeLine(char*& ptr, const char* blobEnd) {
   char* start = skipSpace(ptr);
   char* p = start;
 
   for (;;) {
+    // `*blobEnd` is always NUL, so this lands on one of the cases below.
+    p = findLineBreak(p, blobEnd);
     switch (*p) {
       case '\0':
         ptr = p;
@@ -883,8 +1041,7 @@ static kj::StringPtr consumeLine(char*& ptr) {
       }
 
       default:
-        ++p;
-        break;
+        KJ_UNREACHABLE;
     }
   }
 }
@@ -983,7 +1140,7 @@ HttpHeaders::RequestConnectOrProtocolError HttpHeaders::tryParseRequestOrConnect
   }
 
   // Ignore rest of line. Don't care about "HTTP/1.1" or whatever.
-  consumeLine(ptr);
+  consumeLine(ptr, end);
 
   if (!parseHeaders(ptr, end)) {
     return ProtocolError { 400, "Bad Request",
@@ -1021,7 +1178,7 @@ HttpHeaders::ResponseOrProtocolError HttpHeaders::tryParseResponse(kj::ArrayPtr<
         "Invalid response status line (invalid status code).", content };
   }
 
-  response.statusText = consumeLine(ptr);
+  response.statusText = consumeLine(ptr, end);
 
   if (!parseHeaders(ptr, end)) {
     return ProtocolError { 502, "Bad Gateway",
@@ -1042,7 +1199,7 @@ bool HttpHeaders::tryParse(kj::ArrayPtr<char> content) {
 bool HttpHeaders::parseHeaders(char* ptr, char* end) {
   while (*ptr != '\0') {
     KJ_IF_SOME(name, consumeHeaderName(ptr)) {
-      kj::StringPtr line = consumeLine(ptr);
+      kj::StringPtr line = consumeLine(ptr, end);
       addNoCheck(name, line);
     } else {
       return false;
@@ -1096,6 +1253,11 @@ kj::String HttpHeaders::serialize(kj::ArrayPtr<const char> word1,
   for (auto& header: unindexedHeaders) {
     size += header.name.size() + header.value.size() + 4;
   }
+  kj::ArrayPtr<const char> frozenText = nullptr;
+  KJ_IF_SOME(f, frozen) {
+    frozenText = f.getSerialized();
+    size += frozenText.size();
+  }
 
   String result = heapString(size);
   char* ptr = result.begin();
@@ -1112,7 +1274,7 @@ kj::String HttpHeaders::serialize(kj::ArrayPtr<const char> word1,
   for (auto& header: unindexedHeaders) {
     ptr = kj::_::fill(ptr, header.name, colon, header.value, newline);
   }
-  ptr = kj::_::fill(ptr, newline);
+  ptr = kj::_::fill(ptr, frozenText, newline);
 
   KJ_ASSERT(ptr == result.end());
   return result;
@@ -1530,6 +1692,25 @@ public:
     return !lineBreakBeforeNextHeader && leftover == nullptr;
   }
 
+  bool hasBufferedMessageHeader() {
+    // Returns whether the next message's entire header is already buffered, so that
+    // readMessageHeaders() can return it without waiting for the network. Only meaningful once the
+    // current message's body has been consumed, or when it has none, so that `leftover` holds the
+    // start of the next message.
+    snarfBufferedLineBreak();
+    if (lineBreakBeforeNextHeader) return false;
+
+    // Look for a blank line, accepting "\r\n" or "\n" line breaks as readHeader() does.
+    for (size_t i = 1; i < leftover.size(); i++) {
+      if (leftover[i] == '\n' &&
+          (leftover[i - 1] == '\n' ||
+           (i >= 2 && leftover[i - 1] == '\r' && leftover[i - 2] == '\n'))) {
+        return true;
+      }
+    }
+    return false;
+  }
+
   kj::Promise<kj::OneOf<kj::ArrayPtr<char>, HttpHeaders::ProtocolError>> readMessageHeaders() {
     ++pendingMessageCount;
     auto paf = kj::newPromiseAndFulfiller<void>();
@@ -2281,9 +2462,15 @@ public:
     writeInProgress = true;
     auto fork = writeQueue.fork();
     writeQueue = fork.addBranch();
+    auto prefix = takeQueuedWrites();
 
     co_await fork;
-    co_await inner.write(buffer, size);
+    if (prefix.empty()) {
+      co_await inner.write(buffer, size);
+    } else {
+      ArrayPtr<const byte> body = kj::arrayPtr(reinterpret_cast<const byte*>(buffer), size);
+      co_await writeWithPrefix(prefix, kj::arrayPtr(&body, 1));
+    }
 
     // We intentionally don't use KJ_DEFER to clean this up because if an exception is thrown, we
     // want to block further writes.
@@ -2297,9 +2484,14 @@ public:
     writeInProgress = true;
     auto fork = writeQueue.fork();
     writeQueue = fork.addBranch();
+    auto prefix = takeQueuedWrites();
 
     co_await fork;
-    co_await inner.write(pieces);
+    if (prefix.empty()) {
+      co_await inner.write(pieces);
+    } else {
+      co_await writeWithPrefix(prefix, pieces);
+    }
 
     // We intentionally don't use KJ_DEFER to clean this up because if an exception is thrown, we
     // want to block further writes.
@@ -2337,6 +2529,7 @@ public:
       // Cancel any writes that are still queued.
       writeQueue = KJ_EXCEPTION(FAILED,
           "previous HTTP message body incomplete; can't write more messages");
+      queuedWrites.clear();
     }
   }
 
@@ -2349,6 +2542,7 @@ public:
     // Cancel any writes that are still queued.
     writeQueue = KJ_EXCEPTION(FAILED,
         "previous HTTP message body incomplete; can't write more messages");
+    queuedWrites.clear();
   }
 
   kj::Promise<void> flush() {
@@ -2374,6 +2568,11 @@ private:
   // a write throws an exception or is canceled, this remains true forever. In these cases, the
   // underlying stream is in an inconsistent state and cannot be reused.
 
+  kj::Vector<kj::String> queuedWrites;
+  // Content passed to queueWrite() that hasn't been handed to `inner` yet. Consecutive queued
+  // writes go out together, and the next body write takes them over so that e.g. the status line,
+  // headers and a small body leave in a single vectored write.
+
   void queueWrite(kj::String content) {
     // We only use queueWrite() in cases where we can take ownership of the write buffer, and where
     // it is convenient if we can return `void` rather than a promise.  In particular, this is used
@@ -2382,10 +2581,40 @@ private:
     // is empty, then they make the write directly, using `writeInProgress` to detect and block
     // concurrent writes.
 
-    writeQueue = writeQueue.then([this,content=kj::mv(content)]() mutable {
-      auto promise = inner.write(content.begin(), content.size());
-      return promise.attach(kj::mv(content));
-    });
+    if (queuedWrites.empty()) {
+      // Nothing is waiting yet, so schedule a flush. Content queued before it runs joins it.
+      writeQueue = writeQueue.then([this]() {
+        auto contents = takeQueuedWrites();
+        return writeWithPrefix(contents, nullptr).attach(kj::mv(contents));
+      });
+    }
+    queuedWrites.add(kj::mv(content));
+  }
+
+  kj::Vector<kj::String> takeQueuedWrites() {
+    // Takes over the content from queueWrite() that hasn't been written yet. It is always at the
+    // tail of `writeQueue`, so the caller may write it as soon as `writeQueue` has resolved; the
+    // scheduled flush will then find nothing left to do.
+    return kj::mv(queuedWrites);
+  }
+
+  kj::Promise<void> writeWithPrefix(kj::ArrayPtr<const kj::String> prefix,
+                                    kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) {
+    // Writes `prefix` followed by `pieces` with one call to `inner`. The caller must keep both
+    // alive until the returned promise resolves.
+
+    if (pieces.size() == 0) {
+      if (prefix.size() == 0) return kj::READY_NOW;
+      if (prefix.size() == 1) return inner.write(prefix[0].begin(), prefix[0].size());
+    }
+
+    auto all = kj::heapArrayBuilder<kj::ArrayPtr<const byte>>(prefix.size() + pieces.size());
+    for (auto& content: prefix) {
+      all.add(content.asBytes());
+    }
+    all.addAll(pieces);
+    auto allPtr = all.asPtr();
+    return inner.write(allPtr).attach(all.finish());
   }
 };
 
@@ -2629,12 +2858,13 @@ public:
                 kj::Maybe<EntropySource&> maskKeyGenerator,
                 kj::Maybe<CompressionParameters> compressionConfigParam = kj::none,
                 kj::Maybe<WebSocketErrorHandler&> errorHandler = kj::none,
+                WebSocketSettings settings = {},
                 kj::Array<byte> buffer = kj::heapArray<byte>(4096),
                 kj::ArrayPtr<byte> leftover = nullptr,
                 kj::Maybe<kj::Promise<void>> waitBeforeSend = kj::none)
       : stream(kj::mv(stream)), maskKeyGenerator(maskKeyGenerator),
         compressionConfig(kj::mv(compressionConfigParam)),
-        errorHandler(errorHandler.orDefault(*this)),
+        errorHandler(errorHandler.orDefault(*this)), settings(settings),
         sendingControlMessage(kj::mv(waitBeforeSend)),
         recvBuffer(kj::mv(buffer)), recvData(leftover) {
 #if KJ_HAS_ZLIB
@@ -2861,10 +3091,16 @@ public:
             // We want to add the null terminator when receiving a TEXT message.
             auto decompressed = decompressor.processMessage(message, originalMaxSize,
                 addNullTerminator);
+            if (settings.validateUtf8 && !isValidUtf8(decompressed.asChars())) {
+              return sendCloseDueToError(1007, "Invalid UTF-8 in text message");
+            }
             return Message(kj::String(decompressed.releaseAsChars()));
           }
 #endif // KJ_HAS_ZLIB
           message.back() = '\0';
+          if (settings.validateUtf8 && !isValidUtf8(message.asChars())) {
+            return sendCloseDueToError(1007, "Invalid UTF-8 in text message");
+          }
           return Message(kj::String(message.releaseAsChars()));
         case OPCODE_BINARY:
 #if KJ_HAS_ZLIB
@@ -3068,7 +3304,37 @@ private:
     byte maskBytes[4];
 
     void apply(byte* __restrict__ bytes, size_t size) const {
-      for (size_t i = 0; i < size; i++) {
+      // XOR a word at a time, after going byte-by-byte up to a word boundary. Since the bulk loop
+      // always advances by a multiple of 4, one pattern word lines up with every chunk.
+      size_t i = 0;
+      for (; i < size && reinterpret_cast<uintptr_t>(bytes + i) % sizeof(uint64_t) != 0; i++) {
+        bytes[i] ^= maskBytes[i % 4];
+      }
+
+      if (size - i >= sizeof(uint64_t)) {
+        byte patternBytes[sizeof(uint64_t)];
+        for (size_t j = 0; j < sizeof(patternBytes); j++) {
+          patternBytes[j] = maskBytes[(i + j) % 4];
+        }
+        uint64_t pattern;
+        memcpy(&pattern, patternBytes, sizeof(pattern));
+
+#if defined(__SSE2__)
+        __m128i widePattern = _mm_set1_epi64x(pattern);
+        for (; size - i >= 16; i += 16) {
+          auto chunk = reinterpret_cast<__m128i*>(bytes + i);
+          _mm_storeu_si128(chunk, _mm_xor_si128(_mm_loadu_si128(chunk), widePattern));
+        }
+#endif
+        for (; size - i >= sizeof(uint64_t); i += sizeof(uint64_t)) {
+          uint64_t chunk;
+          memcpy(&chunk, bytes + i, sizeof(chunk));
+          chunk ^= pattern;
+          memcpy(bytes + i, &chunk, sizeof(chunk));
+        }
+      }
+
+      for (; i < size; i++) {
         bytes[i] ^= maskBytes[i % 4];
       }
     }
@@ -3417,6 +3683,7 @@ private:
   kj::Maybe<EntropySource&> maskKeyGenerator;
   kj::Maybe<CompressionParameters> compressionConfig;
   WebSocketErrorHandler& errorHandler;
+  WebSocketSettings settings;
 #if KJ_HAS_ZLIB
   kj::Maybe<ZlibContext> compressionContext;
   kj::Maybe<ZlibContext> decompressionContext;
@@ -3710,11 +3977,12 @@ kj::Own<WebSocket> upgradeToWebSocket(
     kj::Own<kj::AsyncIoStream> stream, HttpInputStreamImpl& httpInput, HttpOutputStream& httpOutput,
     kj::Maybe<EntropySource&> maskKeyGenerator,
     kj::Maybe<CompressionParameters> compressionConfig = kj::none,
-    kj::Maybe<WebSocketErrorHandler&> errorHandler = kj::none) {
+    kj::Maybe<WebSocketErrorHandler&> errorHandler = kj::none,
+    WebSocketSettings settings = {}) {
   // Create a WebSocket upgraded from an HTTP stream.
   auto releasedBuffer = httpInput.releaseBuffer();
   return kj::heap<WebSocketImpl>(kj::mv(stream), maskKeyGenerator,
-                                 kj::mv(compressionConfig), errorHandler,
+                                 kj::mv(compressionConfig), errorHandler, settings,
                                  kj::mv(releasedBuffer.buffer),
                                  releasedBuffer.leftover, httpOutput.flush());
 }
@@ -3724,8 +3992,10 @@ kj::Own<WebSocket> upgradeToWebSocket(
 kj::Own<WebSocket> newWebSocket(kj::Own<kj::AsyncIoStream> stream,
                                 kj::Maybe<EntropySource&> maskKeyGenerator,
                                 kj::Maybe<CompressionParameters> compressionConfig,
-                                kj::Maybe<WebSocketErrorHandler&> errorHandler) {
-  return kj::heap<WebSocketImpl>(kj::mv(stream), maskKeyGenerator, kj::mv(compressionConfig), errorHandler);
+                                kj::Maybe<WebSocketErrorHandler&> errorHandler,
+                                WebSocketSettings settings) {
+  return kj::heap<WebSocketImpl>(kj::mv(stream), maskKeyGenerator, kj::mv(compressionConfig),
+                                 errorHandler, settings);
 }
 
 static kj::Promise<void> pumpWebSocketLoop(WebSocket& from, WebSocket& to) {
@@ -5543,7 +5813,8 @@ public:
               response.statusText,
               &httpInput.getHeaders(),
               upgradeToWebSocket(kj::mv(ownStream), httpInput, httpOutput, settings.entropySource,
-                  kj::mv(compressionParameters), settings.webSocketErrorHandler),
+                  kj::mv(compressionParameters), settings.webSocketErrorHandler,
+                  settings.webSocketSettings),
             };
           } else {
             upgraded = false;
@@ -5727,6 +5998,10 @@ HttpClient::ConnectRequest HttpClient::connect(
   KJ_UNIMPLEMENTED("CONNECT is not implemented by this HttpClient");
 }
 
+kj::Promise<void> HttpClient::prewarm(kj::StringPtr url, uint count) {
+  return kj::READY_NOW;
+}
+
 kj::Own<HttpClient> newHttpClient(
     const HttpHeaderTable& responseHeaderTable, kj::AsyncIoStream& stream,
     HttpClientSettings settings) {
@@ -5915,14 +6190,87 @@ void PausableReadAsyncIoStream::reject(kj::Exception&& exc) {
 
 namespace {
 
-class NetworkAddressHttpClient final: public HttpClient {
+class IdleConnection {
+  // An idle connection tracked by an HttpConnectionPool.
+
+public:
+  virtual void evict() = 0;
+  // Closes the connection, destroying this object, to make room in the pool.
+
+  kj::ListLink<IdleConnection> poolLink;
+};
+
+}  // namespace
+
+struct HttpConnectionPool::Impl {
+  explicit Impl(uint maxIdleConnections): maxIdleConnections(maxIdleConnections) {}
+
+  uint maxIdleConnections;
+  Stats stats;
+
+  kj::List<IdleConnection, &IdleConnection::poolLink> idle;
+  // Least-recently-used first.
+
+  void add(IdleConnection& connection) {
+    idle.add(connection);
+    while (idle.size() > maxIdleConnections) {
+      ++stats.evictions;
+      idle.front().evict();
+    }
+  }
+
+  void remove(IdleConnection& connection) {
+    idle.remove(connection);
+  }
+};
+
+HttpConnectionPool::HttpConnectionPool(uint maxIdleConnections)
+    : impl(kj::heap<Impl>(maxIdleConnections)) {}
+HttpConnectionPool::~HttpConnectionPool() noexcept(false) {}
+
+HttpConnectionPool::Stats HttpConnectionPool::getStats() const {
+  auto result = impl->stats;
+  result.idleConnections = impl->idle.size();
+  return result;
+}
+
+namespace _ {
+
+class HttpConnectionPoolAccess {
+  // Lets the HttpClient implementations below get at the pool's internals.
+
+public:
+  static HttpConnectionPool::Impl& get(HttpConnectionPool& pool) { return *pool.impl; }
+};
+
+}  // namespace _
+
+namespace {
+
+class PrewarmWaiter final: public kj::Refcounted {
+  // Fulfills the promise returned by prewarm() once every connection attempt it started has
+  // finished, successfully or not. Each attempt holds a reference until then.
+
+public:
+  explicit PrewarmWaiter(kj::Own<kj::PromiseFulfiller<void>> fulfiller)
+      : fulfiller(kj::mv(fulfiller)) {}
+  ~PrewarmWaiter() noexcept(false) {
+    fulfiller->fulfill();
+  }
+
+private:
+  kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+};
+
+class NetworkAddressHttpClient final: public HttpClient, private kj::TaskSet::ErrorHandler {
 public:
   NetworkAddressHttpClient(kj::Timer& timer, const HttpHeaderTable& responseHeaderTable,
                            kj::Own<kj::NetworkAddress> address, HttpClientSettings settings)
       : timer(timer),
         responseHeaderTable(responseHeaderTable),
         address(kj::mv(address)),
-        settings(kj::mv(settings)) {}
+        settings(kj::mv(settings)),
+        prewarmTasks(*this) {}
 
   bool isDrained() {
     // Returns true if there are no open connections.
@@ -5982,6 +6330,38 @@ public:
     };
   }
 
+  kj::Promise<void> prewarm(kj::StringPtr url, uint count) override {
+    if (settings.idleTimeout <= 0 * kj::SECONDS) {
+      // The connections would be closed as soon as they were established.
+      return kj::READY_NOW;
+    }
+
+    count = kj::min(count, settings.maxIdleConnectionsPerHost);
+    size_t existing = availableClients.size() + prewarmingCount;
+    if (existing >= count) return kj::READY_NOW;
+
+    // The attempts belong to `prewarmTasks`, not to the promise we return, so that neither the
+    // caller dropping the promise nor us being destroyed first leaves anything dangling.
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    auto waiter = kj::refcounted<PrewarmWaiter>(kj::mv(paf.fulfiller));
+    for (auto i KJ_UNUSED: kj::zeroTo(count - existing)) {
+      // Count the connection as active while it's being established, so that we don't appear
+      // drained in the meantime.
+      ++prewarmingCount;
+      ++activeConnectionCount;
+      prewarmTasks.add(address->connect()
+          .then([this](kj::Own<kj::AsyncIoStream> stream) {
+        returnClientToAvailable(
+            kj::heap<HttpClientImpl>(responseHeaderTable, kj::mv(stream), settings));
+      }).attach(kj::defer([this]() {
+        --prewarmingCount;
+        --activeConnectionCount;
+        scheduleTimeouts();
+      }), kj::addRef(*waiter)));
+    }
+    return kj::mv(paf.promise);
+  }
+
 private:
   kj::Timer& timer;
   const HttpHeaderTable& responseHeaderTable;
@@ -5990,16 +6370,46 @@ private:
 
   kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> drainedFulfiller;
   uint activeConnectionCount = 0;
+  uint prewarmingCount = 0;
 
   bool timeoutsScheduled = false;
   kj::Promise<void> timeoutTask = nullptr;
 
-  struct AvailableClient {
+  struct AvailableClient final: public IdleConnection {
+    AvailableClient(NetworkAddressHttpClient& parent, kj::Own<HttpClientImpl> client,
+                    kj::TimePoint expires)
+        : parent(parent), client(kj::mv(client)), expires(expires) {}
+    ~AvailableClient() noexcept(false) {
+      if (poolLink.isLinked()) {
+        auto& pool = KJ_ASSERT_NONNULL(parent.settings.connectionPool);
+        _::HttpConnectionPoolAccess::get(pool).remove(*this);
+      }
+    }
+
+    void evict() override {
+      auto& p = parent;
+      p.availableClients.erase(self);
+      if (p.isDrained()) {
+        KJ_IF_SOME(f, p.drainedFulfiller) {
+          f->fulfill();
+          p.drainedFulfiller = kj::none;
+        }
+      }
+    }
+
+    NetworkAddressHttpClient& parent;
     kj::Own<HttpClientImpl> client;
     kj::TimePoint expires;
+    std::list<AvailableClient>::iterator self;
   };
 
-  std::deque<AvailableClient> availableClients;
+  std::list<AvailableClient> availableClients;
+  // Sorted by expiration time, which is also least-recently-used first. Idle connections are also
+  // tracked by the connection pool, if any, which may evict them from the middle of the list.
+
+  kj::TaskSet prewarmTasks;
+  // Connection attempts started by prewarm(). Declared after everything they touch, so that
+  // they're canceled first.
 
   struct RefcountedClient final: public kj::Refcounted {
     RefcountedClient(NetworkAddressHttpClient& parent, kj::Own<HttpClientImpl> client)
@@ -6022,6 +6432,9 @@ private:
   kj::Own<RefcountedClient> getClient() {
     for (;;) {
       if (availableClients.empty()) {
+        KJ_IF_SOME(pool, settings.connectionPool) {
+          ++_::HttpConnectionPoolAccess::get(pool).stats.misses;
+        }
         auto stream = newPromisedStream(address->connect());
         return kj::refcounted<RefcountedClient>(*this,
           kj::heap<HttpClientImpl>(responseHeaderTable, kj::mv(stream), settings));
@@ -6029,6 +6442,9 @@ private:
         auto client = kj::mv(availableClients.back().client);
         availableClients.pop_back();
         if (client->canReuse()) {
+          KJ_IF_SOME(pool, settings.connectionPool) {
+            ++_::HttpConnectionPoolAccess::get(pool).stats.hits;
+          }
           return kj::refcounted<RefcountedClient>(*this, kj::mv(client));
         }
         // Whoops, this client's connection was closed by the server at some point. Discard.
@@ -6039,13 +6455,31 @@ private:
   void returnClientToAvailable(kj::Own<HttpClientImpl> client) {
     // Only return the connection to the pool if it is reusable and if our settings indicate we
     // should reuse connections.
-    if (client->canReuse() && settings.idleTimeout > 0 * kj::SECONDS) {
-      availableClients.push_back(AvailableClient {
-        kj::mv(client), timer.now() + settings.idleTimeout
-      });
+    if (client->canReuse() && settings.idleTimeout > 0 * kj::SECONDS &&
+        settings.maxIdleConnectionsPerHost > 0) {
+      auto& entry = availableClients.emplace_back(
+          *this, kj::mv(client), timer.now() + settings.idleTimeout);
+      entry.self = --availableClients.end();
+
+      if (availableClients.size() > settings.maxIdleConnectionsPerHost) {
+        // Make room by closing our least-recently-used connection.
+        KJ_IF_SOME(pool, settings.connectionPool) {
+          ++_::HttpConnectionPoolAccess::get(pool).stats.evictions;
+        }
+        availableClients.pop_front();
+      }
+
+      KJ_IF_SOME(pool, settings.connectionPool) {
+        // Note that this may evict `entry` itself.
+        _::HttpConnectionPoolAccess::get(pool).add(entry);
+      }
     }
 
     // Call this either way because it also signals onDrained().
+    scheduleTimeouts();
+  }
+
+  void scheduleTimeouts() {
     if (!timeoutsScheduled) {
       timeoutsScheduled = true;
       timeoutTask = applyTimeouts();
@@ -6066,12 +6500,20 @@ private:
       auto time = availableClients.front().expires;
       return timer.atTime(time).then([this,time]() {
         while (!availableClients.empty() && availableClients.front().expires <= time) {
+          KJ_IF_SOME(pool, settings.connectionPool) {
+            ++_::HttpConnectionPoolAccess::get(pool).stats.expirations;
+          }
           availableClients.pop_front();
         }
         return applyTimeouts();
       });
     }
   }
+
+  void taskFailed(kj::Exception&& exception) override {
+    // Prewarming is best-effort: a request will simply open its own connection instead.
+    KJ_LOG(WARNING, "failed to prewarm HTTP connection", exception);
+  }
 };
 
 class TransitionaryAsyncIoStream final: public kj::AsyncIoStream {
@@ -6143,7 +6585,8 @@ private:
   kj::Own<kj::PausableReadAsyncIoStream> inner;
 };
 
-class PromiseNetworkAddressHttpClient final: public HttpClient {
+class PromiseNetworkAddressHttpClient final: public HttpClient,
+                                              private kj::TaskSet::ErrorHandler {
   // An HttpClient which waits for a promise to resolve then forwards all calls to the promised
   // client.
 
@@ -6151,7 +6594,8 @@ public:
   PromiseNetworkAddressHttpClient(kj::Promise<kj::Own<NetworkAddressHttpClient>> promise)
       : promise(promise.then([this](kj::Own<NetworkAddressHttpClient>&& client) {
           this->client = kj::mv(client);
-        }).fork()) {}
+        }).fork()),
+        prewarmTasks(*this) {}
 
   bool isDrained() {
     KJ_IF_SOME(c, client) {
@@ -6232,10 +6676,29 @@ public:
     }
   }
 
+  kj::Promise<void> prewarm(kj::StringPtr url, uint count) override {
+    KJ_IF_SOME(c, client) {
+      return c->prewarm(url, count);
+    } else {
+      // As in NetworkAddressHttpClient::prewarm(), the work belongs to us, not to the caller.
+      auto paf = kj::newPromiseAndFulfiller<void>();
+      prewarmTasks.add(promise.addBranch().then([this,url=kj::str(url),count]() {
+        return KJ_ASSERT_NONNULL(client)->prewarm(url, count);
+      }).attach(kj::refcounted<PrewarmWaiter>(kj::mv(paf.fulfiller))));
+      return kj::mv(paf.promise);
+    }
+  }
+
 private:
   kj::ForkedPromise<void> promise;
   kj::Maybe<kj::Own<NetworkAddressHttpClient>> client;
   bool failed = false;
+  kj::TaskSet prewarmTasks;
+
+  void taskFailed(kj::Exception&& exception) override {
+    // Resolving the address failed. Prewarming is best-effort, so this isn't the caller's problem.
+    KJ_LOG(WARNING, "failed to prewarm HTTP connection", exception);
+  }
 };
 
 class NetworkHttpClient final: public HttpClient, private kj::TaskSet::ErrorHandler {
@@ -6333,6 +6796,16 @@ public:
     };
   }
 
+  kj::Promise<void> prewarm(kj::StringPtr url, uint count) override {
+    Url::Options urlOptions;
+    urlOptions.allowEmpty = true;
+    urlOptions.percentDecode = false;
+
+    auto parsed = Url::parse(url, Url::HTTP_PROXY_REQUEST, urlOptions);
+    auto path = parsed.toString(Url::HTTP_REQUEST);
+    return getClient(parsed).prewarm(path, count);
+  }
+
 private:
   kj::Timer& timer;
   const HttpHeaderTable& responseHeaderTable;
@@ -6542,6 +7015,11 @@ public:
     };
   }
 
+  kj::Promise<void> prewarm(kj::StringPtr url, uint count) override {
+    // Opening idle connections doesn't count against the concurrency limit.
+    return inner.prewarm(url, count);
+  }
+
 private:
   struct ConnectionCounter;
 
@@ -7400,6 +7878,9 @@ public:
         return kj::mv(promise);
       }
 
+      // Requests that were handed to the service ahead of their turn will never get to respond.
+      pipeline.clear();
+
       return sendError(kj::mv(e));
     });
   }
@@ -7407,6 +7888,8 @@ public:
   SuspendedRequest suspend(SuspendableRequest& suspendable) {
     KJ_REQUIRE(httpInput.canSuspend(),
         "suspend() may only be called before the request body is consumed");
+    KJ_REQUIRE(pipeline.empty(),
+        "suspend() may not be called while earlier pipelined requests are still in flight");
     KJ_DEFER(suspended = true);
     auto released = httpInput.releaseBuffer();
     return {
@@ -7439,6 +7922,14 @@ private:
   kj::Maybe<kj::Promise<LoopResult>> tunnelRejected;
   kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> tunnelWriteGuard;
 
+  size_t pipelineBufferedBytes = 0;
+  // Response body bytes currently buffered by requests in `pipeline`.
+
+  class PipelinedRequest;
+  std::deque<kj::Own<PipelinedRequest>> pipeline;
+  // Requests that were handed to the HttpService before it was their turn to respond, oldest
+  // first. Only used when HttpServerSettings::maxPipelinedRequests > 1.
+
   static HttpInputStreamImpl makeHttpInput(
       kj::AsyncIoStream& stream,
       const kj::HttpHeaderTable& table,
@@ -7571,6 +8062,12 @@ private:
   }
 
   kj::Promise<LoopResult> onHeaders(HttpHeaders::RequestConnectOrProtocolError&& requestOrProtocolError) {
+    if (!pipeline.empty() && !requestOrProtocolError.is<HttpHeaders::Request>()) {
+      // Whatever happens next, the requests already in flight get to respond first.
+      auto result = co_await finishPipelined();
+      if (result != CONTINUE_LOOP) co_return result;
+    }
+
     if (timedOut) {
       // Client took too long to send anything, so we're going to close the connection. In
       // theory, we should send back an HTTP 408 error -- it is designed exactly for this
@@ -7697,7 +8194,11 @@ private:
   kj::Promise<LoopResult> onRequest(HttpHeaders::Request& request) {
     auto& headers = httpInput.getHeaders();
 
-    currentMethod = request.method;
+    if (pipeline.empty()) {
+      // (If earlier requests still have to respond, then so much as an error response to this one
+      // would go out of order, so we don't offer it a Response until its turn.)
+      currentMethod = request.method;
+    }
 
     SuspendableRequest suspendable(*this, request.method, request.url, headers);
     auto maybeService = factory(suspendable);
@@ -7717,9 +8218,69 @@ private:
     auto body = httpInput.getEntityBody(
         HttpInputStreamImpl::REQUEST, request.method, 0, headers);
 
+    if (server.settings.maxPipelinedRequests > 1 && httpInput.canReuse() &&
+        !headers.isWebSocket()) {
+      co_return co_await dispatchPipelined(request, headers, kj::mv(service), kj::mv(body));
+    }
+
+    if (!pipeline.empty()) {
+      // This request can't be handled ahead of its turn, so let everything in flight respond
+      // first. Its body stays unread in the meantime.
+      auto result = co_await finishPipelined();
+      if (result != CONTINUE_LOOP) co_return result;
+      currentMethod = request.method;
+    }
+
     co_await service->request(
         request.method, request.url, headers, *body, *this).attach(kj::mv(service));
-    // Response done. Await next request.
+    co_return co_await finishRequest(kj::mv(body));
+  }
+
+  kj::Promise<LoopResult> dispatchPipelined(
+      HttpHeaders::Request& request, const HttpHeaders& headers,
+      kj::Own<HttpService> service, kj::Own<kj::AsyncInputStream> body) {
+    // `request` has no body, so the client may have already sent the next request right behind
+    // it. Start handling this one now, with its own copy of everything it needs from the input
+    // buffer, and go back to reading while it runs -- but only if the next request's headers are
+    // already here. Otherwise, waiting on the network for them would hold up responses that are
+    // ready to go, so let everything in flight respond first.
+
+    currentMethod = kj::none;
+    pipeline.push_back(kj::heap<PipelinedRequest>(*this, request.method, kj::str(request.url),
+        headers.clone(), kj::mv(service), kj::mv(body)));
+
+    if (pipeline.size() < server.settings.maxPipelinedRequests &&
+        httpInput.hasBufferedMessageHeader() && !server.draining) {
+      return CONTINUE_LOOP;
+    }
+
+    return finishPipelined();
+  }
+
+  kj::Promise<LoopResult> finishPipelined() {
+    // Lets each request in `pipeline` respond in turn, oldest first.
+
+    while (!pipeline.empty()) {
+      auto head = kj::mv(pipeline.front());
+      pipeline.pop_front();
+
+      currentMethod = head->getMethod();
+      co_await head->finish(*this);
+
+      auto result = co_await finishRequest(kj::none);
+      if (result != CONTINUE_LOOP) {
+        pipeline.clear();
+        co_return result;
+      }
+    }
+
+    co_return CONTINUE_LOOP;
+  }
+
+  kj::Promise<LoopResult> finishRequest(kj::Maybe<kj::Own<kj::AsyncInputStream>> body) {
+    // Called once the HttpService is done with a request, to decide what happens to the
+    // connection. `body` is kj::none for a pipelined request, whose body was fully read before
+    // any request behind it.
 
     KJ_IF_SOME(p, webSocketError) {
       // sendWebSocketError() was called. Finish sending and close the connection.
@@ -7756,7 +8317,7 @@ private:
 
     co_await httpOutput.flush();
 
-    if (httpInput.canReuse()) {
+    if (body == kj::none || httpInput.canReuse()) {
       // Things look clean. Go ahead and accept the next request.
 
       if (closeAfterSend) {
@@ -7789,9 +8350,10 @@ private:
       // enough at connection management. The best we can do is give the client some grace
       // period and then abort the connection.
 
+      auto& unreadBody = KJ_ASSERT_NONNULL(body);
       auto dummy = kj::heap<HttpDiscardingEntityWriter>();
       auto lengthGrace = kj::evalNow([&]() {
-        return body->pumpTo(*dummy, server.settings.canceledUploadGraceBytes);
+        return unreadBody->pumpTo(*dummy, server.settings.canceledUploadGraceBytes);
       }).catch_([](kj::Exception&& e) -> uint64_t {
         // Reading from the input failed in some way. This may actually be the whole
         // reason we got here in the first place so don't propagate this error, just
@@ -7989,7 +8551,8 @@ private:
     kj::Own<kj::AsyncIoStream> ownStream(&stream, kj::NullDisposer::instance);
     return upgradeToWebSocket(ownStream.attach(kj::mv(deferNoteClosed)),
                               httpInput, httpOutput, kj::none, kj::mv(acceptedParameters),
-                             server.settings.webSocketErrorHandler);
+                             server.settings.webSocketErrorHandler,
+                             server.settings.webSocketSettings);
   }
 
   kj::Promise<LoopResult> sendError(HttpHeaders::ProtocolError protocolError) {
@@ -8133,6 +8696,171 @@ private:
     closeAfterSend = true;
     return send(statusCode, statusText, headers, expectedBodySize);
   }
+
+  class PipelinedRequest final: private HttpService::Response {
+    // A request that was handed to the HttpService before the responses to earlier requests on
+    // the connection were done. Until its turn comes, its response is buffered here (up to
+    // HttpServerSettings::pipelineBufferBytes across the connection); finish() then replays it on
+    // the connection and forwards everything after that.
+
+  public:
+    PipelinedRequest(Connection& connection, HttpMethod method, kj::String url,
+                     HttpHeaders headers, kj::Own<HttpService> service,
+                     kj::Own<kj::AsyncInputStream> body)
+        : connection(connection), method(method), url(kj::mv(url)), headers(kj::mv(headers)),
+          service(kj::mv(service)), body(kj::mv(body)),
+          handler(this->service->request(method, this->url, this->headers, *this->body, *this)
+              .eagerlyEvaluate(nullptr)) {}
+    ~PipelinedRequest() noexcept(false) {
+      KJ_IF_SOME(r, response) {
+        connection.pipelineBufferedBytes -= r.body.size();
+      }
+    }
+
+    HttpMethod getMethod() { return method; }
+
+    kj::Promise<void> finish(HttpService::Response& connectionResponse) {
+      // Called when it's this request's turn to respond. Completes when the HttpService is done
+      // with the request.
+
+      target = connectionResponse;
+
+      KJ_IF_SOME(r, response) {
+        auto stream = connectionResponse.send(
+            r.statusCode, r.statusText, r.headers, r.expectedBodySize);
+        if (r.body.size() > 0) {
+          co_await stream->write(r.body.begin(), r.body.size());
+          connection.pipelineBufferedBytes -= r.body.size();
+          r.body = kj::Vector<byte>();
+        }
+
+        if (bodyStreamAlive) {
+          out = kj::mv(stream);
+          KJ_IF_SOME(w, waiter) {
+            w->fulfill();
+            waiter = kj::none;
+          }
+        }
+        // Otherwise, the service already dropped its body stream, so dropping `stream` here ends
+        // the body.
+      }
+
+      co_await handler;
+    }
+
+  private:
+    class BodyStream final: public kj::AsyncOutputStream {
+    public:
+      BodyStream(PipelinedRequest& request): request(request) {}
+      ~BodyStream() noexcept(false) {
+        request.bodyStreamAlive = false;
+        request.out = kj::none;
+      }
+
+      kj::Promise<void> write(const void* buffer, size_t size) override {
+        KJ_IF_SOME(o, request.out) {
+          return o->write(buffer, size);
+        }
+        if (request.canBuffer(size)) {
+          request.buffer(kj::arrayPtr(reinterpret_cast<const byte*>(buffer), size));
+          return kj::READY_NOW;
+        }
+        return request.whenForwarding().then([this, buffer, size]() {
+          return KJ_ASSERT_NONNULL(request.out)->write(buffer, size);
+        });
+      }
+      kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
+        KJ_IF_SOME(o, request.out) {
+          return o->write(pieces);
+        }
+        size_t size = 0;
+        for (auto& piece: pieces) size += piece.size();
+        if (request.canBuffer(size)) {
+          for (auto& piece: pieces) request.buffer(piece);
+          return kj::READY_NOW;
+        }
+        return request.whenForwarding().then([this, pieces]() {
+          return KJ_ASSERT_NONNULL(request.out)->write(pieces);
+        });
+      }
+
+      kj::Promise<void> whenWriteDisconnected() override {
+        return request.connection.httpOutput.whenWriteDisconnected();
+      }
+
+    private:
+      PipelinedRequest& request;
+    };
+
+    struct BufferedResponse {
+      uint statusCode;
+      kj::String statusText;
+      HttpHeaders headers;
+      kj::Maybe<uint64_t> expectedBodySize;
+      kj::Vector<byte> body;
+    };
+
+    Connection& connection;
+    HttpMethod method;
+    kj::String url;
+    HttpHeaders headers;
+    kj::Own<HttpService> service;
+    kj::Own<kj::AsyncInputStream> body;
+
+    kj::Maybe<BufferedResponse> response;
+    // What the service sent before our turn came.
+
+    bool bodyStreamAlive = false;
+    // Whether the service still holds the BodyStream returned by send().
+
+    kj::Maybe<HttpService::Response&> target;
+    // The connection's own Response, once it's our turn.
+
+    kj::Maybe<kj::Own<kj::AsyncOutputStream>> out;
+    // The connection's body stream for our response, once buffered data has been replayed.
+
+    kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> waiter;
+    // A write that didn't fit in the buffer, waiting for `out`.
+
+    kj::Promise<void> handler;
+    // Declared last so that the service's handler is canceled before anything it might use.
+
+    kj::Own<kj::AsyncOutputStream> send(
+        uint statusCode, kj::StringPtr statusText, const HttpHeaders& responseHeaders,
+        kj::Maybe<uint64_t> expectedBodySize) override {
+      KJ_IF_SOME(t, target) {
+        return t.send(statusCode, statusText, responseHeaders, expectedBodySize);
+      }
+
+      KJ_REQUIRE(response == kj::none, "already called send()");
+      response = BufferedResponse {
+        statusCode, kj::str(statusText), responseHeaders.clone(), expectedBodySize, {}
+      };
+      bodyStreamAlive = true;
+      return kj::heap<BodyStream>(*this);
+    }
+
+    kj::Own<WebSocket> acceptWebSocket(const HttpHeaders& responseHeaders) override {
+      KJ_FAIL_REQUIRE(
+          "can't call acceptWebSocket() if the request headers didn't have Upgrade: WebSocket");
+    }
+
+    bool canBuffer(size_t size) {
+      return target == kj::none && connection.pipelineBufferedBytes + size <=
+          connection.server.settings.pipelineBufferBytes;
+    }
+
+    void buffer(kj::ArrayPtr<const byte> bytes) {
+      KJ_ASSERT_NONNULL(response).body.addAll(bytes);
+      connection.pipelineBufferedBytes += bytes.size();
+    }
+
+    kj::Promise<void> whenForwarding() {
+      auto paf = kj::newPromiseAndFulfiller<void>();
+      waiter = kj::mv(paf.fulfiller);
+      return kj::mv(paf.promise);
+    }
+  };
 };
 
 HttpServer::HttpServer(kj::Timer& timer, const HttpHeaderTable& requestHeaderTable,
@@ -106,6 +106,7 @@ kj::Maybe<kj::OneOf<HttpMethod, HttpConnectMethod>> tryParseHttpMethodAllowingCo
 // breaking API changes in existing uses of tryParseHttpMethod.
 
 class HttpHeaderTable;
+class FrozenHttpHeaders;
 
 class HttpHeaderId {
   // Identifies an HTTP header by numeric ID that indexes into an HttpHeaderTable.
@@ -353,7 +354,8 @@ public:
   //   `takeOwnership()`.
 
   void unset(HttpHeaderId id);
-  // Removes a header.
+  // Removes a header. Removing a frozen header (see setFrozen()) first copies the whole frozen
+  // block into this object as ordinary headers, since the block itself is shared and can't change.
   //
   // It's not possible to remove a header by string name because non-indexed headers would take
   // O(n) time to remove. Instead, construct a new HttpHeaders object and copy contents.
@@ -364,6 +366,17 @@ public:
   // Takes ownership of a string so that it lives until the HttpHeaders object is destroyed. Useful
   // when you've passed a dynamic value to set() or add() or parse*().
 
+  void setFrozen(const FrozenHttpHeaders& frozen);
+  // Includes a pre-serialized block of headers in this set. get(), forEach() and size() see the
+  // frozen headers as if they had been added directly, and serialization copies the frozen block
+  // verbatim rather than re-serializing each header. The frozen headers must come from the same
+  // HttpHeaderTable and must outlive this object, or until clear() is called or a frozen header
+  // is unset(). Shallow clones (cloneShallow()) borrow it too; clone() copies it.
+  //
+  // An indexed header can't be both frozen and set directly: set() or add() of a header that the
+  // frozen block already contains throws. Unindexed headers may repeat. Only one frozen block can
+  // be attached at a time; calling setFrozen() again replaces it.
+
   struct Request {
     HttpMethod method;
     kj::StringPtr url;
@@ -477,6 +490,15 @@ private:
 
   kj::Vector<kj::Array<char>> ownedStrings;
 
+  kj::Maybe<const FrozenHttpHeaders&> frozen;
+  // Borrowed, like `table`: the caller of setFrozen() keeps the frozen headers alive for as long
+  // as this is set. Typically they're built once at startup and shared by every response.
+
+  void requireNotFrozen(HttpHeaderId id) const;
+  void thaw();
+
+  friend class FrozenHttpHeaders;
+
   void addNoCheck(kj::StringPtr name, kj::StringPtr value);
 
   kj::StringPtr cloneToOwn(kj::StringPtr str);
@@ -493,6 +515,31 @@ private:
   //   also add direct accessors for those headers.
 };
 
+class FrozenHttpHeaders {
+  // A set of headers that is serialized once and then shared by many messages, e.g. the Server,
+  // Content-Type and Cache-Control headers of a static-content endpoint. Attach it to each
+  // response's HttpHeaders with HttpHeaders::setFrozen(), then set only the headers that vary.
+  //
+  // Connection-level headers (Content-Length, Transfer-Encoding, Connection, Upgrade, etc.) are
+  // computed per message by HttpServer and HttpClient, so they can't be frozen.
+
+public:
+  explicit FrozenHttpHeaders(const HttpHeaders& headers);
+  // Makes a deep copy of `headers`.
+
+  KJ_DISALLOW_COPY_AND_MOVE(FrozenHttpHeaders);
+
+  const HttpHeaders& getHeaders() const { return headers; }
+
+  kj::ArrayPtr<const char> getSerialized() const { return text.slice(0, text.size() - 2); }
+  // The serialized header lines, each terminated by CRLF, without the blank line that ends a
+  // header block.
+
+private:
+  HttpHeaders headers;
+  kj::String text;
+};
+
 struct HttpByteRange {
   // Inclusive HTTP range
 
@@ -885,6 +932,20 @@ public:
   //
   // The `host` and `headers` need only remain valid until `connect()` returns (it can be
   // stack-allocated).
+
+  virtual kj::Promise<void> prewarm(kj::StringPtr url, uint count);
+  // Opens connections ahead of time, so that up to `count` requests to the host of `url` can start
+  // without waiting for a connection to be established. The promise resolves once the
+  // connections are established and idle. As with `request()`, `url` is a full URL for proxy
+  // clients and is otherwise ignored. Prewarmed connections are subject to the usual idle timeout
+  // and idle limits, so no more than `HttpClientSettings::maxIdleConnectionsPerHost` are opened.
+  //
+  // Prewarming is best-effort: connections that fail to open are logged and skipped, and the
+  // promise still resolves once every attempt has finished. The attempts belong to the client, so
+  // the promise may be dropped early; they're canceled when the client is destroyed.
+  //
+  // The default implementation does nothing, which is appropriate for clients that don't manage
+  // their own connections.
 };
 
 class HttpService {
@@ -1034,11 +1095,73 @@ public:
   // exception from being thrown.
 };
 
+struct WebSocketSettings {
+  bool validateUtf8 = false;
+  // If true, every received text message is checked to be valid UTF-8, as RFC 6455 requires, and
+  // the connection is failed with close code 1007 if it isn't. This costs an extra pass over each
+  // text message, so it's off by default; most applications validate text anyway when they parse
+  // it, or pass it on to something that does.
+};
+
+namespace _ { class HttpConnectionPoolAccess; }
+
+class HttpConnectionPool {
+  // Limits the number of idle connections kept open by one or more HttpClients, across all of the
+  // hosts they talk to, and keeps statistics about connection reuse. Attach it to clients via
+  // `HttpClientSettings::connectionPool`. Only clients which automatically create new connections
+  // (those created with `newHttpClient()` taking a Network or NetworkAddress) use the pool.
+  //
+  // When the limit is reached, the least-recently-used idle connection is closed to make room,
+  // regardless of which host or client it belongs to. Per-host limits and idle timeouts are
+  // configured separately, in HttpClientSettings.
+  //
+  // The pool must outlive all clients using it. It is not thread-safe; all clients sharing it must
+  // run in the same thread.
+
+public:
+  explicit HttpConnectionPool(uint maxIdleConnections = kj::maxValue);
+  ~HttpConnectionPool() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(HttpConnectionPool);
+
+  struct Stats {
+    uint64_t hits = 0;
+    // Requests which reused an idle connection.
+
+    uint64_t misses = 0;
+    // Requests which had to open a new connection.
+
+    uint64_t evictions = 0;
+    // Idle connections closed to stay within the pool's limit or a per-host limit.
+
+    uint64_t expirations = 0;
+    // Idle connections closed after `HttpClientSettings::idleTimeout`.
+
+    uint idleConnections = 0;
+    // Number of idle connections currently open.
+  };
+
+  Stats getStats() const;
+
+private:
+  struct Impl;
+  kj::Own<Impl> impl;
+
+  friend class _::HttpConnectionPoolAccess;
+};
+
 struct HttpClientSettings {
   kj::Duration idleTimeout = 5 * kj::SECONDS;
   // For clients which automatically create new connections, any connection idle for at least this
   // long will be closed. Set this to 0 to prevent connection reuse entirely.
 
+  uint maxIdleConnectionsPerHost = kj::maxValue;
+  // For clients which automatically create new connections, the maximum number of idle
+  // connections kept open to each host. Past this, the least-recently-used one is closed.
+
+  kj::Maybe<HttpConnectionPool&> connectionPool = kj::none;
+  // For clients which automatically create new connections, a pool shared with other clients
+  // which limits the total number of idle connections and counts connection reuse.
+
   kj::Maybe<EntropySource&> entropySource = kj::none;
   // Must be provided in order to use `openWebSocket`. If you don't need WebSockets, this can be
   // omitted. The WebSocket protocol uses random values to avoid triggering flaws (including
@@ -1062,6 +1185,9 @@ struct HttpClientSettings {
   kj::Maybe<WebSocketErrorHandler&> webSocketErrorHandler = kj::none;
   // Customize exceptions thrown on WebSocket protocol errors.
 
+  WebSocketSettings webSocketSettings;
+  // Settings for WebSockets returned by openWebSocket().
+
   kj::Maybe<SecureNetworkWrapper&> tlsContext;
   // A reference to a TLS context that will be used when tlsStarter is invoked.
 };
@@ -1134,7 +1260,8 @@ kj::Own<HttpInputStream> newHttpInputStream(
 kj::Own<WebSocket> newWebSocket(kj::Own<kj::AsyncIoStream> stream,
                                 kj::Maybe<EntropySource&> maskEntropySource,
                                 kj::Maybe<CompressionParameters> compressionConfig = kj::none,
-                                kj::Maybe<WebSocketErrorHandler&> errorHandler = kj::none);
+                                kj::Maybe<WebSocketErrorHandler&> errorHandler = kj::none,
+                                WebSocketSettings settings = {});
 // Create a new WebSocket on top of the given stream. It is assumed that the HTTP -> WebSocket
 // upgrade handshake has already occurred (or is not needed), and messages can immediately be
 // sent and received on the stream. Normally applications would not call this directly.
@@ -1153,6 +1280,8 @@ kj::Own<WebSocket> newWebSocket(kj::Own<kj::AsyncIoStream> stream,
 //
 // `errorHandler` is an optional argument that lets callers throw custom exceptions for WebSocket
 // protocol errors.
+//
+// `settings` controls optional protocol checks; see WebSocketSettings.
 
 struct WebSocketPipe {
   kj::Own<WebSocket> ends[2];
@@ -1183,6 +1312,19 @@ struct HttpServerSettings {
   // above two values -- if they hit either one, we'll close the socket, but if the request
   // completes, we'll let the connection stay open to handle more requests.
 
+  uint maxPipelinedRequests = 1;
+  // When greater than 1, the server keeps reading pipelined requests while earlier ones are still
+  // being handled, and calls HttpService::request() for up to this many at a time on each
+  // connection. Responses are still written in the order the requests arrived. Only requests
+  // without a body (and that aren't WebSocket upgrades) are handled ahead like this; any other
+  // request waits for every earlier response to finish first. A SuspendableHttpServiceFactory
+  // can't suspend a request while earlier ones are still in flight.
+
+  size_t pipelineBufferBytes = 65536;
+  // Limits how many bytes of response body each connection will hold in memory on behalf of
+  // requests handled ahead of their turn. Once the limit is reached, further writes from those
+  // requests wait until their response can go out on the connection.
+
   kj::Maybe<HttpServerErrorHandler&> errorHandler = kj::none;
   // Customize how client protocol errors and service application exceptions are handled by the
   // HttpServer. If null, HttpServerErrorHandler's default implementation will be used.
@@ -1193,6 +1335,9 @@ struct HttpServerSettings {
   kj::Maybe<WebSocketErrorHandler&> webSocketErrorHandler = kj::none;
   // Customize exceptions thrown on WebSocket protocol errors.
 
+  WebSocketSettings webSocketSettings;
+  // Settings for WebSockets returned by Response::acceptWebSocket().
+
   enum WebSocketCompressionMode {
     NO_COMPRESSION,
     MANUAL_COMPRESSION,    // Gives the application more control when considering whether to compress.
@@ -1442,11 +1587,22 @@ inline kj::StringPtr HttpHeaderTable::idToString(HttpHeaderId id) const {
 inline kj::Maybe<kj::StringPtr> HttpHeaders::get(HttpHeaderId id) const {
   id.requireFrom(*table);
   auto result = indexedHeaders[id.id];
-  return result == nullptr ? kj::Maybe<kj::StringPtr>(kj::none) : result;
+  if (result == nullptr) {
+    KJ_IF_SOME(f, frozen) {
+      return f.getHeaders().get(id);
+    }
+    return kj::none;
+  }
+  return result;
 }
 
 inline void HttpHeaders::unset(HttpHeaderId id) {
   id.requireFrom(*table);
+  KJ_IF_SOME(f, frozen) {
+    if (f.getHeaders().indexedHeaders[id.id] != nullptr) {
+      thaw();
+    }
+  }
   indexedHeaders[id.id] = nullptr;
 }
 
@@ -1461,6 +1617,10 @@ inline void HttpHeaders::forEach(Func&& func) const {
   for (auto& header: unindexedHeaders) {
     func(header.name, header.value);
   }
+
+  KJ_IF_SOME(f, frozen) {
+    f.getHeaders().forEach(func);
+  }
 }
 
 template <typename Func1, typename Func2>
@@ -1471,9 +1631,25 @@ inline void HttpHeaders::forEach(Func1&& func1, Func2&& func2) const {
     }
   }
 
+  KJ_IF_SOME(f, frozen) {
+    // Frozen and direct indexed headers never overlap, so no need to skip any here.
+    auto& frozenIndexed = f.getHeaders().indexedHeaders;
+    for (auto i: kj::indices(frozenIndexed)) {
+      if (frozenIndexed[i] != nullptr) {
+        func1(HttpHeaderId(table, i), frozenIndexed[i]);
+      }
+    }
+  }
+
   for (auto& header: unindexedHeaders) {
     func2(header.name, header.value);
   }
+
+  KJ_IF_SOME(f, frozen) {
+    for (auto& header: f.getHeaders().unindexedHeaders) {
+      func2(header.name, header.value);
+    }
+  }
 }
 
 // =======================================================================================
@@ -48,6 +48,10 @@ public:
   bool isAtEnd() { return eof; }
   // Returns true if read() would return zero.
 
+  bool isIdle() { return !isPumping && content.size() == 0; }
+  // Returns true if no data is buffered and no read from the underlying stream is in progress,
+  // i.e. everything read from the underlying stream so far has been consumed.
+
 private:
   AsyncInputStream& input;
   kj::ForkedPromise<void> pumpTask = nullptr;
@@ -76,6 +80,9 @@ public:
   kj::Promise<void> whenReady();
   // Returns a promise that resolves when write() will return non-null.
 
+  bool isIdle() { return !isPumping && filled == 0; }
+  // Returns true if everything passed to write() so far has been written to the underlying stream.
+
   class Cork;
   // An object that, when destructed, will uncork its parent stream.
 
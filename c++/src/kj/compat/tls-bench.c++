@@ -0,0 +1,123 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks for TLS connection setup. Run with `--benchmark-time <seconds>` to get useful
+// timings; by default each benchmark runs once, as a smoke test.
+
+#if KJ_HAS_OPENSSL
+
+#include "tls.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+
+// The benchmark generates its own certificate, which requires OpenSSL directly.
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+namespace kj {
+namespace {
+
+String toPem(int (*write)(BIO*, void*), void* object) {
+  BIO* bio = BIO_new(BIO_s_mem());
+  KJ_ASSERT(bio != nullptr);
+  KJ_DEFER(BIO_free(bio));
+  KJ_ASSERT(write(bio, object) > 0);
+  char* data;
+  long size = BIO_get_mem_data(bio, &data);
+  return heapString(data, size);
+}
+
+TlsKeypair makeSelfSignedKeypair(StringPtr hostname) {
+  EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  KJ_ASSERT(pctx != nullptr);
+  KJ_DEFER(EVP_PKEY_CTX_free(pctx));
+  EVP_PKEY* pkey = nullptr;
+  KJ_ASSERT(EVP_PKEY_keygen_init(pctx) > 0);
+  KJ_ASSERT(EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx, NID_X9_62_prime256v1) > 0);
+  KJ_ASSERT(EVP_PKEY_keygen(pctx, &pkey) > 0);
+  KJ_DEFER(EVP_PKEY_free(pkey));
+
+  X509* cert = X509_new();
+  KJ_ASSERT(cert != nullptr);
+  KJ_DEFER(X509_free(cert));
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+      reinterpret_cast<const byte*>(hostname.cStr()), -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_set_pubkey(cert, pkey);
+  KJ_ASSERT(X509_sign(cert, pkey, EVP_sha256()) > 0);
+
+  auto keyPem = toPem([](BIO* bio, void* key) {
+    return PEM_write_bio_PrivateKey(bio, reinterpret_cast<EVP_PKEY*>(key),
+                                    nullptr, nullptr, 0, nullptr, nullptr);
+  }, pkey);
+  auto certPem = toPem([](BIO* bio, void* x509) {
+    return PEM_write_bio_X509(bio, reinterpret_cast<X509*>(x509));
+  }, cert);
+
+  return { TlsPrivateKey(keyPem), TlsCertificate(certPem) };
+}
+
+KJ_TEST("benchmark: TLS handshakes") {
+  auto io = setupAsyncIo();
+  auto keypair = makeSelfSignedKeypair("example.com");
+
+  // Each iteration connects a client over a loopback socket pair and exchanges one byte, which
+  // in TLS 1.3 is also what delivers the session to the client.
+  auto run = [&](StringPtr label, bool resumeSessions) {
+    TlsContext::Options serverOptions;
+    serverOptions.defaultKeypair = keypair;
+    serverOptions.resumeSessions = resumeSessions;
+    TlsContext server(kj::mv(serverOptions));
+
+    TlsContext::Options clientOptions;
+    clientOptions.useSystemTrustStore = false;
+    clientOptions.trustedCertificates = arrayPtr(&keypair.certificate, 1);
+    clientOptions.resumeSessions = resumeSessions;
+    TlsContext client(kj::mv(clientOptions));
+
+    doBenchmark(label, 0, [&]() {
+      auto pipe = io.provider->newTwoWayPipe();
+      auto serverPromise = server.wrapServer(kj::mv(pipe.ends[1]));
+      auto clientConn = client.wrapClient(kj::mv(pipe.ends[0]), "example.com")
+          .wait(io.waitScope);
+      auto serverConn = serverPromise.wait(io.waitScope);
+
+      char c;
+      serverConn->write("x", 1).wait(io.waitScope);
+      clientConn->read(&c, 1).wait(io.waitScope);
+    });
+  };
+
+  run("full handshake", false);
+  run("resumed handshake", true);
+}
+
+}  // namespace
+}  // namespace kj
+
+#endif  // KJ_HAS_OPENSSL
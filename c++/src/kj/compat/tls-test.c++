@@ -42,8 +42,27 @@
 #endif
 
 #include <kj/async-io.h>
+#include <kj/encoding.h>
+#include <kj/filesystem.h>
 #include <kj/test.h>
 
+#if __linux__ && !defined(OPENSSL_IS_BORINGSSL) && !defined(LIBRESSL_VERSION_NUMBER) && \
+    OPENSSL_VERSION_NUMBER >= 0x10101000L && __has_include(<linux/tls.h>)
+// The conditions under which tls.c++ supports kernel TLS.
+#define KJ_TEST_KTLS 1
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#else
+#define KJ_TEST_KTLS 0
+#endif
+
 namespace kj {
 namespace {
 
@@ -686,6 +705,320 @@ KJ_TEST("TLS full duplex") {
   writeDown.wait(test.io.waitScope);
 }
 
+KJ_TEST("TLS kernel offload") {
+  // Kernel TLS is opportunistic: if the kernel can't take over (e.g. the `tls` module isn't
+  // available), the connection keeps using OpenSSL. Either way, behavior must be the same.
+
+  auto clientOptions = TlsTest::defaultClient();
+  clientOptions.kernelTls = true;
+  auto serverOptions = TlsTest::defaultServer();
+  serverOptions.kernelTls = true;
+  TlsTest test(kj::mv(clientOptions), kj::mv(serverOptions));
+  ErrorNexus e;
+
+  // Kernel TLS requires TCP, so we can't use newTwoWayPipe().
+  auto& network = test.io.provider->getNetwork();
+  auto listener = network.parseAddress("127.0.0.1", 0).wait(test.io.waitScope)->listen();
+  auto serverPromise = e.wrap(listener->accept().then([&](kj::Own<kj::AsyncIoStream> stream) {
+    return test.tlsServer.wrapServer(kj::mv(stream));
+  }));
+  auto clientPromise = e.wrap(network.parseAddress("127.0.0.1", listener->getPort())
+      .then([](kj::Own<kj::NetworkAddress> addr) { return addr->connect(); })
+      .then([&](kj::Own<kj::AsyncIoStream> stream) {
+    return test.tlsClient.wrapClient(kj::mv(stream), "example.com");
+  }));
+
+  auto client = clientPromise.wait(test.io.waitScope);
+  auto server = serverPromise.wait(test.io.waitScope);
+
+  test.testConnection(*client, *server);
+
+  // Send enough to span many records in each direction, with the server side pumping from a
+  // file (which can use sendfile() when the kernel is encrypting).
+  auto big = kj::heapString(1 << 20);
+  for (auto i: kj::indices(big)) big[i] = 'a' + i % 26;
+
+  auto fs = kj::newDiskFilesystem();
+  auto file = fs->getCurrent().createTemporary();
+  file->writeAll(big);
+
+  {
+    auto readPromise = client->readAllText();
+    FileInputStream input(*file);
+    KJ_EXPECT(input.pumpTo(*server).wait(test.io.waitScope) == big.size());
+    server->shutdownWrite();
+    KJ_EXPECT((readPromise.wait(test.io.waitScope) == big));
+  }
+
+  {
+    auto readPromise = server->readAllText();
+    client->write(big.begin(), big.size()).wait(test.io.waitScope);
+    client->shutdownWrite();
+    KJ_EXPECT((readPromise.wait(test.io.waitScope) == big));
+  }
+}
+
+#if KJ_TEST_KTLS
+KJ_TEST("TLS kernel offload takes over the socket") {
+  // The test above passes whether or not the kernel takes over. Where the kernel supports it,
+  // check that it actually does, and that data still makes it through both ways.
+
+  auto clientOptions = TlsTest::defaultClient();
+  clientOptions.kernelTls = true;
+  auto serverOptions = TlsTest::defaultServer();
+  serverOptions.kernelTls = true;
+  TlsTest test(kj::mv(clientOptions), kj::mv(serverOptions));
+  ErrorNexus e;
+
+  auto& network = test.io.provider->getNetwork();
+  auto listener = network.parseAddress("127.0.0.1", 0).wait(test.io.waitScope)->listen();
+  auto address = network.parseAddress("127.0.0.1", listener->getPort()).wait(test.io.waitScope);
+
+  {
+    // Find out whether the kernel has the `tls` module, using a plain connection.
+    auto serverPromise = listener->accept();
+    auto client = address->connect().wait(test.io.waitScope);
+    auto server = serverPromise.wait(test.io.waitScope);
+    int fd = KJ_ASSERT_NONNULL(client->getFd());
+    if (::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+      int error = errno;
+      if (error == ENOENT) {
+        KJ_LOG(WARNING, "kernel TLS not supported by this kernel; skipping test");
+        return;
+      }
+      KJ_FAIL_SYSCALL("setsockopt(TCP_ULP)", error);
+    }
+  }
+
+  int serverFd = -1;
+  int clientFd = -1;
+  auto serverPromise = e.wrap(listener->accept().then([&](kj::Own<kj::AsyncIoStream> stream) {
+    serverFd = KJ_ASSERT_NONNULL(stream->getFd());
+    return test.tlsServer.wrapServer(kj::mv(stream));
+  }));
+  auto clientPromise = e.wrap(address->connect()
+      .then([&](kj::Own<kj::AsyncIoStream> stream) {
+    clientFd = KJ_ASSERT_NONNULL(stream->getFd());
+    return test.tlsClient.wrapClient(kj::mv(stream), "example.com");
+  }));
+
+  auto client = clientPromise.wait(test.io.waitScope);
+  auto server = serverPromise.wait(test.io.waitScope);
+
+  // Exchange some data first: each side hands reception to the kernel only once OpenSSL has
+  // consumed everything it buffered during the handshake.
+  test.testConnection(*client, *server);
+
+  for (int fd: {clientFd, serverFd}) {
+    char ulp[16];
+    memset(ulp, 0, sizeof(ulp));
+    socklen_t len = sizeof(ulp);
+    KJ_SYSCALL(::getsockopt(fd, SOL_TCP, TCP_ULP, ulp, &len));
+    KJ_EXPECT(kj::StringPtr(ulp) == "tls");
+
+    // These fail with EBUSY unless we installed keys in that direction.
+    byte info[64];
+    len = sizeof(info);
+    KJ_SYSCALL(::getsockopt(fd, SOL_TLS, TLS_TX, info, &len));
+    len = sizeof(info);
+    KJ_SYSCALL(::getsockopt(fd, SOL_TLS, TLS_RX, info, &len));
+  }
+
+  // If the kernel had the wrong keys or sequence numbers, the peer (whichever side is decrypting)
+  // would fail here.
+  auto big = kj::heapString(1 << 20);
+  for (auto i: kj::indices(big)) big[i] = 'a' + i % 26;
+
+  {
+    auto readPromise = server->readAllText();
+    client->write(big.begin(), big.size()).wait(test.io.waitScope);
+    client->shutdownWrite();
+    KJ_EXPECT((readPromise.wait(test.io.waitScope) == big));
+  }
+
+  {
+    auto readPromise = client->readAllText();
+    server->write(big.begin(), big.size()).wait(test.io.waitScope);
+    server->shutdownWrite();
+    KJ_EXPECT((readPromise.wait(test.io.waitScope) == big));
+  }
+}
+
+KJ_TEST("TLS 1.2 key expansion") {
+  // Expected values come from an independent implementation of the TLS 1.2 PRF, which reproduces
+  // the widely published P_SHA256 test vector.
+
+  byte masterSecret[48];
+  byte clientRandom[32];
+  byte serverRandom[32];
+  for (uint i = 0; i < sizeof(masterSecret); i++) masterSecret[i] = i;
+  for (uint i = 0; i < sizeof(clientRandom); i++) clientRandom[i] = 0x40 + i;
+  for (uint i = 0; i < sizeof(serverRandom); i++) serverRandom[i] = 0x80 + i;
+
+  // AES-128-GCM with SHA-256: two 16-byte keys and two 4-byte salts.
+  byte keyBlock[72];
+  KJ_ASSERT(_::tls12KeyExpansion("SHA256", masterSecret, clientRandom, serverRandom,
+                                 kj::arrayPtr(keyBlock, 40)));
+  KJ_EXPECT(kj::encodeHex(kj::arrayPtr(keyBlock, 40)) ==
+      "a1c8bdbce8830007e5719b5f9764ae0c42c3a103d08d01b711b292bfd1f33247"
+      "3e5667ef1f21ed64");
+
+  // AES-256-GCM with SHA-384: two 32-byte keys and two 4-byte salts.
+  KJ_ASSERT(_::tls12KeyExpansion("SHA384", masterSecret, clientRandom, serverRandom,
+                                 kj::arrayPtr(keyBlock, 72)));
+  KJ_EXPECT(kj::encodeHex(kj::arrayPtr(keyBlock, 72)) ==
+      "c01fa61789f58022d722461abcb5df04cf985a08f0d461ab4d544db598b85319"
+      "03c0472368c11f6751efc2d81d6b896d8db6be95536abb42a66b015259cf7264"
+      "092ed6c52036945c");
+
+  // The client and server randoms aren't interchangeable.
+  KJ_ASSERT(_::tls12KeyExpansion("SHA256", masterSecret, serverRandom, clientRandom,
+                                 kj::arrayPtr(keyBlock, 40)));
+  KJ_EXPECT(kj::encodeHex(kj::arrayPtr(keyBlock, 40)) !=
+      "a1c8bdbce8830007e5719b5f9764ae0c42c3a103d08d01b711b292bfd1f33247"
+      "3e5667ef1f21ed64");
+}
+#endif  // KJ_TEST_KTLS
+
+class ByteCountingStream final: public kj::AsyncIoStream {
+  // Counts the bytes read through it. A resumed handshake is much smaller than a full one, since
+  // the server doesn't send its certificate chain.
+
+public:
+  ByteCountingStream(kj::Own<kj::AsyncIoStream> inner): inner(kj::mv(inner)) {}
+
+  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    return inner->tryRead(buffer, minBytes, maxBytes).then([this](size_t n) {
+      bytesRead += n;
+      return n;
+    });
+  }
+  kj::Promise<void> write(const void* buffer, size_t size) override {
+    return inner->write(buffer, size);
+  }
+  kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
+    return inner->write(pieces);
+  }
+  Promise<void> whenWriteDisconnected() override {
+    return inner->whenWriteDisconnected();
+  }
+  void shutdownWrite() override {
+    return inner->shutdownWrite();
+  }
+
+  size_t bytesRead = 0;
+
+private:
+  kj::Own<AsyncIoStream> inner;
+};
+
+size_t handshakeSize(TlsTest& test, kj::Maybe<kj::StringPtr> serverAddress = kj::none) {
+  // Connects a new client to the server, returning the number of bytes the client read during
+  // the handshake. If `serverAddress` is given, the client is told it's connected to that
+  // address.
+
+  ErrorNexus e;
+  auto pipe = test.io.provider->newTwoWayPipe();
+  auto counter = kj::heap<ByteCountingStream>(kj::mv(pipe.ends[0]));
+  auto& counterRef = *counter;
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> clientPromise = nullptr;
+  KJ_IF_SOME(address, serverAddress) {
+    auto parsed = test.io.provider->getNetwork().parseAddress(address).wait(test.io.waitScope);
+    kj::AuthenticatedStream stream {
+      kj::mv(counter), kj::NetworkPeerIdentity::newInstance(kj::mv(parsed)) };
+    clientPromise = test.tlsClient.wrapClient(kj::mv(stream), "example.com")
+        .then([](kj::AuthenticatedStream stream) { return kj::mv(stream.stream); });
+  } else {
+    clientPromise = test.tlsClient.wrapClient(kj::mv(counter), "example.com");
+  }
+  clientPromise = e.wrap(kj::mv(clientPromise));
+  auto serverPromise = e.wrap(test.tlsServer.wrapServer(kj::mv(pipe.ends[1])));
+
+  auto client = clientPromise.wait(test.io.waitScope);
+  auto server = serverPromise.wait(test.io.waitScope);
+  size_t result = counterRef.bytesRead;
+
+  // In TLS 1.3, the server sends the session after the handshake, so make the client read.
+  test.testConnection(*server, *client);
+
+  return result;
+}
+
+TlsTest resumingTlsTest(TlsContext::Options clientOptions = TlsTest::defaultClient()) {
+  auto serverOptions = TlsTest::defaultServer();
+  clientOptions.resumeSessions = true;
+  serverOptions.resumeSessions = true;
+  return TlsTest(kj::mv(clientOptions), kj::mv(serverOptions));
+}
+
+KJ_TEST("TLS session resumption") {
+  auto test = resumingTlsTest();
+
+  size_t full = handshakeSize(test);
+  size_t resumed = handshakeSize(test);
+  KJ_EXPECT(resumed < full / 2, resumed, full);
+
+  // Tickets issued under the previous key are still accepted...
+  test.tlsServer.rotateTicketKeys();
+  KJ_EXPECT(handshakeSize(test) < full / 2);
+
+  // ...but not older ones.
+  test.tlsServer.rotateTicketKeys();
+  test.tlsServer.rotateTicketKeys();
+  KJ_EXPECT(handshakeSize(test) >= full);
+  KJ_EXPECT(handshakeSize(test) < full / 2);
+}
+
+KJ_TEST("TLS session resumption with custom cache") {
+  class TestCache final: public TlsSessionCache {
+  public:
+    kj::Maybe<kj::Array<const byte>> get(kj::StringPtr key) override {
+      ++gets;
+      KJ_EXPECT(key == expectedKey, key);
+      return session.map([](kj::Array<const byte>& s) { return kj::heapArray<const byte>(s); });
+    }
+    void put(kj::StringPtr key, kj::Array<const byte> session) override {
+      ++puts;
+      KJ_EXPECT(key == expectedKey, key);
+      this->session = kj::mv(session);
+    }
+
+    kj::StringPtr expectedKey = "example.com";
+    kj::Maybe<kj::Array<const byte>> session;
+    uint gets = 0;
+    uint puts = 0;
+  };
+
+  TestCache cache;
+  auto clientOptions = TlsTest::defaultClient();
+  clientOptions.sessionCache = cache;
+  auto test = resumingTlsTest(kj::mv(clientOptions));
+
+  size_t full = handshakeSize(test);
+  KJ_EXPECT(cache.gets == 1);
+  KJ_EXPECT(cache.puts > 0);
+
+  cache.session = kj::none;
+  KJ_EXPECT(handshakeSize(test) >= full);
+  KJ_EXPECT(handshakeSize(test) < full / 2);
+  KJ_EXPECT(cache.gets == 3);
+
+  // When the server's address is known, sessions are kept per port, since another port on the
+  // same host may be a different server.
+  cache.session = kj::none;
+  cache.expectedKey = "example.com:1234";
+  KJ_EXPECT(handshakeSize(test, "127.0.0.1:1234"_kj) >= full);
+  KJ_EXPECT(handshakeSize(test, "127.0.0.1:1234"_kj) < full / 2);
+}
+
+KJ_TEST("TLS session resumption is off by default") {
+  TlsTest test;
+
+  size_t full = handshakeSize(test);
+  KJ_EXPECT(handshakeSize(test) >= full);
+}
+
 class TestSniCallback: public TlsSniCallback {
 public:
   kj::Maybe<TlsKeypair> getKey(kj::StringPtr hostname) override {
@@ -29,15 +29,48 @@
 #include <openssl/conf.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/rand.h>
 #include <openssl/ssl.h>
 #include <openssl/tls1.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_IS_BORINGSSL) && \
+    !defined(LIBRESSL_VERSION_NUMBER)
+#include <openssl/core_names.h>
+#define KJ_TICKET_MAC_CTX EVP_MAC_CTX
+#else
+#include <openssl/hmac.h>
+#define KJ_TICKET_MAC_CTX HMAC_CTX
+#endif
+
 #include <kj/async-queue.h>
 #include <kj/debug.h>
+#include <kj/map.h>
 #include <kj/vector.h>
 
+#if __linux__ && !defined(OPENSSL_IS_BORINGSSL) && !defined(LIBRESSL_VERSION_NUMBER) && \
+    OPENSSL_VERSION_NUMBER >= 0x10101000L && __has_include(<linux/tls.h>)
+// Kernel TLS offload (see TlsContext::Options::kernelTls). We can't use OpenSSL's own kTLS
+// support because it only works when OpenSSL does the socket I/O itself, so we derive the record
+// keys ourselves and hand them to the kernel.
+#define KJ_HAS_KTLS 1
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <openssl/kdf.h>
+#include <kj/encoding.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#else
+#define KJ_HAS_KTLS 0
+#endif
+
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 #define BIO_set_init(x,v)          (x->init=v)
 #define BIO_get_data(x)            (x->ptr)
@@ -145,8 +178,92 @@ bool isIpAddress(kj::StringPtr addr) {
       || (isPossiblyIp6 && colonCount >= 2 && colonCount <= 7);
 }
 
+#if KJ_HAS_KTLS
+
+constexpr byte TLS_RECORD_ALERT = 21;
+constexpr byte TLS_RECORD_HANDSHAKE = 22;
+constexpr byte TLS_RECORD_APPLICATION_DATA = 23;
+
+union KernelCryptoInfo {
+  // The argument to setsockopt(SOL_TLS, TLS_TX / TLS_RX), whose layout depends on the cipher.
+
+  struct tls_crypto_info info;
+  struct tls12_crypto_info_aes_gcm_128 aesGcm128;
+  struct tls12_crypto_info_aes_gcm_256 aesGcm256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+  struct tls12_crypto_info_chacha20_poly1305 chacha20Poly1305;
+#endif
+};
+
+bool hkdfExpandLabel(const EVP_MD* md, kj::ArrayPtr<const byte> secret, kj::StringPtr label,
+                     kj::ArrayPtr<byte> out) {
+  // TLS 1.3's HKDF-Expand-Label() with an empty context, per RFC 8446 section 7.1.
+
+  byte info[2 + 1 + 255 + 1];
+  size_t infoSize = 0;
+  info[infoSize++] = out.size() >> 8;
+  info[infoSize++] = out.size();
+  info[infoSize++] = 6 + label.size();
+  memcpy(info + infoSize, "tls13 ", 6);
+  infoSize += 6;
+  memcpy(info + infoSize, label.begin(), label.size());
+  infoSize += label.size();
+  info[infoSize++] = 0;
+
+  EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+  KJ_DEFER(EVP_PKEY_CTX_free(pctx));
+  size_t outSize = out.size();
+  return pctx != nullptr &&
+      EVP_PKEY_derive_init(pctx) > 0 &&
+      EVP_PKEY_CTX_hkdf_mode(pctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0 &&
+      EVP_PKEY_CTX_set_hkdf_md(pctx, md) > 0 &&
+      EVP_PKEY_CTX_set1_hkdf_key(pctx, secret.begin(), secret.size()) > 0 &&
+      EVP_PKEY_CTX_add1_hkdf_info(pctx, info, infoSize) > 0 &&
+      EVP_PKEY_derive(pctx, out.begin(), &outSize) > 0 &&
+      outSize == out.size();
+}
+
+bool tls12KeyExpansion(const EVP_MD* md, kj::ArrayPtr<const byte> masterSecret,
+                       kj::ArrayPtr<const byte> clientRandom,
+                       kj::ArrayPtr<const byte> serverRandom, kj::ArrayPtr<byte> out) {
+  // TLS 1.2's key block, per RFC 5246 section 6.3.
+
+  static constexpr char LABEL[] = "key expansion";
+  EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr);
+  KJ_DEFER(EVP_PKEY_CTX_free(pctx));
+  size_t outSize = out.size();
+  return pctx != nullptr &&
+      EVP_PKEY_derive_init(pctx) > 0 &&
+      EVP_PKEY_CTX_set_tls1_prf_md(pctx, md) > 0 &&
+      EVP_PKEY_CTX_set1_tls1_prf_secret(pctx, masterSecret.begin(), masterSecret.size()) > 0 &&
+      EVP_PKEY_CTX_add1_tls1_prf_seed(
+          pctx, reinterpret_cast<const byte*>(LABEL), sizeof(LABEL) - 1) > 0 &&
+      EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, serverRandom.begin(), serverRandom.size()) > 0 &&
+      EVP_PKEY_CTX_add1_tls1_prf_seed(pctx, clientRandom.begin(), clientRandom.size()) > 0 &&
+      EVP_PKEY_derive(pctx, out.begin(), &outSize) > 0 &&
+      outSize == out.size();
+}
+
+#endif  // KJ_HAS_KTLS
+
 }  // namespace
 
+namespace _ {  // private
+
+bool tls12KeyExpansion(kj::StringPtr digest, kj::ArrayPtr<const byte> masterSecret,
+                       kj::ArrayPtr<const byte> clientRandom,
+                       kj::ArrayPtr<const byte> serverRandom, kj::ArrayPtr<byte> out) {
+#if KJ_HAS_KTLS
+  const EVP_MD* md = EVP_get_digestbyname(digest.cStr());
+  return md != nullptr &&
+      kj::tls12KeyExpansion(md, masterSecret, clientRandom, serverRandom, out);
+#else
+  return false;
+#endif
+}
+
+}  // namespace _ (private)
+
 // =======================================================================================
 // Implementation of kj::AsyncIoStream that applies TLS on top of some other AsyncIoStream.
 //
@@ -154,16 +271,17 @@ bool isIpAddress(kj::StringPtr addr) {
 //   completion-based. This forces us to use an intermediate buffer which wastes memory and incurs
 //   redundant copies. We could improve the situation by creating a way to detect if the underlying
 //   AsyncIoStream is simply wrapping a file descriptor (or other readiness-based stream?) and use
-//   that directly if so.
+//   that directly if so. When kernel TLS is enabled (see TlsContext::Options::kernelTls), this
+//   layer is bypassed entirely once the handshake is done.
 
 class TlsConnection final: public kj::AsyncIoStream {
 public:
-  TlsConnection(kj::Own<kj::AsyncIoStream> stream, SSL_CTX* ctx)
-      : TlsConnection(*stream, ctx) {
+  TlsConnection(kj::Own<kj::AsyncIoStream> stream, SSL_CTX* ctx, bool kernelTls = false)
+      : TlsConnection(*stream, ctx, kernelTls) {
     ownInner = kj::mv(stream);
   }
 
-  TlsConnection(kj::AsyncIoStream& stream, SSL_CTX* ctx)
+  TlsConnection(kj::AsyncIoStream& stream, SSL_CTX* ctx, bool kernelTls = false)
       : inner(stream), readBuffer(stream), writeBuffer(stream) {
     ssl = SSL_new(ctx);
     if (ssl == nullptr) {
@@ -179,13 +297,44 @@ public:
     BIO_set_data(bio, this);
     BIO_set_init(bio, 1);
     SSL_set_bio(ssl, bio, bio);
+    SSL_set_ex_data(ssl, getExDataIndex(), this);
+
+#if KJ_HAS_KTLS
+    if (kernelTls && stream.getFd() != kj::none) {
+      // Watch the handshake so that we can later reconstruct the record keys and sequence
+      // numbers for the kernel.
+      kernelTlsRequested = true;
+      SSL_set_msg_callback(ssl, &TlsConnection::messageCallback);
+      SSL_set_msg_callback_arg(ssl, this);
+    }
+#endif
   }
 
-  kj::Promise<void> connect(kj::StringPtr expectedServerHostname) {
+  kj::Promise<void> connect(kj::StringPtr expectedServerHostname,
+                            kj::Maybe<TlsSessionCache&> sessionCache = kj::none,
+                            kj::StringPtr port = nullptr) {
+    // `port` is the server's port, if known. Sessions are cached per server name and port, since
+    // different ports on one host may well be different servers.
+
     if (!SSL_set_tlsext_host_name(ssl, expectedServerHostname.cStr())) {
       return getOpensslError();
     }
 
+    KJ_IF_SOME(cache, sessionCache) {
+      sessionCacheKey = port == nullptr ? kj::str(expectedServerHostname)
+                                        : kj::str(expectedServerHostname, ':', port);
+      KJ_IF_SOME(bytes, cache.get(sessionCacheKey)) {
+        const byte* ptr = bytes.begin();
+        SSL_SESSION* session = d2i_SSL_SESSION(nullptr, &ptr, bytes.size());
+        if (session == nullptr || !SSL_set_session(ssl, session)) {
+          // An unusable session just means a full handshake.
+          ERR_clear_error();
+        }
+        SSL_SESSION_free(session);
+      }
+      this->sessionCache = cache;
+    }
+
     X509_VERIFY_PARAM* verify = SSL_get0_param(ssl);
     if (verify == nullptr) {
       return getOpensslError();
@@ -220,7 +369,7 @@ public:
         const char* reason = X509_verify_cert_error_string(result);
         KJ_FAIL_REQUIRE("TLS peer's certificate is not trusted", reason) { break; }
       }
-    });
+    }).then([this]() { return enableKernelTls(); });
   }
 
   kj::Promise<void> accept() {
@@ -235,7 +384,7 @@ public:
         kj::throwRecoverableException(
             KJ_EXCEPTION(DISCONNECTED, "Client disconnected during SSL_accept()"));
       }
-    });
+    }).then([this]() { return enableKernelTls(); });
   }
 
   kj::Own<TlsPeerIdentity> getIdentity(kj::Own<kj::PeerIdentity> inner) {
@@ -245,21 +394,65 @@ public:
 
   ~TlsConnection() noexcept(false) {
     SSL_free(ssl);
+#if KJ_HAS_KTLS
+    OPENSSL_cleanse(clientTrafficSecret.begin(), clientTrafficSecret.size());
+    OPENSSL_cleanse(serverTrafficSecret.begin(), serverTrafficSecret.size());
+#endif
   }
 
   kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+#if KJ_HAS_KTLS
+    if (kernelRxPending) maybeEnableKernelRx();
+    if (kernelRx) return tryReadKernel(buffer, minBytes, maxBytes, 0);
+#endif
     return tryReadInternal(buffer, minBytes, maxBytes, 0);
   }
 
+  kj::Promise<uint64_t> pumpTo(kj::AsyncOutputStream& output, uint64_t amount) override {
+#if KJ_HAS_KTLS
+    if (kernelRxPending) maybeEnableKernelRx();
+    if (kernelRx && SSL_is_server(ssl) && amount != kj::maxValue &&
+        controlRecord.size() == 0 && !receivedCloseNotify) {
+      // The socket yields plaintext, so the output can pull from it directly, e.g. with
+      // splice(). The kernel fails such reads when it reaches a non-data record, so we only do
+      // this for bounded pumps, and only as the server: clients routinely receive session
+      // tickets after the handshake, which must go through tryReadKernel().
+      KJ_IF_SOME(promise, output.tryPumpFrom(inner, amount)) {
+        return kj::mv(promise);
+      }
+    }
+#endif
+    return AsyncInputStream::pumpTo(output, amount);
+  }
+
   Promise<void> write(const void* buffer, size_t size) override {
+    if (kernelTx) {
+      KJ_REQUIRE(shutdownTask == kj::none, "already called shutdownWrite()");
+      return inner.write(buffer, size);
+    }
     return writeInternal(kj::arrayPtr(reinterpret_cast<const byte*>(buffer), size), nullptr);
   }
 
   Promise<void> write(ArrayPtr<const ArrayPtr<const byte>> pieces) override {
+    if (kernelTx) {
+      KJ_REQUIRE(shutdownTask == kj::none, "already called shutdownWrite()");
+      return inner.write(pieces);
+    }
     auto cork = writeBuffer.cork();
     return writeInternal(pieces[0], pieces.slice(1, pieces.size())).attach(kj::mv(cork));
   }
 
+  kj::Maybe<kj::Promise<uint64_t>> tryPumpFrom(
+      kj::AsyncInputStream& input, uint64_t amount) override {
+    if (kernelTx) {
+      KJ_REQUIRE(shutdownTask == kj::none, "already called shutdownWrite()");
+      // The kernel encrypts whatever is written to the socket, so the socket's own optimized
+      // pumps (e.g. sendfile() from a file, or splice() from another socket) apply.
+      return inner.tryPumpFrom(input, amount);
+    }
+    return kj::none;
+  }
+
   Promise<void> whenWriteDisconnected() override {
     return inner.whenWriteDisconnected();
   }
@@ -267,6 +460,23 @@ public:
   void shutdownWrite() override {
     KJ_REQUIRE(shutdownTask == kj::none, "already called shutdownWrite()");
 
+#if KJ_HAS_KTLS
+    if (kernelTx) {
+      // OpenSSL no longer knows the write sequence number, so send the close_notify alert
+      // through the kernel ourselves.
+      static constexpr byte CLOSE_NOTIFY[2] = { SSL3_AL_WARNING, SSL_AD_CLOSE_NOTIFY };
+      static constexpr byte ALERT = TLS_RECORD_ALERT;
+      static const AncillaryMessage RECORD_TYPE(
+          SOL_TLS, TLS_SET_RECORD_TYPE, kj::arrayPtr(&ALERT, 1));
+      shutdownTask = inner.writeWithAncillary(kj::arrayPtr(CLOSE_NOTIFY, 2),
+                                              kj::arrayPtr(&RECORD_TYPE, 1))
+          .eagerlyEvaluate([](kj::Exception&& e) {
+        KJ_LOG(ERROR, e);
+      });
+      return;
+    }
+#endif
+
     // TODO(2.0): shutdownWrite() is problematic because it doesn't return a promise. It was
     //   designed to assume that it would only be called after all writes are finished and that
     //   there was no reason to block at that point, but SSL sessions don't fit this since they
@@ -302,6 +512,55 @@ public:
     return inner.getFd();
   }
 
+  static int newSessionCallback(SSL* ssl, SSL_SESSION* session) {
+    // Installed on the SSL_CTX by TlsContext when session resumption is enabled. Saves the
+    // sessions of client connections. (TLS 1.3 sessions arrive after the handshake.)
+
+    auto conn = reinterpret_cast<TlsConnection*>(SSL_get_ex_data(ssl, getExDataIndex()));
+    if (conn == nullptr) return 0;
+
+    KJ_IF_SOME(cache, conn->sessionCache) {
+      int size = i2d_SSL_SESSION(session, nullptr);
+      if (size > 0) {
+        auto bytes = kj::heapArray<byte>(size);
+        byte* ptr = bytes.begin();
+        i2d_SSL_SESSION(session, &ptr);
+        KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+          cache.put(conn->sessionCacheKey, kj::mv(bytes));
+        })) {
+          KJ_LOG(ERROR, "exception when saving TLS session", exception);
+        }
+      }
+    }
+
+    return 0;  // We didn't keep a reference to `session`.
+  }
+
+#if KJ_HAS_KTLS
+  static void keylogCallback(const SSL* ssl, const char* line) {
+    // Installed on the SSL_CTX by TlsContext when kernel TLS is enabled. Captures the TLS 1.3
+    // application traffic secrets, from which enableKernelTls() derives the record keys.
+
+    auto conn = reinterpret_cast<TlsConnection*>(SSL_get_ex_data(ssl, getExDataIndex()));
+    if (conn == nullptr || !conn->kernelTlsRequested) return;
+
+    kj::StringPtr text = line;
+    auto capture = [&](kj::StringPtr label, kj::Array<byte>& secret) {
+      // Lines look like "<label> <client random> <secret>", all in hex.
+      if (!text.startsWith(label)) return;
+      auto rest = text.slice(label.size());
+      KJ_IF_SOME(space, rest.findFirst(' ')) {
+        auto decoded = kj::decodeHex(rest.slice(space + 1));
+        if (!decoded.hadErrors) {
+          secret = kj::mv(decoded);
+        }
+      }
+    };
+    capture("CLIENT_TRAFFIC_SECRET_0 ", conn->clientTrafficSecret);
+    capture("SERVER_TRAFFIC_SECRET_0 ", conn->serverTrafficSecret);
+  }
+#endif
+
 private:
   SSL* ssl;
   kj::AsyncIoStream& inner;
@@ -312,6 +571,310 @@ private:
   ReadyInputStreamWrapper readBuffer;
   ReadyOutputStreamWrapper writeBuffer;
 
+  kj::Maybe<TlsSessionCache&> sessionCache;
+  kj::String sessionCacheKey;
+  // Where to save sessions of this (client) connection for later resumption.
+
+  static int getExDataIndex() {
+    static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+  }
+
+  bool kernelTx = false;
+  bool kernelRx = false;
+  // Whether the kernel has taken over encryption / decryption of records on the socket. Once it
+  // has, `writeBuffer` / `readBuffer` and the corresponding half of `ssl` are no longer used.
+
+#if KJ_HAS_KTLS
+  bool kernelTlsRequested = false;
+  bool kernelRxPending = false;
+  // The kernel's TLS layer is installed on the socket, but receiving is still done by OpenSSL
+  // until it has consumed everything it already read from the socket.
+
+  bool receivedCloseNotify = false;
+  byte lastRecordType = TLS_RECORD_APPLICATION_DATA;
+  // Record type of the most recent read from the socket, reported by the kernel.
+
+  byte controlRecordType = 0;
+  kj::Vector<byte> controlRecord;
+  // Content of a non-data record which the kernel has delivered only partially so far.
+
+  uint64_t recordsSinceChangeCipherSpec[2] = { 0, 0 };
+  uint64_t recordsSinceFinished[2] = { 0, 0 };
+  // Count of records read ([0]) and written ([1]) since the last key change, from which the
+  // record sequence numbers are derived: TLS 1.2 resets them at ChangeCipherSpec, while in TLS 1.3
+  // the application keys take effect after the Finished message.
+
+  kj::Array<byte> clientTrafficSecret;
+  kj::Array<byte> serverTrafficSecret;
+
+  static void messageCallback(int writeP, int version, int contentType, const void* buf,
+                              size_t len, SSL* ssl, void* arg) {
+    auto& conn = *reinterpret_cast<TlsConnection*>(arg);
+    auto bytes = reinterpret_cast<const byte*>(buf);
+    switch (contentType) {
+      case SSL3_RT_HEADER:
+        // OpenSSL doesn't report ChangeCipherSpec messages it receives, so look at the record
+        // header instead. The record after it is the first under the new keys.
+        if (len > 0 && bytes[0] == SSL3_RT_CHANGE_CIPHER_SPEC) {
+          conn.recordsSinceChangeCipherSpec[writeP] = 0;
+        } else {
+          ++conn.recordsSinceChangeCipherSpec[writeP];
+        }
+        ++conn.recordsSinceFinished[writeP];
+        break;
+      case SSL3_RT_HANDSHAKE:
+        if (len > 0 && bytes[0] == SSL3_MT_FINISHED) {
+          conn.recordsSinceFinished[writeP] = 0;
+        } else if (len > 0 && bytes[0] == SSL3_MT_KEY_UPDATE) {
+          // The keys we'd derive are no longer current.
+          conn.kernelRxPending = false;
+        }
+        break;
+    }
+  }
+
+  kj::Promise<void> enableKernelTls() {
+    // Called when the handshake completes. Transmission is handed to the kernel as soon as
+    // OpenSSL's last handshake records have been flushed to the socket. Reception is handed over
+    // once OpenSSL has consumed all the input it buffered, which may not be until a later read.
+
+    if (!kernelTlsRequested) return kj::READY_NOW;
+    kernelTlsRequested = false;
+
+    KernelCryptoInfo info;
+    bool supported = getKernelCryptoInfo(true, info) != kj::none;
+    OPENSSL_cleanse(&info, sizeof(info));
+    if (!supported) return kj::READY_NOW;
+
+    int fd = KJ_ASSERT_NONNULL(inner.getFd());
+    if (::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) < 0) {
+      // Most likely the `tls` kernel module isn't available, or this isn't a TCP socket.
+      return kj::READY_NOW;
+    }
+    kernelRxPending = true;
+
+    auto flushed = writeBuffer.isIdle() ? kj::Promise<void>(kj::READY_NOW)
+                                        : writeBuffer.whenReady();
+    return flushed.then([this, fd]() {
+      kernelTx = installKernelKey(fd, true);
+      maybeEnableKernelRx();
+    });
+  }
+
+  void maybeEnableKernelRx() {
+    if (!kernelRxPending || !readBuffer.isIdle() || SSL_has_pending(ssl)) return;
+    kernelRxPending = false;
+
+    // The kernel reports each record's type as a control message. Without it we can't tell
+    // alerts from data, so give up on offloading if the stream can't deliver it.
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+      inner.registerAncillaryMessageHandler([this](kj::ArrayPtr<AncillaryMessage> messages) {
+        for (auto& message: messages) {
+          if (message.getLevel() == SOL_TLS && message.getType() == TLS_GET_RECORD_TYPE) {
+            KJ_IF_SOME(type, message.as<byte>()) {
+              lastRecordType = type;
+            }
+          }
+        }
+      });
+    })) {
+      KJ_LOG(WARNING, "stream can't report TLS record types; not offloading TLS receive",
+          exception);
+      return;
+    }
+
+    kernelRx = installKernelKey(KJ_ASSERT_NONNULL(inner.getFd()), false);
+  }
+
+  bool installKernelKey(int fd, bool tx) {
+    KernelCryptoInfo info;
+    KJ_DEFER(OPENSSL_cleanse(&info, sizeof(info)));
+    KJ_IF_SOME(size, getKernelCryptoInfo(tx, info)) {
+      return ::setsockopt(fd, SOL_TLS, tx ? TLS_TX : TLS_RX, &info, size) == 0;
+    }
+    return false;
+  }
+
+  kj::Maybe<size_t> getKernelCryptoInfo(bool tx, KernelCryptoInfo& out) {
+    // Fills in `out` with the current keys for the given direction, returning its size, or
+    // returns none if the kernel can't handle this connection's protocol version or cipher.
+
+    const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl);
+    int version = SSL_version(ssl);
+    if (cipher == nullptr || (version != TLS1_2_VERSION && version != TLS1_3_VERSION)) {
+      return kj::none;
+    }
+    bool tls13 = version == TLS1_3_VERSION;
+
+    int nid = SSL_CIPHER_get_cipher_nid(cipher);
+    size_t keySize;
+    size_t ivSize;  // TLS 1.2 AES-GCM only derives the 4-byte salt; the rest is explicit.
+    switch (nid) {
+      case NID_aes_128_gcm:
+        keySize = 16;
+        ivSize = tls13 ? 12 : 4;
+        break;
+      case NID_aes_256_gcm:
+        keySize = 32;
+        ivSize = tls13 ? 12 : 4;
+        break;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+      case NID_chacha20_poly1305:
+        keySize = 32;
+        ivSize = 12;
+        break;
+#endif
+      default:
+        return kj::none;
+    }
+
+    const EVP_MD* md = SSL_CIPHER_get_handshake_digest(cipher);
+    if (md == nullptr) return kj::none;
+
+    // We send with our own keys and receive with the peer's.
+    bool clientKeys = tx != bool(SSL_is_server(ssl));
+
+    byte key[32];
+    byte iv[12];
+    KJ_DEFER(OPENSSL_cleanse(key, sizeof(key)));
+    KJ_DEFER(OPENSSL_cleanse(iv, sizeof(iv)));
+
+    if (tls13) {
+      auto& secret = clientKeys ? clientTrafficSecret : serverTrafficSecret;
+      if (secret.size() == 0 ||
+          !hkdfExpandLabel(md, secret, "key", kj::arrayPtr(key, keySize)) ||
+          !hkdfExpandLabel(md, secret, "iv", kj::arrayPtr(iv, ivSize))) {
+        return kj::none;
+      }
+    } else {
+      byte masterSecret[SSL_MAX_MASTER_KEY_LENGTH];
+      byte keyBlock[2 * sizeof(key) + 2 * sizeof(iv)];
+      KJ_DEFER(OPENSSL_cleanse(masterSecret, sizeof(masterSecret)));
+      KJ_DEFER(OPENSSL_cleanse(keyBlock, sizeof(keyBlock)));
+
+      size_t masterSize = SSL_SESSION_get_master_key(
+          SSL_get_session(ssl), masterSecret, sizeof(masterSecret));
+      byte clientRandom[SSL3_RANDOM_SIZE];
+      byte serverRandom[SSL3_RANDOM_SIZE];
+      if (masterSize == 0 ||
+          SSL_get_client_random(ssl, clientRandom, sizeof(clientRandom)) != sizeof(clientRandom) ||
+          SSL_get_server_random(ssl, serverRandom, sizeof(serverRandom)) != sizeof(serverRandom)) {
+        return kj::none;
+      }
+
+      // The key block is: client key, server key, client IV, server IV.
+      auto block = kj::arrayPtr(keyBlock, 2 * keySize + 2 * ivSize);
+      if (!tls12KeyExpansion(md, kj::arrayPtr(masterSecret, masterSize),
+                             clientRandom, serverRandom, block)) {
+        return kj::none;
+      }
+      memcpy(key, block.begin() + (clientKeys ? 0 : keySize), keySize);
+      memcpy(iv, block.begin() + 2 * keySize + (clientKeys ? 0 : ivSize), ivSize);
+    }
+
+    uint64_t sequence = tls13 ? recordsSinceFinished[tx] : recordsSinceChangeCipherSpec[tx];
+    byte sequenceBytes[8];
+    for (uint i = 0; i < 8; i++) {
+      sequenceBytes[i] = sequence >> (56 - 8 * i);
+    }
+
+    memset(&out, 0, sizeof(out));
+    auto fill = [&](auto& crypto, uint16_t cipherType) -> size_t {
+      crypto.info.version = version;
+      crypto.info.cipher_type = cipherType;
+      memcpy(crypto.key, key, sizeof(crypto.key));
+      memcpy(crypto.salt, iv, sizeof(crypto.salt));
+      if (tls13 || sizeof(crypto.salt) == 0) {
+        memcpy(crypto.iv, iv + sizeof(crypto.salt), sizeof(crypto.iv));
+      } else {
+        // The explicit part of a TLS 1.2 AES-GCM nonce only needs to be unique; like OpenSSL, we
+        // use the sequence number.
+        memcpy(crypto.iv, sequenceBytes, sizeof(crypto.iv));
+      }
+      memcpy(crypto.rec_seq, sequenceBytes, sizeof(crypto.rec_seq));
+      return sizeof(crypto);
+    };
+    switch (nid) {
+      case NID_aes_128_gcm:
+        return fill(out.aesGcm128, TLS_CIPHER_AES_GCM_128);
+      case NID_aes_256_gcm:
+        return fill(out.aesGcm256, TLS_CIPHER_AES_GCM_256);
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+      case NID_chacha20_poly1305:
+        return fill(out.chacha20Poly1305, TLS_CIPHER_CHACHA20_POLY1305);
+#endif
+    }
+    KJ_UNREACHABLE;
+  }
+
+  kj::Promise<size_t> tryReadKernel(
+      void* buffer, size_t minBytes, size_t maxBytes, size_t alreadyDone) {
+    if (receivedCloseNotify) return alreadyDone;
+
+    // Each read from the socket returns data from records of a single type, so read one chunk
+    // at a time and check its type before counting it as application data.
+    lastRecordType = TLS_RECORD_APPLICATION_DATA;
+    return inner.tryRead(buffer, 1, maxBytes)
+        .then([this,buffer,minBytes,maxBytes,alreadyDone](size_t n) -> kj::Promise<size_t> {
+      if (n == 0) {
+        return KJ_EXCEPTION(DISCONNECTED,
+            "peer disconnected without gracefully ending TLS session");
+      } else if (lastRecordType != TLS_RECORD_APPLICATION_DATA) {
+        handleControlRecord(kj::arrayPtr(reinterpret_cast<byte*>(buffer), n));
+        return tryReadKernel(buffer, minBytes, maxBytes, alreadyDone);
+      } else if (n >= minBytes) {
+        return alreadyDone + n;
+      } else {
+        return tryReadKernel(reinterpret_cast<byte*>(buffer) + n,
+                             minBytes - n, maxBytes - n, alreadyDone + n);
+      }
+    });
+  }
+
+  void handleControlRecord(kj::ArrayPtr<const byte> bytes) {
+    // The kernel delivered a non-data record. Without OpenSSL's state machine we can only
+    // handle the ones that are expected after a handshake.
+
+    if (controlRecord.size() > 0 && controlRecordType != lastRecordType) {
+      KJ_FAIL_REQUIRE("TLS peer sent a truncated record", controlRecordType);
+    }
+    controlRecordType = lastRecordType;
+    controlRecord.addAll(bytes);
+
+    switch (controlRecordType) {
+      case TLS_RECORD_ALERT:
+        if (controlRecord.size() < 2) return;
+        if (controlRecord[1] == SSL_AD_CLOSE_NOTIFY) {
+          receivedCloseNotify = true;
+          controlRecord.clear();
+          return;
+        }
+        kj::throwFatalException(KJ_EXCEPTION(DISCONNECTED, "TLS peer sent an alert",
+            SSL_alert_desc_string_long(controlRecord[1])));
+
+      case TLS_RECORD_HANDSHAKE:
+        while (controlRecord.size() >= 4) {
+          size_t size = 4 + ((size_t(controlRecord[1]) << 16) |
+                             (size_t(controlRecord[2]) << 8) | controlRecord[3]);
+          if (controlRecord.size() < size) return;
+          KJ_REQUIRE(controlRecord[0] == SSL3_MT_NEWSESSION_TICKET,
+              "TLS peer sent a post-handshake message that kernel TLS can't handle",
+              controlRecord[0]);
+          // OpenSSL can't take the ticket anymore, so this connection's session just won't be
+          // saved for resumption.
+          kj::Vector<byte> rest(controlRecord.size() - size);
+          rest.addAll(controlRecord.asPtr().slice(size, controlRecord.size()));
+          controlRecord = kj::mv(rest);
+        }
+        return;
+
+      default:
+        KJ_FAIL_REQUIRE("TLS peer sent an unexpected record type", controlRecordType);
+    }
+  }
+#endif  // KJ_HAS_KTLS
+
   kj::Promise<size_t> tryReadInternal(
       void* buffer, size_t minBytes, size_t maxBytes, size_t alreadyDone) {
     return sslCall([this,buffer,maxBytes]() { return SSL_read(ssl, buffer, maxBytes); })
@@ -404,8 +967,13 @@ private:
 
   static int bioWrite(BIO* b, const char* in, int inl) {
     BIO_clear_retry_flags(b);
-    KJ_IF_SOME(n, reinterpret_cast<TlsConnection*>(BIO_get_data(b))->writeBuffer
-        .write(kj::arrayPtr(in, inl).asBytes())) {
+    auto& conn = *reinterpret_cast<TlsConnection*>(BIO_get_data(b));
+    if (conn.kernelTx) {
+      // OpenSSL wants to send a record of its own (e.g. in response to a key update) after the
+      // kernel took over. Its sequence numbers are stale, so fail rather than corrupt the stream.
+      return -1;
+    }
+    KJ_IF_SOME(n, conn.writeBuffer.write(kj::arrayPtr(in, inl).asBytes())) {
       return n;
     } else {
       BIO_set_retry_write(b);
@@ -426,7 +994,8 @@ private:
 #ifdef BIO_CTRL_GET_KTLS_SEND
       case BIO_CTRL_GET_KTLS_SEND:
       case BIO_CTRL_GET_KTLS_RECV:
-        // TODO(someday): Support kTLS if the underlying stream is a raw socket.
+        // OpenSSL's own kTLS support requires that it does the socket I/O. We set up kTLS
+        // ourselves instead; see enableKernelTls().
         return 0;
 #endif
       default:
@@ -585,11 +1154,16 @@ public:
     // Note: It's unfortunately pretty common for people to assume they can drop the NetworkAddress
     //   as soon as connect() returns, and this works with the native network implementation.
     //   So, we make some copies here.
+    //
+    // We connect through connectAuthenticated() because the peer's address lets wrapClient() key
+    // cached sessions by port.
     auto& tlsRef = tls;
     auto hostnameCopy = kj::str(hostname);
-    return inner->connect().then(
-        [&tlsRef,hostname=kj::mv(hostnameCopy)](Own<AsyncIoStream>&& stream) {
+    return inner->connectAuthenticated().then(
+        [&tlsRef,hostname=kj::mv(hostnameCopy)](kj::AuthenticatedStream stream) {
       return tlsRef.wrapClient(kj::mv(stream), hostname);
+    }).then([](kj::AuthenticatedStream stream) {
+      return kj::mv(stream.stream);
     });
   }
 
@@ -710,7 +1284,9 @@ TlsContext::Options::Options()
     : useSystemTrustStore(true),
       verifyClients(false),
       minVersion(TlsVersion::TLS_1_2),
-      cipherList("ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305") {}
+      cipherList("ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305"),
+      kernelTls(false),
+      resumeSessions(false) {}
 // Cipher list is Mozilla's "intermediate" list, except with classic DH removed since we don't
 // currently support setting dhparams. See:
 //     https://mozilla.github.io/server-side-tls/ssl-config-generator/
@@ -725,6 +1301,43 @@ struct TlsContext::SniCallback {
   static int callback(SSL* ssl, int* ad, void* arg);
 };
 
+struct TlsContext::TicketKeys {
+  // Keys with which servers encrypt and authenticate session tickets. We manage these ourselves,
+  // rather than letting OpenSSL generate them, so that they can be rotated.
+
+  struct Key {
+    byte name[16];
+    byte aesKey[32];
+    byte hmacKey[32];
+  };
+
+  Key current;
+  kj::Maybe<Key> previous;
+  kj::TimePoint rotatedAt = kj::origin<kj::TimePoint>();
+
+  TicketKeys() { generate(current); }
+
+  static void generate(Key& key) {
+    if (RAND_bytes(reinterpret_cast<byte*>(&key), sizeof(key)) <= 0) {
+      throwOpensslError();
+    }
+  }
+
+  ~TicketKeys() noexcept(false) {
+    OPENSSL_cleanse(&current, sizeof(current));
+    KJ_IF_SOME(key, previous) {
+      OPENSSL_cleanse(&key, sizeof(key));
+    }
+  }
+};
+
+struct TlsContext::TicketKeyCallback {
+  // Like SniCallback, exists so that callback() can reference OpenSSL types.
+
+  static int callback(SSL* ssl, unsigned char* name, unsigned char* iv,
+                      EVP_CIPHER_CTX* cipherCtx, KJ_TICKET_MAC_CTX* macCtx, int encrypt);
+};
+
 TlsContext::TlsContext(Options options) {
   ensureOpenSslInitialized();
 
@@ -834,7 +1447,127 @@ TlsContext::TlsContext(Options options) {
 
   this->acceptErrorHandler = kj::mv(options.acceptErrorHandler);
 
+  if (options.resumeSessions) {
+    KJ_IF_SOME(cache, options.sessionCache) {
+      this->sessionCache = cache;
+    } else {
+      ownSessionCache = newInMemoryTlsSessionCache();
+      this->sessionCache = *ownSessionCache;
+    }
+
+    // Clients save sessions through our callback. Servers resume from tickets alone, so OpenSSL
+    // needn't remember anything.
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx, &TlsConnection::newSessionCallback);
+
+    // OpenSSL refuses to resume sessions when verifying peers unless a session ID context is set.
+    static constexpr byte SESSION_ID_CONTEXT[] = { 'k', 'j' };
+    if (!SSL_CTX_set_session_id_context(ctx, SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT))) {
+      throwOpensslError();
+    }
+
+    KJ_IF_SOME(interval, options.ticketKeyRotationInterval) {
+      this->timer = KJ_REQUIRE_NONNULL(options.timer,
+          "ticketKeyRotationInterval option requires that a timer is also provided");
+      this->ticketKeyRotationInterval = interval;
+    }
+    ticketKeys = kj::heap<TicketKeys>();
+    SSL_CTX_set_app_data(ctx, this);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_IS_BORINGSSL) && \
+    !defined(LIBRESSL_VERSION_NUMBER)
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, &TicketKeyCallback::callback);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx, &TicketKeyCallback::callback);
+#endif
+  } else {
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+#ifdef TLS1_3_VERSION
+    SSL_CTX_set_num_tickets(ctx, 0);
+#endif
+  }
+
+  this->kernelTls = options.kernelTls;
+#if KJ_HAS_KTLS
+  if (kernelTls) {
+    // Kernel TLS needs the TLS 1.3 traffic secrets, which OpenSSL only reveals through the key log.
+    SSL_CTX_set_keylog_callback(ctx, &TlsConnection::keylogCallback);
+  }
+#endif
+
   this->ctx = ctx;
+
+  if (ticketKeys.get() != nullptr) {
+    KJ_IF_SOME(t, timer) {
+      ticketKeys->rotatedAt = t.now();
+    }
+  }
+}
+
+void TlsContext::rotateTicketKeys() {
+  KJ_REQUIRE(ticketKeys.get() != nullptr, "session resumption is disabled");
+  auto& keys = *ticketKeys;
+
+  TicketKeys::Key key;
+  TicketKeys::generate(key);
+  keys.previous = keys.current;
+  keys.current = key;
+  OPENSSL_cleanse(&key, sizeof(key));
+
+  KJ_IF_SOME(t, timer) {
+    keys.rotatedAt = t.now();
+  }
+}
+
+int TlsContext::TicketKeyCallback::callback(
+    SSL* ssl, unsigned char* name, unsigned char* iv,
+    EVP_CIPHER_CTX* cipherCtx, KJ_TICKET_MAC_CTX* macCtx, int encrypt) {
+  // Returns 1 on success, 2 if the ticket should be replaced, 0 if the ticket's key is unknown,
+  // and -1 on error.
+
+  TlsContext& context = *reinterpret_cast<TlsContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+  auto& keys = *context.ticketKeys;
+
+  KJ_IF_SOME(interval, context.ticketKeyRotationInterval) {
+    if (KJ_ASSERT_NONNULL(context.timer).now() - keys.rotatedAt >= interval) {
+      KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { context.rotateTicketKeys(); })) {
+        KJ_LOG(ERROR, "failed to rotate TLS ticket keys", exception);
+        return -1;
+      }
+    }
+  }
+
+  TicketKeys::Key* key = &keys.current;
+  if (encrypt) {
+    if (RAND_bytes(iv, 16) <= 0) return -1;
+    memcpy(name, key->name, sizeof(key->name));
+  } else if (memcmp(name, key->name, sizeof(key->name)) != 0) {
+    KJ_IF_SOME(previous, keys.previous) {
+      if (memcmp(name, previous.name, sizeof(previous.name)) != 0) return 0;
+      key = &previous;
+    } else {
+      return 0;
+    }
+  }
+
+  if (!EVP_CipherInit_ex(cipherCtx, EVP_aes_256_cbc(), nullptr, key->aesKey, iv, encrypt)) {
+    return -1;
+  }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_IS_BORINGSSL) && \
+    !defined(LIBRESSL_VERSION_NUMBER)
+  OSSL_PARAM params[] = {
+    OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key->hmacKey, sizeof(key->hmacKey)),
+    OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, const_cast<char*>("SHA256"), 0),
+    OSSL_PARAM_construct_end(),
+  };
+  if (!EVP_MAC_CTX_set_params(macCtx, params)) return -1;
+#else
+  if (!HMAC_Init_ex(macCtx, key->hmacKey, sizeof(key->hmacKey), EVP_sha256(), nullptr)) {
+    return -1;
+  }
+#endif
+
+  return key == &keys.current ? 1 : 2;
 }
 
 int TlsContext::SniCallback::callback(SSL* ssl, int* ad, void* arg) {
@@ -886,8 +1619,9 @@ TlsContext::~TlsContext() noexcept(false) {
 
 kj::Promise<kj::Own<kj::AsyncIoStream>> TlsContext::wrapClient(
     kj::Own<kj::AsyncIoStream> stream, kj::StringPtr expectedServerHostname) {
-  auto conn = kj::heap<TlsConnection>(kj::mv(stream), reinterpret_cast<SSL_CTX*>(ctx));
-  auto promise = conn->connect(expectedServerHostname);
+  auto conn = kj::heap<TlsConnection>(kj::mv(stream),
+      reinterpret_cast<SSL_CTX*>(ctx), kernelTls);
+  auto promise = conn->connect(expectedServerHostname, sessionCache);
   return promise.then([conn=kj::mv(conn)]() mutable
       -> kj::Own<kj::AsyncIoStream> {
     return kj::mv(conn);
@@ -895,7 +1629,8 @@ kj::Promise<kj::Own<kj::AsyncIoStream>> TlsContext::wrapClient(
 }
 
 kj::Promise<kj::Own<kj::AsyncIoStream>> TlsContext::wrapServer(kj::Own<kj::AsyncIoStream> stream) {
-  auto conn = kj::heap<TlsConnection>(kj::mv(stream), reinterpret_cast<SSL_CTX*>(ctx));
+  auto conn = kj::heap<TlsConnection>(kj::mv(stream),
+      reinterpret_cast<SSL_CTX*>(ctx), kernelTls);
   auto promise = conn->accept();
   KJ_IF_SOME(timeout, acceptTimeout) {
     promise = KJ_REQUIRE_NONNULL(timer).afterDelay(timeout).then([]() -> kj::Promise<void> {
@@ -910,8 +1645,20 @@ kj::Promise<kj::Own<kj::AsyncIoStream>> TlsContext::wrapServer(kj::Own<kj::Async
 
 kj::Promise<kj::AuthenticatedStream> TlsContext::wrapClient(
     kj::AuthenticatedStream stream, kj::StringPtr expectedServerHostname) {
-  auto conn = kj::heap<TlsConnection>(kj::mv(stream.stream), reinterpret_cast<SSL_CTX*>(ctx));
-  auto promise = conn->connect(expectedServerHostname);
+  auto conn = kj::heap<TlsConnection>(kj::mv(stream.stream),
+      reinterpret_cast<SSL_CTX*>(ctx), kernelTls);
+
+  // If we know the server's address, key cached sessions by its port as well.
+  kj::String address;
+  kj::StringPtr port;
+  KJ_IF_SOME(id, kj::dynamicDowncastIfAvailable<kj::NetworkPeerIdentity>(*stream.peerIdentity)) {
+    address = id.getAddress().toString();
+    KJ_IF_SOME(pos, address.findLast(':')) {
+      port = address.slice(pos + 1);
+    }
+  }
+
+  auto promise = conn->connect(expectedServerHostname, sessionCache, port);
   return promise.then([conn=kj::mv(conn),innerId=kj::mv(stream.peerIdentity)]() mutable {
     auto id = conn->getIdentity(kj::mv(innerId));
     return kj::AuthenticatedStream { kj::mv(conn), kj::mv(id) };
@@ -919,7 +1666,8 @@ kj::Promise<kj::AuthenticatedStream> TlsContext::wrapClient(
 }
 
 kj::Promise<kj::AuthenticatedStream> TlsContext::wrapServer(kj::AuthenticatedStream stream) {
-  auto conn = kj::heap<TlsConnection>(kj::mv(stream.stream), reinterpret_cast<SSL_CTX*>(ctx));
+  auto conn = kj::heap<TlsConnection>(kj::mv(stream.stream),
+      reinterpret_cast<SSL_CTX*>(ctx), kernelTls);
   auto promise = conn->accept();
   KJ_IF_SOME(timeout, acceptTimeout) {
     promise = KJ_REQUIRE_NONNULL(timer).afterDelay(timeout).then([]() -> kj::Promise<void> {
@@ -948,6 +1696,75 @@ kj::Own<kj::Network> TlsContext::wrapNetwork(kj::Network& network) {
   return kj::heap<TlsNetwork>(*this, network);
 }
 
+// =======================================================================================
+// class TlsSessionCache
+
+namespace {
+
+class InMemoryTlsSessionCache final: public TlsSessionCache {
+public:
+  InMemoryTlsSessionCache(uint maxSessions): maxSessions(maxSessions) {
+    KJ_REQUIRE(maxSessions > 0);
+  }
+
+  ~InMemoryTlsSessionCache() noexcept(false) {
+    for (auto& entry: sessions) {
+      wipe(entry.value.session);
+    }
+  }
+
+  kj::Maybe<kj::Array<const byte>> get(kj::StringPtr key) override {
+    KJ_IF_SOME(entry, sessions.find(key)) {
+      entry.lastUsed = ++clock;
+      return kj::heapArray<const byte>(entry.session);
+    }
+    return kj::none;
+  }
+
+  void put(kj::StringPtr key, kj::Array<const byte> session) override {
+    KJ_IF_SOME(entry, sessions.find(key)) {
+      wipe(entry.session);
+      entry.session = kj::mv(session);
+      entry.lastUsed = ++clock;
+      return;
+    }
+
+    if (sessions.size() >= maxSessions) {
+      // Evict the least-recently-used session. A linear scan is fine since this happens at most
+      // once per full handshake.
+      auto* oldest = sessions.begin();
+      for (auto& entry: sessions) {
+        if (entry.value.lastUsed < oldest->value.lastUsed) oldest = &entry;
+      }
+      wipe(oldest->value.session);
+      sessions.erase(*oldest);
+    }
+
+    sessions.insert(kj::str(key), { kj::mv(session), ++clock });
+  }
+
+private:
+  struct Entry {
+    kj::Array<const byte> session;
+    uint64_t lastUsed;
+  };
+
+  uint maxSessions;
+  uint64_t clock = 0;
+  kj::HashMap<kj::String, Entry> sessions;
+
+  static void wipe(kj::ArrayPtr<const byte> session) {
+    // Sessions contain secrets, so don't leave them lying around in freed memory.
+    OPENSSL_cleanse(const_cast<byte*>(session.begin()), session.size());
+  }
+};
+
+}  // namespace
+
+kj::Own<TlsSessionCache> newInMemoryTlsSessionCache(uint maxSessions) {
+  return kj::heap<InMemoryTlsSessionCache>(maxSessions);
+}
+
 // =======================================================================================
 // class TlsPrivateKey
 
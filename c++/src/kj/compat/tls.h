@@ -38,6 +38,7 @@ class TlsPrivateKey;
 class TlsCertificate;
 struct TlsKeypair;
 class TlsSniCallback;
+class TlsSessionCache;
 class TlsConnection;
 
 enum class TlsVersion {
@@ -117,6 +118,38 @@ public:
 
     kj::Maybe<TlsErrorHandler> acceptErrorHandler;
     // Error handler used for TLS accept errors.
+
+    bool kernelTls;
+    // If true, after the handshake completes, try to hand record encryption and decryption to
+    // the operating system kernel ("kTLS"). Application data then moves between the socket and
+    // the caller's buffers with a single copy, and pumps to or from other file descriptors can
+    // use sendfile() and splice().
+    //
+    // This is only possible on Linux, when the wrapped stream is a TCP socket backed by a file
+    // descriptor, the `tls` kernel module is available, and the negotiated cipher is AES-GCM or
+    // ChaCha20-Poly1305. Otherwise the connection silently keeps using OpenSSL. Once offloaded, a
+    // connection cannot handle TLS 1.2 renegotiation or TLS 1.3 key updates; these cause the
+    // connection to fail. Default: false
+
+    bool resumeSessions;
+    // Whether to support session resumption, which lets a client that reconnects to a server it
+    // recently talked to skip the certificate exchange and key agreement. As a client, sessions
+    // are saved to and looked up in `sessionCache`, keyed by the expected server hostname and,
+    // when the connection's PeerIdentity reveals it, the server's port. As a server, sessions
+    // are resumed using session tickets (see `ticketKeyRotationInterval`); no server-side state
+    // is kept. Default: false
+
+    kj::Maybe<TlsSessionCache&> sessionCache;
+    // Where client connections store sessions for later resumption. If null, each TlsContext
+    // keeps its own cache of up to 256 recently-used sessions, as if created with
+    // newInMemoryTlsSessionCache(). Provide your own to share sessions between contexts or
+    // persist them.
+
+    kj::Maybe<kj::Duration> ticketKeyRotationInterval;
+    // How often a server replaces the key it uses to encrypt session tickets. Tickets encrypted
+    // under the previous key are still accepted (and replaced with fresh ones), so a ticket is
+    // valid for between one and two intervals. `timer` is required if this is set. If null, the
+    // key only changes when rotateTicketKeys() is called.
   };
 
   TlsContext(Options options = Options());
@@ -160,13 +193,27 @@ public:
   // only accept addresses of the form "hostname" and "hostname:port" (it does not accept raw IP
   // addresses). It will automatically use SNI and verify certificates based on these hostnames.
 
+  void rotateTicketKeys();
+  // Generate a new key for encrypting session tickets issued by servers using this context. The
+  // previous key is kept for decrypting tickets that were already issued; the one before that is
+  // forgotten, so its tickets no longer resume sessions.
+
 private:
   void* ctx;  // actually type SSL_CTX, but we don't want to #include the OpenSSL headers here
   kj::Maybe<kj::Timer&> timer;
   kj::Maybe<kj::Duration> acceptTimeout;
   kj::Maybe<TlsErrorHandler> acceptErrorHandler;
+  bool kernelTls;
+
+  kj::Maybe<TlsSessionCache&> sessionCache;
+  kj::Own<TlsSessionCache> ownSessionCache;
+  kj::Maybe<kj::Duration> ticketKeyRotationInterval;
+
+  struct TicketKeys;
+  kj::Own<TicketKeys> ticketKeys;
 
   struct SniCallback;
+  struct TicketKeyCallback;
 };
 
 class TlsPrivateKey {
@@ -271,6 +318,27 @@ public:
   // TlsContext::Options::defaultKeypair.
 };
 
+class TlsSessionCache {
+  // Storage for the sessions of past client connections, so that reconnecting to the same server
+  // can resume a session instead of performing a full handshake. Sessions are opaque serialized
+  // blobs.
+  //
+  // A session contains secrets from which the traffic of connections resumed from it can be
+  // decrypted. Implementations that store sessions outside the process must protect them
+  // accordingly.
+
+public:
+  virtual kj::Maybe<kj::Array<const byte>> get(kj::StringPtr key) = 0;
+  // Returns a copy of the session most recently stored under `key`, if any.
+
+  virtual void put(kj::StringPtr key, kj::Array<const byte> session) = 0;
+  // Stores `session` under `key`, replacing any session already stored there.
+};
+
+kj::Own<TlsSessionCache> newInMemoryTlsSessionCache(uint maxSessions = 256);
+// Returns a TlsSessionCache which keeps sessions in memory, evicting the least-recently-used one
+// when full.
+
 class TlsPeerIdentity final: public kj::PeerIdentity {
 public:
   KJ_DISALLOW_COPY_AND_MOVE(TlsPeerIdentity);
@@ -309,6 +377,17 @@ public:  // (not really public, only TlsConnection can call this)
       : cert(cert), inner(kj::mv(inner)) {}
 };
 
+namespace _ {  // private
+
+bool tls12KeyExpansion(kj::StringPtr digest, kj::ArrayPtr<const byte> masterSecret,
+                       kj::ArrayPtr<const byte> clientRandom,
+                       kj::ArrayPtr<const byte> serverRandom, kj::ArrayPtr<byte> out);
+// Fills `out` with the TLS 1.2 key block (RFC 5246 section 6.3) derived using the PRF hash
+// named by `digest` (e.g. "SHA256"), as done for kernel TLS offload. Exposed for testing. Returns
+// false if the derivation fails, or if this build doesn't support kernel TLS.
+
+}  // namespace _ (private)
+
 } // namespace kj
 
 KJ_END_HEADER
@@ -240,6 +240,34 @@ KJ_TEST("round-trip invalid UTF-16") {
   expectRes(encodeUtf16(decodeUtf32(encodeUtf32(decodeUtf16(INVALID)))), INVALID, true);
 }
 
+KJ_TEST("validate UTF-8") {
+  KJ_EXPECT(isValidUtf8(""_kj));
+  KJ_EXPECT(isValidUtf8("foo"_kj));
+  KJ_EXPECT(isValidUtf8("$¢€𐍈"_kj));
+  KJ_EXPECT(isValidUtf8("\xed\x9f\xbf \xee\x80\x80 \xf4\x8f\xbf\xbf"_kj));
+  KJ_EXPECT(isValidUtf8(kj::StringPtr("foo\0bar", 7)));
+
+  KJ_EXPECT(!isValidUtf8("\x80"_kj));                // lone continuation byte
+  KJ_EXPECT(!isValidUtf8("\xc0\x80"_kj));            // overlong NUL
+  KJ_EXPECT(!isValidUtf8("\xe0\x9f\xbf"_kj));        // overlong 3-byte
+  KJ_EXPECT(!isValidUtf8("\xf0\x8f\xbf\xbf"_kj));    // overlong 4-byte
+  KJ_EXPECT(!isValidUtf8("\xed\xa0\x80"_kj));        // surrogate
+  KJ_EXPECT(!isValidUtf8("\xf4\x90\x80\x80"_kj));    // beyond U+10FFFF
+  KJ_EXPECT(!isValidUtf8("\xf5\x80\x80\x80"_kj));
+  KJ_EXPECT(!isValidUtf8("\xe2\x82"_kj));            // truncated
+  KJ_EXPECT(!isValidUtf8("\xe2\x28\xa1"_kj));        // bad continuation
+
+  // Errors are caught at every position relative to the blocks scanned as ASCII.
+  for (size_t prefix: kj::zeroTo(40)) {
+    auto good = kj::str(kj::repeat('a', prefix), "€", kj::repeat('b', prefix));
+    KJ_EXPECT(isValidUtf8(good), prefix);
+    auto bad = kj::str(kj::repeat('a', prefix), "\xe2\x82", kj::repeat('b', prefix));
+    KJ_EXPECT(!isValidUtf8(bad), prefix);
+    auto truncated = kj::str(kj::repeat('a', prefix), "\xe2\x82");
+    KJ_EXPECT(!isValidUtf8(truncated), prefix);
+  }
+}
+
 KJ_TEST("EncodingResult as a Maybe") {
   {
     auto result = encodeUtf16("\x80");
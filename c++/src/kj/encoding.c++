@@ -23,6 +23,10 @@
 #include "vector.h"
 #include "debug.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace kj {
 
 namespace {
@@ -148,6 +152,80 @@ EncodingResult<Array<char32_t>> encodeUtf32(ArrayPtr<const char> text, bool nulT
   return encodeUtf<char32_t>(text, nulTerminate);
 }
 
+namespace {
+
+size_t skipAscii(const byte* bytes, size_t size) {
+  // Returns the length of the prefix of `bytes` made up entirely of ASCII. Only needs to be
+  // accurate to within a block; the caller re-checks the first non-ASCII block byte-by-byte.
+
+  size_t i = 0;
+#if defined(__SSE2__)
+  for (; size - i >= 16; i += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    if (_mm_movemask_epi8(chunk) != 0) return i;
+  }
+#endif
+  for (; size - i >= sizeof(uint64_t); i += sizeof(uint64_t)) {
+    uint64_t chunk;
+    memcpy(&chunk, bytes + i, sizeof(chunk));
+    if ((chunk & 0x8080808080808080ull) != 0) return i;
+  }
+  return i;
+}
+
+}  // namespace
+
+bool isValidUtf8(ArrayPtr<const char> text) {
+  auto bytes = text.asBytes();
+  size_t size = bytes.size();
+  size_t i = 0;
+
+  while (i < size) {
+    i += skipAscii(bytes.begin() + i, size - i);
+    if (i == size) break;
+
+    byte c = bytes[i];
+    if (c < 0x80) {
+      ++i;
+      continue;
+    }
+
+    // See Table 3-7 ("Well-Formed UTF-8 Byte Sequences") of the Unicode standard. Only the second
+    // byte of a sequence has a range other than 0x80..0xBF.
+    size_t continuationCount;
+    byte secondMin = 0x80;
+    byte secondMax = 0xbf;
+    if (c >= 0xc2 && c <= 0xdf) {
+      continuationCount = 1;
+    } else if (c >= 0xe0 && c <= 0xef) {
+      continuationCount = 2;
+      if (c == 0xe0) {
+        secondMin = 0xa0;  // overlong
+      } else if (c == 0xed) {
+        secondMax = 0x9f;  // surrogate
+      }
+    } else if (c >= 0xf0 && c <= 0xf4) {
+      continuationCount = 3;
+      if (c == 0xf0) {
+        secondMin = 0x90;  // overlong
+      } else if (c == 0xf4) {
+        secondMax = 0x8f;  // beyond U+10FFFF
+      }
+    } else {
+      return false;
+    }
+
+    if (size - i <= continuationCount) return false;
+    if (bytes[i + 1] < secondMin || bytes[i + 1] > secondMax) return false;
+    for (size_t j = 2; j <= continuationCount; j++) {
+      if ((bytes[i + j] & 0xc0) != 0x80) return false;
+    }
+    i += continuationCount + 1;
+  }
+
+  return true;
+}
+
 EncodingResult<String> decodeUtf16(ArrayPtr<const char16_t> utf16) {
   Vector<char> result(utf16.size() + 1);
   bool hadErrors = false;
@@ -108,6 +108,15 @@ EncodingResult<String> decodeUtf32(ArrayPtr<const char32_t> utf32);
 //   raised on subsequent legs unless all invalid sequences were replaced with U+FFFD (which, after
 //   all, is a valid code point).
 
+bool isValidUtf8(ArrayPtr<const char> text);
+// Returns true if `text` is well-formed UTF-8 according to the Unicode standard. Unlike the
+// conversion functions above, this is strict: encoded surrogate code points, overlong encodings,
+// and code points beyond U+10FFFF are all rejected. NUL characters are allowed.
+//
+// Runs of ASCII are skipped many bytes at a time (16 with SSE2), so this is cheap for mostly-ASCII
+// text. Multi-byte sequences are still checked one at a time, so heavily non-ASCII text is
+// validated at scalar speed.
+
 EncodingResult<Array<wchar_t>> encodeWideString(
     ArrayPtr<const char> text, bool nulTerminate = false);
 EncodingResult<String> decodeWideString(ArrayPtr<const wchar_t> wide);
@@ -0,0 +1,106 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks comparing kj::Table's hash indexes. Run with `--benchmark-time <seconds>` to get
+// useful timings; by default each benchmark runs once, as a smoke test.
+
+#include "table.h"
+#include "string.h"
+#include <kj/test.h>
+
+namespace kj {
+namespace {
+
+#if defined(KJ_DEBUG) && !__OPTIMIZE__
+// Unoptimized builds only run the benchmarks as a smoke test, so keep it quick.
+static constexpr uint SIZES[] = { 1000, 10000 };
+#else
+static constexpr uint SIZES[] = { 1000, 100000, 10000000 };
+#endif
+
+inline uint key(uint i) {
+  // Distinct for the first 2^26 values of `i`, in no particular order, and all multiples of 64,
+  // like object IDs or aligned addresses often are. That's hard on any index that uses the low
+  // bits of the hash code directly.
+  return (i * 0x9e3779b1u) << 6;
+}
+
+struct UintHasher {
+  // Returns the key unchanged, like kj::hashCode() does for integers.
+
+  uint keyForRow(uint i) const { return i; }
+  bool matches(uint a, uint b) const { return a == b; }
+  uint hashCode(uint i) const { return i; }
+};
+
+template <typename Index, typename Benchmark>
+void benchmarkIndex(StringPtr indexName, Benchmark&& doBenchmark) {
+  for (uint size: SIZES) {
+    auto label = [&](StringPtr op) { return kj::str(indexName, ", ", op, ", ", size, " rows"); };
+
+    doBenchmark(label("insert"), [&]() {
+      Table<uint, Index> table;
+      for (uint i: kj::zeroTo(size)) table.insert(key(i));
+      KJ_ASSERT(table.size() == size);
+    });
+
+    Table<uint, Index> table;
+    for (uint i: kj::zeroTo(size)) table.insert(key(i));
+
+    doBenchmark(label("find hit"), [&]() {
+      uint found = 0;
+      for (uint i: kj::zeroTo(size)) {
+        if (table.find(key(i)) != kj::none) ++found;
+      }
+      KJ_ASSERT(found == size);
+    });
+
+    doBenchmark(label("find miss"), [&]() {
+      uint found = 0;
+      for (uint i: kj::zeroTo(size)) {
+        if (table.find(key(i) + 32) != kj::none) ++found;
+      }
+      KJ_ASSERT(found == 0);
+    });
+
+    // Erasing changes the table, so each iteration puts the rows back afterwards. Each erasure
+    // also moves the table's last row into the gap, which updates the index too.
+    doBenchmark(label("erase + reinsert"), [&]() {
+      for (uint i: kj::zeroTo(size)) {
+        KJ_ASSERT(table.eraseMatch(key(i)));
+      }
+      for (uint i: kj::zeroTo(size)) table.insert(key(i));
+      KJ_ASSERT(table.size() == size);
+    });
+  }
+}
+
+KJ_TEST("benchmark: kj::Table hash indexes") {
+  auto doBenchmark = [this](StringPtr label, auto&& func) {
+    this->doBenchmark(label, 0, func);
+  };
+
+  benchmarkIndex<HashIndex<UintHasher>>("HashIndex", doBenchmark);
+  benchmarkIndex<SwissHashIndex<UintHasher>>("SwissHashIndex", doBenchmark);
+}
+
+}  // namespace
+}  // namespace kj
@@ -295,6 +295,121 @@ KJ_TEST("HashIndex with many erasures doesn't keep growing") {
   KJ_ASSERT(index.capacity() < 10);
 }
 
+KJ_TEST("SwissHashIndex") {
+  Table<StringPtr, SwissHashIndex<StringHasher>> table;
+
+  KJ_EXPECT(table.find("foo") == kj::none);
+  KJ_EXPECT(table.insert("foo") == "foo");
+  KJ_EXPECT(table.insert("bar") == "bar");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(table.find("foo")) == "foo");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(table.find("bar")) == "bar");
+  KJ_EXPECT(table.find("baz") == kj::none);
+  KJ_EXPECT_THROW_MESSAGE("inserted row already exists in table", table.insert("bar"));
+
+  // Erasing "foo" moves "bar" into its position.
+  KJ_EXPECT(table.eraseMatch("foo"));
+  KJ_EXPECT(table.size() == 1);
+  KJ_EXPECT(table.find("foo") == kj::none);
+  KJ_EXPECT(&KJ_ASSERT_NONNULL(table.find("bar")) == table.begin());
+
+  table.clear();
+  KJ_EXPECT(table.find("bar") == kj::none);
+  KJ_EXPECT(table.insert("bar") == "bar");
+}
+
+KJ_TEST("SwissHashIndex when hash is always same") {
+  // Enough rows to overflow several groups.
+  Table<StringPtr, SwissHashIndex<BadHasher>> table;
+  kj::Vector<String> strings;
+  for (uint i: kj::zeroTo(100)) {
+    strings.add(kj::str(i));
+    table.insert(strings.back());
+  }
+
+  for (uint i: kj::zeroTo(100)) {
+    if (i % 3 == 0) {
+      KJ_EXPECT(table.eraseMatch(strings[i]));
+    }
+  }
+  for (uint i: kj::zeroTo(100)) {
+    if (i % 3 == 0) {
+      KJ_EXPECT(table.find(strings[i]) == kj::none);
+    } else {
+      KJ_EXPECT(KJ_ASSERT_NONNULL(table.find(strings[i])) == strings[i]);
+    }
+  }
+  KJ_EXPECT(table.find("foo") == kj::none);
+}
+
+KJ_TEST("SwissHashIndex with many erasures doesn't keep growing") {
+  SwissHashIndex<IntHasher> index;
+
+  kj::ArrayPtr<uint> rows = nullptr;
+
+  for (uint i: kj::zeroTo(1000000)) {
+    KJ_ASSERT(index.insert(rows, 0, i) == kj::none);
+    index.erase(rows, 0, i);
+  }
+
+  KJ_ASSERT(index.capacity() == 16);
+
+  // Same again, but with a fuller table, so that erasures leave tombstones behind.
+  kj::Vector<uint> rows2;
+  for (uint i: kj::zeroTo(64)) rows2.add(i);
+  SwissHashIndex<IntHasher> index2;
+  for (uint i: kj::zeroTo(64)) {
+    KJ_ASSERT(index2.insert(rows2.asPtr(), i, i) == kj::none);
+  }
+  size_t capacity = index2.capacity();
+  for (uint i: kj::zeroTo(100000)) {
+    uint pos = i % 64;
+    index2.erase(rows2.asPtr(), pos, rows2[pos]);
+    rows2[pos] += 64;
+    KJ_ASSERT(index2.insert(rows2.asPtr(), pos, rows2[pos]) == kj::none);
+  }
+  KJ_EXPECT(index2.capacity() == capacity, index2.capacity(), capacity);
+  for (uint i: kj::zeroTo(64)) {
+    KJ_EXPECT(index2.find(rows2.asPtr(), rows2[i]) == i);
+  }
+}
+
+KJ_TEST("SwissHashIndex agrees with std::unordered_set") {
+  Table<uint, SwissHashIndex<IntHasher>> table;
+  std::unordered_set<uint> reference;
+
+  uint seed = 12345;
+  auto random = [&]() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+  };
+
+  for (uint i KJ_UNUSED: kj::zeroTo(BIG_PRIME * 4)) {
+    // Keys are drawn from a small range, so inserts, finds and erases of existing rows are all
+    // common, and keys are multiples of 64, which would all collide without mixing.
+    uint key = (random() % (BIG_PRIME / 2)) * 64;
+    switch (random() % 3) {
+      case 0:
+        KJ_ASSERT((table.find(key) != kj::none) == (reference.count(key) > 0));
+        break;
+      case 1:
+        if (reference.insert(key).second) {
+          table.insert(key);
+        } else {
+          KJ_ASSERT_NONNULL(table.find(key));
+        }
+        break;
+      case 2:
+        KJ_ASSERT(table.eraseMatch(key) == (reference.erase(key) > 0));
+        break;
+    }
+  }
+
+  KJ_ASSERT(table.size() == reference.size());
+  for (uint key: reference) {
+    KJ_ASSERT(KJ_ASSERT_NONNULL(table.find(key)) == key);
+  }
+}
+
 struct SiPair {
   kj::StringPtr str;
   uint i;
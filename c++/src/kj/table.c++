@@ -195,6 +195,155 @@ kj::Array<HashBucket> rehash(kj::ArrayPtr<const HashBucket> oldBuckets, size_t t
   return newBuckets;
 }
 
+// =======================================================================================
+// SwissTable
+
+static constexpr size_t maxLoad(size_t capacity) {
+  // Fill the table up to 7/8 before growing.
+  return capacity - capacity / 8;
+}
+
+void SwissTable::reserve(size_t size) {
+  if (maxLoad(capacity()) < size) {
+    rehash(size);
+  }
+}
+
+void SwissTable::clear() {
+  if (groups.size() == 0) return;
+  for (auto& group: groups) {
+    memset(group.ctrl, SwissGroup::EMPTY, sizeof(group.ctrl));
+  }
+  growthLeft = maxLoad(capacity());
+  count = 0;
+}
+
+size_t SwissTable::findAvailable(uint hash) const {
+  // Returns the first empty or erased slot in `hash`'s probe sequence. There's always at least
+  // one, since the table is never allowed to fill up.
+
+  size_t groupMask = groups.size() - 1;
+  size_t g = (hash >> 7) & groupMask;
+  for (size_t step = 1;; g = (g + step++) & groupMask) {
+    uint m = SwissGroup(groups[g].ctrl).matchAvailable();
+    if (m != 0) {
+      return g * SwissGroup::WIDTH + countTrailingZeros(m);
+    }
+  }
+}
+
+Maybe<size_t> SwissTable::findPos(uint hash, uint pos) const {
+  // Finds the slot pointing at row `pos`.
+
+  if (groups.size() == 0) return kj::none;
+
+  byte code = hash & 0x7f;
+  size_t groupMask = groups.size() - 1;
+  size_t g = (hash >> 7) & groupMask;
+  for (size_t step = 1;; g = (g + step++) & groupMask) {
+    auto& group = groups[g];
+    SwissGroup ctrl(group.ctrl);
+    for (uint m = ctrl.match(code); m != 0; m &= m - 1) {
+      uint i = countTrailingZeros(m);
+      if (group.slots[i].pos == pos) return g * SwissGroup::WIDTH + i;
+    }
+    if (ctrl.matchEmpty() != 0) return kj::none;
+  }
+}
+
+inline void SwissTable::fill(size_t slot, uint hash, uint pos) {
+  auto& group = groups[slot / SwissGroup::WIDTH];
+  group.ctrl[slot % SwissGroup::WIDTH] = hash & 0x7f;
+  group.slots[slot % SwissGroup::WIDTH] = { hash, pos };
+}
+
+void SwissTable::insert(uint hash, uint pos) {
+  size_t i;
+  if (groups.size() == 0) {
+    rehash(1);
+    i = findAvailable(hash);
+  } else {
+    i = findAvailable(hash);
+    if (groups[i / SwissGroup::WIDTH].ctrl[i % SwissGroup::WIDTH] == SwissGroup::EMPTY &&
+        growthLeft == 0) {
+      if (count + 1 <= capacity() * 25 / 32) {
+        // Mostly erased slots rather than live rows. Rebuilding at the same size reclaims them
+        // and still leaves enough room that this won't happen again right away.
+        resize(capacity());
+      } else {
+        rehash(count + 1);
+      }
+      i = findAvailable(hash);
+    }
+  }
+
+  if (groups[i / SwissGroup::WIDTH].ctrl[i % SwissGroup::WIDTH] == SwissGroup::EMPTY) {
+    --growthLeft;
+  }
+  fill(i, hash, pos);
+  ++count;
+}
+
+void SwissTable::erase(uint hash, uint pos) {
+  KJ_IF_SOME(i, findPos(hash, pos)) {
+    // A lookup stops at the first group with an empty slot. If this group has one, then it has
+    // never been full since the last rehash, so no probe sequence continues past it and the slot
+    // can simply be emptied. Otherwise, mark it erased so that lookups keep going.
+    auto& group = groups[i / SwissGroup::WIDTH];
+    if (SwissGroup(group.ctrl).matchEmpty() != 0) {
+      group.ctrl[i % SwissGroup::WIDTH] = SwissGroup::EMPTY;
+      ++growthLeft;
+    } else {
+      group.ctrl[i % SwissGroup::WIDTH] = SwissGroup::ERASED;
+    }
+    --count;
+  } else {
+    logHashTableInconsistency();
+  }
+}
+
+void SwissTable::move(uint hash, uint oldPos, uint newPos) {
+  KJ_IF_SOME(i, findPos(hash, oldPos)) {
+    groups[i / SwissGroup::WIDTH].slots[i % SwissGroup::WIDTH].pos = newPos;
+  } else {
+    logHashTableInconsistency();
+  }
+}
+
+void SwissTable::rehash(size_t targetSize) {
+  // Rebuilds the table with room for `targetSize` rows, leaving it no more than half full so that
+  // it doesn't have to be rebuilt again right away. Never shrinks.
+
+  // The bits of a hash code above the lowest 7 pick the group, so 2^25 groups is as far as we
+  // can go.
+  KJ_REQUIRE(targetSize < (1 << 28), "hash table has reached maximum size");
+
+  size_t size = SwissGroup::WIDTH;
+  while (size / 2 < targetSize) size *= 2;
+  if (size < capacity()) size = capacity();
+
+  resize(size);
+}
+
+void SwissTable::resize(size_t size) {
+  auto oldGroups = kj::mv(groups);
+  groups = heapArray<Group>(size / SwissGroup::WIDTH);
+  clear();
+
+  for (auto g: kj::indices(oldGroups)) {
+    auto& group = oldGroups[g];
+    // Walk the occupied slots by bitmask, rather than testing each control byte, since whether
+    // a slot is occupied is about as predictable as a coin toss.
+    uint occupied = ~SwissGroup(group.ctrl).matchAvailable() & ((1u << SwissGroup::WIDTH) - 1);
+    for (uint m = occupied; m != 0; m &= m - 1) {
+      auto& slot = group.slots[countTrailingZeros(m)];
+      fill(findAvailable(slot.hash), slot.hash, slot.pos);
+      --growthLeft;
+      ++count;
+    }
+  }
+}
+
 // =======================================================================================
 // BTree
 
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <fcntl.h>
 #include "time.h"
 #ifndef _WIN32
 #include <sys/mman.h>
@@ -43,6 +44,10 @@ TestCase* testCasesHead = nullptr;
 TestCase** testCasesTail = &testCasesHead;
 
 size_t benchmarkIterCount = 1;
+Maybe<uint64_t> benchmarkTargetNanos;
+bool reportBenchmarks = false;
+Maybe<AutoCloseFd> benchmarkJsonFd;
+size_t testFilePrefixLength = 0;
 
 }  // namespace
 
@@ -62,8 +67,102 @@ TestCase::~TestCase() {
   }
 }
 
-size_t TestCase::iterCount() {
-  return benchmarkIterCount;
+// =======================================================================================
+
+namespace {
+
+uint64_t readNanos() {
+  return (systemPreciseMonotonicClock().now() - kj::origin<TimePoint>()) / NANOSECONDS;
+}
+
+String jsonQuote(StringPtr text) {
+  Vector<char> result(text.size() + 2);
+  result.add('"');
+  for (char c: text) {
+    if (c == '"' || c == '\\') {
+      result.add('\\');
+      result.add(c);
+    } else if (static_cast<byte>(c) < 0x20) {
+      const char HEX[] = "0123456789abcdef";
+      result.addAll(StringPtr("\\u00"));
+      result.add(HEX[c >> 4]);
+      result.add(HEX[c & 0x0f]);
+    } else {
+      result.add(c);
+    }
+  }
+  result.add('"');
+  result.add('\0');
+  return String(result.releaseAsArray());
+}
+
+String oneDecimal(double value) {
+  // kj::str() prints doubles with full precision, which is noise in a human-readable report.
+  uint64_t tenths = value * 10 + 0.5;
+  return kj::str(tenths / 10, '.', tenths % 10);
+}
+
+}  // namespace
+
+size_t TestCase::BenchmarkRun::nextBatch() {
+  uint64_t now = readNanos();
+  if (batchSize > 0) {
+    elapsedNanos += now - batchStartNanos;
+    iterations += batchSize;
+  }
+
+  KJ_IF_SOME(target, benchmarkTargetNanos) {
+    if (elapsedNanos >= target) {
+      batchSize = 0;
+    } else if (iterations == 0) {
+      batchSize = 1;
+    } else {
+      // Aim a little past the target, but grow by at most 100x per batch in case the first
+      // iterations were unrepresentative (e.g. cold caches).
+      double nanosPerIteration = kj::max(elapsedNanos, uint64_t(1)) / double(iterations);
+      double wanted = (target - elapsedNanos) / nanosPerIteration * 1.2;
+      batchSize = kj::max(size_t(1), kj::min(iterations * 100, size_t(wanted)));
+    }
+  } else {
+    batchSize = (iterations == 0 && batchSize == 0) ? benchmarkIterCount : 0;
+  }
+
+  if (batchSize == 0) {
+    report();
+  }
+
+  batchStartNanos = readNanos();
+  return batchSize;
+}
+
+void TestCase::BenchmarkRun::report() {
+  if (!reportBenchmarks || iterations == 0) return;
+
+  auto name = kj::str(testCase.file + testFilePrefixLength, ':', testCase.line, ": ",
+                      testCase.description);
+  double nanosPerIteration = elapsedNanos / double(iterations);
+  double bytesPerSecond = 0;
+  if (bytesPerIteration > 0 && elapsedNanos > 0) {
+    bytesPerSecond = double(bytesPerIteration) * iterations / (elapsedNanos / 1e9);
+  }
+
+  auto text = kj::str("[ BENCH ] ", name, label == nullptr ? "" : " ", label, ": ",
+      iterations, " iterations, ", oneDecimal(nanosPerIteration), " ns/iter",
+      bytesPerIteration == 0 ? kj::String()
+          : kj::str(", ", oneDecimal(bytesPerSecond / 1e6), " MB/s"),
+      '\n');
+  FdOutputStream(STDOUT_FILENO).write(text.begin(), text.size());
+
+  KJ_IF_SOME(fd, benchmarkJsonFd) {
+    auto line = kj::str(
+        "{\"test\":", jsonQuote(name), ",\"label\":", jsonQuote(label),
+        ",\"iterations\":", iterations, ",\"nsPerIteration\":", nanosPerIteration,
+        bytesPerIteration == 0 ? kj::String()
+            : kj::str(",\"bytesPerIteration\":", bytesPerIteration,
+                      ",\"bytesPerSecond\":", bytesPerSecond),
+        "}\n");
+    FdOutputStream(fd.get()).write(line.begin(), line.size());
+  }
 }
 
 // =======================================================================================
@@ -125,6 +224,13 @@ public:
         .addOptionWithArg({'b', "benchmark"}, KJ_BIND_METHOD(*this, setBenchmarkIters), "<iters>",
             "Specifies that any benchmarks in the tests should run for <iters> iterations. "
             "If not specified, then count is 1, which simply tests that the benchmarks function.")
+        .addOptionWithArg({"benchmark-time"}, KJ_BIND_METHOD(*this, setBenchmarkTime),
+            "<seconds>",
+            "Specifies that each benchmark should run for about <seconds> (which may be "
+            "fractional), choosing the iteration count automatically.")
+        .addOptionWithArg({"benchmark-json"}, KJ_BIND_METHOD(*this, setBenchmarkJson), "<file>",
+            "Write benchmark results to <file>, one JSON object per line, for tracking "
+            "performance over time.")
         .callAfterParsing(KJ_BIND_METHOD(*this, run))
         .build();
   }
@@ -186,12 +292,32 @@ public:
   MainBuilder::Validity setBenchmarkIters(StringPtr param) {
     KJ_IF_SOME(i, param.tryParseAs<size_t>()) {
       benchmarkIterCount = i;
+      reportBenchmarks = true;
       return true;
     } else {
       return "expected an integer";
     }
   }
 
+  MainBuilder::Validity setBenchmarkTime(StringPtr param) {
+    KJ_IF_SOME(seconds, param.tryParseAs<double>()) {
+      if (seconds <= 0) return "expected a positive number";
+      benchmarkTargetNanos = uint64_t(seconds * 1e9);
+      reportBenchmarks = true;
+      return true;
+    } else {
+      return "expected a number";
+    }
+  }
+
+  MainBuilder::Validity setBenchmarkJson(StringPtr path) {
+    int fd;
+    KJ_SYSCALL(fd = open(path.cStr(), O_WRONLY | O_CREAT | O_TRUNC, 0666),
+               path);
+    benchmarkJsonFd = AutoCloseFd(fd);
+    return true;
+  }
+
   MainBuilder::Validity run() {
     if (testCasesHead == nullptr) {
       return "no tests were declared";
@@ -212,6 +338,7 @@ public:
     while (commonPrefix.size() > 0 && commonPrefix.back() != '/' && commonPrefix.back() != '\\') {
       commonPrefix = commonPrefix.slice(0, commonPrefix.size() - 1);
     }
+    testFilePrefixLength = commonPrefix.size();
 
     // Run the testts.
     uint passCount = 0;
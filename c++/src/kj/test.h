@@ -47,11 +47,24 @@ protected:
     // is set by the --benchmark CLI flag. This defaults to 1, so that when --benchmark is not
     // specified, we only test that the benchmark works.
     //
-    // In the future, this could adaptively choose iteration count by running a few iterations to
-    // find out how fast the benchmark is, then scaling.
+    // Alternatively, the --benchmark-time CLI flag chooses N adaptively, by running a few
+    // iterations to find out how fast the benchmark is, then scaling until the requested time
+    // has been spent. When either flag is given, timings are reported after the test's name.
 
-    for (size_t i = iterCount(); i-- > 0;) {
-      func();
+    doBenchmark(nullptr, 0, kj::fwd<Func>(func));
+  }
+
+  template <typename Func>
+  void doBenchmark(StringPtr label, size_t bytesPerIteration, Func&& func) {
+    // Like doBenchmark(func), but `label` distinguishes multiple benchmarks within one test case
+    // (e.g. different input sizes), and if `bytesPerIteration` is non-zero, throughput is
+    // reported too.
+
+    BenchmarkRun run(*this, label, bytesPerIteration);
+    for (size_t n; (n = run.nextBatch()) > 0;) {
+      while (n-- > 0) {
+        func();
+      }
     }
   }
 
@@ -63,7 +76,27 @@ private:
   TestCase** prev;
   bool matchedFilter;
 
-  static size_t iterCount();
+  class BenchmarkRun {
+  public:
+    BenchmarkRun(TestCase& testCase, StringPtr label, size_t bytesPerIteration)
+        : testCase(testCase), label(label), bytesPerIteration(bytesPerIteration) {}
+
+    size_t nextBatch();
+    // Returns how many more times to call the benchmark function, or zero when done. Time spent
+    // between calls to nextBatch() counts towards the benchmark.
+
+  private:
+    TestCase& testCase;
+    StringPtr label;
+    size_t bytesPerIteration;
+
+    size_t iterations = 0;
+    size_t batchSize = 0;
+    uint64_t elapsedNanos = 0;
+    uint64_t batchStartNanos = 0;
+
+    void report();
+  };
 
   friend class TestRunner;
 };
@@ -0,0 +1,110 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "thread-pool.h"
+#include "mutex.h"
+#include "vector.h"
+#include <kj/test.h>
+#include <atomic>
+
+namespace kj {
+namespace {
+
+KJ_TEST("ThreadPool runs functions and returns results") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  ThreadPool pool(4);
+  KJ_EXPECT(pool.getThreadCount() == 4);
+
+  Vector<Promise<uint>> promises;
+  for (uint i = 0; i < 1000; i++) {
+    promises.add(pool.run([i]() { return i * i; }));
+  }
+  auto results = joinPromises(promises.releaseAsArray()).wait(waitScope);
+  for (uint i = 0; i < 1000; i++) {
+    KJ_EXPECT(results[i] == i * i);
+  }
+
+  std::atomic<uint> count(0);
+  pool.run([&]() { count.fetch_add(1); }).wait(waitScope);
+  KJ_EXPECT(count.load() == 1);
+
+  // Move-only results and captures work.
+  auto owned = pool.run([str = kj::str("foo")]() { return kj::str(str, "bar"); }).wait(waitScope);
+  KJ_EXPECT(owned == "foobar");
+}
+
+KJ_TEST("ThreadPool propagates exceptions") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  ThreadPool pool(2);
+
+  KJ_EXPECT_THROW_MESSAGE("worker failed", pool.run([]() -> int {
+    KJ_FAIL_REQUIRE("worker failed");
+  }).wait(waitScope));
+
+  // The pool still works afterwards.
+  KJ_EXPECT(pool.run([]() { return 123; }).wait(waitScope) == 123);
+}
+
+KJ_TEST("ThreadPool skips canceled tasks") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  ThreadPool pool(1);
+
+  // Keep the only worker busy.
+  MutexGuarded<bool> release(false);
+  auto blocker = pool.run([&]() {
+    release.when([](bool value) { return value; }, [](bool) {});
+  });
+
+  std::atomic<bool> ran(false);
+  {
+    auto promise = pool.run([&]() { ran.store(true); });
+    // Dropped immediately.
+  }
+
+  *release.lockExclusive() = true;
+  blocker.wait(waitScope);
+  pool.run([]() {}).wait(waitScope);
+  KJ_EXPECT(!ran.load());
+}
+
+KJ_TEST("ThreadPool destructor finishes submitted tasks") {
+  EventLoop loop;
+  WaitScope waitScope(loop);
+  std::atomic<uint> count(0);
+  Vector<Promise<void>> promises;
+
+  {
+    ThreadPool pool(4, true);
+    for (uint i = 0; i < 1000; i++) {
+      promises.add(pool.run([&]() { count.fetch_add(1); }));
+    }
+  }
+
+  KJ_EXPECT(count.load() == 1000);
+  joinPromises(promises.releaseAsArray()).wait(waitScope);
+}
+
+}  // namespace
+}  // namespace kj
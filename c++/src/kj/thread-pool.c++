@@ -0,0 +1,272 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#if __linux__ && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "thread-pool.h"
+#include "debug.h"
+#include "mutex.h"
+#include "thread.h"
+#include "vector.h"
+#include <atomic>
+
+#if __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace kj {
+
+namespace {
+
+class WorkDeque {
+  // A fixed-capacity Chase-Lev work-stealing deque. Only the owning worker calls push() and
+  // pop(), which work on the bottom end; other workers call steal(), which takes from the top.
+  //
+  // See "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al., PPoPP 2013).
+
+public:
+  static constexpr size_t CAPACITY = 256;
+
+  WorkDeque() {
+    for (auto& slot: slots) slot.store(nullptr, std::memory_order_relaxed);
+  }
+
+  size_t spaceAvailable() const {
+    // Owner only.
+    return CAPACITY - (bottom.load(std::memory_order_relaxed) -
+                       top.load(std::memory_order_acquire));
+  }
+
+  void push(_::ThreadPoolTask* task) {
+    // Owner only. The caller must have checked spaceAvailable().
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    KJ_DASSERT(b - top.load(std::memory_order_acquire) < int64_t(CAPACITY));
+    slots[b & MASK].store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  _::ThreadPoolTask* pop() {
+    // Owner only.
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      // Empty.
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    _::ThreadPoolTask* task = slots[b & MASK].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last item; race against stealers for it.
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                       std::memory_order_relaxed)) {
+        task = nullptr;
+      }
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  _::ThreadPoolTask* steal() {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+
+    _::ThreadPoolTask* task = slots[t & MASK].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      // Lost the race to another thief or the owner.
+      return nullptr;
+    }
+    return task;
+  }
+
+private:
+  static constexpr size_t MASK = CAPACITY - 1;
+
+  alignas(64) std::atomic<int64_t> top {0};
+  alignas(64) std::atomic<int64_t> bottom {0};
+  std::atomic<_::ThreadPoolTask*> slots[CAPACITY];
+};
+
+}  // namespace
+
+class ThreadPool::Impl {
+public:
+  Impl(uint threadCount, bool pinThreads): deques(kj::heapArray<WorkDeque>(threadCount)) {
+    KJ_REQUIRE(threadCount > 0, "ThreadPool needs at least one thread");
+
+#if __linux__
+    kj::Vector<int> cpus;
+    if (pinThreads) {
+      cpu_set_t allowed;
+      CPU_ZERO(&allowed);
+      KJ_SYSCALL(sched_getaffinity(0, sizeof(allowed), &allowed));
+      for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed)) cpus.add(cpu);
+      }
+    }
+#else
+    (void)pinThreads;
+#endif
+
+    threads.reserve(threadCount);
+    for (uint i = 0; i < threadCount; i++) {
+#if __linux__
+      int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+#else
+      int cpu = -1;
+#endif
+      threads.add(kj::heap<Thread>([this, i, cpu]() {
+        if (cpu >= 0) pinToCpu(cpu);
+        workerLoop(i);
+      }));
+    }
+  }
+
+  ~Impl() noexcept(false) {
+    shared.lockExclusive()->shuttingDown = true;
+
+    // Join all the threads.
+    threads.clear();
+
+    // Workers drain everything before exiting, so there's nothing left to free.
+    KJ_ASSERT(shared.getWithoutLock().queue.empty());
+  }
+
+  uint getThreadCount() const { return deques.size(); }
+
+  void submit(FunctionParam<_::ThreadPoolTask*()> makeTask) const {
+    auto lock = shared.lockExclusive();
+    KJ_ASSERT(!lock->shuttingDown);
+    // Make room first, so that nothing can throw between allocating the task and queueing it.
+    lock->queue.reserve(lock->queue.size() + 1);
+    lock->queue.add(makeTask());
+    // Releasing the lock wakes any idle worker, since its wait condition is now true.
+  }
+
+private:
+  struct Shared {
+    kj::Vector<_::ThreadPoolTask*> queue;
+    size_t queueStart = 0;
+    // Tasks submitted but not yet taken by a worker are queue[queueStart...].
+
+    bool shuttingDown = false;
+
+    bool empty() const { return queueStart == queue.size(); }
+  };
+
+  kj::Array<WorkDeque> deques;
+  MutexGuarded<Shared> shared;
+  kj::Vector<Own<Thread>> threads;
+
+  static void pinToCpu(int cpu) {
+#if __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+      KJ_LOG(WARNING, "couldn't pin ThreadPool worker to CPU", cpu, strerror(error));
+    }
+#endif
+  }
+
+  _::ThreadPoolTask* trySteal(uint self) {
+    for (uint i = 1; i < deques.size(); i++) {
+      _::ThreadPoolTask* task = deques[(self + i) % deques.size()].steal();
+      if (task != nullptr) return task;
+    }
+    return nullptr;
+  }
+
+  _::ThreadPoolTask* takeFromQueue(uint self) {
+    // Takes a batch of submitted tasks, returning one and pushing the rest onto this worker's
+    // deque where other workers can steal them. Blocks until there is work. Returns null on
+    // shutdown once no submitted work remains.
+
+    auto& deque = deques[self];
+    auto lock = shared.lockExclusive();
+    lock.wait([](const Shared& s) { return !s.empty() || s.shuttingDown; });
+
+    if (lock->empty()) {
+      return nullptr;
+    }
+
+    // Take a fair share of the queue, so that other workers woken by the same submissions find
+    // some left.
+    size_t available = lock->queue.size() - lock->queueStart;
+    size_t count = kj::min(kj::max(available / deques.size(), size_t(1)),
+                           deque.spaceAvailable() + 1);
+    auto task = lock->queue[lock->queueStart++];
+    for (size_t i = 1; i < count; i++) {
+      deque.push(lock->queue[lock->queueStart++]);
+    }
+
+    if (lock->empty()) {
+      lock->queue.clear();
+      lock->queueStart = 0;
+    }
+    return task;
+  }
+
+  void workerLoop(uint self) {
+    auto& deque = deques[self];
+    for (;;) {
+      _::ThreadPoolTask* task = deque.pop();
+      if (task == nullptr) task = trySteal(self);
+      if (task == nullptr) task = takeFromQueue(self);
+      if (task == nullptr) break;
+
+      // Tasks catch their own exceptions, but be defensive since a throw would otherwise kill
+      // the whole pool.
+      KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+        KJ_DEFER(delete task);
+        task->run();
+      })) {
+        KJ_LOG(ERROR, "uncaught exception in ThreadPool task", exception);
+      }
+    }
+  }
+};
+
+ThreadPool::ThreadPool(uint threadCount, bool pinThreads)
+    : impl(kj::heap<Impl>(threadCount, pinThreads)) {}
+ThreadPool::~ThreadPool() noexcept(false) {}
+
+uint ThreadPool::getThreadCount() const {
+  return impl->getThreadCount();
+}
+
+void ThreadPool::submit(FunctionParam<_::ThreadPoolTask*()> makeTask) const {
+  impl->submit(makeTask);
+}
+
+}  // namespace kj
@@ -0,0 +1,129 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include "async.h"
+#include "function.h"
+
+KJ_BEGIN_HEADER
+
+namespace kj {
+
+namespace _ {  // private
+
+class ThreadPoolTask {
+public:
+  virtual ~ThreadPoolTask() noexcept(false) = default;
+  virtual void run() = 0;
+};
+
+template <typename T, typename Func>
+class ThreadPoolTaskImpl final: public ThreadPoolTask {
+public:
+  ThreadPoolTaskImpl(Func&& func, Own<CrossThreadPromiseFulfiller<T>> fulfiller)
+      : func(kj::fwd<Func>(func)), fulfiller(kj::mv(fulfiller)) {}
+
+  void run() override {
+    if (!fulfiller->isWaiting()) {
+      // The promise was canceled before we got to it.
+      return;
+    }
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+      if constexpr (isSameType<T, void>()) {
+        func();
+        fulfiller->fulfill();
+      } else {
+        fulfiller->fulfill(func());
+      }
+    })) {
+      fulfiller->reject(kj::mv(exception));
+    }
+  }
+
+private:
+  Decay<Func> func;
+  Own<CrossThreadPromiseFulfiller<T>> fulfiller;
+};
+
+}  // namespace _ (private)
+
+class ThreadPool {
+  // A fixed set of worker threads for running CPU-bound functions -- decompression, encoding,
+  // validation, etc. -- without blocking an event loop. Any thread with an event loop can call
+  // run() and get back a promise which resolves on that thread's loop.
+  //
+  // Each worker keeps its own queue of tasks, from which it takes the most recent first. Idle
+  // workers steal the oldest tasks from other workers' queues, so a burst of submissions spreads
+  // across all workers without contending on a single lock. Submissions themselves go through a
+  // shared queue, from which workers take tasks in batches.
+
+public:
+  explicit ThreadPool(uint threadCount, bool pinThreads = false);
+  // Starts `threadCount` workers. If `pinThreads` is true, each worker is pinned to one of the
+  // CPUs this process may run on (round-robin), to keep its caches warm. Pinning is only
+  // supported on Linux and is ignored elsewhere.
+
+  KJ_DISALLOW_COPY_AND_MOVE(ThreadPool);
+  ~ThreadPool() noexcept(false);
+  // Waits for all submitted tasks to finish, then stops the workers. Tasks whose promises have
+  // already been dropped are skipped.
+
+  template <typename Func>
+  PromiseForResult<Func, void> run(Func&& func) const;
+  // Runs `func()` on some worker and returns a promise for its result, belonging to the calling
+  // thread's event loop. `func` must not return a promise, since workers have no event loop. It
+  // is destroyed on the worker thread, so anything it captures must be safe to destroy there.
+  //
+  // Dropping the promise cancels the task if it hasn't started yet; once started, it runs to
+  // completion and the result is discarded.
+
+  uint getThreadCount() const;
+
+private:
+  class Impl;
+  Own<Impl> impl;
+
+  void submit(FunctionParam<_::ThreadPoolTask*()> makeTask) const;
+  // Calls `makeTask()` to allocate the task only once it's certain to be queued, and takes
+  // ownership of the result. Doing it this way around means nothing leaks if submission fails.
+};
+
+// =======================================================================================
+// inline implementation details
+
+template <typename Func>
+PromiseForResult<Func, void> ThreadPool::run(Func&& func) const {
+  typedef _::ReturnType<Func, void> T;
+  static_assert(isSameType<PromiseForResult<Func, void>, Promise<T>>(),
+      "ThreadPool::run() can't run functions returning promises");
+
+  auto paf = newPromiseAndCrossThreadFulfiller<T>();
+  submit([&]() -> _::ThreadPoolTask* {
+    return new _::ThreadPoolTaskImpl<T, Func>(kj::fwd<Func>(func), kj::mv(paf.fulfiller));
+  });
+  return kj::mv(paf.promise);
+}
+
+}  // namespace kj
+
+KJ_END_HEADER
@@ -21,6 +21,8 @@
 
 #include "thread.h"
 #include "debug.h"
+#include "vector.h"
+#include <atomic>
 
 #if _WIN32
 #include <windows.h>
@@ -154,4 +156,43 @@ void* Thread::runThread(void* ptr) {
   return 0;
 }
 
+namespace _ {  // private
+
+void runInParallel(uint threadCount, size_t count,
+                   FunctionParam<void(uint thread, size_t index)> func) {
+  KJ_IREQUIRE(threadCount > 0);
+
+  std::atomic<size_t> next(0);
+  std::atomic<bool> failed(false);
+  auto work = [&](uint thread) {
+    // If any thread fails, the others stop early. The first failure is rethrown below.
+    KJ_ON_SCOPE_FAILURE(failed.store(true, std::memory_order_relaxed));
+    while (!failed.load(std::memory_order_relaxed)) {
+      size_t i = next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= count) break;
+      func(thread, i);
+    }
+  };
+
+  kj::Vector<kj::Own<Thread>> threads(threadCount - 1);
+  for (uint i = 1; i < threadCount; i++) {
+    threads.add(kj::heap<Thread>([&work, i]() { work(i); }));
+  }
+  kj::Maybe<kj::Exception> firstException = kj::runCatchingExceptions([&]() { work(0); });
+
+  for (auto& thread: threads) {
+    // Joins the thread, rethrowing its exception, if any.
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { thread = nullptr; })) {
+      if (firstException == kj::none) {
+        firstException = kj::mv(exception);
+      }
+    }
+  }
+  KJ_IF_SOME(exception, firstException) {
+    kj::throwRecoverableException(kj::mv(exception));
+  }
+}
+
+}  // namespace _ (private)
+
 }  // namespace kj
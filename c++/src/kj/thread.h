@@ -77,6 +77,18 @@ private:
 #endif
 };
 
+namespace _ {  // private
+
+void runInParallel(uint threadCount, size_t count,
+                   FunctionParam<void(uint thread, size_t index)> func);
+// Calls `func(thread, index)` for every index in [0, count), spread across `threadCount` threads
+// including the calling one, which are numbered 0 (the caller) to threadCount - 1. Each thread
+// takes the next unclaimed index whenever it finishes one, so uneven work balances out. If a call
+// throws, the other threads stop taking indices, and once all have stopped the first exception is
+// rethrown (as a recoverable exception).
+
+}  // namespace _ (private)
+
 }  // namespace kj
 
 KJ_END_HEADER
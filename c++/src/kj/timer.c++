@@ -22,7 +22,13 @@
 
 #include "timer.h"
 #include "debug.h"
-#include <set>
+#include "list.h"
+#include "vector.h"
+#include <algorithm>
+
+#if _MSC_VER && !defined(__clang__)
+#include <intrin.h>
+#endif
 
 namespace kj {
 
@@ -30,64 +36,259 @@ kj::Exception Timer::makeTimeoutException() {
   return KJ_EXCEPTION(OVERLOADED, "operation timed out");
 }
 
-struct TimerImpl::Impl {
-  struct TimerBefore {
-    bool operator()(TimerPromiseAdapter* lhs, TimerPromiseAdapter* rhs) const;
-  };
-  using Timers = std::multiset<TimerPromiseAdapter*, TimerBefore>;
-  Timers timers;
-};
+namespace {
+
+inline uint highestBit(uint64_t value) {
+  // Index of the most significant set bit. Undefined for value = 0.
+#if _MSC_VER && !defined(__clang__)
+  unsigned long i;
+  _BitScanReverse64(&i, value);
+  return i;
+#else
+  return 63 - __builtin_clzll(value);
+#endif
+}
+
+inline uint lowestBit(uint64_t value) {
+  // Index of the least significant set bit. Undefined for value = 0.
+#if _MSC_VER && !defined(__clang__)
+  unsigned long i;
+  _BitScanForward64(&i, value);
+  return i;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+}  // namespace
 
 class TimerImpl::TimerPromiseAdapter {
 public:
-  TimerPromiseAdapter(PromiseFulfiller<void>& fulfiller, TimerImpl& parent, TimePoint time)
-      : time(time), fulfiller(fulfiller), parent(parent) {
-    pos = parent.impl->timers.insert(this);
+  TimerPromiseAdapter(PromiseFulfiller<void>& fulfiller, TimerImpl& parent, TimePoint time);
+  ~TimerPromiseAdapter();
 
-    KJ_IF_SOME(h, parent.sleepHooks) {
-      if (pos == parent.impl->timers.begin()) {
-        h.updateNextTimerEvent(time);
-      }
-    }
+  void fulfill() { fulfiller.fulfill(); }
+
+  const TimePoint time;
+
+private:
+  PromiseFulfiller<void>& fulfiller;
+  TimerImpl& parent;
+
+  uint64_t tick;
+  uint8_t level;
+  uint8_t slot;
+  ListLink<TimerPromiseAdapter> link;
+
+  friend struct TimerImpl::Impl;
+};
+
+struct TimerImpl::Impl {
+  // A hierarchical timing wheel.
+  //
+  // Time is divided into ticks of 2^TICK_SHIFT nanoseconds (about a millisecond), counted from
+  // the timer's start time. Each level of the wheel has 64 slots, and a timer is filed at the
+  // level corresponding to the highest 6-bit digit in which its tick differs from the current
+  // tick, in the slot given by that digit. So, level 0 holds timers due within the current block
+  // of 64 ticks, level 1 holds timers due within the current block of 4096 ticks, and so on.
+  // Inserting and cancelling are O(1) and allocate nothing, since each slot is an intrusive list.
+  // When the current tick reaches the start of a slot at a higher level, that slot's timers are
+  // redistributed to lower levels. Timers in the same level-0 slot are sorted by their exact
+  // times when they fire, so callbacks run in the same order as they always have.
+
+  static constexpr uint LEVEL_BITS = 6;
+  static constexpr uint SLOTS = 1u << LEVEL_BITS;
+  static constexpr uint LEVELS = 8;
+  static constexpr uint TICK_SHIFT = 20;
+  // Ticks are at most 64 - TICK_SHIFT = 44 bits, which fits in LEVELS * LEVEL_BITS = 48.
+
+  using Slot = List<TimerPromiseAdapter, &TimerPromiseAdapter::link>;
+
+  explicit Impl(TimePoint startTime): startTime(startTime) {}
+
+  const TimePoint startTime;
+  uint64_t currentTick = 0;
+  size_t timerCount = 0;
+
+  Slot slots[LEVELS][SLOTS];
+  uint64_t occupied[LEVELS] = {};
+  // Bit N of occupied[L] is set if slots[L][N] is non-empty.
+
+  Maybe<TimePoint> nextEventCache;
+  bool nextEventCacheValid = true;
+  // Cached result of nextEvent(). Inserting a timer can update the cache cheaply, but cancelling
+  // the timer which the cache refers to, or firing timers, forces a recompute.
+
+  Vector<TimerPromiseAdapter*> firing;
+  // Scratch space for advanceTo(), kept around to avoid reallocating.
+
+  uint64_t tickFor(TimePoint time) const {
+    if (time <= startTime) return 0;
+    return uint64_t((time - startTime) / NANOSECONDS) >> TICK_SHIFT;
+  }
+
+  TimePoint timeForTick(uint64_t tick) const {
+    return startTime + int64_t(tick << TICK_SHIFT) * NANOSECONDS;
   }
 
-  ~TimerPromiseAdapter() {
-    if (pos != parent.impl->timers.end()) {
-      KJ_IF_SOME(h, parent.sleepHooks) {
-        bool isFirst = pos == parent.impl->timers.begin();
+  uint64_t slotStartTick(uint level, uint slot) const {
+    // The first tick covered by the given slot, given the current tick.
+    uint shift = LEVEL_BITS * level;
+    uint64_t blockMask = (uint64_t(1) << (shift + LEVEL_BITS)) - 1;
+    return (currentTick & ~blockMask) | (uint64_t(slot) << shift);
+  }
 
-        parent.impl->timers.erase(pos);
+  void insert(TimerPromiseAdapter& timer) {
+    // A timer whose time has already passed is filed in the current tick's slot, so that it
+    // fires on the next advanceTo().
+    uint64_t tick = kj::max(timer.tick, currentTick);
+    uint64_t diff = tick ^ currentTick;
+    uint level = diff == 0 ? 0 : highestBit(diff) / LEVEL_BITS;
+    uint slot = (tick >> (LEVEL_BITS * level)) & (SLOTS - 1);
 
-        if (isFirst) {
-          if (parent.impl->timers.empty()) {
-            h.updateNextTimerEvent(kj::none);
-          } else {
-            h.updateNextTimerEvent((*parent.impl->timers.begin())->time);
-          }
-        }
+    timer.level = level;
+    timer.slot = slot;
+    slots[level][slot].add(timer);
+    occupied[level] |= uint64_t(1) << slot;
+    ++timerCount;
+
+    if (nextEventCacheValid) {
+      KJ_IF_SOME(next, nextEventCache) {
+        if (timer.time < next) nextEventCache = timer.time;
       } else {
-        parent.impl->timers.erase(pos);
+        nextEventCache = timer.time;
       }
     }
   }
 
-  void fulfill() {
-    fulfiller.fulfill();
-    parent.impl->timers.erase(pos);
-    pos = parent.impl->timers.end();
+  void remove(TimerPromiseAdapter& timer) {
+    Slot& slot = slots[timer.level][timer.slot];
+    slot.remove(timer);
+    if (slot.empty()) {
+      occupied[timer.level] &= ~(uint64_t(1) << timer.slot);
+    }
+
+    if (--timerCount == 0) {
+      nextEventCache = kj::none;
+      nextEventCacheValid = true;
+    } else if (nextEventCache == timer.time) {
+      nextEventCacheValid = false;
+    }
   }
 
-  const TimePoint time;
+  Maybe<TimePoint> nextEvent() {
+    if (!nextEventCacheValid) {
+      nextEventCache = computeNextEvent();
+      nextEventCacheValid = true;
+    }
+    return nextEventCache;
+  }
 
-private:
-  PromiseFulfiller<void>& fulfiller;
-  TimerImpl& parent;
-  Impl::Timers::const_iterator pos;
+  Maybe<TimePoint> computeNextEvent() {
+    for (uint level = 0; level < LEVELS; level++) {
+      if (occupied[level] == 0) continue;
+
+      uint slot = lowestBit(occupied[level]);
+      if (level > 0) {
+        // Everything at this level fires after the start of the slot, so that's a safe time to
+        // wake up. We'll find the exact time once the slot has been redistributed, rather than
+        // scanning what could be a very large list of mostly-to-be-cancelled timers.
+        return timeForTick(slotStartTick(level, slot));
+      }
+
+      auto iter = slots[0][slot].begin();
+      TimePoint result = iter->time;
+      for (++iter; iter != slots[0][slot].end(); ++iter) {
+        result = kj::min(result, iter->time);
+      }
+      return result;
+    }
+
+    return kj::none;
+  }
+
+  void advanceTo(TimePoint time) {
+    nextEventCacheValid = false;
+    uint64_t targetTick = tickFor(time);
+
+    for (;;) {
+      // Find the earliest non-empty slot. Lower levels always come before higher levels.
+      uint level = 0;
+      while (level < LEVELS && occupied[level] == 0) ++level;
+      if (level == LEVELS) break;
+
+      uint slot = lowestBit(occupied[level]);
+      uint64_t startTick = slotStartTick(level, slot);
+      if (startTick > targetTick) break;
+      currentTick = startTick;
+
+      Slot& list = slots[level][slot];
+      if (level > 0) {
+        // Redistribute the slot's timers relative to the new current tick.
+        occupied[level] &= ~(uint64_t(1) << slot);
+        while (!list.empty()) {
+          TimerPromiseAdapter& timer = list.front();
+          list.remove(timer);
+          --timerCount;
+          insert(timer);
+        }
+        continue;
+      }
+
+      firing.clear();
+      for (auto& timer: list) {
+        if (timer.time <= time) {
+          firing.add(&timer);
+        }
+      }
+      for (auto timer: firing) {
+        remove(*timer);
+      }
+      std::stable_sort(firing.begin(), firing.end(),
+          [](TimerPromiseAdapter* a, TimerPromiseAdapter* b) { return a->time < b->time; });
+      for (auto timer: firing) {
+        timer->fulfill();
+      }
+
+      if (!list.empty()) {
+        // The rest of this slot is still in the future, hence so is everything else.
+        break;
+      }
+    }
+
+    currentTick = kj::max(currentTick, targetTick);
+    nextEventCacheValid = false;
+  }
 };
 
-inline bool TimerImpl::Impl::TimerBefore::operator()(
-    TimerPromiseAdapter* lhs, TimerPromiseAdapter* rhs) const {
-  return lhs->time < rhs->time;
+TimerImpl::TimerPromiseAdapter::TimerPromiseAdapter(
+    PromiseFulfiller<void>& fulfiller, TimerImpl& parent, TimePoint time)
+    : time(time), fulfiller(fulfiller), parent(parent), tick(parent.impl->tickFor(time)) {
+  KJ_IF_SOME(h, parent.sleepHooks) {
+    auto before = parent.impl->nextEvent();
+    parent.impl->insert(*this);
+    auto after = parent.impl->nextEvent();
+    if (after != before) {
+      h.updateNextTimerEvent(after);
+    }
+  } else {
+    parent.impl->insert(*this);
+  }
+}
+
+TimerImpl::TimerPromiseAdapter::~TimerPromiseAdapter() {
+  if (link.isLinked()) {
+    KJ_IF_SOME(h, parent.sleepHooks) {
+      auto before = parent.impl->nextEvent();
+      parent.impl->remove(*this);
+      auto after = parent.impl->nextEvent();
+      if (after != before) {
+        h.updateNextTimerEvent(after);
+      }
+    } else {
+      parent.impl->remove(*this);
+    }
+  }
 }
 
 TimePoint TimerImpl::now() const {
@@ -108,17 +309,12 @@ Promise<void> TimerImpl::afterDelay(Duration delay) {
 }
 
 TimerImpl::TimerImpl(TimePoint startTime)
-    : time(startTime), impl(heap<Impl>()) {}
+    : time(startTime), impl(heap<Impl>(startTime)) {}
 
 TimerImpl::~TimerImpl() noexcept(false) {}
 
 Maybe<TimePoint> TimerImpl::nextEvent() {
-  auto iter = impl->timers.begin();
-  if (iter == impl->timers.end()) {
-    return kj::none;
-  } else {
-    return (*iter)->time;
-  }
+  return impl->nextEvent();
 }
 
 Maybe<uint64_t> TimerImpl::timeoutToNextEvent(TimePoint start, Duration unit, uint64_t max) {
@@ -152,13 +348,7 @@ void TimerImpl::advanceTo(TimePoint newTime) {
   time = newTime;
 #endif
 
-  for (;;) {
-    auto front = impl->timers.begin();
-    if (front == impl->timers.end() || (*front)->time > time) {
-      break;
-    }
-    (*front)->fulfill();
-  }
+  impl->advanceTo(time);
 }
 
 }  // namespace kj
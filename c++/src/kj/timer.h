@@ -88,6 +88,10 @@ public:
   Maybe<TimePoint> nextEvent();
   // Returns the time at which the next scheduled timer event will occur, or null if no timer
   // events are scheduled.
+  //
+  // When the next event is far in the future, this may return an earlier time, at which point
+  // advanceTo() will not fire anything but will narrow down the estimate. Callers should simply
+  // wait until the returned time, advance, and ask again.
 
   Maybe<uint64_t> timeoutToNextEvent(TimePoint start, Duration unit, uint64_t max);
   // Convenience method which computes a timeout value to pass to an event-waiting system call to